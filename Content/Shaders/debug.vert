@@ -0,0 +1,13 @@
+#version 330 core
+// Lines and solid shapes from DebugDraw (grid, gizmos)
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec4 aColor;
+
+uniform mat4 uViewProj;
+
+out vec4 vColor;
+
+void main() {
+    vColor = aColor;
+    gl_Position = uViewProj * vec4(aPos, 1.0);
+}
@@ -0,0 +1,136 @@
+#version 330 core
+in vec4 vColor;
+#ifdef DIFFUSE_TEXTURE
+in vec3 vTexCoord;
+uniform sampler2DArray uDiffuse;
+#endif
+#ifdef LIGHTING
+in vec3 vWorldPos;
+in vec3 vNormal;
+in vec2 vSurface;
+
+// Written by LightClusters::Bind (src/render/light_clusters.h)
+uniform samplerBuffer uLightData;     // 3 texels per light
+uniform usamplerBuffer uClusterGrid;  // (offset, count) per cluster
+uniform usamplerBuffer uLightIndices;
+uniform vec4 uClusterDims;     // tiles x, tiles y, slices, orthographic
+uniform vec4 uClusterViewport; // x, y, width, height
+uniform vec4 uClusterDepth;    // near, far, slice scale, slice bias
+uniform vec3 uCameraPos;
+uniform vec3 uAmbient;
+uniform vec3 uSunDirection; // towards the sun
+uniform vec3 uSunColor;     // black when there is no sun
+
+#ifdef SHADOWS
+// Written by ShadowCascades::Bind (src/render/shadow_cascades.h); 3 cascades
+uniform sampler2DArrayShadow uShadowMap;
+uniform mat4 uShadowMatrices[3];
+uniform vec4 uCascadeSplits; // view distance where each cascade ends
+uniform vec4 uCascadeTexels; // world size of a shadow texel per cascade
+
+float SunVisibility(vec3 N, float depth) {
+    int cascade = int(dot(step(uCascadeSplits.xyz, vec3(depth)), vec3(1.0)));
+    if (cascade >= 3)
+        return 1.0;
+    // Normal offset keeps surfaces from shadowing themselves (acne)
+    vec3 pos = vWorldPos + N * (1.5 * uCascadeTexels[cascade]);
+    vec4 coord = uShadowMatrices[cascade] * vec4(pos, 1.0);
+    // 2x2 bilinear compares: a 3x3 texel tent
+    float texel = 1.0 / float(textureSize(uShadowMap, 0).x);
+    float sum = 0.0;
+    for (int i = 0; i < 4; ++i) {
+        vec2 offset = (vec2(i & 1, i >> 1) - 0.5) * texel;
+        sum += texture(uShadowMap, vec4(coord.xy + offset, float(cascade), coord.z));
+    }
+    return sum * 0.25;
+}
+#endif
+
+float ViewDepth() {
+    float zNear = uClusterDepth.x;
+    float zFar = uClusterDepth.y;
+    if (uClusterDims.w > 0.5)
+        return mix(zNear, zFar, gl_FragCoord.z);
+    float ndcZ = gl_FragCoord.z * 2.0 - 1.0;
+    return 2.0 * zNear * zFar / (zFar + zNear - ndcZ * (zFar - zNear));
+}
+
+int ClusterIndex(float depth) {
+    vec2 tile = (gl_FragCoord.xy - uClusterViewport.xy) * uClusterDims.xy /
+                uClusterViewport.zw;
+    // Linear slices when orthographic
+    float z = uClusterDims.w > 0.5 ? depth : log(depth);
+    float slice = z * uClusterDepth.z + uClusterDepth.w;
+    ivec3 cell = clamp(ivec3(vec3(tile, slice)), ivec3(0),
+                       ivec3(uClusterDims.xyz) - 1);
+    return (cell.z * int(uClusterDims.y) + cell.y) * int(uClusterDims.x) +
+           cell.x;
+}
+
+// Lambert + normalized Blinn-Phong; metallic tints the highlight and
+// removes the diffuse term, roughness widens the highlight
+vec3 Brdf(vec3 N, vec3 V, vec3 L, vec3 diffuse, vec3 f0, float shininess) {
+    vec3 H = normalize(L + V);
+    float spec = pow(max(dot(N, H), 0.0), shininess) * (shininess + 8.0) / 25.13274;
+    return max(dot(N, L), 0.0) * (diffuse + f0 * spec);
+}
+
+vec3 Shade(vec3 albedo) {
+    vec3 N = normalize(vNormal);
+    vec3 V = normalize(uCameraPos - vWorldPos);
+    float metallic = vSurface.x;
+    float shininess = exp2(11.0 * (1.0 - vSurface.y) + 1.0);
+    vec3 diffuse = albedo * (1.0 - metallic);
+    vec3 f0 = mix(vec3(0.04), albedo, metallic);
+    float depth = ViewDepth();
+
+    vec3 result = uAmbient * albedo;
+    vec3 sun = uSunColor;
+#ifdef SHADOWS
+    if (dot(N, uSunDirection) > 0.0)
+        sun *= SunVisibility(N, depth);
+#endif
+    result += sun * Brdf(N, V, uSunDirection, diffuse, f0, shininess);
+
+    uvec2 cluster = texelFetch(uClusterGrid, ClusterIndex(depth)).xy;
+    for (uint i = 0u; i < cluster.y; ++i) {
+        int light = int(texelFetch(uLightIndices, int(cluster.x + i)).r) * 3;
+        vec4 posRange = texelFetch(uLightData, light);
+        vec4 colorInner = texelFetch(uLightData, light + 1);
+        vec4 dirOuter = texelFetch(uLightData, light + 2);
+
+        vec3 L = posRange.xyz - vWorldPos;
+        float dist = length(L);
+        L /= max(dist, 1e-4);
+        // Smooth window to zero at the range, inverse square inside it
+        float window = clamp(1.0 - pow(dist / posRange.w, 4.0), 0.0, 1.0);
+        float attenuation = window * window / (dist * dist + 1.0);
+        // Point lights store cos angles below -1: always 1
+        attenuation *= smoothstep(dirOuter.w, colorInner.w, dot(-L, dirOuter.xyz));
+
+        result += colorInner.rgb * attenuation * Brdf(N, V, L, diffuse, f0, shininess);
+    }
+    return result;
+}
+#endif
+
+out vec4 FragColor;
+
+void main() {
+    vec3 color = vColor.rgb;
+#ifdef DIFFUSE_TEXTURE
+    color *= texture(uDiffuse, vTexCoord).rgb;
+#endif
+#ifdef LIGHTING
+    vec3 albedo = color;
+    color = Shade(albedo);
+#ifdef EMISSION
+    // Emissive surfaces glow regardless of the lights
+    color += albedo * vColor.a;
+#endif
+#elif defined(EMISSION)
+    // Emissive surfaces are brightened up to 2x
+    color *= 1.0 + vColor.a;
+#endif
+    FragColor = vec4(color, 1.0);
+}
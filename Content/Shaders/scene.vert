@@ -0,0 +1,56 @@
+#version 330 core
+// Scene objects. Permutation defines (see src/shaders/shader_library.h):
+//   SELECTION_TINT  selected objects, tinted in the shader instead of on the CPU
+//   EMISSION        colour alpha carries the material emission in [0, 1]
+//   WORLD_SPACE     positions are already in world space (chunk batches)
+//   DIFFUSE_TEXTURE material colour is modulated by a layer (or an atlas rect
+//                   of a layer) of the uDiffuse array, chosen per instance
+//   LIGHTING        sun plus point/spot lights from the light clusters
+//   SHADOWS         sun shadows from the cascades (with LIGHTING)
+layout (location = 0) in vec3 aPos;
+#ifndef WORLD_SPACE
+layout (location = 2) in mat4 aModel;
+#endif
+layout (location = 6) in vec4 aColor;
+#ifdef DIFFUSE_TEXTURE
+layout (location = 7) in vec2 aTexCoord;
+layout (location = 8) in vec4 aTexRect;   // uv offset (xy), scale (zw)
+layout (location = 9) in float aTexLayer;
+out vec3 vTexCoord;
+#endif
+#ifdef LIGHTING
+layout (location = 1) in vec3 aNormal;
+layout (location = 10) in vec2 aSurface;  // metallic, roughness
+out vec3 vWorldPos;
+out vec3 vNormal;
+out vec2 vSurface;
+#endif
+
+uniform mat4 uViewProj;
+
+out vec4 vColor;
+
+void main() {
+    vColor = aColor;
+#ifdef DIFFUSE_TEXTURE
+    vTexCoord = vec3(aTexRect.xy + aTexCoord * aTexRect.zw, aTexLayer);
+#endif
+#ifdef SELECTION_TINT
+    vColor.rgb *= vec3(1.2, 0.8, 0.4);
+#endif
+#ifdef WORLD_SPACE
+    vec4 worldPos = vec4(aPos, 1.0);
+#else
+    vec4 worldPos = aModel * vec4(aPos, 1.0);
+#endif
+#ifdef LIGHTING
+    vWorldPos = worldPos.xyz;
+#ifdef WORLD_SPACE
+    vNormal = aNormal;
+#else
+    vNormal = transpose(inverse(mat3(aModel))) * aNormal;
+#endif
+    vSurface = aSurface;
+#endif
+    gl_Position = uViewProj * worldPos;
+}
@@ -0,0 +1,17 @@
+#version 330 core
+// Depth-only casters of the shadow cascades (src/render/shadow_cascades.h).
+//   WORLD_SPACE  positions are already in world space (chunk batches)
+layout (location = 0) in vec3 aPos;
+#ifndef WORLD_SPACE
+layout (location = 2) in mat4 aModel;
+#endif
+
+uniform mat4 uViewProj; // cascade light view-projection
+
+void main() {
+#ifdef WORLD_SPACE
+    gl_Position = uViewProj * vec4(aPos, 1.0);
+#else
+    gl_Position = uViewProj * aModel * vec4(aPos, 1.0);
+#endif
+}
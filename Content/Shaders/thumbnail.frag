@@ -0,0 +1,65 @@
+#version 330 core
+// Fixed studio lighting: the previews are compared side by side, so they
+// never depend on the scene's lights
+#ifdef MESH
+in vec3 vNormal;
+uniform vec3 uColor;
+#else
+in vec2 vPoint;
+flat in vec4 vColor;
+flat in vec4 vSurface;
+flat in vec4 vTexRect;
+uniform sampler2DArray uDiffuse;
+#endif
+
+out vec4 FragColor;
+
+const vec3 KEY_DIRECTION = vec3(-0.48, 0.64, 0.6);  // towards the light
+const vec3 FILL_DIRECTION = vec3(0.7, -0.1, 0.7);
+const vec3 AMBIENT = vec3(0.18);
+
+// Same terms as scene.frag
+vec3 Brdf(vec3 N, vec3 V, vec3 L, vec3 diffuse, vec3 f0, float shininess) {
+    vec3 H = normalize(L + V);
+    float spec = pow(max(dot(N, H), 0.0), shininess) * (shininess + 8.0) / 25.13274;
+    return max(dot(N, L), 0.0) * (diffuse + f0 * spec);
+}
+
+vec3 Shade(vec3 N, vec3 albedo, float metallic, float roughness) {
+    vec3 V = vec3(0.0, 0.0, 1.0);
+    float shininess = exp2(11.0 * (1.0 - roughness) + 1.0);
+    vec3 diffuse = albedo * (1.0 - metallic);
+    vec3 f0 = mix(vec3(0.04), albedo, metallic);
+    vec3 result = AMBIENT * albedo;
+    result += 0.9 * Brdf(N, V, normalize(KEY_DIRECTION), diffuse, f0, shininess);
+    result += 0.35 * Brdf(N, V, normalize(FILL_DIRECTION), diffuse, f0, shininess);
+    return result;
+}
+
+void main() {
+#ifdef MESH
+    vec3 N = normalize(vNormal);
+    if (!gl_FrontFacing)
+        N = -N;
+    FragColor = vec4(Shade(N, uColor, 0.0, 0.6), 1.0);
+#else
+    float r = length(vPoint);
+    // One pixel of coverage ramp on the silhouette
+    float coverage = clamp((1.0 - r) / max(fwidth(r), 1e-4), 0.0, 1.0);
+    if (coverage <= 0.0)
+        discard;
+    vec3 N = vec3(vPoint, sqrt(max(1.0 - r * r, 0.0)));
+    vec3 albedo = vColor.rgb;
+    if (vSurface.w > 0.5) {
+        // Longitude/latitude mapping; the seam is on the hidden side
+        vec2 uv = vec2(atan(N.x, N.z) * 0.1591549 + 0.5,
+                       acos(clamp(-N.y, -1.0, 1.0)) * 0.3183099);
+        albedo *= texture(uDiffuse, vec3(vTexRect.xy + uv * vTexRect.zw,
+                                         vSurface.z)).rgb;
+    }
+    vec3 color = Shade(N, albedo, vSurface.x, vSurface.y);
+    // Emissive surfaces glow regardless of the lights
+    color += albedo * vColor.a;
+    FragColor = vec4(color, coverage);
+#endif
+}
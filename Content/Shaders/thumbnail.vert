@@ -0,0 +1,38 @@
+#version 330 core
+// Asset previews of the content browser (src/editor/thumbnail_service.h).
+// Permutation defines:
+//   MESH  a model's triangles; otherwise one quad per material, shaded as
+//         an analytic sphere
+#ifdef MESH
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+
+uniform mat4 uViewProj;
+uniform mat4 uView;
+
+out vec3 vNormal; // view space, like the lights
+#else
+layout (location = 0) in vec2 aCorner;    // unit quad
+layout (location = 1) in vec4 aCell;      // NDC origin (xy), size (zw)
+layout (location = 2) in vec4 aColor;     // rgb, emission
+layout (location = 3) in vec4 aSurface;   // metallic, roughness, layer, textured
+layout (location = 4) in vec4 aTexRect;   // uv offset (xy), scale (zw)
+
+out vec2 vPoint; // [-1, 1] across the sphere
+flat out vec4 vColor;
+flat out vec4 vSurface;
+flat out vec4 vTexRect;
+#endif
+
+void main() {
+#ifdef MESH
+    vNormal = mat3(uView) * aNormal;
+    gl_Position = uViewProj * vec4(aPos, 1.0);
+#else
+    vPoint = aCorner * 2.0 - 1.0;
+    vColor = aColor;
+    vSurface = aSurface;
+    vTexRect = aTexRect;
+    gl_Position = vec4(aCell.xy + aCorner * aCell.zw, 0.0, 1.0);
+#endif
+}
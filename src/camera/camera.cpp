@@ -12,6 +12,7 @@ bool rightMousePressed = false;
 float camPos[3] = {0.0f, 1.2f, 4.0f};
 float camFront[3] = {0.0f, 0.0f, -1.0f};
 float camUp[3] = {0.0f, 1.0f, 0.0f};
+bool camScrollEnabled = true;
 
 void init_camera(unsigned int width, unsigned int height) {
   lastX = static_cast<float>(width) * 0.5f;
@@ -19,7 +20,8 @@ void init_camera(unsigned int width, unsigned int height) {
 }
 
 void framebuffer_size_callback(GLFWwindow *window, int width, int height) {
-  glViewport(0, 0, width, height);
+  // El viewport se fija cada frame en Application::Run a traves de
+  // GLStateCache; llamar glViewport aqui desincronizaria la cache.
 }
 
 void mouse_callback(GLFWwindow *window, double xpos, double ypos) {
@@ -66,6 +68,8 @@ void mouse_button_callback(GLFWwindow *window, int button, int action,
 }
 
 void scroll_callback(GLFWwindow *window, double xoffset, double yoffset) {
+  if (!camScrollEnabled)
+    return;
   float speed = 0.5f;
   camPos[0] += camFront[0] * (float)yoffset * speed;
   camPos[1] += camFront[1] * (float)yoffset * speed;
@@ -13,6 +13,8 @@ extern bool firstMouse;
 extern float camPos[3];
 extern float camFront[3];
 extern float camUp[3];
+// Off while the wheel belongs to another view (e.g. an orthographic panel)
+extern bool camScrollEnabled;
 
 void init_camera(unsigned int width, unsigned int height);
 void framebuffer_size_callback(GLFWwindow *window, int width, int height);
@@ -0,0 +1,79 @@
+#include "view_camera.h"
+#include "camera.h"
+#include <algorithm>
+#include <cmath>
+
+ViewCamera::ViewCamera(Mode mode) : m_Mode(mode) {}
+
+const char *ViewCamera::GetName() const {
+  switch (m_Mode) {
+  case Mode::Top:
+    return "Top";
+  case Mode::Front:
+    return "Front";
+  case Mode::Side:
+    return "Side";
+  default:
+    return "Perspective";
+  }
+}
+
+void ViewCamera::SyncFromFlyCamera() {
+  const float *pos = get_camera_position();
+  const float *front = get_camera_front();
+  const float *up = get_camera_up();
+  std::copy(pos, pos + 3, m_Position);
+  std::copy(front, front + 3, m_Front);
+  std::copy(up, up + 3, m_Up);
+}
+
+void ViewCamera::GetAxes(float front[3], float up[3]) const {
+  // Top looks down with -Z up on screen; Front looks along -Z; Side along -X
+  const float axes[3][2][3] = {{{0.0f, -1.0f, 0.0f}, {0.0f, 0.0f, -1.0f}},
+                               {{0.0f, 0.0f, -1.0f}, {0.0f, 1.0f, 0.0f}},
+                               {{-1.0f, 0.0f, 0.0f}, {0.0f, 1.0f, 0.0f}}};
+  const int i = m_Mode == Mode::Top ? 0 : m_Mode == Mode::Front ? 1 : 2;
+  std::copy(axes[i][0], axes[i][0] + 3, front);
+  std::copy(axes[i][1], axes[i][1] + 3, up);
+}
+
+void ViewCamera::Pan(float dx, float dy, float viewportHeight) {
+  if (!IsOrthographic() || viewportHeight <= 0.0f)
+    return;
+  float front[3], up[3], right[3];
+  GetAxes(front, up);
+  vec3_cross(front, up, right);
+  const float unitsPerPixel = 2.0f * m_HalfHeight / viewportHeight;
+  for (int k = 0; k < 3; ++k)
+    m_Target[k] += (-dx * right[k] + dy * up[k]) * unitsPerPixel;
+}
+
+void ViewCamera::Zoom(float steps) {
+  m_HalfHeight = std::min(std::max(m_HalfHeight * std::pow(0.9f, steps),
+                                   MIN_HALF_HEIGHT),
+                          MAX_HALF_HEIGHT);
+}
+
+void ViewCamera::SetTarget(const float target[3]) {
+  std::copy(target, target + 3, m_Target);
+}
+
+Mat4 ViewCamera::GetView() const {
+  if (!IsOrthographic())
+    return create_view_matrix(m_Position, m_Front, m_Up);
+  float front[3], up[3], eye[3];
+  GetAxes(front, up);
+  for (int k = 0; k < 3; ++k)
+    eye[k] = m_Target[k] - front[k] * ORTHO_DISTANCE;
+  return create_view_matrix(eye, front, up);
+}
+
+Mat4 ViewCamera::GetProjection(float aspect) const {
+  if (!IsOrthographic())
+    return mat4_perspective(FOV_DEGREES * 3.1415926f / 180.0f, aspect,
+                            NEAR_PLANE, FAR_PLANE);
+  // Near stays well above zero: the light clusters slice depth
+  // logarithmically
+  return mat4_orthographic(m_HalfHeight * aspect, m_HalfHeight, 1.0f,
+                           2.0f * ORTHO_DISTANCE);
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "../utils/math_utils.h"
+
+// Camera of one scene viewport. The perspective camera mirrors the fly
+// camera driven by the GLFW callbacks (camera.cpp); the orthographic ones
+// look down a world axis at a target point and are panned and zoomed by
+// their viewport.
+class ViewCamera {
+public:
+  enum class Mode { Perspective, Top, Front, Side };
+
+  static constexpr float FOV_DEGREES = 45.0f;
+  static constexpr float NEAR_PLANE = 0.1f;
+  static constexpr float FAR_PLANE = 100.0f;
+  // Orthographic eye distance from the target; depth covers twice that
+  static constexpr float ORTHO_DISTANCE = 200.0f;
+  static constexpr float MIN_HALF_HEIGHT = 0.5f;
+  static constexpr float MAX_HALF_HEIGHT = 500.0f;
+
+  explicit ViewCamera(Mode mode = Mode::Perspective);
+
+  Mode GetMode() const { return m_Mode; }
+  bool IsOrthographic() const { return m_Mode != Mode::Perspective; }
+  const char *GetName() const;
+
+  // Perspective: copies the fly camera's position and orientation
+  void SyncFromFlyCamera();
+
+  // Orthographic: moves the target by a mouse delta in pixels of a viewport
+  // viewportHeight pixels tall, so the scene follows the cursor
+  void Pan(float dx, float dy, float viewportHeight);
+  // Orthographic: > 0 zooms in, one step per wheel notch
+  void Zoom(float steps);
+  void SetTarget(const float target[3]);
+  const float *GetTarget() const { return m_Target; }
+  float GetHalfHeight() const { return m_HalfHeight; }
+
+  Mat4 GetView() const;
+  Mat4 GetProjection(float aspect) const;
+
+private:
+  // World axes the orthographic modes look along
+  void GetAxes(float front[3], float up[3]) const;
+
+  Mode m_Mode;
+  float m_Position[3] = {0.0f, 0.0f, 0.0f}; // perspective
+  float m_Front[3] = {0.0f, 0.0f, -1.0f};
+  float m_Up[3] = {0.0f, 1.0f, 0.0f};
+  float m_Target[3] = {0.0f, 0.0f, 0.0f}; // orthographic
+  float m_HalfHeight = 10.0f;             // world units, half the view
+};
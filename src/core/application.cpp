@@ -1,10 +1,20 @@
 #include "application.h"
 #include "../camera/camera.h"
 #include "../editor/editor_layer.h"
+#include "../project/project_manager.h"
+#include "../render/frame_capture.h"
+#include "../render/gl_state_cache.h"
+#include "../render/render_target.h"
+#include "../render/texture_cache.h"
+#include "../render/texture_manager.h"
 #include "../scene/scene.h"
-#include "../shaders/shader.h"
+#include "../shaders/program_cache.h"
+#include "../shaders/shader_library.h"
 #include "imgui.h"
+#include <algorithm>
 #include <cmath>
+#include <cstdio>
+#include <cstring>
 #include <iostream>
 
 // Forward declaration if not included
@@ -19,6 +29,48 @@ Application::~Application() {
   // glfwTerminate(); // Cuidado si se llama multiple veces
 }
 
+bool Application::ParseArgs(int argc, char **argv) {
+  for (int i = 1; i < argc; ++i) {
+    const char *arg = argv[i];
+    const char *value = i + 1 < argc ? argv[i + 1] : nullptr;
+    bool ok = true;
+    if (std::strcmp(arg, "--headless") == 0) {
+      m_Options.headless = true;
+      continue;
+    } else if (!value) {
+      ok = false;
+    } else if (std::strcmp(arg, "--project") == 0) {
+      m_Options.project = value;
+    } else if (std::strcmp(arg, "--output") == 0) {
+      m_Options.output = value;
+    } else if (std::strcmp(arg, "--format") == 0) {
+      m_Options.format = value;
+    } else if (std::strcmp(arg, "--size") == 0) {
+      ok = std::sscanf(value, "%dx%d", &m_Options.width, &m_Options.height) ==
+               2 &&
+           m_Options.width > 0 && m_Options.height > 0;
+    } else if (std::strcmp(arg, "--frames") == 0) {
+      ok = std::sscanf(value, "%d", &m_Options.frames) == 1 &&
+           m_Options.frames > 0;
+    } else if (std::strcmp(arg, "--warmup") == 0) {
+      ok = std::sscanf(value, "%d", &m_Options.warmup) == 1 &&
+           m_Options.warmup >= 0;
+    } else {
+      ok = false;
+    }
+    if (!ok) {
+      std::cerr << "Opcion invalida: " << arg << "\n"
+                << "Uso: MarioEngine [--headless] [--project file] "
+                   "[--output file|dir] [--format png|ppm|raw] [--size WxH] "
+                   "[--frames N] [--warmup N]"
+                << std::endl;
+      return false;
+    }
+    i++; // value consumed
+  }
+  return true;
+}
+
 bool Application::Init() {
   // 1. Inicializar GLFW
   if (!glfwInit()) {
@@ -29,7 +81,10 @@ bool Application::Init() {
   glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
   glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
   glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-  glfwWindowHint(GLFW_MAXIMIZED, GLFW_TRUE);
+  if (m_Options.headless)
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE); // only provides the context
+  else
+    glfwWindowHint(GLFW_MAXIMIZED, GLFW_TRUE);
 
   // 2. Crear Ventana
   m_Window =
@@ -57,7 +112,16 @@ bool Application::Init() {
   }
 
   // Config global OpenGL
-  glEnable(GL_DEPTH_TEST);
+  GLStateCache::Get().SetEnabled(GL_DEPTH_TEST, true);
+
+  // Binarios de programas compilados (arranque en caliente)
+  Shader::setProgramCacheDir("shader_cache");
+  // Familias de shaders con permutaciones por #define
+  ShaderLibrary::Get().Init("Content/Shaders");
+  // Texturas: decodificacion en workers, subida por PBO con presupuesto.
+  // Las importadas se guardan ya comprimidas y con mips en la cache.
+  TextureCache::SetDirectory("texture_cache");
+  TextureManager::Get().Init();
 
   // Icono (placeholder logic)
 
@@ -72,22 +136,12 @@ void Application::Run() {
   EditorLayer editor;
   editor.Init(m_Window);
 
-  // Shader (Temporary location)
-  const char *vs3D = R"(#version 330 core
-layout (location = 0) in vec3 aPos;
-uniform mat4 uMVP;
-void main(){ gl_Position = uMVP * vec4(aPos, 1.0); }
-)";
-  const char *fs3D = R"(#version 330 core
-uniform vec4 uColor;
-out vec4 FragColor;
-void main(){ FragColor = uColor; }
-)";
-  GLuint shaderProgram = Shader::createProgram(vs3D, fs3D);
-
   // Loop
   while (!glfwWindowShouldClose(m_Window)) {
     glfwPollEvents();
+    GLStateCache::Get().BeginFrame();
+    ShaderLibrary::Get().Poll();
+    TextureManager::Get().Update();
 
     // Input logic (Camera)
     // Note: Camera handling is still effectively global/static in camera.cpp
@@ -103,22 +157,70 @@ void main(){ FragColor = uColor; }
     if (vpW_gizmo <= 0) vpW_gizmo = 800;
     if (vpH_gizmo <= 0) vpH_gizmo = 600;
     
+    // The main panel's camera follows the fly camera
+    ViewCamera &camera = editor.GetCamera();
+    camera.SyncFromFlyCamera();
     float aspect_gizmo = vpW_gizmo / vpH_gizmo;
-    Mat4 proj_gizmo = mat4_perspective(45.0f * 3.1415926f / 180.0f, aspect_gizmo, 0.1f, 100.0f);
-    Mat4 view_gizmo = create_view_matrix(get_camera_position(), get_camera_front(), get_camera_up());
+    Mat4 proj_gizmo = camera.GetProjection(aspect_gizmo);
+    Mat4 view_gizmo = camera.GetView();
     
     // --- INPUT: Gizmo Interaction ---
     editor.HandleGizmoInput(scene, m_Window, view_gizmo, proj_gizmo);
 
     // --- INPUT: Selection (only if not dragging gizmo and mouse is in viewport) ---
+    // Released without moving: picks the cube under the cursor. Dragged:
+    // selects the cubes inside the rectangle. Shift adds, ctrl toggles.
     static bool mousePressedLastFrame = false;
+    static bool selecting = false;
+    static float selectStart[2] = {0.0f, 0.0f};
     bool mousePressed =
         glfwGetMouseButton(m_Window, GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS;
+    const bool shiftDown =
+        glfwGetKey(m_Window, GLFW_KEY_LEFT_SHIFT) == GLFW_PRESS ||
+        glfwGetKey(m_Window, GLFW_KEY_RIGHT_SHIFT) == GLFW_PRESS;
+    const bool ctrlDown =
+        glfwGetKey(m_Window, GLFW_KEY_LEFT_CONTROL) == GLFW_PRESS ||
+        glfwGetKey(m_Window, GLFW_KEY_RIGHT_CONTROL) == GLFW_PRESS;
+    const EditorLayer::SelectMode selectMode =
+        ctrlDown ? EditorLayer::SelectMode::Toggle
+                 : shiftDown ? EditorLayer::SelectMode::Add
+                             : EditorLayer::SelectMode::Replace;
     
     float viewportMouseX, viewportMouseY;
     bool mouseInViewport = editor.GetMousePosInViewport(viewportMouseX, viewportMouseY);
     
-    if (mousePressed && !mousePressedLastFrame && mouseInViewport && !editor.IsDraggingGizmo() && !editor.IsHoveringGizmo()) {
+    if (mousePressed && !mousePressedLastFrame && mouseInViewport && !editor.IsDraggingGizmo() && !editor.IsHoveringGizmo() && !editor.IsBusy()) {
+      selecting = true;
+      selectStart[0] = viewportMouseX;
+      selectStart[1] = viewportMouseY;
+    }
+    bool pick = false;
+    if (selecting) {
+      // The rectangle follows the cursor outside the panel too
+      double cursorX, cursorY;
+      glfwGetCursorPos(m_Window, &cursorX, &cursorY);
+      float panelX, panelY;
+      editor.GetSceneViewportPos(panelX, panelY);
+      const float endX = (float)cursorX - panelX;
+      const float endY = (float)cursorY - panelY;
+      const bool dragged = std::fabs(endX - selectStart[0]) > 4.0f ||
+                           std::fabs(endY - selectStart[1]) > 4.0f;
+      editor.SetSelectionRect(mousePressed && dragged, selectStart[0],
+                              selectStart[1], endX, endY);
+      if (!mousePressed) {
+        selecting = false;
+        if (dragged)
+          editor.SelectInRect(scene, selectStart[0], selectStart[1], endX,
+                              endY, mat4_mul(proj_gizmo, view_gizmo),
+                              selectMode);
+        else
+          pick = true;
+      }
+    }
+
+    if (pick) {
+      viewportMouseX = selectStart[0];
+      viewportMouseY = selectStart[1];
       // Get viewport size for raycast
       float vpW, vpH;
       editor.GetSceneViewportSize(vpW, vpH);
@@ -194,52 +296,125 @@ void main(){ FragColor = uColor; }
       int hit = scene.Raycast(get_camera_position(), world_dir);
 
       // Handle selection
-      if (hit != -1) {
-        // Deselect all
-        for (auto &c : scene.GetCubes())
-          c.selected = false;
-        scene.GetCubes()[hit].selected = true;
-        editor.SetSelectedCubeIndex(hit);
-      } else {
-        for (auto &c : scene.GetCubes())
-          c.selected = false;
-        editor.SetSelectedCubeIndex(-1);
-      }
+      editor.PickCube(scene, hit >= 0 ? scene.GetHandle(hit) : EntityHandle{},
+                      selectMode);
     }
     mousePressedLastFrame = mousePressed;
 
+    // UI first: the panel size it settles on is the one rendered this frame
+    editor.BuildUI(scene);
+
     // Get viewport size from editor
     float vpWidth, vpHeight;
     editor.GetSceneViewportSize(vpWidth, vpHeight);
     if (vpWidth <= 0) vpWidth = 800;
     if (vpHeight <= 0) vpHeight = 600;
 
-    // Render scene to framebuffer
-    editor.BeginSceneRender();
-    
     float aspect = vpWidth / vpHeight;
-    Mat4 proj =
-        mat4_perspective(45.0f * 3.1415926f / 180.0f, aspect, 0.1f, 100.0f);
-    Mat4 view = create_view_matrix(get_camera_position(), get_camera_front(),
-                                   get_camera_up());
-
-    scene.Render(view, proj, shaderProgram);
-    scene.RenderGizmos(view, proj, shaderProgram, editor.GetSelectedCubeIndex(),
-                       editor.GetTransformMode(), editor.GetHoveredAxis(),
-                       editor.IsLocalSpace());
-    
-    editor.EndSceneRender();
+    Mat4 proj = camera.GetProjection(aspect);
+    Mat4 view = camera.GetView();
 
-    // Render main window
+    // Scene, gizmos and the editor UI, as render graph passes
     int display_w, display_h;
     glfwGetFramebufferSize(m_Window, &display_w, &display_h);
-    glViewport(0, 0, display_w, display_h);
-    glClearColor(0.15f, 0.15f, 0.15f, 1.0f);
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-    // Editor Render (ImGui)
-    editor.Render(scene);
+    editor.RenderFrame(scene, view, proj, display_w, display_h);
 
     glfwSwapBuffers(m_Window);
   }
 }
+
+bool Application::RunHeadless() {
+  const LaunchOptions &opt = m_Options;
+  Scene scene;
+  scene.Init();
+  if (!opt.project.empty()) {
+    ProjectData data;
+    if (!ProjectManager::LoadProject(opt.project, data)) {
+      std::cerr << "No se pudo cargar el proyecto " << opt.project
+                << std::endl;
+      return false;
+    }
+    scene.LoadFromProject(data);
+  }
+
+  RenderTarget target;
+  target.Init(true);
+  target.Reserve(opt.width, opt.height);
+  FrameCapture capture;
+  capture.Init();
+  capture.SetBlocking(true); // every frame, however long it takes
+
+  // Same camera and projection as the editor's scene panel
+  init_camera(opt.width, opt.height);
+  const Mat4 proj = mat4_perspective(45.0f * 3.1415926f / 180.0f,
+                                     (float)opt.width / opt.height, 0.1f,
+                                     100.0f);
+  const Mat4 view = create_view_matrix(
+      get_camera_position(), get_camera_front(), get_camera_up());
+
+  GLStateCache &gl = GLStateCache::Get();
+  auto renderFrame = [&]() {
+    glfwPollEvents();
+    gl.BeginFrame();
+    ShaderLibrary::Get().Poll();
+    TextureManager::Get().Update();
+    gl.BindFramebuffer(target.GetFramebuffer());
+    gl.Viewport(0, 0, opt.width, opt.height);
+    gl.ClearColor(0.1f, 0.1f, 0.1f, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    scene.Render(view, proj);
+  };
+
+  // Deterministic images: wait until every shader variant and texture is
+  // resident (and chunk rebuilds have had frames to land)
+  const int maxWarmup = std::max(opt.warmup, 1) * 20;
+  int warmup = 0;
+  for (; warmup < maxWarmup; ++warmup) {
+    renderFrame();
+    glFinish();
+    const TextureStats &textures = TextureManager::Get().GetStats();
+    const bool settled = ShaderLibrary::Get().GetStats().pending == 0 &&
+                         textures.decoding == 0 && textures.uploading == 0;
+    if (warmup >= opt.warmup && settled)
+      break;
+  }
+
+  if (opt.frames == 1) {
+    capture.Screenshot(opt.output);
+  } else {
+    ImageWriter::Format format;
+    if (!ImageWriter::FormatFromPath("." + opt.format, format)) {
+      std::cerr << "Formato desconocido: " << opt.format << std::endl;
+      return false;
+    }
+    capture.StartSequence(opt.output, format);
+  }
+  for (int i = 0; i < opt.frames; ++i) {
+    renderFrame();
+    capture.Capture(target.GetFramebuffer(), opt.width, opt.height);
+    glFlush();
+  }
+  capture.StopSequence();
+  capture.Flush();
+
+  const CaptureStats stats = capture.GetStats();
+  std::cout << "Headless: " << warmup << " warm-up frames, "
+            << stats.written << "/" << stats.requested << " frames written to "
+            << opt.output << " (dropped " << stats.droppedRing << " ring, "
+            << stats.droppedEncoder << " encoder, " << stats.failed
+            << " failed)" << std::endl;
+  // Last frame: the draw and texture array bind counts of the project
+  const RenderStats &render = scene.GetRenderStats();
+  const TextureStats &textures = TextureManager::Get().GetStats();
+  std::cout << "Headless: " << render.instances << " objects, "
+            << render.drawCalls << " draw calls, " << render.textureBinds
+            << " texture binds, " << textures.resident
+            << " textures resident" << std::endl;
+  // Cold start with an empty shader_cache/, warm on the next run
+  const Shader::ProgramCacheStats &cache = Shader::getProgramCacheStats();
+  std::cout << "Headless: shaders " << cache.hits << " from cache ("
+            << cache.loadMs << " ms), " << cache.misses << " compiled ("
+            << cache.compileMs << " ms), " << cache.rejected
+            << " stale entries rebuilt" << std::endl;
+  return stats.failed == 0 && stats.written == stats.requested;
+}
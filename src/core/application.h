@@ -4,16 +4,35 @@
 #include <GLFW/glfw3.h>
 #include <string>
 
+// Opciones de linea de comandos (ver Application::ParseArgs)
+struct LaunchOptions {
+    // --headless: no editor; renders the scene into an off-screen target,
+    // captures it and exits (automated image diffs)
+    bool headless = false;
+    std::string project;                // --project <file>
+    std::string output = "capture.png"; // --output <file | directory>
+    std::string format = "png";         // --format png|ppm|raw (sequences)
+    int width = 1280, height = 720;     // --size WxH
+    int frames = 1;   // --frames N; more than 1 writes a sequence to output/
+    int warmup = 30;  // --warmup N: minimum frames before capturing
+};
+
 class Application {
 public:
     Application();
     ~Application();
 
+    // false (and a usage message) on unknown or malformed options
+    bool ParseArgs(int argc, char **argv);
+    bool IsHeadless() const { return m_Options.headless; }
+
     // Inicializa GLFW, ventana y contextos
     bool Init();
 
     // Loop principal (Aún no implementado completamente)
     void Run();
+    // Headless capture run; false if anything could not be written
+    bool RunHeadless();
 
     // Obtener la ventana cruda (para transición)
     GLFWwindow* GetWindow() const { return m_Window; }
@@ -23,4 +42,5 @@ private:
     int m_Width;
     int m_Height;
     std::string m_Title;
+    LaunchOptions m_Options;
 };
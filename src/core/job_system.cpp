@@ -0,0 +1,105 @@
+#include "job_system.h"
+#include <algorithm>
+
+JobSystem &JobSystem::Get() {
+  // At least one worker so submitted background jobs always make progress
+  static JobSystem instance(
+      std::max(2u, std::thread::hardware_concurrency()) - 1);
+  return instance;
+}
+
+JobSystem::JobSystem(unsigned workerCount) {
+  m_Workers.reserve(workerCount);
+  for (unsigned i = 0; i < workerCount; ++i)
+    m_Workers.emplace_back([this] { WorkerLoop(); });
+}
+
+JobSystem::~JobSystem() {
+  {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    m_Stop = true;
+  }
+  m_CV.notify_all();
+  for (auto &t : m_Workers)
+    t.join();
+}
+
+void JobSystem::Submit(std::function<void()> job) {
+  {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    m_Queue.push_back(std::move(job));
+  }
+  m_CV.notify_one();
+}
+
+void JobSystem::SubmitBackground(std::function<void()> job) {
+  {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    m_Background.push_back(std::move(job));
+  }
+  m_CV.notify_one();
+}
+
+bool JobSystem::RunOneJob() {
+  std::function<void()> job;
+  {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    if (m_Queue.empty())
+      return false;
+    job = std::move(m_Queue.front());
+    m_Queue.pop_front();
+  }
+  job();
+  return true;
+}
+
+void JobSystem::WorkerLoop() {
+  for (;;) {
+    std::function<void()> job;
+    {
+      std::unique_lock<std::mutex> lock(m_Mutex);
+      m_CV.wait(lock, [this] {
+        return m_Stop || !m_Queue.empty() || !m_Background.empty();
+      });
+      if (m_Stop && m_Queue.empty())
+        return;
+      std::deque<std::function<void()>> &queue =
+          m_Queue.empty() ? m_Background : m_Queue;
+      job = std::move(queue.front());
+      queue.pop_front();
+    }
+    job();
+  }
+}
+
+void JobSystem::ParallelFor(size_t count, size_t minChunk,
+                            const std::function<void(size_t, size_t)> &fn) {
+  if (count == 0)
+    return;
+  minChunk = std::max<size_t>(1, minChunk);
+  size_t chunks =
+      std::min<size_t>(GetThreadCount(), (count + minChunk - 1) / minChunk);
+  if (chunks <= 1) {
+    fn(0, count);
+    return;
+  }
+
+  const size_t chunkSize = (count + chunks - 1) / chunks;
+  std::atomic<size_t> remaining(chunks - 1);
+  for (size_t c = 1; c < chunks; ++c) {
+    size_t begin = c * chunkSize;
+    size_t end = std::min(count, begin + chunkSize);
+    Submit([&fn, &remaining, begin, end] {
+      if (begin < end)
+        fn(begin, end);
+      remaining.fetch_sub(1, std::memory_order_release);
+    });
+  }
+
+  // El hilo llamador procesa el primer rango y luego ayuda con la cola
+  fn(0, std::min(count, chunkSize));
+  while (remaining.load(std::memory_order_acquire) != 0) {
+    if (!RunOneJob())
+      std::this_thread::yield();
+  }
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Pool de hilos compartido por los sistemas del motor.
+// Jobs are plain std::function; ParallelFor blocks the caller, which helps
+// draining the queue while it waits so nested calls cannot deadlock.
+class JobSystem {
+public:
+  // Global pool sized to hardware_concurrency - 1 workers (at least one)
+  static JobSystem &Get();
+
+  explicit JobSystem(unsigned workerCount);
+  ~JobSystem();
+
+  JobSystem(const JobSystem &) = delete;
+  JobSystem &operator=(const JobSystem &) = delete;
+
+  // Threads that can run jobs, including the calling thread
+  unsigned GetThreadCount() const { return (unsigned)m_Workers.size() + 1; }
+
+  // Fire-and-forget job
+  void Submit(std::function<void()> job);
+  // Long fire-and-forget job (file decode, compression). Only workers run
+  // these, and only when the regular queue is empty, so a thread helping in
+  // ParallelFor never stalls on one. Pending ones are dropped at shutdown.
+  void SubmitBackground(std::function<void()> job);
+
+  // Splits [0, count) into at most GetThreadCount() ranges of at least
+  // minChunk elements and runs fn(begin, end) on each. Returns when done.
+  void ParallelFor(size_t count, size_t minChunk,
+                   const std::function<void(size_t, size_t)> &fn);
+
+private:
+  void WorkerLoop();
+  bool RunOneJob(); // returns false if the queue was empty
+
+  std::vector<std::thread> m_Workers;
+  std::deque<std::function<void()>> m_Queue;
+  std::deque<std::function<void()>> m_Background;
+  std::mutex m_Mutex;
+  std::condition_variable m_CV;
+  bool m_Stop = false;
+};
@@ -0,0 +1,60 @@
+#include "long_task.h"
+#include "job_system.h"
+
+float LongTask::GetElapsedSeconds() const {
+  return std::chrono::duration<float>(
+             std::chrono::high_resolution_clock::now() - m_Start)
+      .count();
+}
+
+void LongTaskRunner::Start(const std::string &name, LongTask::Step step,
+                           LongTask::Finish finish, LongTask::Work work,
+                           bool cancellable) {
+  auto task = std::make_shared<LongTask>();
+  task->m_Name = name;
+  task->m_Cancellable = cancellable;
+  task->m_Step = std::move(step);
+  task->m_Finish = std::move(finish);
+  task->m_Work = std::move(work);
+  m_Tasks.push_back(std::move(task));
+}
+
+void LongTaskRunner::Update() {
+  using clock = std::chrono::high_resolution_clock;
+  const auto frameStart = clock::now();
+  const auto deadline =
+      frameStart + std::chrono::microseconds((long long)(m_SliceMs * 1000.0f));
+
+  // A task finishing early in the slice lets the next one start in it
+  while (!m_Tasks.empty()) {
+    std::shared_ptr<LongTask> task = m_Tasks.front();
+    if (!task->m_Started) {
+      task->m_Started = true;
+      task->m_Start = frameStart;
+      if (task->m_Work) {
+        task->m_WorkDone.store(false, std::memory_order_relaxed);
+        JobSystem::Get().SubmitBackground([task] {
+          task->m_Work(*task);
+          task->m_WorkDone.store(true, std::memory_order_release);
+        });
+      }
+    }
+    if (!task->m_WorkDone.load(std::memory_order_acquire))
+      return; // polled again next frame
+
+    task->m_Deadline = deadline;
+    bool more = !task->IsCancelled() && task->m_Step && task->m_Step(*task);
+    if (more)
+      return;
+    if (task->m_Finish)
+      task->m_Finish(*task, task->IsCancelled());
+    m_Tasks.pop_front();
+    if (clock::now() >= deadline)
+      return;
+  }
+}
+
+void LongTaskRunner::Cancel() {
+  if (!m_Tasks.empty() && m_Tasks.front()->m_Cancellable)
+    m_Tasks.front()->m_Cancelled.store(true, std::memory_order_relaxed);
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+
+// Operation too long for one frame (project load, clear, bulk edits),
+// run cooperatively so the window keeps drawing. A task has up to three
+// phases:
+//   work   - optional; runs once on the job system's background queue
+//            (file parsing, encoding). It must not touch the scene.
+//   step   - main thread, called once per frame after the work until it
+//            returns false; it works in slices while HasTime() (the
+//            frame's budget) and commits to the scene.
+//   finish - main thread, once, told whether the task was cancelled.
+// Both work and step poll IsCancelled() and report progress.
+class LongTask {
+public:
+  using Work = std::function<void(LongTask &)>;
+  using Step = std::function<bool(LongTask &)>;
+  using Finish = std::function<void(LongTask &, bool cancelled)>;
+
+  const std::string &GetName() const { return m_Name; }
+  bool IsCancellable() const { return m_Cancellable; }
+  bool IsCancelled() const {
+    return m_Cancelled.load(std::memory_order_relaxed);
+  }
+  // Step: false once this frame's slice is used up
+  bool HasTime() const {
+    return std::chrono::high_resolution_clock::now() < m_Deadline;
+  }
+
+  // Any thread
+  void SetProgress(size_t done, size_t total) {
+    m_Progress.store(total ? (float)((double)done / (double)total) : 0.0f,
+                     std::memory_order_relaxed);
+  }
+  float GetProgress() const {
+    return m_Progress.load(std::memory_order_relaxed);
+  }
+  // Main thread (step, finish)
+  void SetStatus(const std::string &status) { m_Status = status; }
+  const std::string &GetStatus() const { return m_Status; }
+  float GetElapsedSeconds() const;
+  // Has had its first slice (or has its work running)
+  bool IsStarted() const { return m_Started; }
+
+private:
+  friend class LongTaskRunner;
+
+  std::string m_Name;
+  std::string m_Status;
+  bool m_Cancellable = true;
+  std::atomic<bool> m_Cancelled{false};
+  std::atomic<float> m_Progress{0.0f};
+  std::atomic<bool> m_WorkDone{true};
+  bool m_Started = false;
+  Work m_Work;
+  Step m_Step;
+  Finish m_Finish;
+  std::chrono::high_resolution_clock::time_point m_Start;
+  std::chrono::high_resolution_clock::time_point m_Deadline;
+};
+
+// Runs long tasks one at a time, in the order they were started, giving
+// the current one a slice of every frame.
+class LongTaskRunner {
+public:
+  // Per frame; at 8 ms a frame that otherwise takes up to 25 ms stays
+  // above 30 fps
+  static constexpr float DEFAULT_SLICE_MS = 8.0f;
+
+  // step may be null for a task that only has background work
+  void Start(const std::string &name, LongTask::Step step,
+             LongTask::Finish finish = nullptr, LongTask::Work work = nullptr,
+             bool cancellable = true);
+  // Once per frame, on the main thread: starts or polls the current
+  // task's work, runs one slice of its step, finishes it when done
+  void Update();
+  // Asks the current task to stop; it finishes (cancelled) at its next
+  // slice, or once its work returns
+  void Cancel();
+
+  bool IsBusy() const { return !m_Tasks.empty(); }
+  const LongTask *GetCurrent() const {
+    return m_Tasks.empty() ? nullptr : m_Tasks.front().get();
+  }
+  size_t GetQueued() const { return m_Tasks.size(); }
+
+  void SetSliceBudget(float ms) { m_SliceMs = ms; }
+  float GetSliceBudget() const { return m_SliceMs; }
+
+private:
+  // Shared with the job running a task's work
+  std::deque<std::shared_ptr<LongTask>> m_Tasks;
+  float m_SliceMs = DEFAULT_SLICE_MS;
+};
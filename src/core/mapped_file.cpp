@@ -0,0 +1,92 @@
+#include "mapped_file.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::~MappedFile() { Close(); }
+
+#ifdef _WIN32
+
+bool MappedFile::Open(const std::string &path) {
+  Close();
+  HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ,
+                            nullptr, OPEN_EXISTING,
+                            FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN,
+                            nullptr);
+  if (file == INVALID_HANDLE_VALUE)
+    return false;
+  LARGE_INTEGER size;
+  if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+    CloseHandle(file);
+    return false;
+  }
+  HANDLE mapping =
+      CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  if (!mapping) {
+    CloseHandle(file);
+    return false;
+  }
+  void *view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+  if (!view) {
+    CloseHandle(mapping);
+    CloseHandle(file);
+    return false;
+  }
+  m_File = file;
+  m_Mapping = mapping;
+  m_Data = static_cast<const uint8_t *>(view);
+  m_Size = (size_t)size.QuadPart;
+  return true;
+}
+
+void MappedFile::Close() {
+  if (m_Data)
+    UnmapViewOfFile(m_Data);
+  if (m_Mapping)
+    CloseHandle(m_Mapping);
+  if (m_File)
+    CloseHandle(m_File);
+  m_Data = nullptr;
+  m_Mapping = nullptr;
+  m_File = nullptr;
+  m_Size = 0;
+}
+
+#else
+
+bool MappedFile::Open(const std::string &path) {
+  Close();
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0)
+    return false;
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size == 0) {
+    close(fd);
+    return false;
+  }
+  void *view = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  // The mapping keeps its own reference to the file
+  close(fd);
+  if (view == MAP_FAILED)
+    return false;
+  m_Data = static_cast<const uint8_t *>(view);
+  m_Size = (size_t)st.st_size;
+  return true;
+}
+
+void MappedFile::Close() {
+  if (m_Data)
+    munmap(const_cast<uint8_t *>(m_Data), m_Size);
+  m_Data = nullptr;
+  m_Size = 0;
+}
+
+#endif
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Read-only memory mapping of a whole file (mmap / MapViewOfFile).
+// The pages are loaded on first touch by the OS, so "loading" a mapped file
+// costs nothing until its bytes are actually read.
+class MappedFile {
+public:
+  MappedFile() = default;
+  ~MappedFile();
+
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+
+  bool Open(const std::string &path);
+  void Close();
+
+  const uint8_t *Data() const { return m_Data; }
+  size_t Size() const { return m_Size; }
+
+private:
+  const uint8_t *m_Data = nullptr;
+  size_t m_Size = 0;
+#ifdef _WIN32
+  void *m_File = nullptr;
+  void *m_Mapping = nullptr;
+#endif
+};
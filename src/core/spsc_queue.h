@@ -0,0 +1,46 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <utility>
+
+// Bounded single-producer single-consumer ring. One thread pushes, one
+// thread pops; neither ever blocks, locks or allocates (the elements are
+// default-constructed up front and moved in and out). Head and tail live
+// on separate cache lines so the two threads don't share one.
+template <typename T, size_t Capacity> class SpscQueue {
+  static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0,
+                "SpscQueue capacity must be a power of two");
+
+public:
+  // Producer; false (value left untouched) if the ring is full
+  bool Push(T &&value) {
+    const size_t tail = m_Tail.load(std::memory_order_relaxed);
+    if (tail - m_Head.load(std::memory_order_acquire) == Capacity)
+      return false;
+    m_Items[tail & (Capacity - 1)] = std::move(value);
+    m_Tail.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Consumer; false if the ring is empty
+  bool Pop(T &out) {
+    const size_t head = m_Head.load(std::memory_order_relaxed);
+    if (head == m_Tail.load(std::memory_order_acquire))
+      return false;
+    out = std::move(m_Items[head & (Capacity - 1)]);
+    m_Head.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Either thread; only a snapshot
+  bool Empty() const {
+    return m_Head.load(std::memory_order_acquire) ==
+           m_Tail.load(std::memory_order_acquire);
+  }
+
+private:
+  T m_Items[Capacity];
+  alignas(64) std::atomic<size_t> m_Head{0}; // next to pop
+  alignas(64) std::atomic<size_t> m_Tail{0}; // next to push
+};
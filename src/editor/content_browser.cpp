@@ -0,0 +1,775 @@
+#include "content_browser.h"
+#include "../project/project_manager.h"
+#include "imgui.h"
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <iterator>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+static std::string Lowercase(std::string text) {
+  for (char &c : text)
+    c = (char)std::tolower((unsigned char)c);
+  return text;
+}
+
+static int CompareNoCase(const std::string &a, const std::string &b) {
+  const size_t count = std::min(a.size(), b.size());
+  for (size_t i = 0; i < count; ++i) {
+    const int ca = std::tolower((unsigned char)a[i]);
+    const int cb = std::tolower((unsigned char)b[i]);
+    if (ca != cb)
+      return ca < cb ? -1 : 1;
+  }
+  return a.size() == b.size() ? 0 : (a.size() < b.size() ? -1 : 1);
+}
+
+// Listing order: folders first, then by name ignoring case. Total, so
+// equivalent entries are the same entry.
+static bool ItemLess(const FileItem &a, const FileItem &b) {
+  if (a.isDirectory != b.isDirectory)
+    return a.isDirectory;
+  const int order = CompareNoCase(a.name, b.name);
+  return order != 0 ? order < 0 : a.name < b.name;
+}
+
+static bool ContainsNoCase(const std::string &text, const std::string &lower) {
+  auto it = std::search(text.begin(), text.end(), lower.begin(), lower.end(),
+                        [](char c, char l) {
+                          return std::tolower((unsigned char)c) == l;
+                        });
+  return it != text.end();
+}
+
+static std::string ParentOf(const std::string &dir) {
+  const size_t slash = dir.find_last_of('/');
+  return slash == std::string::npos ? dir : dir.substr(0, slash);
+}
+
+// path is dir or lies below it
+static bool IsUnder(const std::string &path, const std::string &dir) {
+  return path.compare(0, dir.size(), dir) == 0 &&
+         (path.size() == dir.size() || path[dir.size()] == '/');
+}
+
+// Removals, then additions (the worker keeps that order within a message);
+// entries already in (or already gone from) items are skipped. Positions
+// are found by binary search, then the array is rebuilt with moves only:
+// O(k log n) comparisons and O(n) moves for k changes.
+static void ApplyChanges(std::vector<FileItem> &items,
+                         std::vector<FileItem> &removed,
+                         std::vector<FileItem> &added) {
+  std::vector<size_t> positions;
+  for (const FileItem &item : removed) {
+    auto it = std::lower_bound(items.begin(), items.end(), item, ItemLess);
+    if (it != items.end() && !ItemLess(item, *it))
+      positions.push_back((size_t)(it - items.begin()));
+  }
+  if (!positions.empty()) {
+    std::sort(positions.begin(), positions.end());
+    size_t out = positions[0], next = 0;
+    for (size_t i = positions[0]; i < items.size(); ++i) {
+      if (next < positions.size() && positions[next] == i) {
+        while (next < positions.size() && positions[next] == i)
+          ++next;
+        continue;
+      }
+      items[out++] = std::move(items[i]);
+    }
+    items.resize(out);
+  }
+
+  std::sort(added.begin(), added.end(), ItemLess);
+  std::vector<FileItem *> fresh;
+  positions.clear();
+  for (size_t i = 0; i < added.size(); ++i) {
+    if (i > 0 && !ItemLess(added[i - 1], added[i]))
+      continue;
+    auto it = std::lower_bound(items.begin(), items.end(), added[i], ItemLess);
+    if (it != items.end() && !ItemLess(added[i], *it))
+      continue;
+    fresh.push_back(&added[i]);
+    positions.push_back((size_t)(it - items.begin()));
+  }
+  // From the back, each new entry goes before the old ones at or past its
+  // position
+  size_t source = items.size();
+  items.resize(items.size() + fresh.size());
+  size_t target = items.size();
+  for (size_t j = fresh.size(); j-- > 0;) {
+    while (source > positions[j])
+      items[--target] = std::move(items[--source]);
+    items[--target] = std::move(*fresh[j]);
+  }
+}
+
+static const char *TypeTag(FileType type) {
+  switch (type) {
+  case FILETYPE_FOLDER:
+    return "DIR";
+  case FILETYPE_TEXTURE:
+    return "IMG";
+  case FILETYPE_AUDIO:
+    return "SND";
+  case FILETYPE_MODEL:
+    return "MDL";
+  case FILETYPE_SCENE:
+    return "SCN";
+  case FILETYPE_MATERIAL:
+    return "MAT";
+  default:
+    return "...";
+  }
+}
+
+static const char *TypeName(FileType type) {
+  switch (type) {
+  case FILETYPE_FOLDER:
+    return "Folder";
+  case FILETYPE_TEXTURE:
+    return "Texture";
+  case FILETYPE_AUDIO:
+    return "Audio";
+  case FILETYPE_MODEL:
+    return "Model";
+  case FILETYPE_SCENE:
+    return "Scene";
+  case FILETYPE_MATERIAL:
+    return "Material";
+  default:
+    return "File";
+  }
+}
+
+static ImU32 TypeColor(FileType type) {
+  switch (type) {
+  case FILETYPE_FOLDER:
+    return IM_COL32(196, 156, 64, 255);
+  case FILETYPE_TEXTURE:
+    return IM_COL32(64, 140, 196, 255);
+  case FILETYPE_AUDIO:
+    return IM_COL32(150, 96, 196, 255);
+  case FILETYPE_MODEL:
+    return IM_COL32(72, 164, 108, 255);
+  case FILETYPE_SCENE:
+    return IM_COL32(196, 88, 72, 255);
+  case FILETYPE_MATERIAL:
+    return IM_COL32(196, 120, 160, 255);
+  default:
+    return IM_COL32(96, 96, 104, 255);
+  }
+}
+
+ContentBrowser::~ContentBrowser() { Shutdown(); }
+
+void ContentBrowser::Init(const std::string &root) {
+  m_Root = std::filesystem::path(root).lexically_normal().generic_string();
+  while (m_Root.size() > 1 && m_Root.back() == '/')
+    m_Root.pop_back();
+  m_ProjectExtension = Lowercase(ProjectManager::GetProjectExtension());
+#ifdef __linux__
+  m_Notify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (m_Notify < 0)
+    std::cerr << "Content browser: inotify unavailable, use Refresh"
+              << std::endl;
+  m_WakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+#endif
+  m_Stop.store(false);
+  m_Worker = std::thread([this] { WorkerLoop(); });
+  Open(m_Root);
+}
+
+void ContentBrowser::Shutdown() {
+  if (!m_Worker.joinable())
+    return;
+  m_Stop.store(true);
+  Wake();
+  m_Worker.join();
+#ifdef __linux__
+  if (m_Notify >= 0)
+    close(m_Notify);
+  if (m_WakeFd >= 0)
+    close(m_WakeFd);
+#endif
+  m_Notify = m_WakeFd = -1;
+  m_WatchDirs.clear();
+  m_DirWatches.clear();
+}
+
+FileType ContentBrowser::Classify(const std::string &name, bool isDirectory,
+                                  const std::string &projectExtension) {
+  if (isDirectory)
+    return FILETYPE_FOLDER;
+  const size_t dot = name.find_last_of('.');
+  if (dot == std::string::npos)
+    return FILETYPE_UNKNOWN;
+  const std::string ext = Lowercase(name.substr(dot));
+  if (ext == ".png" || ext == ".jpg" || ext == ".jpeg" || ext == ".bmp" ||
+      ext == ".tga" || ext == ".hdr")
+    return FILETYPE_TEXTURE;
+  if (ext == ".wav" || ext == ".ogg" || ext == ".mp3" || ext == ".flac")
+    return FILETYPE_AUDIO;
+  if (ext == ".obj" || ext == ".fbx" || ext == ".gltf" || ext == ".glb")
+    return FILETYPE_MODEL;
+  if (ext == ".scene" || ext == projectExtension)
+    return FILETYPE_SCENE;
+  if (ext == ".mat")
+    return FILETYPE_MATERIAL;
+  return FILETYPE_UNKNOWN;
+}
+
+// UI thread
+
+void ContentBrowser::Post(Request &&request) {
+  // Behind the ones already waiting, to keep their order
+  if (!m_Unsent.empty() || !m_Requests.Push(std::move(request))) {
+    m_Unsent.push_back(std::move(request));
+    return;
+  }
+  Wake();
+}
+
+void ContentBrowser::Open(const std::string &dir) {
+  m_Current = dir;
+  m_Selected.clear();
+  // Abandons the listing the worker may be busy with
+  const uint64_t generation = m_Generation.fetch_add(1) + 1;
+  Directory &entry = m_Dirs[dir];
+  entry.lastUsed = m_Frame;
+  // Also when a listing of it (a Refresh) was abandoned
+  if (!entry.complete || entry.listing) {
+    entry.listing = true;
+    Request request;
+    request.kind = Request::List;
+    request.dir = dir;
+    request.generation = generation;
+    Post(std::move(request));
+  }
+  Evict();
+}
+
+void ContentBrowser::Refresh() {
+  m_Dirs[m_Current].listing = true;
+  Request request;
+  request.kind = Request::List;
+  request.dir = m_Current;
+  request.generation = m_Generation.load();
+  Post(std::move(request));
+}
+
+void ContentBrowser::Evict() {
+  while (m_Dirs.size() > MAX_CACHED_DIRS) {
+    auto oldest = m_Dirs.end();
+    for (auto it = m_Dirs.begin(); it != m_Dirs.end(); ++it) {
+      if (it->first != m_Current &&
+          (oldest == m_Dirs.end() ||
+           it->second.lastUsed < oldest->second.lastUsed))
+        oldest = it;
+    }
+    if (oldest == m_Dirs.end())
+      return;
+    Request request;
+    request.kind = Request::Forget;
+    request.dir = oldest->first;
+    Post(std::move(request));
+    m_Dirs.erase(oldest);
+  }
+}
+
+void ContentBrowser::Update() {
+  ++m_Frame;
+  size_t sent = 0;
+  while (sent < m_Unsent.size() && m_Requests.Push(std::move(m_Unsent[sent])))
+    ++sent;
+  if (sent > 0) {
+    m_Unsent.erase(m_Unsent.begin(), m_Unsent.begin() + sent);
+    Wake();
+  }
+
+  // Whatever is left waits in the ring (and the worker with it)
+  const auto start = std::chrono::high_resolution_clock::now();
+  std::unique_ptr<Message> message;
+  while (m_Messages.Pop(message)) {
+    Apply(*message);
+    message.reset();
+    if (std::chrono::duration<float, std::milli>(
+            std::chrono::high_resolution_clock::now() - start)
+            .count() >= UPDATE_BUDGET_MS)
+      break;
+  }
+}
+
+void ContentBrowser::Apply(Message &message) {
+  if (message.kind == Message::Gone) {
+    for (auto it = m_Dirs.begin(); it != m_Dirs.end();) {
+      if (IsUnder(it->first, message.dir))
+        it = m_Dirs.erase(it);
+      else
+        ++it;
+    }
+    if (IsUnder(m_Current, message.dir)) {
+      // To its parent; if that went too, its own Gone follows
+      const std::string parent = ParentOf(message.dir);
+      Open(message.dir != m_Root && IsUnder(parent, m_Root) ? parent
+                                                            : m_Root);
+    }
+    return;
+  }
+  auto it = m_Dirs.find(message.dir);
+  if (it == m_Dirs.end())
+    return; // evicted since
+  Directory &dir = it->second;
+  if (message.kind == Message::Listing) {
+    if (message.first)
+      dir.incoming.clear();
+    dir.incoming.insert(dir.incoming.end(),
+                        std::make_move_iterator(message.items.begin()),
+                        std::make_move_iterator(message.items.end()));
+    if (message.last) {
+      dir.items.swap(dir.incoming);
+      std::vector<FileItem>().swap(dir.incoming);
+      dir.complete = true;
+      dir.listing = false;
+      dir.version++;
+    }
+    return;
+  }
+  if (m_Thumbnails) {
+    for (const std::vector<FileItem> *items :
+         {&message.removed, &message.items, &message.modified})
+      for (const FileItem &item : *items)
+        m_Thumbnails->Invalidate(item.path);
+  }
+  if (message.removed.empty() && message.items.empty())
+    return;
+  ApplyChanges(dir.items, message.removed, message.items);
+  dir.version++;
+}
+
+void ContentBrowser::UpdateVisible(const Directory &dir) {
+  if (m_VisibleDir == m_Current && m_VisibleVersion == dir.version &&
+      m_VisibleFilter == m_Filter)
+    return;
+  m_VisibleDir = m_Current;
+  m_VisibleVersion = dir.version;
+  m_VisibleFilter = m_Filter;
+  const std::string query = Lowercase(m_VisibleFilter);
+  m_Visible.clear();
+  for (size_t i = 0; i < dir.items.size(); ++i) {
+    if (query.empty() || ContainsNoCase(dir.items[i].name, query))
+      m_Visible.push_back((uint32_t)i);
+  }
+}
+
+bool ContentBrowser::Draw(FileItem &activated) {
+  DrawToolbar();
+
+  Directory &dir = m_Dirs[m_Current];
+  dir.lastUsed = m_Frame;
+  UpdateVisible(dir);
+  if (!dir.complete || dir.listing)
+    ImGui::TextDisabled("%s... %zu entries", dir.complete ? "Refreshing"
+                                                          : "Reading",
+                        m_Listed.load(std::memory_order_relaxed));
+  else if (m_Visible.size() != dir.items.size())
+    ImGui::TextDisabled("%zu of %zu items", m_Visible.size(),
+                        dir.items.size());
+  else
+    ImGui::TextDisabled("%zu items", dir.items.size());
+
+  const bool result =
+      m_GridView ? DrawGrid(dir, activated) : DrawList(dir, activated);
+  if (!m_OpenNext.empty()) {
+    Open(m_OpenNext);
+    m_OpenNext.clear();
+  }
+  return result;
+}
+
+void ContentBrowser::DrawToolbar() {
+  ImGui::BeginDisabled(m_Current == m_Root);
+  if (ImGui::ArrowButton("##up", ImGuiDir_Up))
+    m_OpenNext = ParentOf(m_Current);
+  ImGui::EndDisabled();
+  ImGui::SameLine();
+  if (ImGui::Button("Refresh"))
+    Refresh();
+  ImGui::SameLine();
+  if (ImGui::Button(m_GridView ? "List" : "Grid"))
+    m_GridView = !m_GridView;
+  if (m_GridView) {
+    ImGui::SameLine();
+    ImGui::SetNextItemWidth(90.0f);
+    ImGui::SliderFloat("##size", &m_CellSize, 48.0f, 128.0f, "%.0f px");
+  }
+  ImGui::SameLine();
+  ImGui::SetNextItemWidth(-1);
+  ImGui::InputTextWithHint("##filter", "Filter", m_Filter, sizeof(m_Filter));
+
+  // Breadcrumbs: the root, then every folder down to the current one
+  std::string crumb = m_Root;
+  if (ImGui::SmallButton(std::filesystem::path(m_Root).filename().string().c_str()))
+    m_OpenNext = m_Root;
+  size_t begin = m_Root.size() + 1;
+  while (begin < m_Current.size()) {
+    size_t end = m_Current.find('/', begin);
+    if (end == std::string::npos)
+      end = m_Current.size();
+    crumb = m_Current.substr(0, end);
+    ImGui::SameLine(0.0f, 2.0f);
+    ImGui::TextDisabled("/");
+    ImGui::SameLine(0.0f, 2.0f);
+    ImGui::PushID(crumb.c_str());
+    if (ImGui::SmallButton(m_Current.substr(begin, end - begin).c_str()))
+      m_OpenNext = crumb;
+    ImGui::PopID();
+    begin = end + 1;
+  }
+}
+
+bool ContentBrowser::Activate(const FileItem &item, FileItem &activated) {
+  if (item.isDirectory) {
+    m_OpenNext = item.path;
+    return false;
+  }
+  activated = item;
+  return true;
+}
+
+bool ContentBrowser::DrawGrid(const Directory &dir, FileItem &activated) {
+  bool result = false;
+  if (!ImGui::BeginChild("##grid"))
+    return false;
+  const ImGuiStyle &style = ImGui::GetStyle();
+  const float labelHeight = ImGui::GetTextLineHeight();
+  const float cellHeight = m_CellSize + labelHeight;
+  const int columns = std::max(
+      1, (int)((ImGui::GetContentRegionAvail().x + style.ItemSpacing.x) /
+               (m_CellSize + style.ItemSpacing.x)));
+  const int rows = (int)((m_Visible.size() + columns - 1) / columns);
+  ImDrawList *draw = ImGui::GetWindowDrawList();
+
+  ImGuiListClipper clipper;
+  clipper.Begin(rows, cellHeight + style.ItemSpacing.y);
+  while (clipper.Step()) {
+    for (int row = clipper.DisplayStart; row < clipper.DisplayEnd; ++row) {
+      for (int column = 0; column < columns; ++column) {
+        const size_t slot = (size_t)row * columns + column;
+        if (slot >= m_Visible.size())
+          break;
+        const FileItem &item = dir.items[m_Visible[slot]];
+        if (column > 0)
+          ImGui::SameLine();
+        ImGui::PushID((int)slot);
+        const ImVec2 pos = ImGui::GetCursorScreenPos();
+        if (ImGui::Selectable("##cell", m_Selected == item.path,
+                              ImGuiSelectableFlags_AllowDoubleClick,
+                              ImVec2(m_CellSize, cellHeight))) {
+          m_Selected = item.path;
+          if (ImGui::IsMouseDoubleClicked(ImGuiMouseButton_Left))
+            result |= Activate(item, activated);
+        }
+        if (ImGui::IsItemHovered(ImGuiHoveredFlags_DelayNormal))
+          ImGui::SetTooltip("%s", item.path.c_str());
+
+        // Icon: the asset's preview once there is one, otherwise a tile in
+        // the type's colour with its tag
+        const ImVec2 iconMin(pos.x + 6.0f, pos.y + 4.0f);
+        const ImVec2 iconMax(pos.x + m_CellSize - 6.0f,
+                             pos.y + m_CellSize - 4.0f);
+        float uv[4];
+        if (m_Thumbnails && m_Thumbnails->Get(item.path, item.type, uv)) {
+          const float side = std::min(iconMax.x - iconMin.x,
+                                      iconMax.y - iconMin.y);
+          const ImVec2 center(0.5f * (iconMin.x + iconMax.x),
+                              0.5f * (iconMin.y + iconMax.y));
+          draw->AddImage(
+              (ImTextureID)(intptr_t)m_Thumbnails->GetAtlas(),
+              ImVec2(center.x - 0.5f * side, center.y - 0.5f * side),
+              ImVec2(center.x + 0.5f * side, center.y + 0.5f * side),
+              ImVec2(uv[0], uv[1]), ImVec2(uv[2], uv[3]));
+        } else {
+          draw->AddRectFilled(iconMin, iconMax, TypeColor(item.type), 4.0f);
+          const char *tag = TypeTag(item.type);
+          const ImVec2 tagSize = ImGui::CalcTextSize(tag);
+          draw->AddText(ImVec2(0.5f * (iconMin.x + iconMax.x - tagSize.x),
+                               0.5f * (iconMin.y + iconMax.y - tagSize.y)),
+                        IM_COL32(255, 255, 255, 230), tag);
+        }
+        // Name, centred and clipped to the cell
+        const ImVec2 nameSize = ImGui::CalcTextSize(item.name.c_str());
+        draw->PushClipRect(ImVec2(pos.x, pos.y + m_CellSize),
+                           ImVec2(pos.x + m_CellSize, pos.y + cellHeight),
+                           true);
+        draw->AddText(
+            ImVec2(pos.x + std::max(0.0f, 0.5f * (m_CellSize - nameSize.x)),
+                   pos.y + m_CellSize),
+            ImGui::GetColorU32(ImGuiCol_Text), item.name.c_str());
+        draw->PopClipRect();
+        ImGui::PopID();
+      }
+    }
+  }
+  clipper.End();
+  ImGui::EndChild();
+  return result;
+}
+
+bool ContentBrowser::DrawList(const Directory &dir, FileItem &activated) {
+  bool result = false;
+  if (!ImGui::BeginTable("##list", 2,
+                         ImGuiTableFlags_RowBg | ImGuiTableFlags_ScrollY))
+    return false;
+  ImGui::TableSetupScrollFreeze(0, 1);
+  ImGui::TableSetupColumn("Name", ImGuiTableColumnFlags_WidthStretch);
+  ImGui::TableSetupColumn("Type", ImGuiTableColumnFlags_WidthFixed, 80.0f);
+  ImGui::TableHeadersRow();
+
+  ImGuiListClipper clipper;
+  clipper.Begin((int)m_Visible.size());
+  while (clipper.Step()) {
+    for (int row = clipper.DisplayStart; row < clipper.DisplayEnd; ++row) {
+      const FileItem &item = dir.items[m_Visible[row]];
+      ImGui::TableNextRow();
+      ImGui::TableNextColumn();
+      ImGui::PushID(row);
+      ImGui::PushStyleColor(ImGuiCol_Text, TypeColor(item.type));
+      ImGui::TextUnformatted(TypeTag(item.type));
+      ImGui::PopStyleColor();
+      ImGui::SameLine();
+      if (ImGui::Selectable(item.name.c_str(), m_Selected == item.path,
+                            ImGuiSelectableFlags_SpanAllColumns |
+                                ImGuiSelectableFlags_AllowDoubleClick)) {
+        m_Selected = item.path;
+        if (ImGui::IsMouseDoubleClicked(ImGuiMouseButton_Left))
+          result |= Activate(item, activated);
+      }
+      if (ImGui::IsItemHovered(ImGuiHoveredFlags_DelayNormal))
+        ImGui::SetTooltip("%s", item.path.c_str());
+      ImGui::TableNextColumn();
+      ImGui::TextDisabled("%s", TypeName(item.type));
+      ImGui::PopID();
+    }
+  }
+  clipper.End();
+  ImGui::EndTable();
+  return result;
+}
+
+// Worker thread
+
+void ContentBrowser::Wake() {
+#ifdef __linux__
+  if (m_WakeFd >= 0) {
+    const uint64_t one = 1;
+    (void)!write(m_WakeFd, &one, sizeof(one));
+  }
+#endif
+}
+
+void ContentBrowser::Send(std::unique_ptr<Message> message) {
+  // The UI thread drains the ring every frame; when it is full, wait
+  while (!m_Messages.Push(std::move(message))) {
+    if (m_Stop.load(std::memory_order_relaxed))
+      return;
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+}
+
+void ContentBrowser::WorkerLoop() {
+  while (!m_Stop.load(std::memory_order_acquire)) {
+    Request request;
+    while (!m_Stop.load(std::memory_order_relaxed) &&
+           m_Requests.Pop(request)) {
+      if (request.kind == Request::List) {
+        // Watched first, so that no change after the listing is missed
+        Watch(request.dir);
+        ListDirectory(request.dir, request.generation);
+      } else {
+        Unwatch(request.dir);
+      }
+    }
+#ifdef __linux__
+    pollfd fds[2] = {{m_WakeFd, POLLIN, 0}, {m_Notify, POLLIN, 0}};
+    if (poll(fds, 2, 250) <= 0)
+      continue;
+    if (fds[0].revents & POLLIN) {
+      uint64_t count;
+      (void)!read(m_WakeFd, &count, sizeof(count));
+    }
+    if (fds[1].revents & POLLIN)
+      ReadEvents();
+#else
+    std::this_thread::sleep_for(std::chrono::milliseconds(15));
+#endif
+  }
+}
+
+void ContentBrowser::ListDirectory(const std::string &dir,
+                                   uint64_t generation) {
+  namespace fs = std::filesystem;
+  auto stale = [&] {
+    return m_Stop.load(std::memory_order_relaxed) ||
+           (generation != 0 &&
+            m_Generation.load(std::memory_order_relaxed) != generation);
+  };
+  std::vector<FileItem> items;
+  m_Listed.store(0, std::memory_order_relaxed);
+  std::error_code ec;
+  fs::directory_iterator it(dir, fs::directory_options::skip_permission_denied,
+                            ec);
+  for (; !ec && it != fs::directory_iterator(); it.increment(ec)) {
+    if (stale())
+      return;
+    FileItem item;
+    item.name = it->path().filename().string();
+    if (item.name.empty() || item.name[0] == '.')
+      continue;
+    // From readdir's d_type; a stat only for symlinks or filesystems that
+    // don't report it
+    std::error_code typeError;
+    item.isDirectory = it->is_directory(typeError);
+    item.path = dir + "/" + item.name;
+    item.type = Classify(item.name, item.isDirectory, m_ProjectExtension);
+    items.push_back(std::move(item));
+    if ((items.size() & 255) == 0)
+      m_Listed.store(items.size(), std::memory_order_relaxed);
+  }
+  if (ec)
+    std::cerr << "Content browser: can't list '" << dir
+              << "': " << ec.message() << std::endl;
+  std::sort(items.begin(), items.end(), ItemLess);
+  m_Listed.store(items.size(), std::memory_order_relaxed);
+
+  // Always at least one (possibly empty) batch, so the UI stops waiting
+  size_t sent = 0;
+  do {
+    if (stale())
+      return;
+    auto message = std::make_unique<Message>();
+    message->kind = Message::Listing;
+    message->dir = dir;
+    message->first = sent == 0;
+    const size_t count = std::min(BATCH_SIZE, items.size() - sent);
+    message->items.assign(
+        std::make_move_iterator(items.begin() + sent),
+        std::make_move_iterator(items.begin() + sent + count));
+    sent += count;
+    message->last = sent == items.size();
+    Send(std::move(message));
+  } while (sent < items.size());
+}
+
+void ContentBrowser::Watch(const std::string &dir) {
+#ifdef __linux__
+  if (m_Notify < 0 || m_DirWatches.count(dir))
+    return;
+  const int watch = inotify_add_watch(
+      m_Notify, dir.c_str(),
+      IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_CLOSE_WRITE |
+          IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR);
+  if (watch < 0)
+    return; // e.g. out of watches: Refresh still works
+  m_WatchDirs[watch] = dir;
+  m_DirWatches[dir] = watch;
+#else
+  (void)dir;
+#endif
+}
+
+void ContentBrowser::Unwatch(const std::string &dir) {
+#ifdef __linux__
+  auto it = m_DirWatches.find(dir);
+  if (it == m_DirWatches.end())
+    return;
+  inotify_rm_watch(m_Notify, it->second);
+  m_WatchDirs.erase(it->second);
+  m_DirWatches.erase(it);
+#else
+  (void)dir;
+#endif
+}
+
+void ContentBrowser::ReadEvents() {
+#ifdef __linux__
+  alignas(inotify_event) char buffer[64 * 1024];
+  // One Changes message per directory, sent when full or when a removal
+  // follows an addition (the UI applies removals first)
+  std::unordered_map<int, std::unique_ptr<Message>> changes;
+  std::vector<std::string> gone;
+  bool overflow = false;
+  for (;;) {
+    const ssize_t size = read(m_Notify, buffer, sizeof(buffer));
+    if (size <= 0)
+      break;
+    for (const char *p = buffer; p < buffer + size;) {
+      const inotify_event *event = (const inotify_event *)p;
+      p += sizeof(inotify_event) + event->len;
+      if (event->mask & IN_Q_OVERFLOW) {
+        overflow = true;
+        continue;
+      }
+      auto watched = m_WatchDirs.find(event->wd);
+      if (watched == m_WatchDirs.end())
+        continue;
+      const std::string dir = watched->second;
+      if (event->mask & (IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED)) {
+        // Deleted, renamed or unmounted; once, whichever event comes first
+        Unwatch(dir);
+        gone.push_back(dir);
+        continue;
+      }
+      if (event->len == 0 || event->name[0] == '.')
+        continue;
+
+      FileItem item;
+      item.name = event->name;
+      item.path = dir + "/" + item.name;
+      item.isDirectory = (event->mask & IN_ISDIR) != 0;
+      item.type = Classify(item.name, item.isDirectory, m_ProjectExtension);
+      const bool added = (event->mask & (IN_CREATE | IN_MOVED_TO)) != 0;
+      const bool modified = (event->mask & IN_CLOSE_WRITE) != 0;
+      std::unique_ptr<Message> &message = changes[event->wd];
+      if (message && (message->items.size() + message->removed.size() +
+                              message->modified.size() >=
+                          BATCH_SIZE ||
+                      (!added && !modified && !message->items.empty())))
+        Send(std::move(message));
+      if (!message) {
+        message = std::make_unique<Message>();
+        message->kind = Message::Changes;
+        message->dir = dir;
+      }
+      (modified ? message->modified
+                : added ? message->items : message->removed)
+          .push_back(std::move(item));
+    }
+  }
+  for (auto &change : changes) {
+    if (change.second)
+      Send(std::move(change.second));
+  }
+  for (const std::string &dir : gone) {
+    auto message = std::make_unique<Message>();
+    message->kind = Message::Gone;
+    message->dir = dir;
+    Send(std::move(message));
+  }
+  if (overflow) {
+    // Events were lost: every watched directory is listed again
+    std::vector<std::string> dirs;
+    for (const auto &watch : m_WatchDirs)
+      dirs.push_back(watch.second);
+    for (const std::string &dir : dirs)
+      ListDirectory(dir, 0);
+  }
+#endif
+}
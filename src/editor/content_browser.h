@@ -0,0 +1,143 @@
+#pragma once
+
+#include "../core/spsc_queue.h"
+#include "editor_defs.h"
+#include "thumbnail_service.h"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Content browser of the File Explorer panel.
+//
+// A worker thread of its own (listing a slow mount, or waiting on the
+// filesystem, would hold a job system worker for seconds) enumerates
+// directories. Entries are classified from the directory entry's type and
+// the file extension only: files are never opened. Each listing is sorted
+// (folders first, then by name) on the worker and handed to the UI thread
+// in batches of BATCH_SIZE through a lock-free SPSC queue. The UI thread
+// keeps every visited directory in a cache, so going back to one shows it
+// at once; opening another directory abandons a listing still in progress.
+//
+// On Linux the worker watches the cached directories with inotify and
+// sends their changes through the same queue (a kernel queue overflow
+// re-lists them); elsewhere Refresh re-lists the current one.
+//
+// Update() applies the worker's messages within a time budget and Draw()
+// lays out only the visible rows of the grid or list (ImGuiListClipper),
+// so a directory of 100k entries costs the frame what fits on screen.
+// With a ThumbnailService the grid shows previews of the visible materials
+// and models; files that change on disk are invalidated in it.
+class ContentBrowser {
+public:
+  static constexpr size_t BATCH_SIZE = 2048;     // entries per message
+  static constexpr size_t MAX_CACHED_DIRS = 64;  // watched while cached
+  static constexpr float UPDATE_BUDGET_MS = 2.0f;
+
+  ContentBrowser() = default;
+  ~ContentBrowser();
+
+  ContentBrowser(const ContentBrowser &) = delete;
+  ContentBrowser &operator=(const ContentBrowser &) = delete;
+
+  // Starts the worker and opens root; navigation stays under it
+  void Init(const std::string &root);
+  void Shutdown();
+
+  // Once per frame on the UI thread, whether the panel is shown or not
+  void Update();
+  // Contents of the current window. Returns true when a file was
+  // double-clicked, copied to activated.
+  bool Draw(FileItem &activated);
+
+  // Optional; not owned
+  void SetThumbnails(ThumbnailService *thumbnails) { m_Thumbnails = thumbnails; }
+
+  void Open(const std::string &dir);
+  void Refresh();
+  const std::string &GetCurrentDir() const { return m_Current; }
+
+  // From the name alone (any thread)
+  static FileType Classify(const std::string &name, bool isDirectory,
+                           const std::string &projectExtension);
+
+private:
+  struct Request {
+    enum Kind { List, Forget } kind = List;
+    std::string dir;
+    uint64_t generation = 0; // List: abandoned once stale (0 = never)
+  };
+  struct Message {
+    enum Kind { Listing, Changes, Gone } kind = Listing;
+    std::string dir;
+    // Listing: this batch, sorted; Changes: entries that appeared
+    std::vector<FileItem> items;
+    std::vector<FileItem> removed; // Changes
+    std::vector<FileItem> modified; // Changes: rewritten in place
+    bool first = false, last = false; // Listing
+  };
+  struct Directory {
+    std::vector<FileItem> items;    // sorted
+    std::vector<FileItem> incoming; // listing being received
+    bool complete = false;          // items hold a whole listing
+    bool listing = false;           // requested, not complete yet
+    uint64_t lastUsed = 0;          // frame of the last Open or Draw
+    uint64_t version = 0;           // bumped when items change
+  };
+
+  // UI thread
+  void Post(Request &&request);
+  void Apply(Message &message);
+  void Evict();
+  void UpdateVisible(const Directory &dir);
+  void DrawToolbar();
+  bool DrawGrid(const Directory &dir, FileItem &activated);
+  bool DrawList(const Directory &dir, FileItem &activated);
+  // Double-click: folders open, files are returned by Draw
+  bool Activate(const FileItem &item, FileItem &activated);
+
+  // Worker thread
+  void WorkerLoop();
+  void ListDirectory(const std::string &dir, uint64_t generation);
+  void Watch(const std::string &dir);
+  void Unwatch(const std::string &dir);
+  void ReadEvents();
+  void Send(std::unique_ptr<Message> message);
+  void Wake();
+
+  std::string m_Root;
+  ThumbnailService *m_Thumbnails = nullptr;
+  std::string m_ProjectExtension; // lowercase, read once by Init
+
+  // UI thread state
+  std::unordered_map<std::string, Directory> m_Dirs;
+  std::string m_Current;
+  std::vector<Request> m_Unsent; // the request queue was full
+  uint64_t m_Frame = 0;
+  bool m_GridView = true;
+  float m_CellSize = 72.0f;
+  char m_Filter[128] = "";
+  std::string m_Selected;          // path
+  std::string m_OpenNext;          // opened once the frame's items are drawn
+  std::vector<uint32_t> m_Visible; // items of the current dir passing the filter
+  std::string m_VisibleDir;
+  std::string m_VisibleFilter;
+  uint64_t m_VisibleVersion = ~0ull;
+
+  // Shared
+  SpscQueue<Request, 64> m_Requests;                   // UI -> worker
+  SpscQueue<std::unique_ptr<Message>, 256> m_Messages; // worker -> UI
+  std::atomic<uint64_t> m_Generation{0}; // of the current directory
+  std::atomic<size_t> m_Listed{0};       // entries of the running listing
+  std::atomic<bool> m_Stop{false};
+  std::thread m_Worker;
+
+  // Worker thread state
+  int m_Notify = -1; // inotify descriptor (Linux)
+  int m_WakeFd = -1; // eventfd the UI thread writes to (Linux)
+  std::unordered_map<int, std::string> m_WatchDirs; // watch -> dir
+  std::unordered_map<std::string, int> m_DirWatches;
+};
@@ -1,13 +1,77 @@
 #include "editor_layer.h"
+#include "../camera/camera.h"
+#include "../core/job_system.h"
 #include "../project/project_manager.h"
+#include "../render/gl_state_cache.h"
+#include "../render/image_loader.h"
+#include "../render/texture_cache.h"
+#include "../render/texture_manager.h"
 #include "../scene/scene.h"
+#include "../shaders/program_cache.h"
+#include "../shaders/shader_library.h"
 #include "backends/imgui_impl_glfw.h"
 #include "backends/imgui_impl_opengl3.h"
 #include "imgui.h"
+#include <algorithm>
+#include <atomic>
+#include <cfloat>
 #include <cmath>
+#include <cstring>
+#include <ctime>
+#include <filesystem>
 #include <iostream>
+#include <mutex>
+#include <random>
 
-EditorLayer::EditorLayer() {}
+struct TextureBenchmarkRun {
+  TextureCacheBenchmark result;
+  std::atomic<bool> done{false};
+};
+
+// Random point and spot lights over the grid, to exercise the light clusters
+static void SpawnTestLights(Scene &scene, int count) {
+  std::mt19937 rng((unsigned)scene.GetLights().size() + 1);
+  std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+  for (int i = 0; i < count; ++i) {
+    Light light;
+    light.type = (i % 4 == 3) ? LightType::Spot : LightType::Point;
+    light.pos[0] = unit(rng) * 50.0f - 25.0f;
+    light.pos[1] = 0.5f + unit(rng) * 3.0f;
+    light.pos[2] = unit(rng) * 50.0f - 25.0f;
+    // Saturated hue
+    const float h = unit(rng) * 6.0f;
+    for (int k = 0; k < 3; ++k) {
+      const float d = std::fabs(std::fmod(h + 4.0f - 2.0f * k, 6.0f) - 3.0f);
+      light.color[k] = std::min(std::max(d - 1.0f, 0.0f), 1.0f);
+    }
+    light.intensity = 4.0f + unit(rng) * 8.0f;
+    light.range = 3.0f + unit(rng) * 4.0f;
+    scene.AddLight(light);
+  }
+}
+
+// Local time as 20240131_235959, for capture file names
+static std::string CaptureTimestamp() {
+  const std::time_t now = std::time(nullptr);
+  char text[32];
+  std::strftime(text, sizeof(text), "%Y%m%d_%H%M%S", std::localtime(&now));
+  return text;
+}
+
+// Transform field edited by a gizmo mode: 0=pos, 1=rotation, 2=scale
+static float *CubeField(CubeInst &cube, int field) {
+  return field == 0 ? cube.pos : field == 1 ? cube.rotation : cube.scale;
+}
+static const float *CubeField(const CubeInst &cube, int field) {
+  return field == 0 ? cube.pos : field == 1 ? cube.rotation : cube.scale;
+}
+
+EditorLayer::EditorLayer() {
+  const ViewCamera::Mode modes[SPLIT_VIEWS] = {
+      ViewCamera::Mode::Top, ViewCamera::Mode::Front, ViewCamera::Mode::Side};
+  for (int i = 0; i < SPLIT_VIEWS; ++i)
+    m_SplitViews[i].camera = ViewCamera(modes[i]);
+}
 
 EditorLayer::~EditorLayer() { Shutdown(); }
 
@@ -15,6 +79,9 @@ void EditorLayer::Init(GLFWwindow *window) {
   m_Window = window;
   InitImGui(window);
   InitFramebuffer();
+  m_Thumbnails.Init();
+  m_ContentBrowser.SetThumbnails(&m_Thumbnails);
+  m_ContentBrowser.Init("Content");
 }
 
 void EditorLayer::InitImGui(GLFWwindow *window) {
@@ -41,33 +108,22 @@ void EditorLayer::InitImGui(GLFWwindow *window) {
 }
 
 void EditorLayer::Shutdown() {
-  if (m_Framebuffer) glDeleteFramebuffers(1, &m_Framebuffer);
-  if (m_SceneTexture) glDeleteTextures(1, &m_SceneTexture);
-  if (m_DepthRenderbuffer) glDeleteRenderbuffers(1, &m_DepthRenderbuffer);
+  m_ContentBrowser.Shutdown();
+  if (m_ChangeScene) {
+    m_ChangeScene->RemoveChangeListener(m_ChangeListener);
+    m_ChangeScene = nullptr;
+  }
   ImGui_ImplOpenGL3_Shutdown();
   ImGui_ImplGlfw_Shutdown();
   ImGui::DestroyContext();
 }
 
 void EditorLayer::InitFramebuffer() {
-  glGenFramebuffers(1, &m_Framebuffer);
-  glBindFramebuffer(GL_FRAMEBUFFER, m_Framebuffer);
-
-  // Color texture
-  glGenTextures(1, &m_SceneTexture);
-  glBindTexture(GL_TEXTURE_2D, m_SceneTexture);
-  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, m_FBWidth, m_FBHeight, 0, GL_RGB, GL_UNSIGNED_BYTE, nullptr);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_SceneTexture, 0);
-
-  // Depth renderbuffer
-  glGenRenderbuffers(1, &m_DepthRenderbuffer);
-  glBindRenderbuffer(GL_RENDERBUFFER, m_DepthRenderbuffer);
-  glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, m_FBWidth, m_FBHeight);
-  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, m_DepthRenderbuffer);
-
-  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  m_SceneTarget.Init(false);
+  m_SceneTarget.Reserve(m_FBWidth, m_FBHeight);
+  for (SplitView &split : m_SplitViews)
+    split.target.Init(false);
+  m_Capture.Init();
 }
 
 void EditorLayer::ResizeFramebuffer(int width, int height) {
@@ -76,53 +132,214 @@ void EditorLayer::ResizeFramebuffer(int width, int height) {
   
   m_FBWidth = width;
   m_FBHeight = height;
+  m_SceneTarget.Reserve(width, height);
+}
 
-  glBindTexture(GL_TEXTURE_2D, m_SceneTexture);
-  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, nullptr);
+void EditorLayer::RenderFrame(Scene &scene, const Mat4 &view,
+                              const Mat4 &proj, int displayWidth,
+                              int displayHeight) {
+  using Graph = RenderGraph;
+  // Previews requested by this frame's UI, before ImGui draws the atlas
+  m_Thumbnails.Update();
+  m_Graph.Reset();
 
-  glBindRenderbuffer(GL_RENDERBUFFER, m_DepthRenderbuffer);
-  glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
-}
+  int renderWidth, renderHeight;
+  m_DynamicResolution.GetRenderSize(m_FBWidth, m_FBHeight, renderWidth,
+                                    renderHeight);
+  const bool scaled = renderWidth != m_FBWidth || renderHeight != m_FBHeight;
 
-void EditorLayer::BeginSceneRender() {
-  glBindFramebuffer(GL_FRAMEBUFFER, m_Framebuffer);
-  glViewport(0, 0, m_FBWidth, m_FBHeight);
-  glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
-  glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-}
+  // Scaled targets are pooled at the full panel size so that changing the
+  // scale never reallocates
+  const Graph::Resource viewport =
+      m_Graph.ImportTexture("Viewport", m_SceneTarget.GetColorTexture(),
+                            m_FBWidth, m_FBHeight, GL_RGB8);
+  Graph::TextureDesc colorDesc;
+  colorDesc.width = renderWidth;
+  colorDesc.height = renderHeight;
+  colorDesc.format = GL_RGB8;
+  colorDesc.poolWidth = m_FBWidth;
+  colorDesc.poolHeight = m_FBHeight;
+  Graph::TextureDesc depthDesc = colorDesc;
+  depthDesc.format = GL_DEPTH24_STENCIL8;
+  const Graph::Resource color =
+      scaled ? m_Graph.CreateTexture("SceneColor", colorDesc) : viewport;
+  const Graph::Resource depth = m_Graph.CreateTexture("SceneDepth", depthDesc);
+
+  // Every scene view of the frame: the main panel first (occlusion and
+  // shadows follow it), then the visible split views
+  SceneView views[1 + SPLIT_VIEWS];
+  int splitIndex[SPLIT_VIEWS];
+  int viewCount = 1;
+  views[0] = {view, proj};
+  for (int i = 0; i < SPLIT_VIEWS; ++i) {
+    const SplitView &split = m_SplitViews[i];
+    splitIndex[i] = -1;
+    if (!split.imageVisible)
+      continue;
+    const float aspect = (float)split.width / split.height;
+    views[viewCount] = {split.camera.GetView(),
+                        split.camera.GetProjection(aspect)};
+    splitIndex[i] = viewCount++;
+  }
+
+  m_Graph.AddPass("Scene", [&] { scene.RenderView(0); })
+      .Write(color, Graph::CLEAR)
+      .Write(depth, Graph::CLEAR)
+      .ClearColor(0.1f, 0.1f, 0.1f, 1.0f);
+  m_Graph
+      .AddPass("Gizmos",
+               [&] {
+                 scene.RenderGizmos(view, proj, m_SelectedCubeIndex,
+                                    m_TransformMode, m_HoveredAxis,
+                                    m_LocalSpace);
+               })
+      .Write(color)
+      .Write(depth);
+  if (scaled)
+    m_Graph.AddBlitPass("Upscale", color, viewport, GL_LINEAR);
+  // Runs while anything is requested or still in flight; reads the panel
+  // at its resolution, after the upscale
+  if (!m_Capture.IsIdle())
+    m_Graph
+        .AddPass("Capture",
+                 [&] {
+                   m_Capture.Capture(m_SceneTarget.GetFramebuffer(),
+                                     m_FBWidth, m_FBHeight);
+                 })
+        .Read(viewport)
+        .SideEffect();
+
+  // Split views: own colour target, depth from the pool (same-sized views
+  // share one texture), no gizmos. Declared before the ImGui pass that
+  // reads them.
+  Graph::Resource splitColors[SPLIT_VIEWS];
+  int splitCount = 0;
+  for (int i = 0; i < SPLIT_VIEWS; ++i) {
+    if (splitIndex[i] < 0)
+      continue;
+    SplitView &split = m_SplitViews[i];
+    const Graph::Resource splitColor = m_Graph.ImportTexture(
+        split.camera.GetName(), split.target.GetColorTexture(), split.width,
+        split.height, GL_RGB8);
+    Graph::TextureDesc splitDepth;
+    splitDepth.width = split.width;
+    splitDepth.height = split.height;
+    splitDepth.format = GL_DEPTH24_STENCIL8;
+    const int index = splitIndex[i];
+    m_Graph
+        .AddPass(split.camera.GetName(),
+                 [&scene, index] { scene.RenderView(index); })
+        .Write(splitColor, Graph::CLEAR)
+        .Write(m_Graph.CreateTexture("SplitDepth", splitDepth), Graph::CLEAR)
+        .ClearColor(0.1f, 0.1f, 0.1f, 1.0f);
+    splitColors[splitCount++] = splitColor;
+  }
+
+  // ImGui composition at native resolution. The scene passes only run if
+  // the panel (or a capture) uses their output.
+  const Graph::Resource backbuffer =
+      m_Graph.ImportBackbuffer("Backbuffer", displayWidth, displayHeight);
+  Graph::PassBuilder ui =
+      m_Graph
+          .AddPass("ImGui",
+                   [] { ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData()); })
+          .Write(backbuffer, Graph::CLEAR)
+          .ClearColor(0.15f, 0.15f, 0.15f, 1.0f)
+          .SideEffect();
+  if (m_SceneImageVisible)
+    ui.Read(viewport);
+  for (int i = 0; i < splitCount; ++i)
+    ui.Read(splitColors[i]);
+
+  // The work shared by the views runs once, before any of their passes;
+  // skipped when no panel shows the scene
+  const bool sceneVisible =
+      m_SceneImageVisible || viewCount > 1 || !m_Capture.IsIdle();
+  if (sceneVisible)
+    scene.BeginFrame(views, viewCount);
+  m_Graph.Execute();
+  if (sceneVisible)
+    scene.EndFrame();
+  GLStateCache::Get().BindFramebuffer(0);
 
-void EditorLayer::EndSceneRender() {
-  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  const RenderGraphPassStats *scenePass = m_Graph.FindPass("Scene");
+  if (scenePass && scenePass->gpuUpdated) {
+    const RenderGraphPassStats *gizmoPass = m_Graph.FindPass("Gizmos");
+    m_DynamicResolution.Update(scenePass->gpuMs +
+                               (gizmoPass ? gizmoPass->gpuMs : 0.0f));
+  }
 }
 
-void EditorLayer::Render(Scene &scene) {
+void EditorLayer::BuildUI(Scene &scene) {
   // Start Frame
   ImGui_ImplOpenGL3_NewFrame();
   ImGui_ImplGlfw_NewFrame();
   ImGui::NewFrame();
+  m_Labels.Reset();
+  if (m_ChangeScene != &scene) {
+    // The hierarchy index follows the scene through its change batches
+    if (m_ChangeScene)
+      m_ChangeScene->RemoveChangeListener(m_ChangeListener);
+    m_ChangeScene = &scene;
+    m_ChangeListener = scene.AddChangeListener(
+        [this](const SceneChangeBatch &batch) {
+          m_HierarchyChanges.Merge(batch);
+        });
+    m_HierarchyIndex.Clear();
+    m_HierarchyChanges = SceneChangeBatch();
+  }
+  // This frame's slice of the long task, before anything reads the scene
+  m_Tasks.Update();
+  m_ContentBrowser.Update();
+  SyncSelection(scene);
+  // Undo/redo shortcuts, unless a text field has the keyboard
+  if (!ImGui::GetIO().WantTextInput && !m_Tasks.IsBusy()) {
+    if (ImGui::IsKeyChordPressed(ImGuiMod_Ctrl | ImGuiKey_Z))
+      Undo(scene);
+    else if (ImGui::IsKeyChordPressed(ImGuiMod_Ctrl | ImGuiKey_Y) ||
+             ImGui::IsKeyChordPressed(ImGuiMod_Ctrl | ImGuiMod_Shift |
+                                      ImGuiKey_Z))
+      Redo(scene);
+  }
+  m_SceneImageVisible = false;
+  bool splitHovered = false;
+  for (SplitView &split : m_SplitViews) {
+    splitHovered |= split.hovered;
+    split.imageVisible = false;
+    split.hovered = false;
+  }
+  // The wheel zooms the hovered split view instead of moving the fly camera
+  camScrollEnabled = !splitHovered;
 
   // Apply wireframe mode to scene
   scene.SetWireframe(m_WireframeMode);
+  scene.SetOcclusionCulling(m_OcclusionCulling);
 
   DrawDockSpace(scene);
 
   if (m_ShowSceneViewport)
     DrawSceneViewport();
+  for (SplitView &split : m_SplitViews) {
+    if (split.show)
+      DrawSplitView(split);
+  }
   if (m_ShowHierarchy)
     DrawHierarchy(scene);
   if (m_ShowProperties)
     DrawProperties(scene);
   if (m_ShowFileExplorer)
-    DrawFileExplorer();
+    DrawFileExplorer(scene);
+  if (m_ShowStats)
+    DrawStats(scene);
   // Demo window disabled - requires imgui_demo.cpp
   // if (m_ShowDemoWindow)
   //   ImGui::ShowDemoWindow(&m_ShowDemoWindow);
   if (m_ShowAbout)
     DrawAboutDialog();
+  DrawLongTaskModal();
 
-  // Render ImGui
+  // Draw lists; rendered by the ImGui pass of RenderFrame
   ImGui::Render();
-  ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
 }
 
 void EditorLayer::DrawDockSpace(Scene &scene) {
@@ -152,21 +369,27 @@ void EditorLayer::DrawDockSpace(Scene &scene) {
 
   if (ImGui::BeginMenuBar()) {
     if (ImGui::BeginMenu("File")) {
-      if (ImGui::MenuItem("New Project", "Ctrl+N")) {
+      // Both replace the scene a running task still works on (its handles,
+      // its undo group); wait for it, or cancel it from the progress bar
+      const bool idle = !m_Tasks.IsBusy();
+      if (ImGui::MenuItem("New Project", "Ctrl+N", false, idle)) {
+        ClearSelection(scene);
         scene.Clear();
-        m_SelectedCubeIndex = -1;
+        m_Undo.Clear();
       }
-      if (ImGui::MenuItem("Open Project", "Ctrl+O")) {
-        ProjectData data;
-        if (ProjectManager::LoadProject("myproject.MarioEngine", data)) {
-          scene.LoadFromProject(data);
-        }
-      }
-      if (ImGui::MenuItem("Save Project", "Ctrl+S")) {
-        ProjectData data;
-        data.projectName = "MyProject";
-        scene.GetProjectData(data);
-        ProjectManager::SaveProject("myproject.MarioEngine", data);
+      if (ImGui::MenuItem("Open Project", "Ctrl+O", false, idle))
+        StartOpenProject(scene, "myproject.MarioEngine");
+      if (ImGui::MenuItem("Save Project", "Ctrl+S"))
+        StartSaveProject(scene, "myproject.MarioEngine");
+      ImGui::Separator();
+      if (ImGui::MenuItem("Screenshot"))
+        m_Capture.Screenshot("captures/" + CaptureTimestamp() + ".png");
+      if (ImGui::MenuItem("Record Sequence", nullptr, m_Capture.IsRecording())) {
+        if (m_Capture.IsRecording())
+          m_Capture.StopSequence();
+        else
+          m_Capture.StartSequence("captures/" + CaptureTimestamp(),
+                                  ImageWriter::Format::Png);
       }
       ImGui::Separator();
       if (ImGui::MenuItem("Exit", "Alt+F4")) {
@@ -175,29 +398,46 @@ void EditorLayer::DrawDockSpace(Scene &scene) {
       ImGui::EndMenu();
     }
     if (ImGui::BeginMenu("Edit")) {
-      if (ImGui::MenuItem("Undo", "Ctrl+Z", false, false)) {}
-      if (ImGui::MenuItem("Redo", "Ctrl+Y", false, false)) {}
+      std::string undoLabel = std::string("Undo ") + m_Undo.GetUndoName();
+      std::string redoLabel = std::string("Redo ") + m_Undo.GetRedoName();
+      if (ImGui::MenuItem(undoLabel.c_str(), "Ctrl+Z", false,
+                          m_Undo.CanUndo()))
+        Undo(scene);
+      if (ImGui::MenuItem(redoLabel.c_str(), "Ctrl+Y", false,
+                          m_Undo.CanRedo()))
+        Redo(scene);
+      int limitMb = (int)(m_Undo.GetMemoryLimit() >> 20);
+      ImGui::SetNextItemWidth(120.0f);
+      if (ImGui::SliderInt("Undo memory (MB)", &limitMb, 1, 1024))
+        m_Undo.SetMemoryLimit((size_t)limitMb << 20);
       ImGui::Separator();
-      if (ImGui::MenuItem("Delete Selected", "Del")) {
-        if (m_SelectedCubeIndex >= 0 && m_SelectedCubeIndex < (int)scene.GetCubes().size()) {
-          scene.GetCubes().erase(scene.GetCubes().begin() + m_SelectedCubeIndex);
-          m_SelectedCubeIndex = -1;
-        }
-      }
-      if (ImGui::MenuItem("Duplicate", "Ctrl+D")) {
-        if (m_SelectedCubeIndex >= 0 && m_SelectedCubeIndex < (int)scene.GetCubes().size()) {
-          CubeInst copy = scene.GetCubes()[m_SelectedCubeIndex];
-          copy.pos[0] += 1.0f;
-          copy.selected = false;
-          scene.AddCube(copy);
-        }
-      }
+      if (ImGui::MenuItem("Delete Selected", "Del", false,
+                          !m_Selection.Empty()))
+        EraseSelection(scene);
+      if (ImGui::MenuItem("Duplicate", "Ctrl+D", false,
+                          !m_Selection.Empty()))
+        StartDuplicate(scene, m_Selection.GetHandles());
+      ImGui::Separator();
+      if (ImGui::MenuItem("Add 256 Test Lights"))
+        SpawnTestLights(scene, 256);
+      if (ImGui::MenuItem("Clear Lights", nullptr, false,
+                          !scene.GetLights().empty()))
+        scene.ClearLights();
+      ImGui::MenuItem("Sun Light", nullptr, &scene.GetSun().enabled);
+      ImGui::MenuItem("Sun Shadows", nullptr, &scene.GetSun().castShadows,
+                      scene.GetSun().enabled);
       ImGui::EndMenu();
     }
     if (ImGui::BeginMenu("View")) {
       ImGui::MenuItem("Hierarchy", nullptr, &m_ShowHierarchy);
       ImGui::MenuItem("Properties", nullptr, &m_ShowProperties);
       ImGui::MenuItem("File Explorer", nullptr, &m_ShowFileExplorer);
+      ImGui::MenuItem("Stats", nullptr, &m_ShowStats);
+      if (ImGui::BeginMenu("Split Views")) {
+        for (SplitView &split : m_SplitViews)
+          ImGui::MenuItem(split.camera.GetName(), nullptr, &split.show);
+        ImGui::EndMenu();
+      }
       ImGui::EndMenu();
     }
     if (ImGui::BeginMenu("Windows")) {
@@ -212,6 +452,7 @@ void EditorLayer::DrawDockSpace(Scene &scene) {
       ImGui::MenuItem("Hierarchy", nullptr, &m_ShowHierarchy);
       ImGui::MenuItem("Properties", nullptr, &m_ShowProperties);
       ImGui::MenuItem("File Explorer", nullptr, &m_ShowFileExplorer);
+      ImGui::MenuItem("Stats", nullptr, &m_ShowStats);
       ImGui::EndMenu();
     }
     if (ImGui::BeginMenu("Settings")) {
@@ -222,6 +463,13 @@ void EditorLayer::DrawDockSpace(Scene &scene) {
         ImGui::EndMenu();
       }
       ImGui::MenuItem("Wireframe Mode", nullptr, &m_WireframeMode);
+      ImGui::MenuItem("Occlusion Culling", nullptr, &m_OcclusionCulling);
+      bool dynamicResolution = m_DynamicResolution.IsEnabled();
+      if (ImGui::MenuItem("Dynamic Resolution", nullptr, &dynamicResolution))
+        m_DynamicResolution.SetEnabled(dynamicResolution);
+      float budget = m_DynamicResolution.GetBudget();
+      if (ImGui::SliderFloat("GPU Budget (ms)", &budget, 2.0f, 33.0f, "%.1f"))
+        m_DynamicResolution.SetBudget(budget);
       ImGui::EndMenu();
     }
     if (ImGui::BeginMenu("Help")) {
@@ -248,6 +496,36 @@ void EditorLayer::DrawDockSpace(Scene &scene) {
   ImGui::End();
 }
 
+void EditorLayer::DrawSplitView(SplitView &split) {
+  ImGui::SetNextWindowSize(ImVec2(400, 300), ImGuiCond_FirstUseEver);
+  ImGui::PushStyleVar(ImGuiStyleVar_WindowPadding, ImVec2(0, 0));
+  const std::string title = std::string(split.camera.GetName()) + " View";
+  if (ImGui::Begin(title.c_str(), &split.show)) {
+    ImVec2 size = ImGui::GetContentRegionAvail();
+    if (size.x >= 1.0f && size.y >= 1.0f) {
+      split.width = (int)size.x;
+      split.height = (int)size.y;
+      split.target.Reserve(split.width, split.height);
+      ImGui::Image((ImTextureID)(intptr_t)split.target.GetColorTexture(), size,
+                   ImVec2(0, split.target.GetUvY()),
+                   ImVec2(split.target.GetUvX(), 0));
+      split.imageVisible = true;
+
+      // Wheel zooms, middle button drags the view
+      if (ImGui::IsItemHovered()) {
+        split.hovered = true;
+        const ImGuiIO &io = ImGui::GetIO();
+        if (io.MouseWheel != 0.0f)
+          split.camera.Zoom(io.MouseWheel);
+        if (ImGui::IsMouseDown(ImGuiMouseButton_Middle))
+          split.camera.Pan(io.MouseDelta.x, io.MouseDelta.y, size.y);
+      }
+    }
+  }
+  ImGui::End();
+  ImGui::PopStyleVar();
+}
+
 void EditorLayer::DrawSceneViewport() {
   ImGui::SetNextWindowSize(ImVec2(800, 600), ImGuiCond_FirstUseEver);
   ImGui::PushStyleVar(ImGuiStyleVar_WindowPadding, ImVec2(0, 0));
@@ -271,7 +549,21 @@ void EditorLayer::DrawSceneViewport() {
       m_SceneViewportHeight = viewportSize.y;
       
       // Display the scene texture
-      ImGui::Image((ImTextureID)(intptr_t)m_SceneTexture, viewportSize, ImVec2(0, 1), ImVec2(1, 0));
+      // Only the bottom-left corner of the pooled target is in use
+      ImGui::Image((ImTextureID)(intptr_t)m_SceneTarget.GetColorTexture(),
+                   viewportSize, ImVec2(0, m_SceneTarget.GetUvY()),
+                   ImVec2(m_SceneTarget.GetUvX(), 0));
+      m_SceneImageVisible = true;
+
+      if (m_SelectionRectActive) {
+        ImDrawList *drawList = ImGui::GetWindowDrawList();
+        const ImVec2 a(contentPos.x + m_SelectionRect[0],
+                       contentPos.y + m_SelectionRect[1]);
+        const ImVec2 b(contentPos.x + m_SelectionRect[2],
+                       contentPos.y + m_SelectionRect[3]);
+        drawList->AddRectFilled(a, b, IM_COL32(80, 140, 230, 40));
+        drawList->AddRect(a, b, IM_COL32(80, 140, 230, 200));
+      }
     }
     
     // Toolbar overlay inside scene viewport (top-right corner)
@@ -339,56 +631,133 @@ void EditorLayer::DrawHierarchy(Scene &scene) {
       c.pos[2] = 0;
       c.scale[0] = c.scale[1] = c.scale[2] = 1.0f;
       c.rotation[0] = c.rotation[1] = c.rotation[2] = 0.0f;
-      scene.AddCube(c);
+      m_Undo.RecordAdd("Add Cube", scene, {scene.AddCube(c)});
     }
     ImGui::SameLine();
     if (ImGui::Button("Clear All")) {
-      scene.Clear();
-      m_SelectedCubeIndex = -1;
+      ClearSelection(scene);
+      std::vector<EntityHandle> all(scene.GetCubes().size());
+      for (size_t i = 0; i < all.size(); ++i)
+        all[i] = scene.GetHandle((uint32_t)i);
+      StartRemove(scene, "Clear All", std::move(all));
     }
     
+    ImGui::SetNextItemWidth(-1);
+    ImGui::InputTextWithHint("##search", "Search name or material",
+                             m_HierarchySearch, sizeof(m_HierarchySearch));
+
+    const std::vector<CubeInst> &cubes = scene.GetCubes();
+    // The index is only kept up to date while searching; it catches up on
+    // the change batches gathered in between
+    const bool searching = m_HierarchySearch[0] != '\0';
+    const std::vector<uint32_t> *filtered = nullptr;
+    if (searching) {
+      m_HierarchyIndex.Update(scene, m_HierarchyChanges.first,
+                              m_HierarchyChanges.end);
+      m_HierarchyChanges = SceneChangeBatch();
+      filtered = &m_HierarchyIndex.Filter(m_HierarchySearch);
+    }
+    const int rows = searching ? (int)filtered->size() : (int)cubes.size();
+
     ImGui::Separator();
-    ImGui::Text("Scene Objects (%d)", (int)scene.GetCubes().size());
+    if (searching)
+      ImGui::Text("%d of %d objects (%.2f ms)", rows, (int)cubes.size(),
+                  m_HierarchyIndex.GetFilterMs());
+    else
+      ImGui::Text("Scene Objects (%d)", (int)cubes.size());
     ImGui::Separator();
 
-    auto &cubes = scene.GetCubes();
-    for (int i = 0; i < (int)cubes.size(); ++i) {
-      std::string label = "Cube " + std::to_string(i);
-      bool isSelected = (m_SelectedCubeIndex == i);
-      
-      if (ImGui::Selectable(label.c_str(), isSelected)) {
-        // Deselect all
-        for (auto &c : cubes)
-          c.selected = false;
-        cubes[i].selected = true;
-        m_SelectedCubeIndex = i;
-      }
-      
-      // Right-click context menu
-      if (ImGui::BeginPopupContextItem()) {
-        if (ImGui::MenuItem("Delete")) {
-          cubes.erase(cubes.begin() + i);
-          if (m_SelectedCubeIndex == i)
-            m_SelectedCubeIndex = -1;
-          else if (m_SelectedCubeIndex > i)
-            m_SelectedCubeIndex--;
+    // Only the rows in view are submitted; labels live in the frame arena
+    ImGui::BeginChild("##objects");
+    const float rowHeight = ImGui::GetTextLineHeightWithSpacing();
+    // Row listing a cube, -1 if filtered out
+    auto rowOf = [&](int index) {
+      if (!searching || index < 0)
+        return index;
+      auto it = std::lower_bound(filtered->begin(), filtered->end(),
+                                 (uint32_t)index);
+      return it != filtered->end() && *it == (uint32_t)index
+                 ? (int)(it - filtered->begin())
+                 : -1;
+    };
+    if (m_SelectedCubeIndex != m_HierarchyShownSelection) {
+      // Selected elsewhere (viewport picking): bring its row into view
+      m_HierarchyShownSelection = m_SelectedCubeIndex;
+      const int row = rowOf(m_SelectedCubeIndex);
+      const float y = row * rowHeight;
+      if (row >= 0 && (y < ImGui::GetScrollY() ||
+                       y + rowHeight > ImGui::GetScrollY() +
+                                           ImGui::GetWindowHeight()))
+        ImGui::SetScrollY(y - 0.5f * ImGui::GetWindowHeight());
+    }
+
+    ImGuiListClipper clipper;
+    clipper.Begin(rows, rowHeight);
+    bool erased = false;
+    while (!erased && clipper.Step()) {
+      for (int row = clipper.DisplayStart; row < clipper.DisplayEnd; ++row) {
+        const int i = searching ? (int)(*filtered)[row] : row;
+        const EntityHandle handle = scene.GetHandle((uint32_t)i);
+        if (ImGui::Selectable(m_Labels.Format("Cube %u", handle.index),
+                              m_Selection.Contains(handle))) {
+          const ImGuiIO &io = ImGui::GetIO();
+          const int anchor = rowOf(scene.GetIndex(m_SelectionAnchor));
+          if (io.KeyShift && anchor >= 0) {
+            // Rows from the anchor to this one as listed, ending on it so
+            // that it becomes the active object
+            std::vector<EntityHandle> range;
+            const int step = row >= anchor ? 1 : -1;
+            for (int r = anchor;; r += step) {
+              range.push_back(scene.GetHandle(
+                  searching ? (*filtered)[r] : (uint32_t)r));
+              if (r == row)
+                break;
+            }
+            SelectCubes(scene, range,
+                        io.KeyCtrl ? SelectMode::Add : SelectMode::Replace);
+          } else {
+            SelectCubes(scene, {handle},
+                        io.KeyCtrl ? SelectMode::Toggle : SelectMode::Replace);
+            m_SelectionAnchor = handle;
+          }
+          m_HierarchyShownSelection = m_SelectedCubeIndex;
+        }
+
+        // Right-click context menu
+        if (ImGui::BeginPopupContextItem()) {
+          if (ImGui::MenuItem("Delete")) {
+            EraseCube(scene, handle);
+            m_HierarchyShownSelection = m_SelectedCubeIndex;
+            ImGui::EndPopup();
+            erased = true; // the filtered rows are stale until next frame
+            break;
+          }
+          if (ImGui::MenuItem("Duplicate")) {
+            CubeInst copy = cubes[i];
+            copy.pos[0] += 1.0f;
+            copy.selected = false;
+            m_Undo.RecordAdd("Duplicate", scene, {scene.AddCube(copy)});
+          }
           ImGui::EndPopup();
-          break;
         }
-        if (ImGui::MenuItem("Duplicate")) {
-          CubeInst copy = cubes[i];
-          copy.pos[0] += 1.0f;
-          copy.selected = false;
-          scene.AddCube(copy);
+
+        // Material file, after the row's own popup
+        const std::string &path = cubes[i].materialPath;
+        if (!path.empty()) {
+          const size_t slash = path.find_last_of("/\\");
+          ImGui::SameLine();
+          ImGui::TextDisabled(
+              "%s", path.c_str() + (slash == std::string::npos ? 0 : slash + 1));
         }
-        ImGui::EndPopup();
       }
     }
-    
+    clipper.End();
+
     if (cubes.empty()) {
       ImGui::TextColored(ImVec4(0.5f, 0.5f, 0.5f, 1.0f), "No objects in scene");
       ImGui::TextWrapped("Click 'Add Cube' to create an object.");
     }
+    ImGui::EndChild();
   }
   ImGui::End();
 }
@@ -398,35 +767,61 @@ void EditorLayer::DrawProperties(Scene &scene) {
   if (ImGui::Begin("Properties", &m_ShowProperties)) {
     if (m_SelectedCubeIndex >= 0 &&
         m_SelectedCubeIndex < (int)scene.GetCubes().size()) {
-      CubeInst &cube = scene.GetCubes()[m_SelectedCubeIndex];
+      const CubeInst &cube = scene.GetCubes()[m_SelectedCubeIndex];
       
       // Object Info Header
-      ImGui::Text("Cube %d", m_SelectedCubeIndex);
+      const uint32_t slot = m_Selection.GetActive().index;
+      if (m_Selection.Size() > 1)
+        ImGui::Text("%d objects (active: Cube %u)", (int)m_Selection.Size(),
+                    slot);
+      else
+        ImGui::Text("Cube %u", slot);
       ImGui::Separator();
       
-      // Transform Section
+      // Transform Section: shows the active cube; an edit moves every
+      // selected cube by the same amount
       if (ImGui::CollapsingHeader("Transform", ImGuiTreeNodeFlags_DefaultOpen)) {
+        float pos[3] = {cube.pos[0], cube.pos[1], cube.pos[2]};
+        float rotation[3] = {cube.rotation[0], cube.rotation[1], cube.rotation[2]};
+        float scale[3] = {cube.scale[0], cube.scale[1], cube.scale[2]};
+
         ImGui::Text("Position");
         ImGui::PushItemWidth(-1);
-        ImGui::DragFloat3("##Pos", cube.pos, 0.1f, -100.0f, 100.0f, "%.2f");
+        if (ImGui::DragFloat3("##Pos", pos, 0.1f, -100.0f, 100.0f, "%.2f"))
+          EditSelection(scene, 0, pos);
+        TrackPropertyEdit(scene, 0);
         ImGui::PopItemWidth();
         
         ImGui::Spacing();
         ImGui::Text("Rotation");
         ImGui::PushItemWidth(-1);
-        ImGui::DragFloat3("##Rot", cube.rotation, 1.0f, -360.0f, 360.0f, "%.1f deg");
+        if (ImGui::DragFloat3("##Rot", rotation, 1.0f, -360.0f, 360.0f, "%.1f deg"))
+          EditSelection(scene, 1, rotation);
+        TrackPropertyEdit(scene, 1);
         ImGui::PopItemWidth();
         
         ImGui::Spacing();
         ImGui::Text("Scale");
         ImGui::PushItemWidth(-1);
-        ImGui::DragFloat3("##Scale", cube.scale, 0.1f, 0.01f, 100.0f, "%.2f");
+        if (ImGui::DragFloat3("##Scale", scale, 0.1f, 0.01f, 100.0f, "%.2f"))
+          EditSelection(scene, 2, scale);
+        TrackPropertyEdit(scene, 2);
         ImGui::PopItemWidth();
       }
       
       // Material Section
       if (ImGui::CollapsingHeader("Material", ImGuiTreeNodeFlags_DefaultOpen)) {
         ImGui::Text("Path: %s", cube.materialPath.empty() ? "(default)" : cube.materialPath.c_str());
+        ImGui::SetNextItemWidth(-60.0f);
+        ImGui::InputTextWithHint("##MaterialPath", "path/to/material.mat",
+                                 m_MaterialPath, sizeof(m_MaterialPath));
+        ImGui::SameLine();
+        if (ImGui::Button("Assign")) {
+          // To the whole selection
+          m_Undo.RecordMaterial("Assign Material", scene,
+                                m_Selection.GetHandles(), m_MaterialPath);
+          scene.SetMaterial(m_Selection.GetHandles(), m_MaterialPath);
+        }
         // TODO: Material editor
       }
       
@@ -434,15 +829,28 @@ void EditorLayer::DrawProperties(Scene &scene) {
       
       // Actions
       if (ImGui::Button("Reset Transform")) {
-        cube.pos[0] = cube.pos[1] = cube.pos[2] = 0.0f;
-        cube.rotation[0] = cube.rotation[1] = cube.rotation[2] = 0.0f;
-        cube.scale[0] = cube.scale[1] = cube.scale[2] = 1.0f;
+        std::vector<float> before[3];
+        for (int field = 0; field < 3; ++field)
+          GatherSelection(scene, field, before[field]);
+        // Origin, no rotation, unit scale: each field written as its
+        // reset value plus a zero delta
+        const std::vector<EntityHandle> &handles = m_Selection.GetHandles();
+        const float zero[3] = {0.0f, 0.0f, 0.0f};
+        std::vector<float> reset(handles.size() * 3, 0.0f);
+        scene.BeginChanges();
+        scene.TransformCubes(handles, 0, reset.data(), zero);
+        scene.TransformCubes(handles, 1, reset.data(), zero);
+        std::fill(reset.begin(), reset.end(), 1.0f);
+        scene.TransformCubes(handles, 2, reset.data(), zero);
+        scene.EndChanges();
+        const float *fields[3] = {before[0].data(), before[1].data(),
+                                  before[2].data()};
+        m_Undo.RecordTransform("Reset Transform", scene,
+                               m_Selection.GetHandles(), fields);
       }
       ImGui::SameLine();
-      if (ImGui::Button("Delete")) {
-        scene.GetCubes().erase(scene.GetCubes().begin() + m_SelectedCubeIndex);
-        m_SelectedCubeIndex = -1;
-      }
+      if (ImGui::Button("Delete"))
+        EraseSelection(scene);
     } else {
       ImGui::TextColored(ImVec4(0.5f, 0.5f, 0.5f, 1.0f), "No object selected");
       ImGui::Spacing();
@@ -452,14 +860,261 @@ void EditorLayer::DrawProperties(Scene &scene) {
   ImGui::End();
 }
 
-void EditorLayer::DrawFileExplorer() {
+void EditorLayer::DrawFileExplorer(Scene &scene) {
   if (ImGui::Begin("File Explorer", &m_ShowFileExplorer)) {
-    ImGui::Text("Content Browser (Placeholder)");
-    // TODO: Port full file explorer logic
+    // Double-click: a material becomes the one Assign Material uses, a
+    // project file is opened
+    FileItem item;
+    if (m_ContentBrowser.Draw(item)) {
+      if (item.type == FILETYPE_MATERIAL) {
+        std::strncpy(m_MaterialPath, item.path.c_str(),
+                     sizeof(m_MaterialPath) - 1);
+        m_MaterialPath[sizeof(m_MaterialPath) - 1] = '\0';
+      } else if (item.type == FILETYPE_SCENE) {
+        StartOpenProject(scene, item.path);
+      }
+    }
+  }
+  ImGui::End();
+}
+
+void EditorLayer::DrawStats(const Scene &scene) {
+  ImGui::SetNextWindowSize(ImVec2(280, 160), ImGuiCond_FirstUseEver);
+  if (ImGui::Begin("Stats", &m_ShowStats)) {
+    const RenderStats &stats = scene.GetRenderStats();
+    ImGui::Text("Frame: %.2f ms (%.0f FPS)", 1000.0f / ImGui::GetIO().Framerate,
+                ImGui::GetIO().Framerate);
+    ImGui::Separator();
+    ImGui::Text("Objects: %d", stats.instances);
+    ImGui::Text("Draw calls: %d (%d texture binds)", stats.drawCalls,
+                stats.textureBinds);
+    ImGui::Text("Indirect commands: %d", stats.indirectCommands);
+    ImGui::Text("Path: %s", stats.multiDrawIndirect ? "MultiDrawIndirect"
+                                                    : "Instanced (GL 3.3)");
+    ImGui::Separator();
+    ImGui::Text("State changes: %d", stats.stateChanges);
+    ImGui::Text("Queue sort: %.3f ms", stats.sortMs);
+    ImGui::Text("Occluders: %d, culled: %d (%.3f ms)", stats.occluders,
+                stats.occlusionCulled, stats.occlusionMs);
+    ImGui::Text("Views: %d, union culled: %d (%.3f ms)", stats.views,
+                stats.unionCulled, stats.visibilityMs);
+    ImGui::Text("Undo: %d steps (%d redo), %.2f / %.0f MB (%.2f MB raw)",
+                (int)m_Undo.GetUndoCount(), (int)m_Undo.GetRedoCount(),
+                m_Undo.GetMemoryBytes() / 1048576.0,
+                m_Undo.GetMemoryLimit() / 1048576.0,
+                m_Undo.GetRawBytes() / 1048576.0);
+    ImGui::Text("Last undo/redo: %.2f ms, %d evicted",
+                m_Undo.GetLastApplyMs(), (int)m_Undo.GetEvicted());
+    ImGui::Separator();
+    const ChunkStats &chunks = stats.chunks;
+    ImGui::Text("Chunks: %d (%d full, %d partial, %d pending)", chunks.chunks,
+                chunks.visibleChunks, chunks.partialChunks,
+                chunks.pendingChunks);
+    ImGui::Text("Chunk draws: %d, sync %.3f ms", chunks.drawCalls,
+                stats.chunkSyncMs);
+    ImGui::Text("Last chunk rebuild: %.2f ms", chunks.rebuildLatencyMs);
+    ImGui::Separator();
+    const LightClusterStats &lights = stats.lights;
+    ImGui::Text("Lights: %d (%d visible), binning %.3f ms", lights.lights,
+                lights.visibleLights, lights.binMs);
+    ImGui::Text("Clusters: %d lit, %d indices, max %d per cluster",
+                lights.activeClusters, lights.indices, lights.maxPerCluster);
+    const ShadowStats &shadows = stats.shadows;
+    if (shadows.cascadeCount > 0) {
+      const uint64_t lookups = shadows.cacheHits + shadows.staticRenders;
+      ImGui::Text("Shadows: %.3f ms, cache hits %.1f%%, %d composites",
+                  shadows.ms,
+                  lookups ? 100.0 * shadows.cacheHits / lookups : 0.0,
+                  shadows.composites);
+      for (int i = 0; i < shadows.cascadeCount; ++i) {
+        const ShadowCascadeStats &c = shadows.cascades[i];
+        if (c.cached)
+          ImGui::Text("  Cascade %d (%.0f m): static cached, %d dynamic "
+                      "(%d draws)",
+                      i, c.splitFar, c.dynamicCasters, c.dynamicDraws);
+        else
+          ImGui::Text("  Cascade %d (%.0f m): static %d draws, %d dynamic "
+                      "(%d draws)",
+                      i, c.splitFar, c.staticDraws, c.dynamicCasters,
+                      c.dynamicDraws);
+      }
+    }
+    ImGui::Separator();
+    const DynamicResolutionStats &resolution = m_DynamicResolution.GetStats();
+    ImGui::Text("Scene GPU: %.2f ms (budget %.1f ms)", resolution.gpuMs,
+                resolution.budgetMs);
+    if (resolution.enabled)
+      ImGui::Text("Render scale: %.0f%% (%dx%d), %d changes",
+                  resolution.scale * 100.0f, resolution.renderWidth,
+                  resolution.renderHeight, resolution.scaleChanges);
+    ImGui::Text("Viewport target: %dx%d, %d reallocations",
+                m_SceneTarget.GetCapacityWidth(),
+                m_SceneTarget.GetCapacityHeight(),
+                m_SceneTarget.GetReallocations());
+    const RenderGraphStats &graph = m_Graph.GetStats();
+    ImGui::Text("Render graph: %d passes (%d culled)", graph.passes,
+                graph.culledPasses);
+    for (const RenderGraphPassStats &pass : graph.passStats) {
+      if (pass.culled)
+        ImGui::TextDisabled("  %s: culled", pass.name.c_str());
+      else
+        ImGui::Text("  %s: cpu %.3f ms, gpu %.3f ms", pass.name.c_str(),
+                    pass.cpuMs, pass.gpuMs);
+    }
+    ImGui::Text("Transients: %d on %d textures, %.1f/%.1f MB (pool %.1f MB)",
+                graph.transientTextures, graph.physicalTextures,
+                graph.physicalBytes / (1024.0f * 1024.0f),
+                graph.transientBytes / (1024.0f * 1024.0f),
+                graph.poolBytes / (1024.0f * 1024.0f));
+    if (ImGui::SmallButton("Dump Render Graph"))
+      m_Graph.Dump(std::cout);
+    const CaptureStats capture = m_Capture.GetStats();
+    if (capture.requested > 0) {
+      ImGui::Text("Capture: %llu written, %d in flight, %d encoding%s",
+                  (unsigned long long)capture.written,
+                  capture.pendingReadbacks, capture.pendingWrites,
+                  m_Capture.IsRecording() ? " (recording)" : "");
+      ImGui::Text("Dropped: %llu ring, %llu encoder; map %.2f ms, "
+                  "encode %.1f ms",
+                  (unsigned long long)capture.droppedRing,
+                  (unsigned long long)capture.droppedEncoder, capture.mapMs,
+                  capture.encodeMs);
+      if (capture.failed)
+        ImGui::TextColored(ImVec4(1.0f, 0.4f, 0.4f, 1.0f),
+                           "Failed captures: %llu",
+                           (unsigned long long)capture.failed);
+    }
+    ImGui::Separator();
+    ImGui::Text("Debug draws: %d (%d vertices)", stats.debugDrawCalls,
+                stats.debugVertices);
+    ImGui::Separator();
+    const ShaderLibraryStats &shaders = ShaderLibrary::Get().GetStats();
+    ImGui::Text("Shader variants: %d ready, %d pending (%d cached)",
+                shaders.ready, shaders.pending, shaders.fromCache);
+    ImGui::Text("Fallback draws: %d, compile %s", shaders.fallbackUses,
+                shaders.parallelCompile ? "parallel (KHR)" : "1 per frame");
+    const Shader::ProgramCacheStats &cache = Shader::getProgramCacheStats();
+    ImGui::Text("Program cache: %d hits (%.1f ms), %d compiled (%.1f ms), "
+                "%d rebuilt",
+                cache.hits, cache.loadMs, cache.misses, cache.compileMs,
+                cache.rejected);
+    ImGui::Separator();
+    const TextureStats &textures = TextureManager::Get().GetStats();
+    ImGui::Text("Textures: %d resident, %d decoding, %d uploading",
+                textures.resident, textures.decoding, textures.uploading);
+    ImGui::Text("Uploaded %.1f KB (%.3f ms), %.1f MB resident",
+                textures.uploadedBytes / 1024.0f, textures.updateMs,
+                textures.residentBytes / (1024.0f * 1024.0f));
+    ImGui::Text("Cache: %d hits, %d imported", textures.cacheHits,
+                textures.imported);
+    const TexturePackerStats &packer = TextureManager::Get().GetPackerStats();
+    ImGui::Text("Arrays: %d, layers %d/%d, %.1f MB", packer.arrays,
+                packer.layersUsed, packer.layersAllocated,
+                packer.allocatedBytes / (1024.0f * 1024.0f));
+    ImGui::Text("Atlas: %d textures in %d layers (%.0f%% full)",
+                packer.atlasTextures, packer.atlasLayers,
+                packer.atlasFill * 100.0f);
+    ImGui::Separator();
+    const ThumbnailStats &thumbnails = m_Thumbnails.GetStats();
+    ImGui::Text("Thumbnails: %d ready, %d pending, %d failed",
+                thumbnails.ready, thumbnails.pending, thumbnails.failed);
+    ImGui::Text("Thumbnail cache: %d hits, %d rendered in %d batches (%.3f ms)",
+                thumbnails.diskHits, thumbnails.rendered, thumbnails.batches,
+                thumbnails.updateMs);
+    if (textures.failed)
+      ImGui::TextColored(ImVec4(1.0f, 0.4f, 0.4f, 1.0f), "Failed textures: %d",
+                         textures.failed);
+    DrawTextureCacheBenchmark();
+    ImGui::Separator();
+    const GLStateCounters &glCalls =
+        GLStateCache::Get().GetLastFrameCounters();
+    ImGui::Text("GL state calls forwarded: %llu",
+                (unsigned long long)glCalls.forwarded);
+    ImGui::Text("GL state calls filtered: %llu",
+                (unsigned long long)glCalls.filtered);
   }
   ImGui::End();
 }
 
+void EditorLayer::DrawTextureCacheBenchmark() {
+  const int LOADS = 500;
+  const bool running =
+      m_TextureBenchmark && !m_TextureBenchmark->done.load(std::memory_order_acquire);
+  ImGui::BeginDisabled(running);
+  if (ImGui::Button(running ? "Benchmarking..." : "Benchmark texture cache")) {
+    // Every texture under Content/, cycled up to LOADS loads
+    std::vector<std::string> files;
+    std::error_code ec;
+    for (auto it = std::filesystem::recursive_directory_iterator("Content", ec);
+         !ec && it != std::filesystem::recursive_directory_iterator();
+         it.increment(ec)) {
+      if (it->is_regular_file() &&
+          ImageLoader::IsSupportedExtension(it->path().string()))
+        files.push_back(it->path().string());
+    }
+    auto run = std::make_shared<TextureBenchmarkRun>();
+    m_TextureBenchmark = run;
+    JobSystem::Get().SubmitBackground([run, files] {
+      run->result = TextureCache::RunBenchmark(files, LOADS, {});
+      run->done.store(true, std::memory_order_release);
+    });
+  }
+  ImGui::EndDisabled();
+  if (!m_TextureBenchmark || running)
+    return;
+
+  const TextureCacheBenchmark &r = m_TextureBenchmark->result;
+  if (!r.error.empty()) {
+    ImGui::TextColored(ImVec4(1.0f, 0.4f, 0.4f, 1.0f), "Benchmark: %s",
+                       r.error.c_str());
+    return;
+  }
+  ImGui::Text("%d loads of %d files", r.loads, r.files);
+  ImGui::Text("Decode: %.1f ms (%.2f ms/texture)", r.coldMs, r.coldMs / r.loads);
+  ImGui::Text("Import: %.1f ms (%.2f ms/texture)", r.importMs,
+              r.importMs / r.loads);
+  ImGui::Text("Cached: %.1f ms (%.2f ms/texture), %.1fx faster", r.cachedMs,
+              r.cachedMs / r.loads, r.cachedMs > 0.0 ? r.coldMs / r.cachedMs : 0.0);
+  ImGui::Text("Bytes: %.1f MB source, %.1f MB RGBA8, %.1f MB cached",
+              r.sourceBytes / (1024.0f * 1024.0f),
+              r.decodedBytes / (1024.0f * 1024.0f),
+              r.cachedBytes / (1024.0f * 1024.0f));
+}
+
+void EditorLayer::DrawLongTaskModal() {
+  const LongTask *task = m_Tasks.GetCurrent();
+  // A task that finishes within its first slice never shows the modal
+  if (task && task->IsStarted() && !ImGui::IsPopupOpen("Working"))
+    ImGui::OpenPopup("Working");
+
+  const ImGuiViewport *viewport = ImGui::GetMainViewport();
+  ImGui::SetNextWindowPos(viewport->GetCenter(), ImGuiCond_Appearing,
+                          ImVec2(0.5f, 0.5f));
+  if (!ImGui::BeginPopupModal("Working", nullptr,
+                              ImGuiWindowFlags_AlwaysAutoResize |
+                                  ImGuiWindowFlags_NoSavedSettings))
+    return;
+  if (!task) {
+    ImGui::CloseCurrentPopup();
+    ImGui::EndPopup();
+    return;
+  }
+  ImGui::TextUnformatted(task->GetName().c_str());
+  if (!task->GetStatus().empty())
+    ImGui::TextDisabled("%s", task->GetStatus().c_str());
+  ImGui::ProgressBar(task->GetProgress(), ImVec2(320.0f, 0.0f));
+  ImGui::Text("%.1f s", task->GetElapsedSeconds());
+  if (m_Tasks.GetQueued() > 1) {
+    ImGui::SameLine();
+    ImGui::TextDisabled("(%zu more queued)", m_Tasks.GetQueued() - 1);
+  }
+  ImGui::BeginDisabled(!task->IsCancellable() || task->IsCancelled());
+  if (ImGui::Button(task->IsCancelled() ? "Cancelling..." : "Cancel"))
+    m_Tasks.Cancel();
+  ImGui::EndDisabled();
+  ImGui::EndPopup();
+}
+
 void EditorLayer::DrawAboutDialog() {
   ImGui::SetNextWindowSize(ImVec2(400, 200), ImGuiCond_FirstUseEver);
   if (ImGui::Begin("About MarioEngine", &m_ShowAbout, ImGuiWindowFlags_NoResize)) {
@@ -651,6 +1306,9 @@ void EditorLayer::ApplyGizmoDrag(CubeInst& cube, float deltaX, float deltaY, con
 void EditorLayer::HandleGizmoInput(Scene &scene, GLFWwindow *window, const Mat4& view, const Mat4& proj) {
   // Reset hovered axis at start of frame
   m_HoveredAxis = -1;
+  if (m_Tasks.IsBusy())
+    return;
+  SyncSelection(scene);
   
   if (m_SelectedCubeIndex < 0 || m_SelectedCubeIndex >= (int)scene.GetCubes().size())
     return;
@@ -673,7 +1331,7 @@ void EditorLayer::HandleGizmoInput(Scene &scene, GLFWwindow *window, const Mat4&
   if (!mouseInViewport)
     return;
     
-  CubeInst &cube = scene.GetCubes()[m_SelectedCubeIndex];
+  const CubeInst &cube = scene.GetCubes()[m_SelectedCubeIndex];
   
   bool leftPressed = glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS;
   
@@ -709,24 +1367,374 @@ void EditorLayer::HandleGizmoInput(Scene &scene, GLFWwindow *window, const Mat4&
       m_DragStartValue[1] = cube.scale[1];
       m_DragStartValue[2] = cube.scale[2];
     }
+    GatherSelection(scene, m_TransformMode, m_DragStartValues);
   }
   
   // Continue dragging
   if (m_IsDraggingGizmo && leftPressed && m_DragAxis >= 0) {
     float deltaX = (float)xpos - m_DragStartPos[0];
     float deltaY = (float)ypos - m_DragStartPos[1];
-    ApplyGizmoDrag(cube, deltaX, -deltaY, view); // Invert Y
+    CubeInst dragged = cube;
+    ApplyGizmoDrag(dragged, deltaX, -deltaY, view); // Invert Y
+    // The whole selection follows the active cube, each from its own start
+    // value
+    const float *value = CubeField(dragged, m_TransformMode);
+    float delta[3];
+    for (int k = 0; k < 3; ++k)
+      delta[k] = value[k] - m_DragStartValue[k];
+    if (m_DragStartValues.size() == m_Selection.Size() * 3)
+      ApplySelectionDelta(scene, m_TransformMode, m_DragStartValues.data(),
+                          delta);
   }
   
   // Stop dragging
   if (!leftPressed && m_IsDraggingGizmo) {
     m_IsDraggingGizmo = false;
     m_DragAxis = -1;
+    if (m_DragStartValues.size() == m_Selection.Size() * 3) {
+      static const char *const names[3] = {"Move", "Rotate", "Scale"};
+      const float *before[3] = {nullptr, nullptr, nullptr};
+      before[m_TransformMode] = m_DragStartValues.data();
+      m_Undo.RecordTransform(names[m_TransformMode], scene,
+                             m_Selection.GetHandles(), before);
+    }
   }
   
   wasLeftPressed = leftPressed;
 }
 
+void EditorLayer::TrackPropertyEdit(Scene &scene, int field) {
+  // One undo step per drag or typed value of the last widget
+  if (ImGui::IsItemActivated())
+    GatherSelection(scene, field, m_EditStartValues);
+  if (ImGui::IsItemDeactivatedAfterEdit() &&
+      m_EditStartValues.size() == m_Selection.Size() * 3) {
+    static const char *const names[3] = {"Edit Position", "Edit Rotation",
+                                         "Edit Scale"};
+    const float *before[3] = {nullptr, nullptr, nullptr};
+    before[field] = m_EditStartValues.data();
+    m_Undo.RecordTransform(names[field], scene, m_Selection.GetHandles(),
+                           before);
+  }
+}
+
+void EditorLayer::Undo(Scene &scene) {
+  if (m_IsDraggingGizmo || !m_Undo.CanUndo())
+    return;
+  m_Undo.Undo(scene);
+  SyncSelection(scene);
+}
+
+void EditorLayer::Redo(Scene &scene) {
+  if (m_IsDraggingGizmo || !m_Undo.CanRedo())
+    return;
+  m_Undo.Redo(scene);
+  SyncSelection(scene);
+}
+
+void EditorLayer::PickCube(Scene &scene, EntityHandle hit, SelectMode mode) {
+  if (scene.IsValid(hit))
+    SelectCubes(scene, {hit}, mode);
+  else if (mode == SelectMode::Replace)
+    ClearSelection(scene);
+}
+
+void EditorLayer::SelectInRect(Scene &scene, float x0, float y0, float x1,
+                               float y1, const Mat4 &viewProj,
+                               SelectMode mode) {
+  // Rectangle in NDC
+  const float minX = 2.0f * std::min(x0, x1) / m_SceneViewportWidth - 1.0f;
+  const float maxX = 2.0f * std::max(x0, x1) / m_SceneViewportWidth - 1.0f;
+  const float minY = 1.0f - 2.0f * std::max(y0, y1) / m_SceneViewportHeight;
+  const float maxY = 1.0f - 2.0f * std::min(y0, y1) / m_SceneViewportHeight;
+
+  const std::vector<CubeInst> &cubes = scene.GetCubes();
+  const float *m = viewProj.m;
+  std::vector<uint32_t> hits;
+  std::mutex hitsMutex;
+  JobSystem::Get().ParallelFor(
+      cubes.size(), 4096, [&](size_t begin, size_t end) {
+        std::vector<uint32_t> local;
+        for (size_t i = begin; i < end; ++i) {
+          const float *p = cubes[i].pos;
+          const float w = m[3] * p[0] + m[7] * p[1] + m[11] * p[2] + m[15];
+          if (w <= 0.0f)
+            continue; // behind the camera
+          const float x =
+              (m[0] * p[0] + m[4] * p[1] + m[8] * p[2] + m[12]) / w;
+          const float y =
+              (m[1] * p[0] + m[5] * p[1] + m[9] * p[2] + m[13]) / w;
+          if (x >= minX && x <= maxX && y >= minY && y <= maxY)
+            local.push_back((uint32_t)i);
+        }
+        std::lock_guard<std::mutex> lock(hitsMutex);
+        hits.insert(hits.end(), local.begin(), local.end());
+      });
+  std::sort(hits.begin(), hits.end());
+  std::vector<EntityHandle> handles(hits.size());
+  for (size_t j = 0; j < hits.size(); ++j)
+    handles[j] = scene.GetHandle(hits[j]);
+  SelectCubes(scene, handles, mode);
+}
+
+void EditorLayer::SetSelectionRect(bool active, float x0, float y0, float x1,
+                                   float y1) {
+  m_SelectionRectActive = active;
+  m_SelectionRect[0] = std::min(x0, x1);
+  m_SelectionRect[1] = std::min(y0, y1);
+  m_SelectionRect[2] = std::max(x0, x1);
+  m_SelectionRect[3] = std::max(y0, y1);
+}
+
+void EditorLayer::SelectCubes(Scene &scene,
+                              const std::vector<EntityHandle> &handles,
+                              SelectMode mode) {
+  scene.BeginChanges();
+  if (mode == SelectMode::Replace)
+    ClearSelection(scene);
+  if (mode == SelectMode::Toggle) {
+    m_Selection.Toggle(handles, [&](EntityHandle handle) {
+      return scene.IsValid(handle);
+    });
+    for (EntityHandle handle : handles)
+      scene.SetSelected(handle, m_Selection.Contains(handle));
+  } else {
+    for (EntityHandle handle : handles) {
+      if (scene.IsValid(handle) && m_Selection.Add(handle))
+        scene.SetSelected(handle, true);
+    }
+  }
+  scene.EndChanges();
+  m_SelectedCubeIndex = scene.GetIndex(m_Selection.GetActive());
+}
+
+void EditorLayer::ClearSelection(Scene &scene) {
+  scene.BeginChanges();
+  for (EntityHandle handle : m_Selection.GetHandles())
+    scene.SetSelected(handle, false);
+  scene.EndChanges();
+  m_Selection.Clear();
+  m_SelectedCubeIndex = -1;
+  m_SelectionAnchor = EntityHandle{};
+}
+
+void EditorLayer::SyncSelection(const Scene &scene) {
+  // Removed cubes take their selected flag with them; only the handles
+  // are left to drop
+  if (m_SelectionEntityVersion != scene.GetEntityVersion()) {
+    m_SelectionEntityVersion = scene.GetEntityVersion();
+    m_Selection.RemoveIf(
+        [&](EntityHandle handle) { return !scene.IsValid(handle); });
+    if (!scene.IsValid(m_SelectionAnchor))
+      m_SelectionAnchor = EntityHandle{};
+  }
+  m_SelectedCubeIndex = scene.GetIndex(m_Selection.GetActive());
+}
+
+void EditorLayer::ResolveSelection(const Scene &scene) {
+  const std::vector<EntityHandle> &handles = m_Selection.GetHandles();
+  m_SelectedIndices.resize(handles.size());
+  for (size_t j = 0; j < handles.size(); ++j)
+    m_SelectedIndices[j] = (uint32_t)scene.GetIndex(handles[j]);
+}
+
+void EditorLayer::EraseCube(Scene &scene, EntityHandle handle) {
+  m_Undo.RecordRemove("Delete", scene, {handle});
+  m_Selection.Remove(handle);
+  scene.RemoveCube(handle);
+  SyncSelection(scene);
+}
+
+void EditorLayer::EraseSelection(Scene &scene) {
+  // Swap-and-pop per cube: O(selected), whatever the scene size
+  std::vector<EntityHandle> handles = m_Selection.GetHandles();
+  m_Selection.Clear();
+  m_SelectedCubeIndex = -1;
+  m_SelectionAnchor = EntityHandle{};
+  StartRemove(scene, "Delete", std::move(handles));
+}
+
+static void RemoveSlice(Scene &scene, UndoStack &undo, const char *name,
+                        const EntityHandle *handles, size_t count) {
+  std::vector<EntityHandle> slice(handles, handles + count);
+  undo.RecordRemove(name, scene, slice);
+  scene.RemoveCubes(slice);
+}
+
+static void DuplicateSlice(Scene &scene, UndoStack &undo,
+                           const EntityHandle *handles, size_t count) {
+  std::vector<CubeInst> copies;
+  copies.reserve(count);
+  for (size_t i = 0; i < count; ++i) {
+    const int index = scene.GetIndex(handles[i]);
+    if (index < 0)
+      continue;
+    copies.push_back(scene.GetCubes()[index]);
+    copies.back().pos[0] += 1.0f;
+    copies.back().selected = false;
+  }
+  std::vector<EntityHandle> added;
+  scene.AddCubes(copies.data(), copies.size(), &added);
+  undo.RecordAdd("Duplicate", scene, added);
+}
+
+// State of a sliced edit, shared by its step and finish
+struct SlicedEdit {
+  std::vector<EntityHandle> handles;
+  size_t done = 0;
+  bool grouped = false;
+};
+
+void EditorLayer::StartRemove(Scene &scene, const char *name,
+                              std::vector<EntityHandle> handles) {
+  if (handles.size() <= EDIT_SLICE) {
+    RemoveSlice(scene, m_Undo, name, handles.data(), handles.size());
+    SyncSelection(scene);
+    return;
+  }
+  auto edit = std::make_shared<SlicedEdit>();
+  edit->handles = std::move(handles);
+  const std::string label = name;
+  m_Tasks.Start(
+      label + " (" + std::to_string(edit->handles.size()) + " cubes)",
+      [this, &scene, edit, label](LongTask &task) {
+        if (!edit->grouped) {
+          m_Undo.BeginGroup(label.c_str());
+          edit->grouped = true;
+        }
+        // From the back: for Clear All that is the tail of the dense
+        // array, so every removal is a plain pop
+        const size_t total = edit->handles.size();
+        while (edit->done < total && task.HasTime()) {
+          const size_t count = std::min(EDIT_SLICE, total - edit->done);
+          edit->done += count;
+          RemoveSlice(scene, m_Undo, label.c_str(),
+                      edit->handles.data() + (total - edit->done), count);
+          task.SetProgress(edit->done, total);
+        }
+        return edit->done < total;
+      },
+      [this, &scene, edit](LongTask &, bool) {
+        // Cancelled: the slices already removed stay removed, as one step
+        if (edit->grouped)
+          m_Undo.EndGroup();
+        SyncSelection(scene);
+      });
+}
+
+void EditorLayer::StartDuplicate(Scene &scene,
+                                 std::vector<EntityHandle> handles) {
+  if (handles.size() <= EDIT_SLICE) {
+    DuplicateSlice(scene, m_Undo, handles.data(), handles.size());
+    return;
+  }
+  auto edit = std::make_shared<SlicedEdit>();
+  edit->handles = std::move(handles);
+  m_Tasks.Start(
+      "Duplicate (" + std::to_string(edit->handles.size()) + " cubes)",
+      [this, &scene, edit](LongTask &task) {
+        if (!edit->grouped) {
+          m_Undo.BeginGroup("Duplicate");
+          edit->grouped = true;
+        }
+        // One slice per frame: syncing the chunks of the added cubes in the
+        // next BeginFrame costs far more than adding them
+        const size_t total = edit->handles.size();
+        if (edit->done < total && task.HasTime()) {
+          const size_t count = std::min(EDIT_SLICE, total - edit->done);
+          DuplicateSlice(scene, m_Undo, edit->handles.data() + edit->done,
+                         count);
+          edit->done += count;
+          task.SetProgress(edit->done, total);
+        }
+        return edit->done < total;
+      },
+      [this, edit](LongTask &, bool) {
+        if (edit->grouped)
+          m_Undo.EndGroup();
+      });
+}
+
+void EditorLayer::StartOpenProject(Scene &scene, const std::string &path) {
+  struct Load {
+    ProjectData data;
+    bool loaded = false;
+    bool reset = false;
+    size_t next = 0;
+  };
+  auto load = std::make_shared<Load>();
+  m_Tasks.Start(
+      "Open " + path,
+      [this, &scene, load](LongTask &task) {
+        if (!load->loaded)
+          return false;
+        if (!load->reset) {
+          // The old scene goes here; a cancel from now on keeps the cubes
+          // loaded so far
+          ClearSelection(scene);
+          scene.Reset();
+          m_Undo.Clear();
+          load->reset = true;
+        }
+        // One slice per frame, as Duplicate
+        const size_t total = load->data.cubes.size();
+        if (load->next < total && task.HasTime()) {
+          const size_t count = std::min(EDIT_SLICE, total - load->next);
+          scene.AddProjectCubes(load->data, load->next, count);
+          load->next += count;
+          task.SetProgress(load->next, total);
+        }
+        task.SetStatus(std::to_string(load->next) + " / " +
+                       std::to_string(total) + " cubes");
+        return load->next < total;
+      },
+      nullptr,
+      // Parsing can't stop halfway; a cancel while reading leaves the
+      // scene untouched
+      [load, path](LongTask &) {
+        load->loaded = ProjectManager::LoadProject(path, load->data);
+      });
+}
+
+void EditorLayer::StartSaveProject(const Scene &scene,
+                                   const std::string &path) {
+  // Snapshot now; later edits don't reach the file being written
+  auto data = std::make_shared<ProjectData>();
+  data->projectName = "MyProject";
+  scene.GetProjectData(*data);
+  m_Tasks.Start("Save " + path, nullptr, nullptr,
+                [data, path](LongTask &) {
+                  ProjectManager::SaveProject(path, *data);
+                },
+                false);
+}
+
+void EditorLayer::GatherSelection(const Scene &scene, int field,
+                                  std::vector<float> &out) {
+  const std::vector<CubeInst> &cubes = scene.GetCubes();
+  ResolveSelection(scene);
+  out.resize(m_SelectedIndices.size() * 3);
+  for (size_t j = 0; j < m_SelectedIndices.size(); ++j)
+    std::memcpy(&out[j * 3], CubeField(cubes[m_SelectedIndices[j]], field),
+                3 * sizeof(float));
+}
+
+void EditorLayer::ApplySelectionDelta(Scene &scene, int field,
+                                      const float *start,
+                                      const float delta[3]) {
+  scene.TransformCubes(m_Selection.GetHandles(), field, start, delta,
+                       field == 2 ? 0.01f : -FLT_MAX);
+}
+
+void EditorLayer::EditSelection(Scene &scene, int field,
+                                const float edited[3]) {
+  const float *value = CubeField(scene.GetCubes()[m_SelectedCubeIndex], field);
+  const float delta[3] = {edited[0] - value[0], edited[1] - value[1],
+                          edited[2] - value[2]};
+  GatherSelection(scene, field, m_EditValues);
+  ApplySelectionDelta(scene, field, m_EditValues.data(), delta);
+}
+
 bool EditorLayer::GetMousePosInViewport(float &x, float &y) const {
   if (!m_SceneWindowHovered) return false;
   
@@ -1,10 +1,23 @@
 #pragma once
 
+#include "../camera/view_camera.h"
+#include "../core/long_task.h"
+#include "../render/dynamic_resolution.h"
+#include "../render/frame_capture.h"
+#include "../render/render_graph.h"
+#include "../render/render_target.h"
 #include "../scene/scene.h"
 #include "../utils/math_utils.h"
+#include "content_browser.h"
 #include "editor_defs.h"
+#include "hierarchy_index.h"
+#include "label_arena.h"
+#include "selection_set.h"
+#include "thumbnail_service.h"
+#include "undo_stack.h"
 #include <GLFW/glfw3.h>
 #include <glad/glad.h>
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -17,13 +30,34 @@ public:
   ~EditorLayer();
 
   void Init(GLFWwindow *window);
-  void Render(Scene &scene);
+  // Builds this frame's UI; it is drawn by RenderFrame
+  void BuildUI(Scene &scene);
+  // Renders the frame through the render graph: scene (at the dynamic
+  // resolution scale), gizmos, upscale into the panel, the split views,
+  // capture and the ImGui composition into the window's framebuffer. All
+  // scene views share one Scene::BeginFrame.
+  void RenderFrame(Scene &scene, const Mat4 &view, const Mat4 &proj,
+                   int displayWidth, int displayHeight);
 
   // Input handling if needed, though ImGui handles most via callbacks
   void Shutdown();
 
+  // Dense index of the active object, the last one added to the selection
+  // (-1 = none)
   int GetSelectedCubeIndex() const { return m_SelectedCubeIndex; }
-  void SetSelectedCubeIndex(int index) { m_SelectedCubeIndex = index; }
+  const SelectionSet &GetSelection() const { return m_Selection; }
+
+  // Replace: the cubes become the selection; Add (shift): joined to it;
+  // Toggle (ctrl): each one flips
+  enum class SelectMode { Replace, Add, Toggle };
+  // Viewport click; an invalid hit clears the selection in Replace mode
+  void PickCube(Scene &scene, EntityHandle hit, SelectMode mode);
+  // Cubes whose centre falls inside a rectangle of the scene panel (pixels,
+  // any two corners); the projection runs on the job system
+  void SelectInRect(Scene &scene, float x0, float y0, float x1, float y1,
+                    const Mat4 &viewProj, SelectMode mode);
+  // Rectangle being dragged, drawn over the scene panel
+  void SetSelectionRect(bool active, float x0, float y0, float x1, float y1);
   int GetTransformMode() const { return m_TransformMode; }
   int GetHoveredAxis() const { return m_HoveredAxis; }
   bool IsLocalSpace() const { return m_LocalSpace; }
@@ -33,16 +67,21 @@ public:
   bool IsDraggingGizmo() const { return m_IsDraggingGizmo; }
   bool IsHoveringGizmo() const { return m_HoveredAxis >= 0; }
   
+  // Camera of the main scene panel
+  ViewCamera &GetCamera() { return m_Camera; }
+
   // Scene viewport
-  void BeginSceneRender();
-  void EndSceneRender();
-  GLuint GetSceneTexture() const { return m_SceneTexture; }
+  GLuint GetSceneTexture() const { return m_SceneTarget.GetColorTexture(); }
   bool IsSceneWindowFocused() const { return m_SceneWindowFocused; }
   bool IsSceneWindowHovered() const { return m_SceneWindowHovered; }
   void GetSceneViewportSize(float &width, float &height) const { width = m_SceneViewportWidth; height = m_SceneViewportHeight; }
   void GetSceneViewportPos(float &x, float &y) const { x = m_SceneViewportPosX; y = m_SceneViewportPosY; }
   bool GetMousePosInViewport(float &x, float &y) const;
 
+  // A long operation (project load, bulk edits) is running over frames;
+  // scene input waits for it
+  bool IsBusy() const { return m_Tasks.IsBusy(); }
+
 private:
   void InitImGui(GLFWwindow *window);
   void InitFramebuffer();
@@ -50,32 +89,101 @@ private:
   void DrawMainMenuBar();
   void DrawDockSpace(Scene &scene);
   void DrawSceneViewport();
+  struct SplitView;
+  void DrawSplitView(SplitView &split);
   void DrawHierarchy(Scene &scene);
   void DrawProperties(Scene &scene);
-  void DrawFileExplorer();
+  void DrawFileExplorer(Scene &scene);
+  void DrawStats(const Scene &scene);
+  void DrawTextureCacheBenchmark();
   void DrawAboutDialog();
+  // Progress and Cancel of the running long task, while it takes more
+  // than one frame
+  void DrawLongTaskModal();
   
+  // Selection edits keep CubeInst::selected (read by the renderer) in sync
+  // by touching only the cubes that enter or leave the set
+  void SelectCubes(Scene &scene, const std::vector<EntityHandle> &handles,
+                   SelectMode mode);
+  void ClearSelection(Scene &scene);
+  // Drops the handles removed from the scene and refreshes the active
+  // cube's dense index; after anything that removes or moves cubes
+  void SyncSelection(const Scene &scene);
+  // Dense indices of the selection (selection order) into
+  // m_SelectedIndices
+  void ResolveSelection(const Scene &scene);
+  void EraseCube(Scene &scene, EntityHandle handle);
+  void EraseSelection(Scene &scene);
+  // Operations that may touch the whole scene, as long tasks committing
+  // slices of EDIT_SLICE cubes: removals as many as fit the frame budget,
+  // adds one per frame. Each is one undo step; up to EDIT_SLICE cubes are
+  // done at once.
+  static constexpr size_t EDIT_SLICE = 16384;
+  void StartOpenProject(Scene &scene, const std::string &path);
+  void StartSaveProject(const Scene &scene, const std::string &path);
+  void StartRemove(Scene &scene, const char *name,
+                   std::vector<EntityHandle> handles);
+  void StartDuplicate(Scene &scene, std::vector<EntityHandle> handles);
+  // field: 0=pos, 1=rotation, 2=scale (as m_TransformMode). Gather packs it
+  // for every selected cube (selection order); Apply writes start + delta
+  // back through the SIMD batch path, scale clamped to 0.01.
+  void GatherSelection(const Scene &scene, int field, std::vector<float> &out);
+  void ApplySelectionDelta(Scene &scene, int field, const float *start,
+                           const float delta[3]);
+  // Properties edit of the active cube's field, applied as a delta to all
+  void EditSelection(Scene &scene, int field, const float edited[3]);
+  // After a Properties transform widget: records its edit once released
+  void TrackPropertyEdit(Scene &scene, int field);
+  void Undo(Scene &scene);
+  void Redo(Scene &scene);
+
   // Gizmo helpers
   int DetectHoveredGizmoAxis(const float objPos[3], const Mat4& view, const Mat4& proj, float mouseX, float mouseY);
   void ApplyGizmoDrag(CubeInst& cube, float deltaX, float deltaY, const Mat4& view);
 
   GLFWwindow *m_Window = nullptr;
 
-  // Framebuffer for scene rendering
-  GLuint m_Framebuffer = 0;
-  GLuint m_SceneTexture = 0;
-  GLuint m_DepthRenderbuffer = 0;
+  // Texture shown in the scene panel, pooled so that resizing the panel
+  // only reallocates when it grows past the storage. Imported into the
+  // render graph; depth and scaled colour are graph transients.
+  RenderTarget m_SceneTarget;
   int m_FBWidth = 800;
   int m_FBHeight = 600;
+  bool m_SceneImageVisible = false; // panel drawn this frame
+  RenderGraph m_Graph;
+  // Driven by the GPU time of the graph's Scene pass
+  DynamicResolution m_DynamicResolution;
+  // Screenshots / sequences of the scene panel (File menu)
+  FrameCapture m_Capture;
+  ViewCamera m_Camera; // perspective, follows the fly camera
+
+  // Orthographic panels (View > Split Views), each with its own camera and
+  // render target. Their depth is a graph transient shared through the
+  // pool; dynamic resolution, capture and picking stay on the main panel.
+  static constexpr int SPLIT_VIEWS = 3;
+  struct SplitView {
+    ViewCamera camera;
+    RenderTarget target;
+    bool show = false;
+    int width = 0, height = 0;
+    bool imageVisible = false; // panel drawn this frame
+    bool hovered = false;
+  };
+  SplitView m_SplitViews[SPLIT_VIEWS];
 
   // State
   bool m_ShowHierarchy = true;
   bool m_ShowProperties = true;
   bool m_ShowFileExplorer = true;
   bool m_ShowSceneViewport = true;
+  bool m_ShowStats = false;
   bool m_ShowAbout = false;
   bool m_WireframeMode = false;
+  bool m_OcclusionCulling = true;
   bool m_LocalSpace = false;
+
+  // Texture cache benchmark running on a background job (Stats panel)
+  std::shared_ptr<struct TextureBenchmarkRun> m_TextureBenchmark;
   
   // Scene viewport state
   bool m_SceneWindowFocused = false;
@@ -85,8 +193,36 @@ private:
   float m_SceneViewportPosX = 0.0f;
   float m_SceneViewportPosY = 0.0f;
 
+  // Hierarchy panel: rows are clipped to the visible ones, searched through
+  // the index and labelled from the arena (reset every frame)
+  HierarchyIndex m_HierarchyIndex;
+  SceneChangeBatch m_HierarchyChanges; // not yet in the index
+  Scene *m_ChangeScene = nullptr;      // scene listened to
+  int m_ChangeListener = 0;
+  LabelArena m_Labels;
+  char m_HierarchySearch[128] = "";
+  int m_HierarchyShownSelection = -1; // selection the list last scrolled to
+
   // Selection state
-  int m_SelectedCubeIndex = -1;
+  SelectionSet m_Selection;
+  std::vector<uint32_t> m_SelectedIndices; // ResolveSelection
+  uint64_t m_SelectionEntityVersion = 0;   // scene version last synced
+  int m_SelectedCubeIndex = -1; // dense, of m_Selection.GetActive()
+  EntityHandle m_SelectionAnchor; // start of shift-click ranges (Hierarchy)
+  bool m_SelectionRectActive = false;
+  float m_SelectionRect[4] = {0, 0, 0, 0}; // scene panel pixels
+  // Packed xyz of the dragged field per selected cube at drag start, and
+  // the current values (EditSelection)
+  std::vector<float> m_DragStartValues;
+  std::vector<float> m_EditValues;
+  std::vector<float> m_EditStartValues; // Properties widget being edited
+
+  // Every edit to the cubes goes through here (Edit > Undo/Redo)
+  UndoStack m_Undo;
+  ContentBrowser m_ContentBrowser; // File Explorer panel
+  ThumbnailService m_Thumbnails;   // its material and model previews
+  LongTaskRunner m_Tasks;
+  char m_MaterialPath[256] = "";
   int m_TransformMode = 0; // 0=Translate, 1=Rotate, 2=Scale
   
   // Gizmo state
@@ -0,0 +1,165 @@
+#include "hierarchy_index.h"
+#include "../core/job_system.h"
+#include "../scene/scene.h"
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+
+static std::string ToLower(const std::string &text) {
+  std::string lower(text);
+  for (char &c : lower)
+    c = (char)std::tolower((unsigned char)c);
+  return lower;
+}
+
+bool HierarchyIndex::Update(const Scene &scene, size_t first,
+                            size_t end) {
+  if (m_SceneMaterials != scene.GetMaterialsVersion()) {
+    // The scene was reset: every entry is read again below
+    Clear();
+    m_SceneMaterials = scene.GetMaterialsVersion();
+  }
+  const std::vector<CubeInst> &cubes = scene.GetCubes();
+  const size_t n = cubes.size();
+  const size_t previous = m_Handles.size();
+  bool changed = n != previous;
+  m_Names.resize(n * NAME_STRIDE, '\0');
+  // Never a real slot or handle: new entries read both below
+  m_Slots.resize(n, EntityHandle::INVALID_INDEX);
+  m_Handles.resize(n, -2);
+  m_Materials.resize(n, 0);
+
+  auto diff = [&](size_t i) {
+    const uint32_t slot = scene.GetHandle((uint32_t)i).index;
+    if (m_Slots[i] != slot) {
+      m_Slots[i] = slot;
+      char *name = &m_Names[i * NAME_STRIDE];
+      std::memset(name, 0, NAME_STRIDE);
+      std::snprintf(name, NAME_STRIDE, "cube %u", slot);
+      changed = true;
+    }
+    // Handles and paths match one to one once resolved, so comparing the
+    // handle catches material changes and cubes moved by a removal; an
+    // unresolved one (-1, just assigned) always re-reads the path
+    if (cubes[i].material >= 0 && m_Handles[i] == cubes[i].material)
+      return;
+    m_Handles[i] = cubes[i].material;
+    const uint32_t material = InternMaterial(cubes[i].materialPath);
+    if (m_Materials[i] != material) {
+      m_Materials[i] = material;
+      changed = true;
+    }
+  };
+  end = std::min(end, std::min(n, previous));
+  for (size_t i = first; i < end; ++i)
+    diff(i);
+  for (size_t i = previous; i < n; ++i)
+    diff(i);
+  if (changed)
+    m_Version++;
+  return changed;
+}
+
+void HierarchyIndex::Clear() {
+  m_Names.clear();
+  m_Slots.clear();
+  m_Handles.clear();
+  m_Materials.clear();
+  m_MaterialNames.clear();
+  m_MaterialIds.clear();
+  m_Results.clear();
+  m_Query.clear();
+  m_Version++;
+}
+
+uint32_t HierarchyIndex::InternMaterial(const std::string &path) {
+  if (m_MaterialNames.empty())
+    m_MaterialNames.emplace_back(); // id 0: no material
+  if (path.empty())
+    return 0;
+  auto it = m_MaterialIds.find(path);
+  if (it != m_MaterialIds.end())
+    return it->second;
+  size_t begin = path.find_last_of("/\\");
+  begin = begin == std::string::npos ? 0 : begin + 1;
+  size_t end = path.find_last_of('.');
+  if (end == std::string::npos || end < begin)
+    end = path.size();
+  const uint32_t id = (uint32_t)m_MaterialNames.size();
+  m_MaterialNames.push_back(ToLower(path.substr(begin, end - begin)));
+  m_MaterialIds.emplace(path, id);
+  return id;
+}
+
+bool HierarchyIndex::Matches(uint32_t entry, const std::string &query) const {
+  return std::strstr(&m_Names[(size_t)entry * NAME_STRIDE], query.c_str()) ||
+         m_MaterialNames[m_Materials[entry]].find(query) != std::string::npos;
+}
+
+const std::vector<uint32_t> &
+HierarchyIndex::Filter(const std::string &query) {
+  const std::string lower = ToLower(query);
+  if (lower == m_Query && m_ResultVersion == m_Version)
+    return m_Results;
+  const auto start = std::chrono::high_resolution_clock::now();
+  const size_t n = Size();
+
+  if (lower.empty()) {
+    m_Results.resize(n);
+    for (size_t i = 0; i < n; ++i)
+      m_Results[i] = (uint32_t)i;
+  } else if (m_ResultVersion == m_Version && !m_Query.empty() &&
+             lower.find(m_Query) != std::string::npos) {
+    // Typing on: only the previous matches can still match
+    m_Results.erase(std::remove_if(m_Results.begin(), m_Results.end(),
+                                   [&](uint32_t entry) {
+                                     return !Matches(entry, lower);
+                                   }),
+                    m_Results.end());
+  } else {
+    m_MaterialHits.resize(m_MaterialNames.size());
+    for (size_t i = 0; i < m_MaterialNames.size(); ++i)
+      m_MaterialHits[i] = m_MaterialNames[i].find(lower) != std::string::npos;
+
+    // Ranges split on entry boundaries, and the zero padding keeps a match
+    // inside one name
+    m_Hits.assign(n, 0);
+    const std::boyer_moore_horspool_searcher<std::string::const_iterator>
+        searcher(lower.begin(), lower.end());
+    const char *names = m_Names.data();
+    JobSystem::Get().ParallelFor(n, 16384, [&](size_t begin, size_t end) {
+      const char *last = names + end * NAME_STRIDE;
+      const char *it = names + begin * NAME_STRIDE;
+      // A single character gains nothing from the skip table; memchr is
+      // vectorized
+      auto next = [&](const char *from) {
+        if (lower.size() > 1)
+          return std::search(from, last, searcher);
+        const void *found = std::memchr(from, lower[0], last - from);
+        return found ? (const char *)found : last;
+      };
+      while ((it = next(it)) != last) {
+        const size_t entry = (size_t)(it - names) / NAME_STRIDE;
+        m_Hits[entry] = 1;
+        it = names + (entry + 1) * NAME_STRIDE;
+      }
+      for (size_t i = begin; i < end; ++i)
+        m_Hits[i] |= m_MaterialHits[m_Materials[i]];
+    });
+    m_Results.clear();
+    for (size_t i = 0; i < n; ++i) {
+      if (m_Hits[i])
+        m_Results.push_back((uint32_t)i);
+    }
+  }
+
+  m_Query = lower;
+  m_ResultVersion = m_Version;
+  m_FilterMs = std::chrono::duration<float, std::milli>(
+                   std::chrono::high_resolution_clock::now() - start)
+                   .count();
+  return m_Results;
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "../scene/scene_defs.h"
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class Scene;
+
+// Search index of the Hierarchy panel.
+//
+// Holds, per cube (dense order), its lowercase name ("cube N", N being its
+// entity slot) in a flat buffer of NAME_STRIDE bytes per entry and the id
+// of its interned material name (the file stem of materialPath). Update()
+// diffs the cubes of the scene's change batches against the index instead
+// of rebuilding it: an entry rewrites its name only when another cube
+// moved into its position (a removal) and re-reads its material only when
+// its handle changes; a Scene::Reset renumbers the material handles, so the
+// index starts over after one. Filter() scans the name buffer on
+// the job system and caches its result until the query or the index
+// changes; a query extending the previous one only refines its result.
+class HierarchyIndex {
+public:
+  static constexpr int NAME_STRIDE = 16; // "cube 4294967295" + '\0'
+
+  // Diffs the cubes in the dense range [first, end) and the ones past the
+  // index's size; the rest must be unchanged since the last Update (see
+  // SceneChangeBatch). Returns true if the index changed.
+  bool Update(const Scene &scene, size_t first, size_t end);
+  void Clear();
+
+  // Dense indices of the cubes whose name or material name contains query
+  // (case-insensitive), ascending
+  const std::vector<uint32_t> &Filter(const std::string &query);
+  float GetFilterMs() const { return m_FilterMs; }
+  size_t Size() const { return m_Handles.size(); }
+
+private:
+  uint32_t InternMaterial(const std::string &path);
+  bool Matches(uint32_t entry, const std::string &query) const;
+
+  std::vector<char> m_Names;      // NAME_STRIDE per entry, zero padded
+  std::vector<uint32_t> m_Slots;  // entity slot named by each entry
+  std::vector<int> m_Handles;     // CubeInst::material seen by Update
+  std::vector<uint32_t> m_Materials; // interned material name per entry
+  std::vector<std::string> m_MaterialNames; // lowercase stems; 0 = none
+  std::unordered_map<std::string, uint32_t> m_MaterialIds; // path -> id
+  uint64_t m_Version = 0; // bumped on every change
+  uint64_t m_SceneMaterials = 0; // Scene::GetMaterialsVersion of m_Handles
+
+  std::vector<char> m_Hits;        // per entry, scratch of Filter
+  std::vector<char> m_MaterialHits; // per material name
+  std::vector<uint32_t> m_Results;
+  std::string m_Query;
+  uint64_t m_ResultVersion = ~0ull;
+  float m_FilterMs = 0.0f;
+};
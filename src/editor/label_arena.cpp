@@ -0,0 +1,40 @@
+#include "label_arena.h"
+#include <algorithm>
+#include <cstdarg>
+#include <cstdio>
+
+void LabelArena::Reset() {
+  m_Block = 0;
+  m_Offset = 0;
+  m_Used = 0;
+}
+
+const char *LabelArena::Format(const char *fmt, ...) {
+  va_list args;
+  va_start(args, fmt);
+  va_list copy;
+  va_copy(copy, args);
+  const int length = std::vsnprintf(nullptr, 0, fmt, copy);
+  va_end(copy);
+  const size_t needed = length > 0 ? (size_t)length + 1 : 1;
+
+  // Move on to the next block (or a new one) when it does not fit
+  while (m_Block < m_Blocks.size() &&
+         m_Offset + needed > m_Blocks[m_Block].size) {
+    m_Block++;
+    m_Offset = 0;
+  }
+  if (m_Block == m_Blocks.size()) {
+    Block block;
+    block.size = std::max(BLOCK_SIZE, needed);
+    block.data.reset(new char[block.size]);
+    m_Blocks.push_back(std::move(block));
+  }
+
+  char *label = m_Blocks[m_Block].data.get() + m_Offset;
+  std::vsnprintf(label, needed, fmt, args);
+  va_end(args);
+  m_Offset += needed;
+  m_Used += needed;
+  return label;
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+// Per-frame storage for formatted UI labels. Format() hands out strings
+// that stay valid until the next Reset(); the blocks are kept across
+// frames, so steady-state frames do not allocate.
+class LabelArena {
+public:
+  static constexpr size_t BLOCK_SIZE = 16 * 1024;
+
+  // Call once per frame, before the first Format
+  void Reset();
+  // printf-style; the result lives until the next Reset
+  const char *Format(const char *fmt, ...);
+
+  size_t GetUsedBytes() const { return m_Used; }
+
+private:
+  struct Block {
+    std::unique_ptr<char[]> data;
+    size_t size = 0;
+  };
+  std::vector<Block> m_Blocks;
+  size_t m_Block = 0;  // block being filled
+  size_t m_Offset = 0; // in that block
+  size_t m_Used = 0;   // bytes handed out since Reset
+};
@@ -0,0 +1,99 @@
+#include "selection_set.h"
+#include <algorithm>
+
+void SelectionSet::Clear() {
+  m_Handles.clear();
+  if (++m_Generation == 0) {
+    // Wrapped: stamps from 2^32 clears ago could read as current
+    std::fill(m_WordGeneration.begin(), m_WordGeneration.end(), 0u);
+    m_Generation = 1;
+  }
+}
+
+bool SelectionSet::Contains(EntityHandle handle) const {
+  const size_t word = handle.index / 64;
+  return word < m_Bits.size() && m_WordGeneration[word] == m_Generation &&
+         (m_Bits[word] >> (handle.index % 64) & 1u) &&
+         m_SlotGenerations[handle.index] == handle.generation;
+}
+
+uint64_t &SelectionSet::Word(uint32_t slot) {
+  const size_t word = slot / 64;
+  if (word >= m_Bits.size()) {
+    m_Bits.resize(word + 1, 0);
+    m_WordGeneration.resize(word + 1, 0);
+    m_SlotGenerations.resize((word + 1) * 64, 0);
+  }
+  if (m_WordGeneration[word] != m_Generation) {
+    m_WordGeneration[word] = m_Generation;
+    m_Bits[word] = 0;
+  }
+  return m_Bits[word];
+}
+
+void SelectionSet::SetBit(EntityHandle handle, bool value) {
+  const uint64_t bit = 1ull << (handle.index % 64);
+  uint64_t &word = Word(handle.index);
+  word = value ? word | bit : word & ~bit;
+  m_SlotGenerations[handle.index] = handle.generation;
+}
+
+bool SelectionSet::Add(EntityHandle handle) {
+  if (handle.index == EntityHandle::INVALID_INDEX || Contains(handle))
+    return false;
+  // A stale handle of the same slot leaves the list when the new one
+  // takes its bit
+  const size_t word = handle.index / 64;
+  const bool slotTaken = word < m_Bits.size() &&
+                         m_WordGeneration[word] == m_Generation &&
+                         (m_Bits[word] >> (handle.index % 64) & 1u);
+  SetBit(handle, true);
+  if (slotTaken)
+    Compact();
+  m_Handles.push_back(handle);
+  return true;
+}
+
+bool SelectionSet::Remove(EntityHandle handle) {
+  if (!Contains(handle))
+    return false;
+  SetBit(handle, false);
+  m_Handles.erase(std::find(m_Handles.begin(), m_Handles.end(), handle));
+  return true;
+}
+
+void SelectionSet::ToggleValid() {
+  if (++m_ToggleSerial == 0) {
+    std::fill(m_ToggleMarks.begin(), m_ToggleMarks.end(), 0u);
+    m_ToggleSerial = 1;
+  }
+  // Deselect first and compact once, so a handle listed again is not
+  // pushed while its old entry is still in the list
+  bool removed = false;
+  size_t adds = 0;
+  for (EntityHandle handle : m_Toggled) {
+    if (handle.index >= m_ToggleMarks.size())
+      m_ToggleMarks.resize(handle.index + 1, 0);
+    if (m_ToggleMarks[handle.index] == m_ToggleSerial)
+      continue;
+    m_ToggleMarks[handle.index] = m_ToggleSerial;
+    if (Contains(handle)) {
+      SetBit(handle, false);
+      removed = true;
+    } else {
+      m_Toggled[adds++] = handle;
+    }
+  }
+  if (removed)
+    Compact();
+  for (size_t i = 0; i < adds; ++i)
+    Add(m_Toggled[i]);
+}
+
+void SelectionSet::Compact() {
+  m_Handles.erase(std::remove_if(m_Handles.begin(), m_Handles.end(),
+                                 [&](EntityHandle handle) {
+                                   return !Contains(handle);
+                                 }),
+                  m_Handles.end());
+}
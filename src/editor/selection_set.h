@@ -0,0 +1,78 @@
+#pragma once
+
+#include "../scene/scene_defs.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Set of selected cubes, by EntityHandle: a bitset over the handles' slots
+// for O(1) membership plus a dense list in selection order (the last one
+// is the active object) for iterating only what is selected. Each slot
+// also keeps the generation it was selected with, so a handle to a cube
+// that was removed and whose slot was reused does not read as selected.
+//
+// Clear() is O(1): each bitset word carries the generation it was written
+// in, and words of an older generation read as empty, so nothing is
+// touched until a bit is set again.
+class SelectionSet {
+public:
+  void Clear();
+
+  bool Contains(EntityHandle handle) const;
+  // False if it already was / was not selected
+  bool Add(EntityHandle handle);
+  bool Remove(EntityHandle handle);
+  // Flips every handle for which valid(handle) is true (stale ones are
+  // skipped), each once however often it is listed; one pass over the
+  // dense list
+  template <typename Fn>
+  void Toggle(const std::vector<EntityHandle> &handles, Fn valid) {
+    m_Toggled.clear();
+    for (EntityHandle handle : handles)
+      if (handle.index != EntityHandle::INVALID_INDEX && valid(handle))
+        m_Toggled.push_back(handle);
+    ToggleValid();
+  }
+
+  const std::vector<EntityHandle> &GetHandles() const { return m_Handles; }
+  size_t Size() const { return m_Handles.size(); }
+  bool Empty() const { return m_Handles.empty(); }
+  // Invalid handle if empty
+  EntityHandle GetActive() const {
+    return m_Handles.empty() ? EntityHandle{} : m_Handles.back();
+  }
+
+  // Drops the handles for which stale(handle) is true; one pass
+  template <typename Fn> size_t RemoveIf(Fn stale) {
+    size_t removed = 0;
+    for (EntityHandle handle : m_Handles) {
+      if (stale(handle)) {
+        SetBit(handle, false);
+        removed++;
+      }
+    }
+    if (removed)
+      Compact();
+    return removed;
+  }
+
+private:
+  uint64_t &Word(uint32_t slot);
+  void SetBit(EntityHandle handle, bool value);
+  // Toggle of m_Toggled
+  void ToggleValid();
+  // Drops the dense entries whose bit is clear
+  void Compact();
+
+  std::vector<uint64_t> m_Bits;
+  std::vector<uint32_t> m_WordGeneration; // word valid if == m_Generation
+  uint32_t m_Generation = 1;
+  std::vector<uint32_t> m_SlotGenerations; // entity generation per set bit
+  std::vector<EntityHandle> m_Handles;
+
+  // Scratch of Toggle: the handles to flip, and per slot the toggle that
+  // last saw it (dedupes the input)
+  std::vector<EntityHandle> m_Toggled;
+  std::vector<uint32_t> m_ToggleMarks;
+  uint32_t m_ToggleSerial = 0;
+};
@@ -0,0 +1,762 @@
+#include "thumbnail_service.h"
+#include "../core/job_system.h"
+#include "../render/gl_state_cache.h"
+#include "../render/texture_manager.h"
+#include "../scene/scene.h"
+#include "../shaders/shader_library.h"
+#include "../utils/math_utils.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+
+// Bump when the previews change look, so the cached ones are not reused
+static const uint32_t THUMBNAIL_VERSION = 1;
+static const uint32_t FEATURE_MESH = 1u << 0;
+
+static const int CELL = ThumbnailService::CELL;
+static const int BATCH_CELLS =
+    ThumbnailService::BATCH_COLUMNS * ThumbnailService::BATCH_ROWS;
+static const int BATCH_WIDTH = ThumbnailService::BATCH_COLUMNS * CELL;
+static const int BATCH_HEIGHT = ThumbnailService::BATCH_ROWS * CELL;
+static const int ATLAS_COLUMNS = ThumbnailService::ATLAS_SIZE / CELL;
+static const size_t CELL_BYTES = (size_t)CELL * CELL * 4;
+// Blank border around a preview, in fractions of the cell
+static const float MARGIN = 0.06f;
+static const int INSTANCE_FLOATS = 16; // cell, colour, surface, texture rect
+static const int VERTEX_FLOATS = 6;    // position, normal
+
+static bool ReadFile(const std::string &path, std::vector<uint8_t> &out) {
+  std::ifstream file(path, std::ios::binary);
+  if (!file)
+    return false;
+  out.assign(std::istreambuf_iterator<char>(file),
+             std::istreambuf_iterator<char>());
+  return !file.bad();
+}
+
+// Domain-separated from texture imports: the entry key hashes a header
+// with the asset's key (and its texture's), so neither an imported texture
+// nor an older thumbnail version can share the entry
+static uint64_t ThumbnailKey(FileType type, const std::vector<uint8_t> &asset,
+                             const std::vector<uint8_t> *texture) {
+  const TextureImportSettings settings;
+  const uint64_t header[5] = {
+      0x4C49414E424D5548ull, // "HUMBNAIL"
+      (uint64_t)THUMBNAIL_VERSION | (uint64_t)CELL << 32, (uint64_t)type,
+      TextureCache::Key(asset.data(), asset.size(), settings),
+      texture ? TextureCache::Key(texture->data(), texture->size(), settings)
+              : 0};
+  return TextureCache::Key((const uint8_t *)header, sizeof(header), settings);
+}
+
+// OBJ index (1-based, negative = from the end) to a position index
+static bool ObjIndex(long index, size_t count, size_t &out) {
+  if (index > 0 && (size_t)index <= count)
+    out = (size_t)index - 1;
+  else if (index < 0 && (size_t)-index <= count)
+    out = count - (size_t)-index;
+  else
+    return false;
+  return true;
+}
+
+// Positions and faces of a Wavefront OBJ (text must be null-terminated),
+// flat shaded, centred and scaled to the unit sphere. Meshes above
+// MAX_TRIANGLES keep an evenly spaced subset of their triangles.
+static bool ParseObj(const char *text, std::vector<float> &out,
+                     std::string &error) {
+  std::vector<float> positions;
+  std::vector<uint32_t> triangles;
+  std::vector<size_t> face;
+  for (const char *line = text; *line;) {
+    const char *end = std::strchr(line, '\n');
+    if (!end)
+      end = line + std::strlen(line);
+    if (line[0] == 'v' && (line[1] == ' ' || line[1] == '\t')) {
+      char *p = (char *)line + 2;
+      for (int i = 0; i < 3; ++i)
+        positions.push_back(std::strtof(p, &p));
+    } else if (line[0] == 'f' && (line[1] == ' ' || line[1] == '\t')) {
+      // f v, v/vt, v//vn or v/vt/vn; fans over the polygon
+      face.clear();
+      char *p = (char *)line + 2;
+      while (p < end) {
+        char *next;
+        const long index = std::strtol(p, &next, 10);
+        if (next == p)
+          break;
+        size_t vertex;
+        if (!ObjIndex(index, positions.size() / 3, vertex)) {
+          error = "face index out of range";
+          return false;
+        }
+        face.push_back(vertex);
+        p = next;
+        while (p < end && *p != ' ' && *p != '\t')
+          ++p;
+      }
+      for (size_t i = 2; i < face.size(); ++i) {
+        triangles.push_back((uint32_t)face[0]);
+        triangles.push_back((uint32_t)face[i - 1]);
+        triangles.push_back((uint32_t)face[i]);
+      }
+    }
+    line = *end ? end + 1 : end;
+  }
+  if (triangles.empty()) {
+    error = "no faces";
+    return false;
+  }
+
+  float bmin[3] = {FLT_MAX, FLT_MAX, FLT_MAX};
+  float bmax[3] = {-FLT_MAX, -FLT_MAX, -FLT_MAX};
+  for (uint32_t v : triangles)
+    for (int i = 0; i < 3; ++i) {
+      bmin[i] = std::min(bmin[i], positions[v * 3 + i]);
+      bmax[i] = std::max(bmax[i], positions[v * 3 + i]);
+    }
+  float center[3], radius = 0.0f;
+  for (int i = 0; i < 3; ++i)
+    center[i] = 0.5f * (bmin[i] + bmax[i]);
+  for (uint32_t v : triangles) {
+    float d[3];
+    vec3_sub(&positions[v * 3], center, d);
+    radius = std::max(radius, vec3_length(d));
+  }
+  const float scale = radius > 0.0f ? 1.0f / radius : 1.0f;
+
+  const size_t count = triangles.size() / 3;
+  const size_t step =
+      (count + ThumbnailService::MAX_TRIANGLES - 1) /
+      ThumbnailService::MAX_TRIANGLES;
+  out.clear();
+  out.reserve(count / step * 3 * VERTEX_FLOATS);
+  for (size_t t = 0; t < count; t += step) {
+    float p[3][3];
+    for (int c = 0; c < 3; ++c) {
+      vec3_sub(&positions[triangles[t * 3 + c] * 3], center, p[c]);
+      vec3_scale(p[c], scale, p[c]);
+    }
+    float e1[3], e2[3], n[3];
+    vec3_sub(p[1], p[0], e1);
+    vec3_sub(p[2], p[0], e2);
+    vec3_cross(e1, e2, n);
+    vec3_normalize(n);
+    for (int c = 0; c < 3; ++c)
+      out.insert(out.end(), {p[c][0], p[c][1], p[c][2], n[0], n[1], n[2]});
+  }
+  return true;
+}
+
+ThumbnailService::~ThumbnailService() {
+  if (m_Atlas == 0)
+    return;
+  GLStateCache &gl = GLStateCache::Get();
+  for (Readback &readback : m_Readbacks) {
+    if (readback.fence)
+      glDeleteSync(readback.fence);
+    gl.DeleteBuffer(readback.pbo);
+  }
+  gl.DeleteVertexArray(m_QuadVAO);
+  gl.DeleteVertexArray(m_MeshVAO);
+  gl.DeleteBuffer(m_QuadVBO);
+  gl.DeleteBuffer(m_InstanceVBO);
+  gl.DeleteBuffer(m_MeshVBO);
+  glDeleteFramebuffers(1, &m_BatchFramebuffer);
+  glDeleteRenderbuffers(1, &m_BatchDepth);
+  gl.DeleteTexture(m_BatchColor);
+  gl.DeleteTexture(m_Atlas);
+}
+
+void ThumbnailService::Init() {
+  // Placeholder for the family's fallback; nothing is rendered until the
+  // real variants are ready, so it never ends up in the cache
+  const char *vs = R"(#version 330 core
+layout (location = 0) in vec3 aPos;
+void main() { gl_Position = vec4(aPos, 1.0); }
+)";
+  const char *fs = R"(#version 330 core
+out vec4 FragColor;
+void main() { FragColor = vec4(1.0); }
+)";
+  ShaderLibrary &shaders = ShaderLibrary::Get();
+  m_Family = shaders.Register("thumbnail", {"MESH"}, vs, fs);
+  // Variants compile on first request: start both now
+  shaders.GetProgram(m_Family, 0);
+  shaders.GetProgram(m_Family, FEATURE_MESH);
+
+  GLStateCache &gl = GLStateCache::Get();
+  auto createTexture = [&gl](GLuint &texture, int width, int height) {
+    glGenTextures(1, &texture);
+    gl.BindTexture(0, GL_TEXTURE_2D, texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA,
+                 GL_UNSIGNED_BYTE, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  };
+  createTexture(m_Atlas, ATLAS_SIZE, ATLAS_SIZE);
+  createTexture(m_BatchColor, BATCH_WIDTH, BATCH_HEIGHT);
+  m_CellOwners.assign(ATLAS_CELLS, std::string());
+
+  glGenFramebuffers(1, &m_BatchFramebuffer);
+  glGenRenderbuffers(1, &m_BatchDepth);
+  glBindRenderbuffer(GL_RENDERBUFFER, m_BatchDepth);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, BATCH_WIDTH,
+                        BATCH_HEIGHT);
+  const GLuint previous = gl.GetFramebuffer();
+  gl.BindFramebuffer(m_BatchFramebuffer);
+  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
+                         m_BatchColor, 0);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,
+                            GL_RENDERBUFFER, m_BatchDepth);
+  if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+    std::cerr << "Thumbnail batch target incomplete" << std::endl;
+  gl.BindFramebuffer(previous);
+
+  // Material spheres: a unit quad per instance
+  static const float corners[8] = {0, 0, 1, 0, 0, 1, 1, 1};
+  glGenVertexArrays(1, &m_QuadVAO);
+  glGenBuffers(1, &m_QuadVBO);
+  glGenBuffers(1, &m_InstanceVBO);
+  gl.BindVertexArray(m_QuadVAO);
+  gl.BindBuffer(GL_ARRAY_BUFFER, m_QuadVBO);
+  glBufferData(GL_ARRAY_BUFFER, sizeof(corners), corners, GL_STATIC_DRAW);
+  glEnableVertexAttribArray(0);
+  glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), nullptr);
+  gl.BindBuffer(GL_ARRAY_BUFFER, m_InstanceVBO);
+  glBufferData(GL_ARRAY_BUFFER, BATCH_CELLS * INSTANCE_FLOATS * sizeof(float),
+               nullptr, GL_STREAM_DRAW);
+  for (GLuint i = 1; i <= 4; ++i) {
+    glEnableVertexAttribArray(i);
+    glVertexAttribDivisor(i, 1);
+  }
+
+  glGenVertexArrays(1, &m_MeshVAO);
+  glGenBuffers(1, &m_MeshVBO);
+  gl.BindVertexArray(m_MeshVAO);
+  gl.BindBuffer(GL_ARRAY_BUFFER, m_MeshVBO);
+  const GLsizei stride = VERTEX_FLOATS * sizeof(float);
+  glEnableVertexAttribArray(0);
+  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, nullptr);
+  glEnableVertexAttribArray(1);
+  glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride,
+                        (void *)(3 * sizeof(float)));
+  gl.BindVertexArray(0);
+
+  for (Readback &readback : m_Readbacks) {
+    glGenBuffers(1, &readback.pbo);
+    gl.BindBuffer(GL_PIXEL_PACK_BUFFER, readback.pbo);
+    glBufferData(GL_PIXEL_PACK_BUFFER, (size_t)BATCH_WIDTH * BATCH_HEIGHT * 4,
+                 nullptr, GL_STREAM_READ);
+    readback.keys.assign(BATCH_CELLS, 0);
+  }
+  gl.BindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+bool ThumbnailService::Get(const std::string &path, FileType type,
+                           float uv[4]) {
+  if (!HasThumbnail(type) || m_Atlas == 0)
+    return false;
+  auto it = m_Entries.find(path);
+  if (it == m_Entries.end()) {
+    Entry entry;
+    entry.type = type;
+    entry.lastUsed = m_Frame;
+    m_Entries.emplace(path, std::move(entry));
+    m_Queued.push_back(path);
+    return false;
+  }
+  Entry &entry = it->second;
+  entry.lastUsed = m_Frame;
+  if (entry.state != State::Ready)
+    return false;
+  // The atlas holds GL rows bottom-up: uv0 is the cell's top-left
+  const float size = (float)CELL / ATLAS_SIZE;
+  const int x = entry.cell % ATLAS_COLUMNS, y = entry.cell / ATLAS_COLUMNS;
+  uv[0] = x * size;
+  uv[1] = (y + 1) * size;
+  uv[2] = (x + 1) * size;
+  uv[3] = y * size;
+  return true;
+}
+
+void ThumbnailService::Invalidate(const std::string &path) {
+  // A job or a batch still holding the old contents finds the entry gone
+  // (or replaced) and drops its result
+  auto it = m_Entries.find(path);
+  if (it == m_Entries.end())
+    return;
+  ReleaseCell(it->second);
+  m_Entries.erase(it);
+}
+
+void ThumbnailService::Prepare(Job &job) {
+  std::vector<uint8_t> bytes;
+  if (!ReadFile(job.path, bytes)) {
+    job.error = "could not read the file";
+    return;
+  }
+  std::vector<uint8_t> texture;
+  bool textured = false;
+  if (job.type == FILETYPE_MATERIAL) {
+    try {
+      job.material = LoadMaterialFile(job.path);
+    } catch (const std::exception &e) {
+      job.error = std::string("malformed material (") + e.what() + ")";
+      return;
+    }
+    // A missing texture previews the bare colour; its key changes once
+    // the file exists
+    textured = !job.material.diffuseTexture.empty() &&
+               ReadFile(job.material.diffuseTexture, texture);
+    if (!textured)
+      job.material.diffuseTexture.clear();
+  }
+  job.key = ThumbnailKey(job.type, bytes, textured ? &texture : nullptr);
+
+  if (TextureCache::Read(job.key, job.cached) &&
+      job.cached.format == TextureFormat::RGBA8 &&
+      job.cached.levels[0].width == CELL &&
+      job.cached.levels[0].height == CELL &&
+      job.cached.levels[0].size == CELL_BYTES) {
+    job.cacheHit = true;
+    job.ok = true;
+    return;
+  }
+  job.cached = TextureData();
+  if (job.type == FILETYPE_MODEL) {
+    bytes.push_back(0);
+    if (!ParseObj((const char *)bytes.data(), job.vertices, job.error))
+      return;
+  }
+  job.ok = true;
+}
+
+void ThumbnailService::SubmitJobs() {
+  // Newest requests first: the ones just scrolled into view
+  for (size_t i = m_Queued.size(); i-- > 0;) {
+    std::string &path = m_Queued[i];
+    auto it = m_Entries.find(path);
+    if (it == m_Entries.end() || it->second.state != State::Queued) {
+      path.clear();
+      continue;
+    }
+    Entry &entry = it->second;
+    if (entry.lastUsed + REQUEST_FRAMES < m_Frame) {
+      m_Entries.erase(it);
+      path.clear();
+      continue;
+    }
+    if (m_Jobs.size() >= (size_t)MAX_JOBS)
+      continue;
+    auto job = std::make_shared<Job>();
+    job->path = path;
+    job->type = entry.type;
+    entry.job = job;
+    entry.state = State::Hashing;
+    m_Jobs.push_back(job);
+    JobSystem::Get().SubmitBackground([job]() {
+      Prepare(*job);
+      job->done.store(true, std::memory_order_release);
+    });
+    path.clear();
+  }
+  m_Queued.erase(std::remove_if(m_Queued.begin(), m_Queued.end(),
+                                [](const std::string &p) { return p.empty(); }),
+                 m_Queued.end());
+}
+
+void ThumbnailService::Collect() {
+  for (size_t i = 0; i < m_Jobs.size();) {
+    if (!m_Jobs[i]->done.load(std::memory_order_acquire)) {
+      ++i;
+      continue;
+    }
+    std::shared_ptr<Job> job = std::move(m_Jobs[i]);
+    m_Jobs[i] = std::move(m_Jobs.back());
+    m_Jobs.pop_back();
+
+    auto it = m_Entries.find(job->path);
+    if (it == m_Entries.end() || it->second.job != job)
+      continue; // invalidated meanwhile
+    Entry &entry = it->second;
+    if (!job->ok) {
+      std::cerr << "Thumbnail of " << job->path << ": " << job->error
+                << std::endl;
+      entry.state = State::Failed;
+      entry.job.reset();
+      m_Stats.failed++;
+      continue;
+    }
+    entry.state = State::Render;
+    if (job->cacheHit) {
+      m_ToUpload.push_back(job->path);
+    } else {
+      if (!job->material.diffuseTexture.empty())
+        entry.texture = TextureManager::Get().Load(job->material.diffuseTexture);
+      m_ToRender.push_back(job->path);
+    }
+  }
+}
+
+void ThumbnailService::ReleaseCell(Entry &entry) {
+  if (entry.cell >= 0)
+    m_CellOwners[entry.cell].clear();
+  entry.cell = -1;
+}
+
+int ThumbnailService::AllocateCell(const std::string &path) {
+  int best = -1;
+  uint64_t oldest = m_Frame; // cells drawn this frame are never taken
+  for (int i = 0; i < ATLAS_CELLS; ++i) {
+    if (m_CellOwners[i].empty()) {
+      best = i;
+      oldest = 0;
+      break;
+    }
+    // Cells handed to the batch being built are not Ready yet
+    const Entry &owner = m_Entries.at(m_CellOwners[i]);
+    if (owner.state == State::Ready && owner.lastUsed < oldest) {
+      oldest = owner.lastUsed;
+      best = i;
+    }
+  }
+  if (best < 0)
+    return -1;
+  // The evicted entry is forgotten; shown again, it comes back from disk
+  if (!m_CellOwners[best].empty())
+    m_Entries.erase(m_CellOwners[best]);
+  m_CellOwners[best] = path;
+  return best;
+}
+
+void ThumbnailService::FinishReadbacks() {
+  GLStateCache &gl = GLStateCache::Get();
+  for (Readback &readback : m_Readbacks) {
+    if (!readback.fence ||
+        glClientWaitSync(readback.fence, 0, 0) == GL_TIMEOUT_EXPIRED)
+      continue;
+    glDeleteSync(readback.fence);
+    readback.fence = nullptr;
+
+    const size_t size = (size_t)BATCH_WIDTH * readback.rows * CELL * 4;
+    gl.BindBuffer(GL_PIXEL_PACK_BUFFER, readback.pbo);
+    const uint8_t *pixels = (const uint8_t *)glMapBufferRange(
+        GL_PIXEL_PACK_BUFFER, 0, size, GL_MAP_READ_BIT);
+    if (pixels) {
+      // Cut the cells out here (the buffer is reused) and write them on a
+      // worker
+      auto entries = std::make_shared<
+          std::vector<std::pair<uint64_t, std::vector<uint8_t>>>>();
+      for (int i = 0; i < BATCH_CELLS; ++i) {
+        if (readback.keys[i] == 0)
+          continue;
+        const int column = i % BATCH_COLUMNS, row = i / BATCH_COLUMNS;
+        std::vector<uint8_t> cell(CELL_BYTES);
+        for (int y = 0; y < CELL; ++y)
+          std::memcpy(&cell[(size_t)y * CELL * 4],
+                      pixels + (((size_t)row * CELL + y) * BATCH_WIDTH +
+                                (size_t)column * CELL) * 4,
+                      (size_t)CELL * 4);
+        entries->emplace_back(readback.keys[i], std::move(cell));
+      }
+      glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+      JobSystem::Get().SubmitBackground([entries]() {
+        for (auto &entry : *entries) {
+          TextureData data;
+          data.format = TextureFormat::RGBA8;
+          data.levels.push_back(
+              {CELL, CELL, entry.second.data(), entry.second.size()});
+          TextureCache::Write(entry.first, data);
+        }
+      });
+    }
+    std::fill(readback.keys.begin(), readback.keys.end(), 0);
+  }
+  gl.BindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+bool ThumbnailService::RenderBatch() {
+  Readback &readback = m_Readbacks[m_NextReadback];
+  if (readback.fence)
+    return false;
+  ShaderLibrary &shaders = ShaderLibrary::Get();
+  TextureManager &textures = TextureManager::Get();
+  const bool materialsReady = shaders.IsReady(m_Family, 0);
+  const bool meshesReady = shaders.IsReady(m_Family, FEATURE_MESH);
+
+  // Newest first; materials wait for their texture, everything for its
+  // shader variant (a fallback image must never reach the cache)
+  std::vector<std::string> batch;
+  size_t triangles = 0;
+  for (size_t i = m_ToRender.size(); i-- > 0 && batch.size() < BATCH_CELLS;) {
+    std::string &path = m_ToRender[i];
+    auto it = m_Entries.find(path);
+    if (it == m_Entries.end() || it->second.state != State::Render) {
+      path.clear();
+      continue;
+    }
+    Entry &entry = it->second;
+    if (entry.lastUsed + REQUEST_FRAMES < m_Frame) {
+      m_Entries.erase(it);
+      path.clear();
+      continue;
+    }
+    if (entry.type == FILETYPE_MATERIAL) {
+      if (!materialsReady || (entry.texture != 0 &&
+                              !textures.IsResident(entry.texture) &&
+                              !textures.IsFailed(entry.texture)))
+        continue;
+    } else {
+      const size_t count = entry.job->vertices.size() / (3 * VERTEX_FLOATS);
+      if (!meshesReady ||
+          (triangles > 0 && triangles + count > (size_t)MAX_TRIANGLES))
+        continue;
+      triangles += count;
+    }
+    batch.push_back(std::move(path));
+    path.clear();
+  }
+  m_ToRender.erase(std::remove_if(m_ToRender.begin(), m_ToRender.end(),
+                                  [](const std::string &p) { return p.empty(); }),
+                   m_ToRender.end());
+  // Materials first, grouped by texture array: one draw per array
+  std::vector<std::pair<GLuint, size_t>> order; // array, batch index
+  std::vector<size_t> meshes;
+  for (size_t i = 0; i < batch.size(); ++i) {
+    const Entry &entry = m_Entries.at(batch[i]);
+    if (entry.type == FILETYPE_MATERIAL)
+      order.push_back({entry.texture ? textures.GetSlot(entry.texture).array
+                                     : 0,
+                       i});
+    else
+      meshes.push_back(i);
+  }
+  std::stable_sort(order.begin(), order.end(),
+                   [](const std::pair<GLuint, size_t> &a,
+                      const std::pair<GLuint, size_t> &b) {
+                     return a.first < b.first;
+                   });
+  for (size_t i : meshes)
+    order.push_back({0, i});
+
+  // Atlas cells; what does not fit waits for cells to leave the screen
+  std::vector<int> cells;
+  for (size_t n = 0; n < order.size(); ++n) {
+    const std::string &path = batch[order[n].second];
+    const int cell = AllocateCell(path);
+    if (cell < 0) {
+      for (size_t r = n; r < order.size(); ++r)
+        m_ToRender.push_back(batch[order[r].second]);
+      order.resize(n);
+      break;
+    }
+    cells.push_back(cell);
+  }
+  if (order.empty())
+    return false;
+
+  GLStateCache &gl = GLStateCache::Get();
+  const GLuint previousFramebuffer = gl.GetFramebuffer();
+  GLint previousViewport[4];
+  gl.GetViewport(previousViewport);
+  gl.BindFramebuffer(m_BatchFramebuffer);
+  gl.Viewport(0, 0, BATCH_WIDTH, BATCH_HEIGHT);
+  gl.SetEnabled(GL_SCISSOR_TEST, false);
+  gl.SetEnabled(GL_BLEND, false);
+  gl.SetEnabled(GL_CULL_FACE, false);
+  gl.DepthMask(true);
+  gl.ClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+  glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+  // Batch position n: column n % BATCH_COLUMNS, row n / BATCH_COLUMNS
+  size_t materialCount = 0;
+  while (materialCount < order.size() &&
+         m_Entries.at(batch[order[materialCount].second]).type ==
+             FILETYPE_MATERIAL)
+    ++materialCount;
+  if (materialCount > 0) {
+    std::vector<float> instances(materialCount * INSTANCE_FLOATS);
+    const float width = 2.0f / BATCH_COLUMNS, height = 2.0f / BATCH_ROWS;
+    for (size_t n = 0; n < materialCount; ++n) {
+      const Entry &entry = m_Entries.at(batch[order[n].second]);
+      const Material &material = entry.job->material;
+      const TextureSlot &slot = textures.GetSlot(entry.texture);
+      float *instance = &instances[n * INSTANCE_FLOATS];
+      const float cell[4] = {
+          -1.0f + width * (n % BATCH_COLUMNS + MARGIN),
+          -1.0f + height * (n / BATCH_COLUMNS + MARGIN),
+          width * (1.0f - 2.0f * MARGIN), height * (1.0f - 2.0f * MARGIN)};
+      const float color[4] = {material.color[0], material.color[1],
+                              material.color[2],
+                              std::min(std::max(material.emission, 0.0f), 1.0f)};
+      const float surface[4] = {material.metallic, material.roughness,
+                                (float)slot.layer, entry.texture ? 1.0f : 0.0f};
+      std::memcpy(instance, cell, sizeof(cell));
+      std::memcpy(instance + 4, color, sizeof(color));
+      std::memcpy(instance + 8, surface, sizeof(surface));
+      std::memcpy(instance + 12, slot.rect, sizeof(slot.rect));
+    }
+    gl.BindVertexArray(m_QuadVAO);
+    gl.BindBuffer(GL_ARRAY_BUFFER, m_InstanceVBO);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, instances.size() * sizeof(float),
+                    instances.data());
+    const GLuint program = shaders.GetProgram(m_Family, 0);
+    gl.UseProgram(program);
+    gl.SetUniform1i(gl.GetUniformLocation(program, "uDiffuse"), 0);
+    gl.SetEnabled(GL_DEPTH_TEST, false);
+    const GLsizei stride = INSTANCE_FLOATS * sizeof(float);
+    for (size_t first = 0; first < materialCount;) {
+      size_t last = first + 1;
+      while (last < materialCount && order[last].first == order[first].first)
+        ++last;
+      for (GLuint a = 0; a < 4; ++a)
+        glVertexAttribPointer(1 + a, 4, GL_FLOAT, GL_FALSE, stride,
+                              (void *)((first * INSTANCE_FLOATS + a * 4) *
+                                       sizeof(float)));
+      if (order[first].first)
+        gl.BindTexture(0, GL_TEXTURE_2D_ARRAY, order[first].first);
+      glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, (GLsizei)(last - first));
+      first = last;
+    }
+  }
+
+  if (materialCount < order.size()) {
+    std::vector<float> vertices;
+    for (size_t n = materialCount; n < order.size(); ++n) {
+      const std::vector<float> &mesh =
+          m_Entries.at(batch[order[n].second]).job->vertices;
+      vertices.insert(vertices.end(), mesh.begin(), mesh.end());
+    }
+    gl.BindVertexArray(m_MeshVAO);
+    gl.BindBuffer(GL_ARRAY_BUFFER, m_MeshVBO);
+    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float),
+                 vertices.data(), GL_STREAM_DRAW);
+
+    // Three-quarter view of the unit sphere the mesh was fitted into
+    const float fov = 30.0f * 3.14159265f / 180.0f;
+    const float distance = (1.0f + MARGIN) / std::sin(0.5f * fov);
+    float eye[3] = {0.55f, 0.45f, 0.7f};
+    vec3_normalize(eye);
+    const float front[3] = {-eye[0], -eye[1], -eye[2]};
+    const float up[3] = {0.0f, 1.0f, 0.0f};
+    vec3_scale(eye, distance, eye);
+    const Mat4 view = create_view_matrix(eye, front, up);
+    const Mat4 viewProj = mat4_mul(
+        mat4_perspective(fov, 1.0f, distance - 1.5f, distance + 1.5f), view);
+
+    const GLuint program = shaders.GetProgram(m_Family, FEATURE_MESH);
+    gl.UseProgram(program);
+    gl.SetUniformMatrix4fv(gl.GetUniformLocation(program, "uViewProj"),
+                           viewProj.m);
+    gl.SetUniformMatrix4fv(gl.GetUniformLocation(program, "uView"), view.m);
+    gl.SetUniform3f(gl.GetUniformLocation(program, "uColor"), 0.75f, 0.75f,
+                    0.78f);
+    gl.SetEnabled(GL_DEPTH_TEST, true);
+    gl.DepthFunc(GL_LESS);
+    GLint first = 0;
+    for (size_t n = materialCount; n < order.size(); ++n) {
+      const GLsizei count =
+          (GLsizei)(m_Entries.at(batch[order[n].second]).job->vertices.size() /
+                    VERTEX_FLOATS);
+      gl.Viewport((GLint)(n % BATCH_COLUMNS) * CELL,
+                  (GLint)(n / BATCH_COLUMNS) * CELL, CELL, CELL);
+      glDrawArrays(GL_TRIANGLES, first, count);
+      first += count;
+    }
+  }
+
+  // Into the atlas, and back to the CPU for the disk cache
+  gl.BindTexture(0, GL_TEXTURE_2D, m_Atlas);
+  for (size_t n = 0; n < order.size(); ++n)
+    glCopyTexSubImage2D(GL_TEXTURE_2D, 0, (cells[n] % ATLAS_COLUMNS) * CELL,
+                        (cells[n] / ATLAS_COLUMNS) * CELL,
+                        (GLint)(n % BATCH_COLUMNS) * CELL,
+                        (GLint)(n / BATCH_COLUMNS) * CELL, CELL, CELL);
+  readback.rows = (int)((order.size() + BATCH_COLUMNS - 1) / BATCH_COLUMNS);
+  gl.BindBuffer(GL_PIXEL_PACK_BUFFER, readback.pbo);
+  glPixelStorei(GL_PACK_ALIGNMENT, 4);
+  glReadPixels(0, 0, BATCH_WIDTH, readback.rows * CELL, GL_RGBA,
+               GL_UNSIGNED_BYTE, nullptr);
+  readback.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  gl.BindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+  m_NextReadback = (m_NextReadback + 1) % READBACK_RING;
+
+  gl.BindFramebuffer(previousFramebuffer);
+  gl.Viewport(previousViewport[0], previousViewport[1], previousViewport[2],
+              previousViewport[3]);
+
+  for (size_t n = 0; n < order.size(); ++n) {
+    Entry &entry = m_Entries.at(batch[order[n].second]);
+    readback.keys[n] = entry.job->key;
+    entry.cell = cells[n];
+    entry.state = State::Ready;
+    entry.job.reset();
+  }
+  m_Stats.rendered += (int)order.size();
+  m_Stats.batches++;
+  return true;
+}
+
+void ThumbnailService::Update() {
+  if (m_Atlas == 0)
+    return;
+  auto start = std::chrono::high_resolution_clock::now();
+  auto elapsedMs = [&start]() {
+    return std::chrono::duration<float, std::milli>(
+               std::chrono::high_resolution_clock::now() - start)
+        .count();
+  };
+
+  FinishReadbacks();
+  Collect();
+  SubmitJobs();
+
+  // Cache hits: CELL x CELL RGBA8 straight into the atlas
+  GLStateCache &gl = GLStateCache::Get();
+  gl.BindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+  gl.BindTexture(0, GL_TEXTURE_2D, m_Atlas);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+  while (!m_ToUpload.empty() && elapsedMs() < m_BudgetMs) {
+    const std::string path = std::move(m_ToUpload.back());
+    m_ToUpload.pop_back();
+    auto it = m_Entries.find(path);
+    if (it == m_Entries.end() || it->second.state != State::Render)
+      continue;
+    if (it->second.lastUsed + REQUEST_FRAMES < m_Frame) {
+      m_Entries.erase(it);
+      continue;
+    }
+    const int cell = AllocateCell(path);
+    if (cell < 0) {
+      m_ToUpload.push_back(path);
+      break;
+    }
+    Entry &entry = m_Entries.at(path);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, (cell % ATLAS_COLUMNS) * CELL,
+                    (cell / ATLAS_COLUMNS) * CELL, CELL, CELL, GL_RGBA,
+                    GL_UNSIGNED_BYTE, entry.job->cached.levels[0].data);
+    entry.cell = cell;
+    entry.state = State::Ready;
+    entry.job.reset();
+    m_Stats.diskHits++;
+  }
+
+  while (elapsedMs() < m_BudgetMs && RenderBatch()) {
+  }
+
+  m_Stats.ready = 0;
+  for (const std::string &owner : m_CellOwners)
+    m_Stats.ready += owner.empty() ? 0 : 1;
+  m_Stats.pending = (int)(m_Queued.size() + m_Jobs.size() +
+                          m_ToUpload.size() + m_ToRender.size());
+  m_Stats.updateMs = elapsedMs();
+  m_Frame++;
+}
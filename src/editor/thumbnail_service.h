@@ -0,0 +1,150 @@
+#pragma once
+
+#include "../render/texture_cache.h"
+#include "../scene/scene_defs.h"
+#include "editor_defs.h"
+#include <glad/glad.h>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Contadores del servicio de miniaturas (panel Stats)
+struct ThumbnailStats {
+  int ready = 0;     // in the atlas
+  int pending = 0;   // hashing, waiting or being rendered
+  int diskHits = 0;  // loaded from the cache
+  int rendered = 0;  // rendered (and written to the cache)
+  int failed = 0;
+  int batches = 0;   // render batches
+  float updateMs = 0.0f; // last Update
+};
+
+// Previews of the assets listed by the content browser: a lit sphere for
+// materials (.mat) and the shaded mesh for models (.obj).
+//
+// Get() queues the assets on screen. A background job reads the asset and
+// hashes its bytes (a material also hashes its diffuse texture); the hash
+// is the key of an RGBA8 entry of the texture cache (TextureCache::Read /
+// Write), so an asset whose bytes have not changed is never rendered again,
+// in this session or a later one. On a miss the job parses the asset, and
+// Update() renders the previews in batches of BATCH_COLUMNS x BATCH_ROWS
+// cells into an offscreen target: the materials of a batch in one
+// instanced draw per texture array (an analytic sphere per quad), the
+// meshes from one shared vertex buffer, a viewport each. The cells are
+// copied into the atlas and read back through a pixel-pack buffer, fenced,
+// to be written to the cache by a job once the GPU is done. Update() stops
+// starting batches and uploads once its budget is spent.
+//
+// The atlas holds ATLAS_CELLS thumbnails; the least recently shown ones
+// are evicted (and come back from the disk cache). Invalidate() forgets an
+// asset whose file changed, so its key is computed again.
+class ThumbnailService {
+public:
+  static constexpr int CELL = 128;         // pixels a side
+  static constexpr int ATLAS_SIZE = 2048;  // 16 x 16 cells
+  static constexpr int ATLAS_CELLS = (ATLAS_SIZE / CELL) * (ATLAS_SIZE / CELL);
+  static constexpr int BATCH_COLUMNS = 8;
+  static constexpr int BATCH_ROWS = 4;
+  static constexpr int MAX_JOBS = 16;      // assets hashed at once
+  static constexpr int REQUEST_FRAMES = 30; // requests not renewed are dropped
+  static constexpr int MAX_TRIANGLES = 1 << 17; // per mesh and per batch
+  static constexpr float DEFAULT_BUDGET_MS = 3.0f;
+
+  ThumbnailService() = default;
+  ~ThumbnailService();
+
+  ThumbnailService(const ThumbnailService &) = delete;
+  ThumbnailService &operator=(const ThumbnailService &) = delete;
+
+  // Requires a current GL context (and ShaderLibrary::Init)
+  void Init();
+
+  static bool HasThumbnail(FileType type) {
+    return type == FILETYPE_MATERIAL || type == FILETYPE_MODEL;
+  }
+  // uv = ImGui::Image uv0 (xy) and uv1 (zw) of the thumbnail in GetAtlas()
+  // if it is ready; otherwise queues it and returns false. Call every frame
+  // the asset is shown.
+  bool Get(const std::string &path, FileType type, float uv[4]);
+  GLuint GetAtlas() const { return m_Atlas; }
+  // The file changed (or went away)
+  void Invalidate(const std::string &path);
+
+  // Once per frame on the GL thread, after the UI has made its Get calls
+  void Update();
+
+  void SetBudget(float ms) { m_BudgetMs = ms; }
+  float GetBudget() const { return m_BudgetMs; }
+  const ThumbnailStats &GetStats() const { return m_Stats; }
+
+private:
+  // Worker output, published through `done`
+  struct Job {
+    std::string path;
+    FileType type = FILETYPE_UNKNOWN;
+    uint64_t key = 0;
+    bool ok = false;
+    bool cacheHit = false;
+    TextureData cached;          // hit: CELL x CELL RGBA8
+    Material material;           // miss, materials
+    std::vector<float> vertices; // miss, models: position, normal
+    std::string error;
+    std::atomic<bool> done{false};
+  };
+  enum class State { Queued, Hashing, Render, Ready, Failed };
+  struct Entry {
+    FileType type = FILETYPE_UNKNOWN;
+    State state = State::Queued;
+    uint64_t lastUsed = 0; // frame of the last Get
+    int cell = -1;         // atlas cell once ready
+    uint32_t texture = 0;  // material diffuse (TextureManager handle)
+    std::shared_ptr<Job> job;
+  };
+  // One rendered batch waiting for its readback
+  struct Readback {
+    GLuint pbo = 0;
+    GLsync fence = nullptr;
+    int rows = 0;               // batch rows read back
+    std::vector<uint64_t> keys; // per batch cell, 0 = unused
+  };
+
+  static const int READBACK_RING = 2;
+
+  // Worker: hash, cache lookup, and on a miss the parse
+  static void Prepare(Job &job);
+
+  void SubmitJobs();
+  void Collect();
+  void FinishReadbacks();
+  // False if there was nothing to render or the readback ring is busy
+  bool RenderBatch();
+  // Free cell, or the least recently shown one not drawn this frame; -1 if
+  // every cell is on screen
+  int AllocateCell(const std::string &path);
+  void ReleaseCell(Entry &entry);
+
+  std::unordered_map<std::string, Entry> m_Entries;
+  std::vector<std::string> m_Queued;          // oldest first
+  std::vector<std::shared_ptr<Job>> m_Jobs;   // in flight
+  std::vector<std::string> m_ToUpload;        // cache hits
+  std::vector<std::string> m_ToRender;        // cache misses
+
+  GLuint m_Atlas = 0;
+  std::vector<std::string> m_CellOwners; // path per atlas cell, "" = free
+  // BATCH_COLUMNS x BATCH_ROWS cells; RGBA8 so the previews keep their
+  // transparent background
+  GLuint m_BatchFramebuffer = 0, m_BatchColor = 0, m_BatchDepth = 0;
+  Readback m_Readbacks[READBACK_RING];
+  int m_NextReadback = 0;
+
+  int m_Family = -1; // "thumbnail" shaders; MESH variant for models
+  GLuint m_QuadVAO = 0, m_QuadVBO = 0, m_InstanceVBO = 0;
+  GLuint m_MeshVAO = 0, m_MeshVBO = 0;
+
+  uint64_t m_Frame = 1;
+  float m_BudgetMs = DEFAULT_BUDGET_MS;
+  ThumbnailStats m_Stats;
+};
@@ -0,0 +1,470 @@
+#include "undo_stack.h"
+#include "../scene/scene.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <unordered_map>
+
+static uint32_t FloatBits(float value) {
+  uint32_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  return bits;
+}
+
+static float BitsFloat(uint32_t bits) {
+  float value;
+  std::memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+static const float *CubeField(const CubeInst &cube, int field) {
+  return field == 0 ? cube.pos : field == 1 ? cube.rotation : cube.scale;
+}
+
+static float *CubeField(CubeInst &cube, int field) {
+  return field == 0 ? cube.pos : field == 1 ? cube.rotation : cube.scale;
+}
+
+// --- Column codec -----------------------------------------------------------
+
+static void WriteVarint(std::vector<uint8_t> &out, size_t value) {
+  while (value >= 0x80) {
+    out.push_back((uint8_t)(value | 0x80));
+    value >>= 7;
+  }
+  out.push_back((uint8_t)value);
+}
+
+static size_t ReadVarint(const uint8_t *&in) {
+  size_t value = 0;
+  int shift = 0;
+  uint8_t byte;
+  do {
+    byte = *in++;
+    value |= (size_t)(byte & 0x7f) << shift;
+    shift += 7;
+  } while (byte & 0x80);
+  return value;
+}
+
+// Byte planes, low byte first; a zero byte is followed by the length of
+// its run of zeros
+static void EncodeWords(const std::vector<uint32_t> &words,
+                        std::vector<uint8_t> &out) {
+  const size_t count = words.size();
+  for (int shift = 0; shift < 32; shift += 8) {
+    size_t i = 0;
+    while (i < count) {
+      const uint8_t byte = (uint8_t)(words[i] >> shift);
+      if (byte) {
+        out.push_back(byte);
+        ++i;
+        continue;
+      }
+      size_t run = 1;
+      while (i + run < count && (uint8_t)(words[i + run] >> shift) == 0)
+        ++run;
+      out.push_back(0);
+      WriteVarint(out, run);
+      i += run;
+    }
+  }
+}
+
+static void DecodeWords(const uint8_t *&in, size_t count,
+                        std::vector<uint32_t> &words) {
+  words.assign(count, 0);
+  for (int shift = 0; shift < 32; shift += 8) {
+    size_t i = 0;
+    while (i < count) {
+      const uint8_t byte = *in++;
+      if (byte)
+        words[i++] |= (uint32_t)byte << shift;
+      else
+        i += ReadVarint(in);
+    }
+  }
+}
+
+// Slots as differences to the previous one (wrapping), generations XORed
+// with the previous one
+static void EncodeHandles(const std::vector<EntityHandle> &handles,
+                          std::vector<uint8_t> &out) {
+  std::vector<uint32_t> slots(handles.size()), generations(handles.size());
+  EntityHandle previous{0, 0};
+  for (size_t j = 0; j < handles.size(); ++j) {
+    slots[j] = handles[j].index - previous.index;
+    generations[j] = handles[j].generation ^ previous.generation;
+    previous = handles[j];
+  }
+  EncodeWords(slots, out);
+  EncodeWords(generations, out);
+}
+
+static void DecodeHandles(const uint8_t *&in, size_t count,
+                          std::vector<EntityHandle> &handles) {
+  std::vector<uint32_t> slots, generations;
+  DecodeWords(in, count, slots);
+  DecodeWords(in, count, generations);
+  handles.resize(count);
+  EntityHandle previous{0, 0};
+  for (size_t j = 0; j < count; ++j) {
+    previous.index += slots[j];
+    previous.generation ^= generations[j];
+    handles[j] = previous;
+  }
+}
+
+// Live handles and their dense indices
+static void Resolve(const Scene &scene,
+                    const std::vector<EntityHandle> &handles,
+                    std::vector<EntityHandle> &live,
+                    std::vector<uint32_t> &indices) {
+  live.clear();
+  indices.clear();
+  for (EntityHandle handle : handles) {
+    const int index = scene.GetIndex(handle);
+    if (index < 0)
+      continue;
+    live.push_back(handle);
+    indices.push_back((uint32_t)index);
+  }
+}
+
+// Transforms and material ids of whole cubes, each column XORed with the
+// previous cube's value
+static void PackCubes(const std::vector<CubeInst> &cubes,
+                      const std::vector<uint32_t> &indices,
+                      std::vector<uint8_t> &out,
+                      std::vector<std::string> &materials) {
+  const size_t count = indices.size();
+  std::vector<uint32_t> words(count);
+  for (int column = 0; column < 9; ++column) {
+    uint32_t previous = 0;
+    for (size_t j = 0; j < count; ++j) {
+      const uint32_t bits =
+          FloatBits(CubeField(cubes[indices[j]], column / 3)[column % 3]);
+      words[j] = bits ^ previous;
+      previous = bits;
+    }
+    EncodeWords(words, out);
+  }
+  std::unordered_map<std::string, uint32_t> ids;
+  uint32_t previous = 0;
+  for (size_t j = 0; j < count; ++j) {
+    const std::string &path = cubes[indices[j]].materialPath;
+    auto it = ids.find(path);
+    if (it == ids.end()) {
+      it = ids.emplace(path, (uint32_t)materials.size()).first;
+      materials.push_back(path);
+    }
+    words[j] = it->second ^ previous;
+    previous = it->second;
+  }
+  EncodeWords(words, out);
+}
+
+static void UnpackCubes(const uint8_t *&in, size_t count,
+                        const std::vector<std::string> &materials,
+                        std::vector<CubeInst> &out) {
+  out.resize(count);
+  std::vector<uint32_t> words;
+  for (int column = 0; column < 9; ++column) {
+    DecodeWords(in, count, words);
+    uint32_t previous = 0;
+    for (size_t j = 0; j < count; ++j) {
+      previous ^= words[j];
+      CubeField(out[j], column / 3)[column % 3] = BitsFloat(previous);
+    }
+  }
+  DecodeWords(in, count, words);
+  uint32_t previous = 0;
+  for (size_t j = 0; j < count; ++j) {
+    previous ^= words[j];
+    out[j].materialPath = materials[previous];
+  }
+}
+
+// --- Recording --------------------------------------------------------------
+
+void UndoStack::RecordTransform(const char *name, const Scene &scene,
+                                const std::vector<EntityHandle> &handles,
+                                const float *const before[3]) {
+  const std::vector<CubeInst> &cubes = scene.GetCubes();
+  Record record;
+  record.type = Type::Transform;
+  record.name = name;
+  record.count = handles.size();
+  EncodeHandles(handles, record.data);
+
+  std::vector<int> indices(handles.size());
+  for (size_t j = 0; j < handles.size(); ++j)
+    indices[j] = scene.GetIndex(handles[j]);
+  bool changed = false;
+  std::vector<uint32_t> words(handles.size());
+  for (int field = 0; field < 3; ++field) {
+    if (!before[field])
+      continue;
+    record.fields |= 1 << field;
+    for (int k = 0; k < 3; ++k) {
+      for (size_t j = 0; j < handles.size(); ++j) {
+        words[j] = indices[j] < 0
+                       ? 0u
+                       : FloatBits(before[field][j * 3 + k]) ^
+                             FloatBits(CubeField(cubes[indices[j]], field)[k]);
+        changed |= words[j] != 0;
+      }
+      EncodeWords(words, record.data);
+    }
+    record.rawBytes += handles.size() * 2 * 3 * sizeof(float);
+  }
+  if (changed)
+    Push(std::move(record));
+}
+
+// Add and Remove store the same thing: the cubes, to restore them
+void UndoStack::RecordAdd(const char *name, const Scene &scene,
+                          const std::vector<EntityHandle> &handles) {
+  std::vector<EntityHandle> live;
+  std::vector<uint32_t> indices;
+  Resolve(scene, handles, live, indices);
+  if (live.empty())
+    return;
+  Record record;
+  record.type = Type::Add;
+  record.name = name;
+  record.count = live.size();
+  EncodeHandles(live, record.data);
+  PackCubes(scene.GetCubes(), indices, record.data, record.materials);
+  record.rawBytes = live.size() * (sizeof(EntityHandle) + sizeof(CubeInst));
+  Push(std::move(record));
+}
+
+void UndoStack::RecordRemove(const char *name, const Scene &scene,
+                             const std::vector<EntityHandle> &handles) {
+  std::vector<EntityHandle> live;
+  std::vector<uint32_t> indices;
+  Resolve(scene, handles, live, indices);
+  if (live.empty())
+    return;
+  Record record;
+  record.type = Type::Remove;
+  record.name = name;
+  record.count = live.size();
+  EncodeHandles(live, record.data);
+  PackCubes(scene.GetCubes(), indices, record.data, record.materials);
+  record.rawBytes = live.size() * (sizeof(EntityHandle) + sizeof(CubeInst));
+  Push(std::move(record));
+}
+
+void UndoStack::RecordMaterial(const char *name, const Scene &scene,
+                               const std::vector<EntityHandle> &handles,
+                               const std::string &materialPath) {
+  std::vector<EntityHandle> live;
+  std::vector<uint32_t> indices;
+  Resolve(scene, handles, live, indices);
+  if (live.empty())
+    return;
+  Record record;
+  record.type = Type::Material;
+  record.name = name;
+  record.count = live.size();
+  record.materialPath = materialPath;
+  EncodeHandles(live, record.data);
+  std::unordered_map<std::string, uint32_t> ids;
+  std::vector<uint32_t> words(indices.size());
+  for (size_t j = 0; j < indices.size(); ++j) {
+    const std::string &path = scene.GetCubes()[indices[j]].materialPath;
+    auto it = ids.find(path);
+    if (it == ids.end()) {
+      it = ids.emplace(path, (uint32_t)record.materials.size()).first;
+      record.materials.push_back(path);
+    }
+    words[j] = it->second;
+  }
+  EncodeWords(words, record.data);
+  record.rawBytes =
+      live.size() * (sizeof(EntityHandle) + sizeof(uint32_t) +
+                     sizeof(std::string));
+  Push(std::move(record));
+}
+
+// --- History ----------------------------------------------------------------
+
+size_t UndoStack::Record::GetBytes() const {
+  size_t bytes = sizeof(Record) + name.capacity() + data.capacity() +
+                 materialPath.capacity();
+  for (const std::string &material : materials)
+    bytes += sizeof(std::string) + material.capacity();
+  for (const Record &child : children)
+    bytes += child.GetBytes();
+  return bytes;
+}
+
+void UndoStack::BeginGroup(const char *name) {
+  if (m_GroupDepth++ > 0)
+    return;
+  m_Group = Record();
+  m_Group.type = Type::Group;
+  m_Group.name = name;
+}
+
+void UndoStack::EndGroup() {
+  if (m_GroupDepth == 0 || --m_GroupDepth > 0)
+    return;
+  Record group = std::move(m_Group);
+  m_Group = Record();
+  if (group.children.empty())
+    return;
+  if (group.children.size() == 1) {
+    Record only = std::move(group.children[0]);
+    only.name = group.name;
+    Push(std::move(only));
+    return;
+  }
+  for (const Record &child : group.children) {
+    group.count += child.count;
+    group.rawBytes += child.rawBytes;
+  }
+  Push(std::move(group));
+}
+
+void UndoStack::Push(Record &&record) {
+  if (m_GroupDepth > 0) {
+    record.data.shrink_to_fit();
+    m_Group.children.push_back(std::move(record));
+    return;
+  }
+  for (const Record &redo : m_Redo) {
+    m_Bytes -= redo.GetBytes();
+    m_RawBytes -= redo.rawBytes;
+  }
+  m_Redo.clear();
+  record.data.shrink_to_fit();
+  m_Bytes += record.GetBytes();
+  m_RawBytes += record.rawBytes;
+  m_Undo.push_back(std::move(record));
+  while (m_Bytes > m_MemoryLimit && m_Undo.size() > 1)
+    EvictOldest();
+}
+
+void UndoStack::EvictOldest() {
+  m_Bytes -= m_Undo.front().GetBytes();
+  m_RawBytes -= m_Undo.front().rawBytes;
+  m_Undo.pop_front();
+  m_Evicted++;
+}
+
+void UndoStack::SetMemoryLimit(size_t bytes) {
+  m_MemoryLimit = bytes;
+  while (m_Bytes > m_MemoryLimit && m_Undo.size() > 1)
+    EvictOldest();
+}
+
+void UndoStack::Clear() {
+  m_GroupDepth = 0;
+  m_Group = Record();
+  m_Undo.clear();
+  m_Redo.clear();
+  m_Bytes = 0;
+  m_RawBytes = 0;
+}
+
+const char *UndoStack::GetUndoName() const {
+  return m_Undo.empty() ? "" : m_Undo.back().name.c_str();
+}
+
+const char *UndoStack::GetRedoName() const {
+  return m_Redo.empty() ? "" : m_Redo.back().name.c_str();
+}
+
+void UndoStack::Undo(Scene &scene) {
+  if (m_Undo.empty() || m_GroupDepth > 0)
+    return;
+  scene.BeginChanges();
+  Apply(m_Undo.back(), false, scene);
+  scene.EndChanges();
+  m_Redo.push_back(std::move(m_Undo.back()));
+  m_Undo.pop_back();
+}
+
+void UndoStack::Redo(Scene &scene) {
+  if (m_Redo.empty() || m_GroupDepth > 0)
+    return;
+  scene.BeginChanges();
+  Apply(m_Redo.back(), true, scene);
+  scene.EndChanges();
+  m_Undo.push_back(std::move(m_Redo.back()));
+  m_Redo.pop_back();
+}
+
+void UndoStack::Apply(const Record &record, bool forward, Scene &scene) {
+  const auto start = std::chrono::high_resolution_clock::now();
+  const uint8_t *in = record.data.data();
+  std::vector<EntityHandle> handles;
+  if (record.type != Type::Group)
+    DecodeHandles(in, record.count, handles);
+
+  switch (record.type) {
+  case Type::Group:
+    // Undone last record first
+    for (size_t j = 0; j < record.children.size(); ++j)
+      Apply(record.children[forward ? j : record.children.size() - 1 - j],
+            forward, scene);
+    break;
+  case Type::Transform: {
+    // XOR both ways; written back through TransformCubes so the change
+    // covers only these cubes
+    std::vector<int> indices(record.count);
+    for (size_t j = 0; j < record.count; ++j)
+      indices[j] = scene.GetIndex(handles[j]);
+    const std::vector<CubeInst> &cubes = scene.GetCubes();
+    std::vector<uint32_t> words;
+    std::vector<float> values(record.count * 3, 0.0f);
+    const float zero[3] = {0.0f, 0.0f, 0.0f};
+    for (int field = 0; field < 3; ++field) {
+      if (!(record.fields & (1 << field)))
+        continue;
+      for (size_t j = 0; j < record.count; ++j)
+        if (indices[j] >= 0)
+          std::memcpy(&values[j * 3], CubeField(cubes[indices[j]], field),
+                      3 * sizeof(float));
+      for (int k = 0; k < 3; ++k) {
+        DecodeWords(in, record.count, words);
+        for (size_t j = 0; j < record.count; ++j) {
+          float &value = values[j * 3 + k];
+          value = BitsFloat(FloatBits(value) ^ words[j]);
+        }
+      }
+      scene.TransformCubes(handles, field, values.data(), zero);
+    }
+    break;
+  }
+  case Type::Add:
+  case Type::Remove:
+    if ((record.type == Type::Add) == forward) {
+      std::vector<CubeInst> restored;
+      UnpackCubes(in, record.count, record.materials, restored);
+      scene.BeginChanges();
+      for (size_t j = 0; j < record.count; ++j)
+        scene.RestoreCube(handles[j], restored[j]);
+      scene.EndChanges();
+    } else {
+      scene.RemoveCubes(handles);
+    }
+    break;
+  case Type::Material: {
+    std::vector<uint32_t> ids;
+    DecodeWords(in, record.count, ids);
+    scene.BeginChanges();
+    for (size_t j = 0; j < record.count; ++j)
+      scene.SetMaterial(handles[j], forward ? record.materialPath
+                                            : record.materials[ids[j]]);
+    scene.EndChanges();
+    break;
+  }
+  }
+  m_LastApplyMs = std::chrono::duration<float, std::milli>(
+                      std::chrono::high_resolution_clock::now() - start)
+                      .count();
+}
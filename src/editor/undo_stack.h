@@ -0,0 +1,105 @@
+#pragma once
+
+#include "../scene/scene_defs.h"
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <vector>
+
+class Scene;
+
+// Undo/redo history of the edits to the scene's cubes.
+//
+// Records refer to cubes by EntityHandle, so they do not depend on the
+// dense order (which removals shuffle): removed cubes come back under
+// their old handles and a stale handle is skipped.
+//
+// Every record stores a compact delta rather than a copy of the cubes it
+// touched. Its columns (handle slots and generations, then each float
+// component or material id, structure of arrays) are reduced to
+// mostly-zero words: transforms XOR the values before and after the edit,
+// so one record serves both undo and redo, while removed or added cubes
+// XOR each value with the previous cube's, slots store the difference to
+// the previous slot and generations are XORed with the previous one. Each
+// column is then written byte plane by byte plane with runs of zero bytes
+// collapsed.
+//
+// Records are applied in stack order, so the cubes always match the state
+// a record was taken against; an edit that is not recorded invalidates the
+// history (call Clear). Undo and redo records share a memory limit; past it
+// the oldest undo records are evicted (the newest one is always kept).
+class UndoStack {
+public:
+  static constexpr size_t DEFAULT_MEMORY_LIMIT = 64u << 20;
+
+  // Recording, after the edit. before[field] holds the packed xyz of that
+  // field (0=pos, 1=rotation, 2=scale) for each handle, or null if the edit
+  // did not change it. Edits that changed nothing are not recorded.
+  void RecordTransform(const char *name, const Scene &scene,
+                       const std::vector<EntityHandle> &handles,
+                       const float *const before[3]);
+  void RecordAdd(const char *name, const Scene &scene,
+                 const std::vector<EntityHandle> &handles);
+  // Recording, before the edit
+  void RecordRemove(const char *name, const Scene &scene,
+                    const std::vector<EntityHandle> &handles);
+  void RecordMaterial(const char *name, const Scene &scene,
+                      const std::vector<EntityHandle> &handles,
+                      const std::string &materialPath);
+
+  // Records made between BeginGroup and EndGroup (nesting) become one
+  // step, so that an operation split over frames records a slice at a time
+  // and is still undone at once. Empty groups are dropped.
+  void BeginGroup(const char *name);
+  void EndGroup();
+
+  bool CanUndo() const { return !m_Undo.empty(); }
+  bool CanRedo() const { return !m_Redo.empty(); }
+  const char *GetUndoName() const;
+  const char *GetRedoName() const;
+  void Undo(Scene &scene);
+  void Redo(Scene &scene);
+
+  void Clear();
+  void SetMemoryLimit(size_t bytes);
+  size_t GetMemoryLimit() const { return m_MemoryLimit; }
+
+  size_t GetMemoryBytes() const { return m_Bytes; }
+  // Bytes the records' cubes would take uncompressed
+  size_t GetRawBytes() const { return m_RawBytes; }
+  size_t GetUndoCount() const { return m_Undo.size(); }
+  size_t GetRedoCount() const { return m_Redo.size(); }
+  uint64_t GetEvicted() const { return m_Evicted; }
+  float GetLastApplyMs() const { return m_LastApplyMs; }
+
+private:
+  enum class Type { Transform, Add, Remove, Material, Group };
+  struct Record {
+    Type type;
+    std::string name;
+    size_t count = 0;  // cubes involved
+    int fields = 0;    // Transform: bit per changed field
+    std::vector<uint8_t> data; // handle columns, then the type's columns
+    std::vector<std::string> materials; // dictionary of the material ids
+    std::string materialPath;           // Material: the assigned path
+    std::vector<Record> children;       // Group: in recording order
+    size_t rawBytes = 0;
+
+    size_t GetBytes() const;
+  };
+
+  void Push(Record &&record);
+  void EvictOldest();
+  // forward: redo direction
+  void Apply(const Record &record, bool forward, Scene &scene);
+
+  int m_GroupDepth = 0;
+  Record m_Group; // being recorded
+  std::deque<Record> m_Undo; // oldest first
+  std::vector<Record> m_Redo;
+  size_t m_MemoryLimit = DEFAULT_MEMORY_LIMIT;
+  size_t m_Bytes = 0, m_RawBytes = 0;
+  uint64_t m_Evicted = 0;
+  float m_LastApplyMs = 0.0f;
+};
@@ -4,15 +4,19 @@
 #include <windows.h>
 int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine, int nCmdShow) {
     Application app;
+    if (!app.ParseArgs(__argc, __argv)) return 1;
     if (app.Init()) {
+        if (app.IsHeadless()) return app.RunHeadless() ? 0 : 1;
         app.Run();
     }
     return 0;
 }
 #else
-int main() {
+int main(int argc, char **argv) {
     Application app;
+    if (!app.ParseArgs(argc, argv)) return 1;
     if (app.Init()) {
+        if (app.IsHeadless()) return app.RunHeadless() ? 0 : 1;
         app.Run();
     }
     return 0;
@@ -0,0 +1,273 @@
+#include "block_compress.h"
+#include <algorithm>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <emmintrin.h>
+#define BLOCK_SSE2 1
+#endif
+
+namespace {
+
+// Copies the 4x4 texels at (x0, y0), RGBA, row by row. Texels outside the
+// image repeat the last column/row.
+void FetchBlock(const Image &img, int x0, int y0, uint8_t block[64]) {
+  const uint8_t *pixels = img.pixels.data();
+  const size_t stride = (size_t)img.width * 4;
+  if (x0 + 4 <= img.width && y0 + 4 <= img.height) {
+    for (int y = 0; y < 4; ++y)
+      std::memcpy(block + y * 16, pixels + (y0 + y) * stride + x0 * 4, 16);
+    return;
+  }
+  for (int y = 0; y < 4; ++y) {
+    const int sy = std::min(y0 + y, img.height - 1);
+    for (int x = 0; x < 4; ++x) {
+      const int sx = std::min(x0 + x, img.width - 1);
+      std::memcpy(block + (y * 4 + x) * 4, pixels + sy * stride + sx * 4, 4);
+    }
+  }
+}
+
+void BlockMinMax(const uint8_t block[64], uint8_t mn[4], uint8_t mx[4]) {
+#ifdef BLOCK_SSE2
+  const __m128i r0 = _mm_loadu_si128((const __m128i *)(block + 0));
+  const __m128i r1 = _mm_loadu_si128((const __m128i *)(block + 16));
+  const __m128i r2 = _mm_loadu_si128((const __m128i *)(block + 32));
+  const __m128i r3 = _mm_loadu_si128((const __m128i *)(block + 48));
+  __m128i lo = _mm_min_epu8(_mm_min_epu8(r0, r1), _mm_min_epu8(r2, r3));
+  __m128i hi = _mm_max_epu8(_mm_max_epu8(r0, r1), _mm_max_epu8(r2, r3));
+  lo = _mm_min_epu8(lo, _mm_srli_si128(lo, 8));
+  lo = _mm_min_epu8(lo, _mm_srli_si128(lo, 4));
+  hi = _mm_max_epu8(hi, _mm_srli_si128(hi, 8));
+  hi = _mm_max_epu8(hi, _mm_srli_si128(hi, 4));
+  const int l = _mm_cvtsi128_si32(lo);
+  const int h = _mm_cvtsi128_si32(hi);
+  std::memcpy(mn, &l, 4);
+  std::memcpy(mx, &h, 4);
+#else
+  for (int c = 0; c < 4; ++c) {
+    mn[c] = 255;
+    mx[c] = 0;
+  }
+  for (int i = 0; i < 16; ++i) {
+    for (int c = 0; c < 4; ++c) {
+      mn[c] = std::min(mn[c], block[i * 4 + c]);
+      mx[c] = std::max(mx[c], block[i * 4 + c]);
+    }
+  }
+#endif
+}
+
+uint16_t To565(const uint8_t c[4]) {
+  return (uint16_t)(((c[0] >> 3) << 11) | ((c[1] >> 2) << 5) | (c[2] >> 3));
+}
+
+void From565(uint16_t v, int c[3]) {
+  const int r = (v >> 11) & 31, g = (v >> 5) & 63, b = v & 31;
+  c[0] = (r << 3) | (r >> 2);
+  c[1] = (g << 2) | (g >> 4);
+  c[2] = (b << 3) | (b >> 2);
+}
+
+void Put16(uint8_t *out, uint16_t v) {
+  out[0] = (uint8_t)(v & 0xFF);
+  out[1] = (uint8_t)(v >> 8);
+}
+
+// 4-colour BC1 block: c0 > c1, indices 0 = c0, 1 = c1, 2 = 2/3 c0 + 1/3 c1,
+// 3 = 1/3 c0 + 2/3 c1
+void EncodeColorBlock(const uint8_t block[64], uint8_t out[8]) {
+  uint8_t mn[4], mx[4];
+  BlockMinMax(block, mn, mx);
+  for (int c = 0; c < 3; ++c) {
+    const int inset = (mx[c] - mn[c]) >> 4;
+    mn[c] = (uint8_t)(mn[c] + inset);
+    mx[c] = (uint8_t)(mx[c] - inset);
+  }
+  // Channel-wise max >= min, so the packed values keep c0 >= c1
+  const uint16_t c0 = To565(mx);
+  const uint16_t c1 = To565(mn);
+  Put16(out + 0, c0);
+  Put16(out + 2, c1);
+  if (c0 == c1) {
+    std::memset(out + 4, 0, 4);
+    return;
+  }
+
+  int p0[3], p1[3], p2[3], p3[3];
+  From565(c0, p0);
+  From565(c1, p1);
+  for (int c = 0; c < 3; ++c) {
+    p2[c] = (2 * p0[c] + p1[c]) / 3;
+    p3[c] = (p0[c] + 2 * p1[c]) / 3;
+  }
+  const int dir[3] = {p0[0] - p1[0], p0[1] - p1[1], p0[2] - p1[2]};
+  auto dot = [&dir](const int *p) {
+    return p[0] * dir[0] + p[1] * dir[1] + p[2] * dir[2];
+  };
+  const int d0 = dot(p0), d1 = dot(p1), d2 = dot(p2), d3 = dot(p3);
+  // Midpoints between consecutive palette entries along the axis, doubled
+  const int stopA = d1 + d3, stopB = d3 + d2, stopC = d2 + d0;
+
+  // Past 0/1/2/3 stops -> index 1/3/2/0:
+  // bit0 = !pastB, bit1 = pastA && !pastC
+  uint32_t indices = 0;
+#ifdef BLOCK_SSE2
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i one = _mm_set1_epi32(1);
+  const __m128i two = _mm_set1_epi32(2);
+  const __m128i axis = _mm_setr_epi16((short)dir[0], (short)dir[1],
+                                      (short)dir[2], 0, (short)dir[0],
+                                      (short)dir[1], (short)dir[2], 0);
+  const __m128i sa = _mm_set1_epi32(stopA);
+  const __m128i sb = _mm_set1_epi32(stopB);
+  const __m128i sc = _mm_set1_epi32(stopC);
+  alignas(16) int32_t idx[4];
+  for (int row = 0; row < 4; ++row) {
+    const __m128i p = _mm_loadu_si128((const __m128i *)(block + row * 16));
+    // Two texels per register as 16-bit RGBA; madd pairs (r,g) and (b,a)
+    const __m128i lo = _mm_madd_epi16(_mm_unpacklo_epi8(p, zero), axis);
+    const __m128i hi = _mm_madd_epi16(_mm_unpackhi_epi8(p, zero), axis);
+    const __m128 flo = _mm_castsi128_ps(lo), fhi = _mm_castsi128_ps(hi);
+    __m128i d = _mm_add_epi32(
+        _mm_castps_si128(_mm_shuffle_ps(flo, fhi, _MM_SHUFFLE(2, 0, 2, 0))),
+        _mm_castps_si128(_mm_shuffle_ps(flo, fhi, _MM_SHUFFLE(3, 1, 3, 1))));
+    d = _mm_add_epi32(d, d);
+    const __m128i pastA = _mm_cmpgt_epi32(d, sa);
+    const __m128i pastB = _mm_cmpgt_epi32(d, sb);
+    const __m128i pastC = _mm_cmpgt_epi32(d, sc);
+    const __m128i bits = _mm_or_si128(_mm_andnot_si128(pastB, one),
+                                      _mm_and_si128(_mm_andnot_si128(pastC, pastA), two));
+    _mm_store_si128((__m128i *)idx, bits);
+    for (int i = 0; i < 4; ++i)
+      indices |= (uint32_t)idx[i] << (2 * (row * 4 + i));
+  }
+#else
+  for (int i = 0; i < 16; ++i) {
+    const int p[3] = {block[i * 4], block[i * 4 + 1], block[i * 4 + 2]};
+    const int d = 2 * dot(p);
+    const bool pastA = d > stopA, pastB = d > stopB, pastC = d > stopC;
+    const uint32_t index = (pastB ? 0u : 1u) | (pastA && !pastC ? 2u : 0u);
+    indices |= index << (2 * i);
+  }
+#endif
+  for (int i = 0; i < 4; ++i)
+    out[4 + i] = (uint8_t)(indices >> (8 * i));
+}
+
+// 8-value BC4 / BC3-alpha block: a0 > a1, indices 0 = a0, 1 = a1,
+// 2..7 = (6 a0 + a1) / 7 ... (a0 + 6 a1) / 7
+void EncodeAlphaBlock(const uint8_t block[64], int channel, uint8_t out[8]) {
+  alignas(16) uint8_t values[16];
+  uint8_t mn = 255, mx = 0;
+  for (int i = 0; i < 16; ++i) {
+    values[i] = block[i * 4 + channel];
+    mn = std::min(mn, values[i]);
+    mx = std::max(mx, values[i]);
+  }
+  const int inset = (mx - mn) >> 5;
+  mn = (uint8_t)(mn + inset);
+  mx = (uint8_t)(mx - inset);
+  out[0] = mx;
+  out[1] = mn;
+  if (mx == mn) {
+    std::memset(out + 2, 0, 6);
+    return;
+  }
+
+  // Texel position on the ramp (0 = a1 .. 7 = a0) = stops it reaches
+  const int range = mx - mn;
+  uint8_t stops[7];
+  for (int k = 1; k <= 7; ++k)
+    stops[k - 1] = (uint8_t)(mn + ((2 * k - 1) * range + 13) / 14);
+
+  alignas(16) uint8_t idx[16];
+#ifdef BLOCK_SSE2
+  const __m128i v = _mm_load_si128((const __m128i *)values);
+  __m128i pos = _mm_setzero_si128();
+  for (int k = 0; k < 7; ++k) {
+    const __m128i s = _mm_set1_epi8((char)stops[k]);
+    // Unsigned v >= s
+    pos = _mm_sub_epi8(pos, _mm_cmpeq_epi8(_mm_max_epu8(v, s), v));
+  }
+  // Position -> index: 0 -> 1, 7 -> 0, p -> 8 - p otherwise
+  __m128i index = _mm_and_si128(_mm_sub_epi8(_mm_set1_epi8(8), pos),
+                                _mm_set1_epi8(7));
+  const __m128i ends = _mm_cmpgt_epi8(_mm_set1_epi8(2), index);
+  index = _mm_xor_si128(index, _mm_and_si128(ends, _mm_set1_epi8(1)));
+  _mm_store_si128((__m128i *)idx, index);
+#else
+  for (int i = 0; i < 16; ++i) {
+    int pos = 0;
+    for (int k = 0; k < 7; ++k)
+      pos += values[i] >= stops[k];
+    idx[i] = (uint8_t)(pos == 0 ? 1 : pos == 7 ? 0 : 8 - pos);
+  }
+#endif
+  uint64_t bits = 0;
+  for (int i = 0; i < 16; ++i)
+    bits |= (uint64_t)idx[i] << (3 * i);
+  for (int i = 0; i < 6; ++i)
+    out[2 + i] = (uint8_t)(bits >> (8 * i));
+}
+
+template <typename EncodeBlock>
+void EncodeImage(const Image &img, uint8_t *out, size_t blockBytes,
+                 EncodeBlock encode) {
+  alignas(16) uint8_t block[64];
+  for (int y = 0; y < img.height; y += 4) {
+    for (int x = 0; x < img.width; x += 4) {
+      FetchBlock(img, x, y, block);
+      encode(block, out);
+      out += blockBytes;
+    }
+  }
+}
+
+} // namespace
+
+namespace BlockCompress {
+
+size_t CompressedSize(int width, int height, size_t blockBytes) {
+  return (size_t)((width + 3) / 4) * ((height + 3) / 4) * blockBytes;
+}
+
+void EncodeBC1(const Image &img, uint8_t *out) {
+  EncodeImage(img, out, 8, [](const uint8_t *block, uint8_t *dst) {
+    EncodeColorBlock(block, dst);
+  });
+}
+
+void EncodeBC3(const Image &img, uint8_t *out) {
+  EncodeImage(img, out, 16, [](const uint8_t *block, uint8_t *dst) {
+    EncodeAlphaBlock(block, 3, dst);
+    EncodeColorBlock(block, dst + 8);
+  });
+}
+
+void EncodeBC4(const Image &img, uint8_t *out) {
+  EncodeImage(img, out, 8, [](const uint8_t *block, uint8_t *dst) {
+    EncodeAlphaBlock(block, 0, dst);
+  });
+}
+
+bool HasAlpha(const Image &img) {
+  const size_t count = (size_t)img.width * img.height;
+  for (size_t i = 0; i < count; ++i) {
+    if (img.pixels[i * 4 + 3] != 255)
+      return true;
+  }
+  return false;
+}
+
+bool IsGrey(const Image &img) {
+  const size_t count = (size_t)img.width * img.height;
+  for (size_t i = 0; i < count; ++i) {
+    const uint8_t *p = &img.pixels[i * 4];
+    if (p[0] != p[1] || p[1] != p[2])
+      return false;
+  }
+  return true;
+}
+
+} // namespace BlockCompress
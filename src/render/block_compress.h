@@ -0,0 +1,29 @@
+#pragma once
+
+#include "image_loader.h"
+#include <cstddef>
+#include <cstdint>
+
+// Real-time 4x4 block compression (S3TC/RGTC), in-house.
+// Endpoints come from the block's colour bounding box, inset by 1/16 of its
+// extent, and each texel takes the palette entry closest along the endpoint
+// axis. Lower quality than an exhaustive search, but fast enough to run on
+// import for every texture. Blocks that stick out of the image replicate the
+// edge texels. SSE2 when available.
+namespace BlockCompress {
+
+// 8 bytes per block (BC1, BC4) or 16 (BC3)
+size_t CompressedSize(int width, int height, size_t blockBytes);
+
+// Opaque RGB, 4 bpp. Alpha is ignored.
+void EncodeBC1(const Image &img, uint8_t *out);
+// RGB + interpolated alpha, 8 bpp
+void EncodeBC3(const Image &img, uint8_t *out);
+// Single channel (red), 4 bpp
+void EncodeBC4(const Image &img, uint8_t *out);
+
+// Content checks used to pick a format
+bool HasAlpha(const Image &img); // any alpha below 255
+bool IsGrey(const Image &img);   // r == g == b everywhere
+
+} // namespace BlockCompress
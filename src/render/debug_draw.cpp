@@ -0,0 +1,245 @@
+#include "debug_draw.h"
+#include "../shaders/shader_library.h"
+#include "gl_state_cache.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+static const size_t INITIAL_CAPACITY = 64 * 1024;
+
+static const float UNIT_CUBE[8][3] = {
+    {-0.5f, -0.5f, -0.5f}, {0.5f, -0.5f, -0.5f}, {0.5f, 0.5f, -0.5f},
+    {-0.5f, 0.5f, -0.5f},  {-0.5f, -0.5f, 0.5f}, {0.5f, -0.5f, 0.5f},
+    {0.5f, 0.5f, 0.5f},    {-0.5f, 0.5f, 0.5f}};
+static const int CUBE_EDGES[12][2] = {{0, 1}, {1, 2}, {2, 3}, {3, 0},
+                                      {4, 5}, {5, 6}, {6, 7}, {7, 4},
+                                      {0, 4}, {1, 5}, {2, 6}, {3, 7}};
+static const int CUBE_TRIANGLES[12][3] = {
+    {0, 2, 1}, {0, 3, 2}, {4, 5, 6}, {4, 6, 7}, {0, 1, 5}, {0, 5, 4},
+    {3, 6, 2}, {3, 7, 6}, {0, 4, 7}, {0, 7, 3}, {1, 2, 6}, {1, 6, 5}};
+
+DebugDraw::~DebugDraw() {
+  GLStateCache &gl = GLStateCache::Get();
+  gl.DeleteVertexArray(m_VAO);
+  gl.DeleteBuffer(m_VBO);
+}
+
+void DebugDraw::Init() {
+  // Built-in copy of Content/Shaders/debug.*, used until that one is ready
+  const char *vs = R"(#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec4 aColor;
+uniform mat4 uViewProj;
+out vec4 vColor;
+void main() { vColor = aColor; gl_Position = uViewProj * vec4(aPos, 1.0); }
+)";
+  const char *fs = R"(#version 330 core
+in vec4 vColor;
+out vec4 FragColor;
+void main() { FragColor = vColor; }
+)";
+  m_Shader = ShaderLibrary::Get().Register("debug", {}, vs, fs);
+
+  m_Capacity = INITIAL_CAPACITY;
+  m_Offset = 0;
+  GLStateCache &gl = GLStateCache::Get();
+  glGenVertexArrays(1, &m_VAO);
+  glGenBuffers(1, &m_VBO);
+  gl.BindVertexArray(m_VAO);
+  gl.BindBuffer(GL_ARRAY_BUFFER, m_VBO);
+  glBufferData(GL_ARRAY_BUFFER, m_Capacity, nullptr, GL_STREAM_DRAW);
+  glEnableVertexAttribArray(0);
+  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(DebugVertex),
+                        (void *)offsetof(DebugVertex, pos));
+  glEnableVertexAttribArray(1);
+  glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(DebugVertex),
+                        (void *)offsetof(DebugVertex, color));
+  gl.BindVertexArray(0);
+}
+
+uint32_t DebugDraw::Color(float r, float g, float b, float a) {
+  auto to8 = [](float v) {
+    return (uint32_t)(std::min(1.0f, std::max(0.0f, v)) * 255.0f + 0.5f);
+  };
+  return to8(r) | to8(g) << 8 | to8(b) << 16 | to8(a) << 24;
+}
+
+void DebugDraw::Push(std::vector<DebugVertex> &dst, const float p[3],
+                     uint32_t color) {
+  DebugVertex v;
+  v.pos[0] = p[0];
+  v.pos[1] = p[1];
+  v.pos[2] = p[2];
+  v.color = color;
+  dst.push_back(v);
+}
+
+void DebugDraw::Line(const float a[3], const float b[3], uint32_t color) {
+  auto &lines = m_Layers[m_Current].lines;
+  Push(lines, a, color);
+  Push(lines, b, color);
+}
+
+void DebugDraw::Line(const Mat4 &transform, const float a[3],
+                     const float b[3], uint32_t color) {
+  float ta[3], tb[3];
+  mat4_transform_point(transform, a, ta);
+  mat4_transform_point(transform, b, tb);
+  Line(ta, tb, color);
+}
+
+void DebugDraw::WireBox(const Mat4 &transform, uint32_t color) {
+  float corners[8][3];
+  for (int i = 0; i < 8; ++i)
+    mat4_transform_point(transform, UNIT_CUBE[i], corners[i]);
+  for (const auto &e : CUBE_EDGES)
+    Line(corners[e[0]], corners[e[1]], color);
+}
+
+void DebugDraw::SolidBox(const Mat4 &transform, uint32_t color) {
+  float corners[8][3];
+  for (int i = 0; i < 8; ++i)
+    mat4_transform_point(transform, UNIT_CUBE[i], corners[i]);
+  auto &tris = m_Layers[m_Current].triangles;
+  for (const auto &t : CUBE_TRIANGLES)
+    for (int k = 0; k < 3; ++k)
+      Push(tris, corners[t[k]], color);
+}
+
+void DebugDraw::Box(const float bmin[3], const float bmax[3],
+                    uint32_t color) {
+  Mat4 t = mat4_identity();
+  for (int k = 0; k < 3; ++k) {
+    t.m[k * 5] = bmax[k] - bmin[k];
+    t.m[12 + k] = 0.5f * (bmin[k] + bmax[k]);
+  }
+  WireBox(t, color);
+}
+
+void DebugDraw::Circle(const Mat4 &transform, uint32_t color, int segments) {
+  float prev[3];
+  const float start[3] = {1.0f, 0.0f, 0.0f};
+  mat4_transform_point(transform, start, prev);
+  for (int i = 1; i <= segments; ++i) {
+    float theta = 2.0f * 3.1415926f * float(i) / float(segments);
+    const float local[3] = {cosf(theta), sinf(theta), 0.0f};
+    float cur[3];
+    mat4_transform_point(transform, local, cur);
+    Line(prev, cur, color);
+    prev[0] = cur[0];
+    prev[1] = cur[1];
+    prev[2] = cur[2];
+  }
+}
+
+void DebugDraw::Arrow(const float from[3], const float to[3], uint32_t color,
+                      float headSize) {
+  Line(from, to, color);
+  float dir[3];
+  vec3_sub(to, from, dir);
+  if (vec3_length(dir) < 1e-6f)
+    return;
+  vec3_normalize(dir);
+  // Any vector not parallel to dir gives the head's spread plane
+  float ref[3] = {0.0f, 1.0f, 0.0f};
+  if (std::fabs(dir[1]) > 0.9f) {
+    ref[0] = 1.0f;
+    ref[1] = 0.0f;
+  }
+  float u[3], v[3];
+  vec3_cross(dir, ref, u);
+  vec3_normalize(u);
+  vec3_cross(dir, u, v);
+  for (int s = 0; s < 4; ++s) {
+    const float *side = (s < 2) ? u : v;
+    float sign = (s % 2) ? -1.0f : 1.0f;
+    float p[3];
+    for (int k = 0; k < 3; ++k)
+      p[k] = to[k] - dir[k] * headSize + side[k] * sign * headSize * 0.5f;
+    Line(to, p, color);
+  }
+}
+
+void DebugDraw::Grid(int halfExtent, float step, uint32_t color) {
+  const float min = -halfExtent * step;
+  const float max = halfExtent * step;
+  auto &lines = m_Layers[m_Current].lines;
+  lines.reserve(lines.size() + (size_t)(halfExtent * 2 + 1) * 4);
+  for (int i = -halfExtent; i <= halfExtent; ++i) {
+    float v = i * step;
+    const float a[3] = {min, 0.0f, v}, b[3] = {max, 0.0f, v};
+    const float c[3] = {v, 0.0f, min}, d[3] = {v, 0.0f, max};
+    Line(a, b, color);
+    Line(c, d, color);
+  }
+}
+
+void DebugDraw::Clear(Layer layer) {
+  m_Layers[layer].lines.clear();
+  m_Layers[layer].triangles.clear();
+}
+
+int DebugDraw::Flush(Layer layer, const Mat4 &viewProj, float lineWidth,
+                     bool keep) {
+  LayerData &data = m_Layers[layer];
+  const size_t lineCount = data.lines.size();
+  const size_t triCount = data.triangles.size();
+  if (lineCount + triCount == 0)
+    return 0;
+
+  GLStateCache &gl = GLStateCache::Get();
+  gl.BindVertexArray(m_VAO);
+  gl.BindBuffer(GL_ARRAY_BUFFER, m_VBO);
+
+  const size_t bytes = (lineCount + triCount) * sizeof(DebugVertex);
+  if (bytes > m_Capacity) {
+    m_Capacity = std::max(bytes, m_Capacity * 2);
+    glBufferData(GL_ARRAY_BUFFER, m_Capacity, nullptr, GL_STREAM_DRAW);
+    m_Offset = 0;
+  } else if (m_Offset + bytes > m_Capacity) {
+    // Wrap: orphan so the driver hands us fresh storage without a stall
+    glBufferData(GL_ARRAY_BUFFER, m_Capacity, nullptr, GL_STREAM_DRAW);
+    m_Offset = 0;
+  }
+
+  // The ring only moves forward until it is orphaned, so ranges in flight
+  // are never overwritten and the unsynchronized map is safe.
+  char *dst = (char *)glMapBufferRange(
+      GL_ARRAY_BUFFER, m_Offset, bytes,
+      GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT |
+          GL_MAP_INVALIDATE_RANGE_BIT);
+  if (!dst) {
+    if (!keep)
+      Clear(layer);
+    return 0;
+  }
+  std::memcpy(dst, data.lines.data(), lineCount * sizeof(DebugVertex));
+  std::memcpy(dst + lineCount * sizeof(DebugVertex), data.triangles.data(),
+              triCount * sizeof(DebugVertex));
+  glUnmapBuffer(GL_ARRAY_BUFFER);
+
+  const GLuint program = ShaderLibrary::Get().GetProgram(m_Shader, 0);
+  gl.UseProgram(program);
+  gl.SetUniformMatrix4fv(gl.GetUniformLocation(program, "uViewProj"),
+                         viewProj.m);
+  gl.SetEnabled(GL_DEPTH_TEST, layer != LAYER_OVERLAY);
+
+  const GLint first = (GLint)(m_Offset / sizeof(DebugVertex));
+  int draws = 0;
+  if (lineCount) {
+    gl.LineWidth(lineWidth);
+    glDrawArrays(GL_LINES, first, (GLsizei)lineCount);
+    draws++;
+  }
+  if (triCount) {
+    glDrawArrays(GL_TRIANGLES, first + (GLint)lineCount, (GLsizei)triCount);
+    draws++;
+  }
+
+  gl.SetEnabled(GL_DEPTH_TEST, true);
+  gl.LineWidth(1.0f);
+  m_Offset += bytes;
+  if (!keep)
+    Clear(layer);
+  return draws;
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include "../utils/math_utils.h"
+#include <glad/glad.h>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct DebugVertex {
+  float pos[3];
+  uint32_t color; // RGBA8, see DebugDraw::Color
+};
+
+// Immediate-mode batcher for lines and simple solids (grid, gizmos, bounds).
+// Primitives are accumulated on the CPU per layer and each Flush uploads the
+// layer into a ring-buffered VBO (unsynchronized map, orphaned on wrap) and
+// issues at most two draws: one GL_LINES and one GL_TRIANGLES.
+class DebugDraw {
+public:
+  enum Layer {
+    LAYER_WORLD = 0,   // depth tested
+    LAYER_OVERLAY = 1, // drawn on top (gizmos)
+    LAYER_COUNT
+  };
+
+  DebugDraw() = default;
+  ~DebugDraw();
+
+  DebugDraw(const DebugDraw &) = delete;
+  DebugDraw &operator=(const DebugDraw &) = delete;
+
+  void Init();
+
+  static uint32_t Color(float r, float g, float b, float a = 1.0f);
+  static uint32_t Color(const float rgba[4]) {
+    return Color(rgba[0], rgba[1], rgba[2], rgba[3]);
+  }
+
+  void SetLayer(Layer layer) { m_Current = layer; }
+
+  void Line(const float a[3], const float b[3], uint32_t color);
+  // Segment from transform * a to transform * b
+  void Line(const Mat4 &transform, const float a[3], const float b[3],
+            uint32_t color);
+  // Unit cube centered at the origin, transformed
+  void WireBox(const Mat4 &transform, uint32_t color);
+  void SolidBox(const Mat4 &transform, uint32_t color);
+  void Box(const float bmin[3], const float bmax[3], uint32_t color);
+  // Unit circle in the XY plane, transformed
+  void Circle(const Mat4 &transform, uint32_t color, int segments = 32);
+  // Line with a four-line head of length headSize
+  void Arrow(const float from[3], const float to[3], uint32_t color,
+             float headSize = 0.1f);
+  // Lines on the y = 0 plane every `step` units up to +/- halfExtent
+  void Grid(int halfExtent, float step, uint32_t color);
+
+  // Uploads and draws the layer, then clears it unless keep is set (the
+  // same primitives drawn again for another view). Returns the draw count.
+  int Flush(Layer layer, const Mat4 &viewProj, float lineWidth = 1.0f,
+            bool keep = false);
+  void Clear(Layer layer);
+
+  size_t GetVertexCount(Layer layer) const {
+    return m_Layers[layer].lines.size() + m_Layers[layer].triangles.size();
+  }
+
+private:
+  struct LayerData {
+    std::vector<DebugVertex> lines;
+    std::vector<DebugVertex> triangles;
+  };
+
+  void Push(std::vector<DebugVertex> &dst, const float p[3], uint32_t color);
+
+  LayerData m_Layers[LAYER_COUNT];
+  Layer m_Current = LAYER_WORLD;
+
+  int m_Shader = -1; // ShaderLibrary family "debug"
+  GLuint m_VAO = 0;
+  GLuint m_VBO = 0;
+  size_t m_Capacity = 0; // bytes
+  size_t m_Offset = 0;   // ring write cursor, bytes
+};
@@ -0,0 +1,60 @@
+#include "dynamic_resolution.h"
+#include <algorithm>
+#include <cmath>
+
+void DynamicResolution::SetEnabled(bool enabled) {
+  if (enabled == m_Enabled)
+    return;
+  m_Enabled = enabled;
+  // Start again from full resolution with a fresh measurement
+  m_Scale = MAX_SCALE;
+  m_SmoothedMs = 0.0f;
+  m_Cooldown = COOLDOWN;
+}
+
+void DynamicResolution::GetRenderSize(int width, int height, int &renderWidth,
+                                      int &renderHeight) {
+  const float scale = GetScale();
+  renderWidth = std::max(1, (int)std::lround(width * scale));
+  renderHeight = std::max(1, (int)std::lround(height * scale));
+  m_Stats.renderWidth = renderWidth;
+  m_Stats.renderHeight = renderHeight;
+}
+
+void DynamicResolution::Update(float gpuMs) {
+  m_Stats.enabled = m_Enabled;
+  m_Stats.gpuMs = gpuMs;
+  m_Stats.budgetMs = m_BudgetMs;
+  if (!m_Enabled) {
+    m_Stats.scale = 1.0f;
+    return;
+  }
+  if (m_Cooldown > 0) {
+    // Frames still in flight were rendered at the previous scale
+    m_Cooldown--;
+    return;
+  }
+
+  m_SmoothedMs = m_SmoothedMs > 0.0f
+                     ? m_SmoothedMs + (gpuMs - m_SmoothedMs) * SMOOTHING
+                     : gpuMs;
+  m_Stats.smoothedMs = m_SmoothedMs;
+  if (m_SmoothedMs <= 0.0f)
+    return;
+
+  float target = m_Scale * std::sqrt(m_BudgetMs * HEADROOM / m_SmoothedMs);
+  target = std::min(std::max(target, m_Scale - MAX_STEP_DOWN),
+                    m_Scale + MAX_STEP_UP);
+  target = std::min(std::max(target, MIN_SCALE), MAX_SCALE);
+  // Small corrections are noise, except for settling onto a limit
+  if (target == m_Scale || (std::fabs(target - m_Scale) < DEADBAND &&
+                            target != MIN_SCALE && target != MAX_SCALE))
+    return;
+
+  // The smoothed time refers to the old scale; rescale it to the new one
+  m_SmoothedMs *= (target * target) / (m_Scale * m_Scale);
+  m_Scale = target;
+  m_Stats.scale = m_Scale;
+  m_Stats.scaleChanges++;
+  m_Cooldown = COOLDOWN;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "render_stats.h"
+
+// Keeps the scene's GPU time under a budget by rendering it at a fraction
+// of the panel resolution (MIN_SCALE..MAX_SCALE per axis) and upscaling the
+// result with a filtered blit; whatever is drawn afterwards (ImGui) stays
+// at native resolution.
+//
+// The controller is fed one GPU time per measured frame. Cost is taken as
+// proportional to the pixel count, so the scale that meets the budget is
+// scale * sqrt(budget * HEADROOM / ms) on the smoothed time, limited to
+// MAX_STEP_DOWN / MAX_STEP_UP per change (drop fast, recover slowly) and
+// ignored inside DEADBAND to avoid oscillating. After a change the next
+// COOLDOWN samples still belong to the old scale and are skipped.
+//
+// The scene renders into a render-graph texture whose pool size is the
+// panel at full scale (see GetRenderSize), so scale changes only move its
+// viewport and the upscale is a filtered blit pass.
+class DynamicResolution {
+public:
+  static constexpr float MIN_SCALE = 0.5f;
+  static constexpr float MAX_SCALE = 1.0f;
+  static constexpr float HEADROOM = 0.9f;
+  static constexpr float MAX_STEP_DOWN = 0.1f;
+  static constexpr float MAX_STEP_UP = 0.02f;
+  static constexpr float DEADBAND = 0.01f;
+  static constexpr float SMOOTHING = 0.2f; // weight of a new sample
+  static constexpr int COOLDOWN = 5;
+
+  void SetEnabled(bool enabled);
+  bool IsEnabled() const { return m_Enabled; }
+  void SetBudget(float ms) { m_BudgetMs = ms; }
+  float GetBudget() const { return m_BudgetMs; }
+  float GetScale() const { return m_Enabled ? m_Scale : 1.0f; }
+
+  // Size to render at for an output (panel) of width x height
+  void GetRenderSize(int width, int height, int &renderWidth,
+                     int &renderHeight);
+
+  // One GPU time of the scene span
+  void Update(float gpuMs);
+
+  const DynamicResolutionStats &GetStats() const { return m_Stats; }
+
+private:
+  bool m_Enabled = false;
+  float m_BudgetMs = 12.0f;
+  float m_Scale = MAX_SCALE;
+  float m_SmoothedMs = 0.0f;
+  int m_Cooldown = 0;
+  DynamicResolutionStats m_Stats;
+};
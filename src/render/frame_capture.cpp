@@ -0,0 +1,215 @@
+#include "frame_capture.h"
+#include "../core/job_system.h"
+#include "gl_state_cache.h"
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <thread>
+
+namespace fs = std::filesystem;
+
+FrameCapture::~FrameCapture() {
+  if (!m_Ring[0].pbo)
+    return;
+  Flush();
+  for (Slot &slot : m_Ring)
+    GLStateCache::Get().DeleteBuffer(slot.pbo);
+}
+
+void FrameCapture::Init() {
+  for (Slot &slot : m_Ring)
+    glGenBuffers(1, &slot.pbo);
+}
+
+static void CreateParentDirectory(const std::string &path) {
+  const fs::path parent = fs::path(path).parent_path();
+  std::error_code ec;
+  if (!parent.empty())
+    fs::create_directories(parent, ec);
+}
+
+void FrameCapture::Screenshot(const std::string &path) {
+  CreateParentDirectory(path);
+  if (m_ScreenshotPath.empty())
+    m_Stats.requested++;
+  m_ScreenshotPath = path;
+}
+
+void FrameCapture::StartSequence(const std::string &directory,
+                                 ImageWriter::Format format) {
+  std::error_code ec;
+  fs::create_directories(directory, ec);
+  m_SequenceDir = directory;
+  m_SequenceFormat = format;
+  m_SequenceFrame = 0;
+  m_Recording = true;
+}
+
+void FrameCapture::StopSequence() { m_Recording = false; }
+
+bool FrameCapture::IsIdle() const {
+  return m_ScreenshotPath.empty() && !m_Recording && m_Pending == 0 &&
+         m_Shared->pendingWrites == 0;
+}
+
+void FrameCapture::Capture(GLuint fbo, int width, int height) {
+  const bool wanted = !m_ScreenshotPath.empty() || m_Recording;
+  Collect(m_Blocking && wanted && m_Pending == RING_SIZE);
+  if (width <= 0 || height <= 0)
+    return;
+
+  if (!m_ScreenshotPath.empty()) {
+    if (m_Pending < RING_SIZE) {
+      Slot &slot = m_Ring[m_Next];
+      slot.path = m_ScreenshotPath;
+      if (!ImageWriter::FormatFromPath(slot.path, slot.format))
+        slot.format = ImageWriter::Format::Png;
+      Readback(slot, fbo, width, height);
+      m_ScreenshotPath.clear();
+    }
+    // else: kept for the next frame
+  }
+  if (m_Recording) {
+    m_Stats.requested++;
+    char name[32];
+    std::snprintf(name, sizeof(name), "frame_%06d.%s", m_SequenceFrame++,
+                  ImageWriter::Extension(m_SequenceFormat));
+    if (m_Pending < RING_SIZE) {
+      Slot &slot = m_Ring[m_Next];
+      slot.path = (fs::path(m_SequenceDir) / name).string();
+      slot.format = m_SequenceFormat;
+      Readback(slot, fbo, width, height);
+    } else {
+      // The frame number is still used, so gaps show in the sequence
+      m_Stats.droppedRing++;
+    }
+  }
+}
+
+void FrameCapture::Readback(Slot &slot, GLuint fbo, int width, int height) {
+  GLStateCache &gl = GLStateCache::Get();
+  const size_t size = (size_t)width * height * 4;
+  gl.BindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+  if (slot.capacity < size) {
+    glBufferData(GL_PIXEL_PACK_BUFFER, size, nullptr, GL_STREAM_READ);
+    slot.capacity = size;
+  }
+  gl.BindReadFramebuffer(fbo);
+  glReadBuffer(fbo ? GL_COLOR_ATTACHMENT0 : GL_BACK);
+  // Rows of RGBA8 need no pack alignment; the copy lands in the PBO
+  glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+  gl.CountForwarded(2);
+  slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  slot.width = width;
+  slot.height = height;
+  gl.BindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+  gl.BindReadFramebuffer(gl.GetFramebuffer());
+
+  m_Next = (m_Next + 1) % RING_SIZE;
+  m_Pending++;
+  m_Stats.readbacks++;
+}
+
+void FrameCapture::Collect(bool wait) {
+  GLStateCache &gl = GLStateCache::Get();
+  while (m_Pending > 0) {
+    Slot &slot = m_Ring[(m_Next - m_Pending + RING_SIZE) % RING_SIZE];
+    if (wait) {
+      while (glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT,
+                              100000000) == GL_TIMEOUT_EXPIRED) {
+      }
+    } else if (glClientWaitSync(slot.fence, 0, 0) == GL_TIMEOUT_EXPIRED) {
+      break; // newer slots cannot be done either
+    }
+    glDeleteSync(slot.fence);
+    slot.fence = nullptr;
+    m_Pending--;
+
+    const auto start = std::chrono::high_resolution_clock::now();
+    const size_t size = (size_t)slot.width * slot.height * 4;
+    gl.BindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+    const uint8_t *pixels = (const uint8_t *)glMapBufferRange(
+        GL_PIXEL_PACK_BUFFER, 0, size, GL_MAP_READ_BIT);
+    if (pixels) {
+      Write(slot, pixels);
+      glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    } else {
+      m_Stats.failed++;
+    }
+    gl.BindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    m_Stats.mapMs = std::chrono::duration<float, std::milli>(
+                        std::chrono::high_resolution_clock::now() - start)
+                        .count();
+  }
+}
+
+std::vector<uint8_t> FrameCapture::AcquireBuffer() {
+  std::lock_guard<std::mutex> lock(m_Shared->mutex);
+  if (m_Shared->freeBuffers.empty())
+    return {};
+  std::vector<uint8_t> buffer = std::move(m_Shared->freeBuffers.back());
+  m_Shared->freeBuffers.pop_back();
+  return buffer;
+}
+
+void FrameCapture::Write(Slot &slot, const uint8_t *pixels) {
+  if (m_Blocking)
+    WaitForWriters(MAX_PENDING_WRITES - 1);
+  if (m_Shared->pendingWrites >= MAX_PENDING_WRITES) {
+    m_Stats.droppedEncoder++;
+    return;
+  }
+  // The only copy on the GL thread; encoding happens on a worker
+  auto image = std::make_shared<Image>();
+  image->width = slot.width;
+  image->height = slot.height;
+  image->pixels = AcquireBuffer();
+  image->pixels.resize(image->ByteSize());
+  std::memcpy(image->pixels.data(), pixels, image->ByteSize());
+
+  m_Shared->pendingWrites++;
+  std::shared_ptr<Shared> shared = m_Shared;
+  const std::string path = slot.path;
+  const ImageWriter::Format format = slot.format;
+  JobSystem::Get().SubmitBackground([shared, image, path, format] {
+    const auto start = std::chrono::high_resolution_clock::now();
+    std::string error;
+    if (ImageWriter::Write(path, *image, format, error)) {
+      shared->written++;
+    } else {
+      shared->failed++;
+      std::cerr << "Capture: " << error << std::endl;
+    }
+    shared->encodeMs = std::chrono::duration<float, std::milli>(
+                           std::chrono::high_resolution_clock::now() - start)
+                           .count();
+    {
+      std::lock_guard<std::mutex> lock(shared->mutex);
+      if (shared->freeBuffers.size() < (size_t)MAX_PENDING_WRITES)
+        shared->freeBuffers.push_back(std::move(image->pixels));
+    }
+    shared->pendingWrites--;
+  });
+}
+
+void FrameCapture::WaitForWriters(int maxPending) {
+  while (m_Shared->pendingWrites > maxPending)
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+}
+
+void FrameCapture::Flush() {
+  Collect(true);
+  WaitForWriters(0);
+}
+
+CaptureStats FrameCapture::GetStats() const {
+  CaptureStats stats = m_Stats;
+  stats.written = m_Shared->written;
+  stats.failed += m_Shared->failed;
+  stats.pendingReadbacks = m_Pending;
+  stats.pendingWrites = m_Shared->pendingWrites;
+  stats.encodeMs = m_Shared->encodeMs;
+  return stats;
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include "image_writer.h"
+#include "render_stats.h"
+#include <glad/glad.h>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Screenshots and frame sequences of a framebuffer without stalling the GL
+// thread. Capture() queues a glReadPixels into the next buffer of a ring of
+// RING_SIZE pixel-pack buffers and fences it; the buffers are mapped on
+// later Capture() calls, once their fence has signalled (normally one or
+// two frames later), and the copy goes to a background job that encodes
+// and writes the file. A frame is dropped rather than waited for when the
+// whole ring is still in flight or more than MAX_PENDING_WRITES frames are
+// waiting for the workers; both cases are counted. In blocking mode
+// (headless runs, where every frame matters more than frame rate) Capture()
+// waits for the oldest buffer or writer instead of dropping.
+class FrameCapture {
+public:
+  static const int RING_SIZE = 3;
+  static const int MAX_PENDING_WRITES = 8;
+
+  FrameCapture() = default;
+  // Waits for the pending writes
+  ~FrameCapture();
+
+  FrameCapture(const FrameCapture &) = delete;
+  FrameCapture &operator=(const FrameCapture &) = delete;
+
+  // Requires a current GL context
+  void Init();
+
+  // Captures the next frame to `path`; the format comes from the extension
+  // (PNG if unknown). Retried on later frames if the ring is full.
+  void Screenshot(const std::string &path);
+  // Every frame from now on to directory/frame_000000.ext, ...
+  void StartSequence(const std::string &directory, ImageWriter::Format format);
+  void StopSequence();
+  bool IsRecording() const { return m_Recording; }
+  bool IsIdle() const;
+  void SetBlocking(bool blocking) { m_Blocking = blocking; }
+
+  // Once per frame on the GL thread, after the frame has been rendered into
+  // the colour attachment 0 of fbo (0, 0, width, height)
+  void Capture(GLuint fbo, int width, int height);
+  // Blocks until every queued frame has been read back and written
+  void Flush();
+
+  CaptureStats GetStats() const;
+
+private:
+  struct Slot {
+    GLuint pbo = 0;
+    GLsync fence = nullptr;
+    size_t capacity = 0;
+    int width = 0, height = 0;
+    std::string path;
+    ImageWriter::Format format = ImageWriter::Format::Png;
+  };
+
+  // Maps the signalled buffers, oldest first; wait = block on the fences
+  void Collect(bool wait);
+  void WaitForWriters(int maxPending);
+  void Readback(Slot &slot, GLuint fbo, int width, int height);
+  void Write(Slot &slot, const uint8_t *pixels);
+
+  // Pixel storage reused between frames (writers give buffers back)
+  std::vector<uint8_t> AcquireBuffer();
+
+  Slot m_Ring[RING_SIZE];
+  int m_Next = 0;    // slot of the next readback
+  int m_Pending = 0; // fenced slots, oldest at m_Next - m_Pending
+
+  std::string m_ScreenshotPath;
+  bool m_Recording = false;
+  std::string m_SequenceDir;
+  ImageWriter::Format m_SequenceFormat = ImageWriter::Format::Png;
+  int m_SequenceFrame = 0;
+  bool m_Blocking = false;
+
+  // Shared with the writer jobs (which hold it through a shared_ptr, so
+  // they never touch a destroyed FrameCapture)
+  struct Shared {
+    std::mutex mutex;
+    std::vector<std::vector<uint8_t>> freeBuffers;
+    std::atomic<int> pendingWrites{0};
+    std::atomic<uint64_t> written{0};
+    std::atomic<uint64_t> failed{0};
+    std::atomic<float> encodeMs{0.0f};
+  };
+  std::shared_ptr<Shared> m_Shared = std::make_shared<Shared>();
+
+  CaptureStats m_Stats; // GL-thread counters
+};
@@ -0,0 +1,342 @@
+#include "gl_state_cache.h"
+#include <cstring>
+
+GLStateCache &GLStateCache::Get() {
+  static GLStateCache instance;
+  return instance;
+}
+
+void GLStateCache::Invalidate() {
+  m_Program = UNKNOWN;
+  m_VAO = UNKNOWN;
+  m_FBO = UNKNOWN;
+  m_ReadFBO = UNKNOWN;
+  for (auto &b : m_Buffers)
+    b = UNKNOWN;
+  m_ActiveUnit = UNKNOWN;
+  for (auto &unit : m_Textures)
+    for (auto &t : unit)
+      t = UNKNOWN;
+  for (auto &c : m_Caps)
+    c = -1;
+  m_DepthFunc = UNKNOWN;
+  m_DepthMask = -1;
+  m_BlendSrc = m_BlendDst = UNKNOWN;
+  m_PolygonMode = UNKNOWN;
+  m_LineWidth = -1.0f;
+  m_Viewport[0] = m_Viewport[1] = m_Viewport[2] = m_Viewport[3] = -1;
+  m_ClearColor[0] = m_ClearColor[1] = m_ClearColor[2] = m_ClearColor[3] =
+      -1.0f;
+  m_Uniforms.clear();
+}
+
+void GLStateCache::BeginFrame() {
+  m_LastFrame = m_Counters;
+  m_Counters = GLStateCounters();
+}
+
+int GLStateCache::BufferSlot(GLenum target) {
+  switch (target) {
+  case GL_ARRAY_BUFFER: return 0;
+  case GL_DRAW_INDIRECT_BUFFER: return 1;
+  case GL_UNIFORM_BUFFER: return 2;
+  case GL_PIXEL_PACK_BUFFER: return 3;
+  case GL_PIXEL_UNPACK_BUFFER: return 4;
+  case GL_COPY_READ_BUFFER: return 5;
+  case GL_COPY_WRITE_BUFFER: return 6;
+  case GL_TEXTURE_BUFFER: return 7;
+  default: return -1;
+  }
+}
+
+int GLStateCache::TextureSlot(GLenum target) {
+  switch (target) {
+  case GL_TEXTURE_2D: return 0;
+  case GL_TEXTURE_2D_ARRAY: return 1;
+  case GL_TEXTURE_BUFFER: return 2;
+  case GL_TEXTURE_CUBE_MAP: return 3;
+  default: return -1;
+  }
+}
+
+int GLStateCache::CapSlot(GLenum cap) {
+  switch (cap) {
+  case GL_DEPTH_TEST: return 0;
+  case GL_BLEND: return 1;
+  case GL_CULL_FACE: return 2;
+  case GL_SCISSOR_TEST: return 3;
+  case GL_STENCIL_TEST: return 4;
+  case GL_POLYGON_OFFSET_FILL: return 5;
+  default: return -1;
+  }
+}
+
+void GLStateCache::UseProgram(GLuint program) {
+  if (!Changed(m_Program == program))
+    return;
+  m_Program = program;
+  glUseProgram(program);
+}
+
+void GLStateCache::BindVertexArray(GLuint vao) {
+  if (!Changed(m_VAO == vao))
+    return;
+  m_VAO = vao;
+  glBindVertexArray(vao);
+}
+
+void GLStateCache::BindBuffer(GLenum target, GLuint buffer) {
+  int slot = BufferSlot(target);
+  if (slot < 0) {
+    m_Counters.forwarded++;
+    glBindBuffer(target, buffer);
+    return;
+  }
+  if (!Changed(m_Buffers[slot] == buffer))
+    return;
+  m_Buffers[slot] = buffer;
+  glBindBuffer(target, buffer);
+}
+
+void GLStateCache::BindTexture(GLuint unit, GLenum target, GLuint texture) {
+  int slot = TextureSlot(target);
+  if (slot >= 0 && unit < (GLuint)MAX_TEXTURE_UNITS &&
+      !Changed(m_Textures[unit][slot] == texture))
+    return;
+  if (m_ActiveUnit != unit) {
+    m_Counters.forwarded++;
+    m_ActiveUnit = unit;
+    glActiveTexture(GL_TEXTURE0 + unit);
+  }
+  if (slot >= 0 && unit < (GLuint)MAX_TEXTURE_UNITS)
+    m_Textures[unit][slot] = texture;
+  else
+    m_Counters.forwarded++;
+  glBindTexture(target, texture);
+}
+
+void GLStateCache::BindFramebuffer(GLuint fbo) {
+  if (!Changed(m_FBO == fbo && m_ReadFBO == fbo))
+    return;
+  m_FBO = m_ReadFBO = fbo;
+  glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+}
+
+void GLStateCache::BindReadFramebuffer(GLuint fbo) {
+  if (!Changed(m_ReadFBO == fbo))
+    return;
+  m_ReadFBO = fbo;
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, fbo);
+}
+
+GLuint GLStateCache::GetFramebuffer() {
+  if (m_FBO == UNKNOWN) {
+    GLint fbo = 0;
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &fbo);
+    return (GLuint)fbo;
+  }
+  return m_FBO;
+}
+
+void GLStateCache::DeleteVertexArray(GLuint vao) {
+  if (!vao)
+    return;
+  // Deleting the bound VAO reverts the binding to 0
+  if (m_VAO == vao)
+    m_VAO = 0;
+  m_Counters.forwarded++;
+  glDeleteVertexArrays(1, &vao);
+}
+
+void GLStateCache::DeleteBuffer(GLuint buffer) {
+  if (!buffer)
+    return;
+  for (auto &b : m_Buffers)
+    if (b == buffer)
+      b = 0;
+  m_Counters.forwarded++;
+  glDeleteBuffers(1, &buffer);
+}
+
+void GLStateCache::DeleteTexture(GLuint texture) {
+  if (!texture)
+    return;
+  for (auto &unit : m_Textures)
+    for (auto &t : unit)
+      if (t == texture)
+        t = 0;
+  m_Counters.forwarded++;
+  glDeleteTextures(1, &texture);
+}
+
+void GLStateCache::DeleteProgram(GLuint program) {
+  if (!program)
+    return;
+  if (m_Program == program)
+    UseProgram(0);
+  ForgetProgram(program);
+  m_Counters.forwarded++;
+  glDeleteProgram(program);
+}
+
+void GLStateCache::ForgetProgram(GLuint program) {
+  for (auto it = m_Uniforms.begin(); it != m_Uniforms.end();) {
+    if ((GLuint)(it->first >> 32) == program)
+      it = m_Uniforms.erase(it);
+    else
+      ++it;
+  }
+  m_Locations.erase(program);
+  if (m_Program == program)
+    m_Program = UNKNOWN;
+}
+
+void GLStateCache::SetEnabled(GLenum cap, bool enabled) {
+  int slot = CapSlot(cap);
+  if (slot >= 0) {
+    if (!Changed(m_Caps[slot] == (enabled ? 1 : 0)))
+      return;
+    m_Caps[slot] = enabled ? 1 : 0;
+  } else {
+    m_Counters.forwarded++;
+  }
+  if (enabled)
+    glEnable(cap);
+  else
+    glDisable(cap);
+}
+
+void GLStateCache::DepthFunc(GLenum func) {
+  if (!Changed(m_DepthFunc == func))
+    return;
+  m_DepthFunc = func;
+  glDepthFunc(func);
+}
+
+void GLStateCache::DepthMask(bool write) {
+  if (!Changed(m_DepthMask == (write ? 1 : 0)))
+    return;
+  m_DepthMask = write ? 1 : 0;
+  glDepthMask(write ? GL_TRUE : GL_FALSE);
+}
+
+void GLStateCache::BlendFunc(GLenum src, GLenum dst) {
+  if (!Changed(m_BlendSrc == src && m_BlendDst == dst))
+    return;
+  m_BlendSrc = src;
+  m_BlendDst = dst;
+  glBlendFunc(src, dst);
+}
+
+void GLStateCache::PolygonMode(GLenum mode) {
+  if (!Changed(m_PolygonMode == mode))
+    return;
+  m_PolygonMode = mode;
+  glPolygonMode(GL_FRONT_AND_BACK, mode);
+}
+
+void GLStateCache::LineWidth(float width) {
+  if (!Changed(m_LineWidth == width))
+    return;
+  m_LineWidth = width;
+  glLineWidth(width);
+}
+
+void GLStateCache::Viewport(GLint x, GLint y, GLsizei w, GLsizei h) {
+  if (!Changed(m_Viewport[0] == x && m_Viewport[1] == y &&
+               m_Viewport[2] == w && m_Viewport[3] == h))
+    return;
+  m_Viewport[0] = x;
+  m_Viewport[1] = y;
+  m_Viewport[2] = w;
+  m_Viewport[3] = h;
+  glViewport(x, y, w, h);
+}
+
+void GLStateCache::GetViewport(GLint out[4]) {
+  if (m_Viewport[2] < 0)
+    glGetIntegerv(GL_VIEWPORT, m_Viewport);
+  for (int i = 0; i < 4; ++i)
+    out[i] = m_Viewport[i];
+}
+
+void GLStateCache::ClearColor(float r, float g, float b, float a) {
+  if (!Changed(m_ClearColor[0] == r && m_ClearColor[1] == g &&
+               m_ClearColor[2] == b && m_ClearColor[3] == a))
+    return;
+  m_ClearColor[0] = r;
+  m_ClearColor[1] = g;
+  m_ClearColor[2] = b;
+  m_ClearColor[3] = a;
+  glClearColor(r, g, b, a);
+}
+
+GLint GLStateCache::GetUniformLocation(GLuint program, const char *name) {
+  auto &locations = m_Locations[program];
+  auto it = locations.find(name);
+  if (it != locations.end()) {
+    m_Counters.filtered++;
+    return it->second;
+  }
+  m_Counters.forwarded++;
+  GLint loc = glGetUniformLocation(program, name);
+  locations.emplace(name, loc);
+  return loc;
+}
+
+bool GLStateCache::UniformChanged(GLint location, const float *v, int count) {
+  if (location < 0)
+    return false;
+  if (m_Program == UNKNOWN) {
+    // Program bound behind the cache: values cannot be attributed to it
+    m_Counters.forwarded++;
+    return true;
+  }
+  uint64_t key = (uint64_t)m_Program << 32 | (uint32_t)location;
+  auto it = m_Uniforms.find(key);
+  if (it != m_Uniforms.end() && it->second.count == count &&
+      std::memcmp(it->second.v, v, count * sizeof(float)) == 0) {
+    m_Counters.filtered++;
+    return false;
+  }
+  UniformValue &value = m_Uniforms[key];
+  std::memcpy(value.v, v, count * sizeof(float));
+  value.count = count;
+  m_Counters.forwarded++;
+  return true;
+}
+
+void GLStateCache::SetUniform1i(GLint location, GLint v) {
+  float bits;
+  std::memcpy(&bits, &v, sizeof(bits));
+  if (UniformChanged(location, &bits, 1))
+    glUniform1i(location, v);
+}
+
+void GLStateCache::SetUniform1f(GLint location, float v) {
+  if (UniformChanged(location, &v, 1))
+    glUniform1f(location, v);
+}
+
+void GLStateCache::SetUniform3f(GLint location, float x, float y, float z) {
+  const float v[3] = {x, y, z};
+  if (UniformChanged(location, v, 3))
+    glUniform3f(location, x, y, z);
+}
+
+void GLStateCache::SetUniform4f(GLint location, float x, float y, float z,
+                                float w) {
+  const float v[4] = {x, y, z, w};
+  if (UniformChanged(location, v, 4))
+    glUniform4f(location, x, y, z, w);
+}
+
+void GLStateCache::SetUniform4fv(GLint location, const float *v) {
+  if (UniformChanged(location, v, 4))
+    glUniform4fv(location, 1, v);
+}
+
+void GLStateCache::SetUniformMatrix4fv(GLint location, const float *m) {
+  if (UniformChanged(location, m, 16))
+    glUniformMatrix4fv(location, 1, GL_FALSE, m);
+}
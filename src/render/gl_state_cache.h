@@ -0,0 +1,130 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+
+// Contadores de llamadas al driver (panel Stats)
+struct GLStateCounters {
+  uint64_t forwarded = 0; // calls that reached the driver
+  uint64_t filtered = 0;  // redundant calls dropped by the cache
+};
+
+// Thin shadow of the GL state touched every frame. Each setter compares
+// against the shadowed value and only forwards real changes to the driver.
+//
+// Code that changes state behind the cache's back must call Invalidate()
+// (or the per-object Forget* helpers) afterwards. Dear ImGui's backend
+// restores everything it touches, so it does not need to.
+class GLStateCache {
+public:
+  static GLStateCache &Get();
+
+  // Marks every shadowed value as unknown; the next call always forwards
+  void Invalidate();
+  // Stores the counters of the finished frame and resets the running ones
+  void BeginFrame();
+
+  // Objects
+  void UseProgram(GLuint program);
+  void BindVertexArray(GLuint vao);
+  // GL_ELEMENT_ARRAY_BUFFER is VAO state and is always forwarded
+  void BindBuffer(GLenum target, GLuint buffer);
+  void BindTexture(GLuint unit, GLenum target, GLuint texture);
+  // GL_FRAMEBUFFER (draw and read)
+  void BindFramebuffer(GLuint fbo);
+  // GL_READ_FRAMEBUFFER only (blit sources)
+  void BindReadFramebuffer(GLuint fbo);
+
+  void DeleteVertexArray(GLuint vao);
+  void DeleteBuffer(GLuint buffer);
+  void DeleteTexture(GLuint texture);
+  // Unbinds it if bound and forgets its uniforms: GL reuses the name, and a
+  // new program must not inherit the cached values
+  void DeleteProgram(GLuint program);
+  // Drop cached uniform values/locations (e.g. after relinking)
+  void ForgetProgram(GLuint program);
+
+  // Fixed-function state
+  void SetEnabled(GLenum cap, bool enabled);
+  void DepthFunc(GLenum func);
+  void DepthMask(bool write);
+  void BlendFunc(GLenum src, GLenum dst);
+  void PolygonMode(GLenum mode); // GL_FRONT_AND_BACK
+  void LineWidth(float width);
+  void Viewport(GLint x, GLint y, GLsizei w, GLsizei h);
+  // x, y, width, height; queried from GL if never set through the cache
+  void GetViewport(GLint out[4]);
+  void ClearColor(float r, float g, float b, float a);
+
+  // Uniforms of the currently bound program
+  GLint GetUniformLocation(GLuint program, const char *name);
+  void SetUniform1i(GLint location, GLint v);
+  void SetUniform1f(GLint location, float v);
+  void SetUniform3f(GLint location, float x, float y, float z);
+  void SetUniform4f(GLint location, float x, float y, float z, float w);
+  void SetUniform4fv(GLint location, const float *v);
+  void SetUniformMatrix4fv(GLint location, const float *m);
+
+  // Direct counting for calls that are always forwarded (draws, uploads)
+  void CountForwarded(uint64_t n = 1) { m_Counters.forwarded += n; }
+
+  GLuint GetProgram() const { return m_Program; }
+  GLuint GetVertexArray() const { return m_VAO; }
+  // Draw framebuffer; queried from GL if never set through the cache
+  GLuint GetFramebuffer();
+  const GLStateCounters &GetCounters() const { return m_Counters; }
+  const GLStateCounters &GetLastFrameCounters() const { return m_LastFrame; }
+
+private:
+  GLStateCache() { Invalidate(); }
+
+  static const GLuint UNKNOWN = 0xFFFFFFFFu;
+  static const int MAX_TEXTURE_UNITS = 16;
+  static const int TEXTURE_TARGETS = 4; // 2D, 2D_ARRAY, BUFFER, CUBE_MAP
+  static const int BUFFER_TARGETS = 8;
+  static const int CAPS = 6;
+
+  // Returns false (after forwarding nothing) if the value is unchanged
+  bool Changed(bool equal) {
+    if (equal) {
+      m_Counters.filtered++;
+      return false;
+    }
+    m_Counters.forwarded++;
+    return true;
+  }
+  bool UniformChanged(GLint location, const float *v, int count);
+  static int BufferSlot(GLenum target);
+  static int TextureSlot(GLenum target);
+  static int CapSlot(GLenum cap);
+
+  GLuint m_Program;
+  GLuint m_VAO;
+  GLuint m_FBO;
+  GLuint m_ReadFBO;
+  GLuint m_Buffers[BUFFER_TARGETS];
+  GLuint m_ActiveUnit;
+  GLuint m_Textures[MAX_TEXTURE_UNITS][TEXTURE_TARGETS];
+  int m_Caps[CAPS]; // -1 unknown, 0 off, 1 on
+  GLenum m_DepthFunc;
+  int m_DepthMask;
+  GLenum m_BlendSrc, m_BlendDst;
+  GLenum m_PolygonMode;
+  float m_LineWidth;
+  GLint m_Viewport[4];
+  float m_ClearColor[4];
+
+  struct UniformValue {
+    float v[16];
+    int count;
+  };
+  // key = program << 32 | location
+  std::unordered_map<uint64_t, UniformValue> m_Uniforms;
+  std::unordered_map<GLuint, std::unordered_map<std::string, GLint>>
+      m_Locations;
+
+  GLStateCounters m_Counters;
+  GLStateCounters m_LastFrame;
+};
@@ -0,0 +1,44 @@
+#include "gpu_timer.h"
+#include <cstdint>
+
+GpuTimer::~GpuTimer() {
+  if (m_Queries[0])
+    glDeleteQueries(LATENCY, m_Queries);
+}
+
+void GpuTimer::Init() { glGenQueries(LATENCY, m_Queries); }
+
+void GpuTimer::Begin() {
+  if (m_Pending == LATENCY)
+    return;
+  glBeginQuery(GL_TIME_ELAPSED, m_Queries[m_Next]);
+  m_Active = true;
+}
+
+void GpuTimer::End() {
+  if (!m_Active)
+    return;
+  glEndQuery(GL_TIME_ELAPSED);
+  m_Active = false;
+  m_Next = (m_Next + 1) % LATENCY;
+  m_Pending++;
+}
+
+bool GpuTimer::Poll(float &ms) {
+  bool read = false;
+  while (m_Pending > 0) {
+    const GLuint query = m_Queries[(m_Next - m_Pending + LATENCY) % LATENCY];
+    GLint available = 0;
+    glGetQueryObjectiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+    if (!available)
+      break;
+    GLuint64 ns = 0;
+    glGetQueryObjectui64v(query, GL_QUERY_RESULT, &ns);
+    m_LastMs = (float)(ns / 1.0e6);
+    m_Pending--;
+    read = true;
+  }
+  if (read)
+    ms = m_LastMs;
+  return read;
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <glad/glad.h>
+
+// GPU time of a span of GL commands (GL_TIME_ELAPSED, core in 3.3).
+// Queries go into a small ring and are read back LATENCY frames later at
+// most, only once the driver reports them available, so timing never
+// stalls the pipeline. Spans must not nest (one elapsed-time query can be
+// active at a time).
+class GpuTimer {
+public:
+  static const int LATENCY = 4;
+
+  GpuTimer() = default;
+  ~GpuTimer();
+
+  GpuTimer(const GpuTimer &) = delete;
+  GpuTimer &operator=(const GpuTimer &) = delete;
+
+  // Requires a current GL context
+  void Init();
+
+  // Skipped (no measurement) while all queries are still in flight
+  void Begin();
+  void End();
+
+  // Reads every finished query; true if at least one arrived since the
+  // last call, with ms set to the newest
+  bool Poll(float &ms);
+  float GetLastMs() const { return m_LastMs; }
+
+private:
+  GLuint m_Queries[LATENCY] = {};
+  int m_Next = 0;    // ring slot of the next Begin
+  int m_Pending = 0; // issued and not read yet, oldest first
+  bool m_Active = false;
+  float m_LastMs = 0.0f;
+};
@@ -0,0 +1,774 @@
+#include "image_loader.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <emmintrin.h>
+#define IMAGE_SSE2 1
+#endif
+
+namespace {
+
+// Images larger than this are rejected before allocating
+const int MAX_DIMENSION = 16384;
+
+uint32_t ReadBE32(const uint8_t *p) {
+  return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 |
+         p[3];
+}
+uint16_t ReadLE16(const uint8_t *p) { return (uint16_t)(p[0] | p[1] << 8); }
+uint32_t ReadLE32(const uint8_t *p) {
+  return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 |
+         (uint32_t)p[3] << 24;
+}
+
+bool ValidSize(int w, int h, std::string &error) {
+  if (w <= 0 || h <= 0 || w > MAX_DIMENSION || h > MAX_DIMENSION) {
+    error = "invalid image size";
+    return false;
+  }
+  return true;
+}
+
+// Decoders write rows top-to-bottom; flipped once at the end
+void FlipRows(Image &img) {
+  const size_t stride = (size_t)img.width * 4;
+  std::vector<uint8_t> tmp(stride);
+  for (int y = 0; y < img.height / 2; ++y) {
+    uint8_t *a = &img.pixels[y * stride];
+    uint8_t *b = &img.pixels[(img.height - 1 - y) * stride];
+    std::memcpy(tmp.data(), a, stride);
+    std::memcpy(a, b, stride);
+    std::memcpy(b, tmp.data(), stride);
+  }
+}
+
+// ---------------------------------------------------------------------------
+// Inflate (RFC 1950/1951), canonical Huffman decoding one bit at a time
+// ---------------------------------------------------------------------------
+
+struct BitReader {
+  const uint8_t *data;
+  size_t size;
+  size_t pos = 0;
+  uint32_t buffer = 0;
+  int count = 0;
+  bool overrun = false;
+
+  BitReader(const uint8_t *d, size_t s) : data(d), size(s) {}
+
+  uint32_t Bits(int n) {
+    while (count < n) {
+      if (pos >= size) {
+        overrun = true;
+        return 0;
+      }
+      buffer |= (uint32_t)data[pos++] << count;
+      count += 8;
+    }
+    uint32_t v = buffer & ((1u << n) - 1);
+    buffer >>= n;
+    count -= n;
+    return v;
+  }
+  void AlignToByte() {
+    buffer = 0;
+    count = 0;
+  }
+};
+
+struct Huffman {
+  uint16_t counts[16];
+  uint16_t symbols[288];
+};
+
+bool BuildHuffman(Huffman &h, const uint8_t *lengths, int n) {
+  std::memset(h.counts, 0, sizeof(h.counts));
+  for (int i = 0; i < n; ++i)
+    h.counts[lengths[i]]++;
+  h.counts[0] = 0;
+  uint16_t offsets[16];
+  offsets[1] = 0;
+  for (int len = 1; len < 15; ++len)
+    offsets[len + 1] = offsets[len] + h.counts[len];
+  // Over-subscribed sets are invalid; incomplete ones are allowed
+  int left = 1;
+  for (int len = 1; len < 16; ++len) {
+    left <<= 1;
+    left -= h.counts[len];
+    if (left < 0)
+      return false;
+  }
+  for (int i = 0; i < n; ++i) {
+    if (lengths[i])
+      h.symbols[offsets[lengths[i]]++] = (uint16_t)i;
+  }
+  return true;
+}
+
+int DecodeSymbol(BitReader &br, const Huffman &h) {
+  int code = 0, first = 0, index = 0;
+  for (int len = 1; len < 16; ++len) {
+    code |= (int)br.Bits(1);
+    // Past the end Bits() returns zeros, which could match a short code
+    if (br.overrun)
+      return -1;
+    const int count = h.counts[len];
+    if (code - count < first)
+      return h.symbols[index + (code - first)];
+    index += count;
+    first += count;
+    first <<= 1;
+    code <<= 1;
+  }
+  return -1;
+}
+
+const uint16_t LENGTH_BASE[29] = {3,  4,  5,  6,   7,   8,   9,   10,  11, 13,
+                                  15, 17, 19, 23,  27,  31,  35,  43,  51, 59,
+                                  67, 83, 99, 115, 131, 163, 195, 227, 258};
+const uint8_t LENGTH_EXTRA[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2,
+                                  2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+const uint16_t DIST_BASE[30] = {
+    1,   2,   3,   4,   5,   7,    9,    13,   17,   25,   33,   49,   65,   97,   129,
+    193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+const uint8_t DIST_EXTRA[30] = {0, 0, 0, 0, 1, 1, 2, 2,  3,  3,  4,  4,  5,  5,  6,
+                                6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+// `limit` caps the output: a corrupt stream fails instead of growing it
+// without end
+bool InflateBlock(BitReader &br, const Huffman &lit, const Huffman &dist,
+                  size_t limit, std::vector<uint8_t> &out) {
+  for (;;) {
+    int sym = DecodeSymbol(br, lit);
+    if (sym < 0)
+      return false;
+    if (sym < 256) {
+      if (br.overrun || out.size() >= limit)
+        return false;
+      out.push_back((uint8_t)sym);
+      continue;
+    }
+    if (sym == 256)
+      return true;
+    sym -= 257;
+    if (sym >= 29)
+      return false;
+    const size_t len = LENGTH_BASE[sym] + br.Bits(LENGTH_EXTRA[sym]);
+    const int dsym = DecodeSymbol(br, dist);
+    if (dsym < 0 || dsym >= 30)
+      return false;
+    const size_t d = DIST_BASE[dsym] + br.Bits(DIST_EXTRA[dsym]);
+    if (br.overrun || d > out.size() || len > limit - out.size())
+      return false;
+    // Byte by byte: the copy may overlap its own output
+    size_t from = out.size() - d;
+    for (size_t i = 0; i < len; ++i)
+      out.push_back(out[from + i]);
+  }
+}
+
+bool Inflate(const uint8_t *data, size_t size, size_t limit,
+             std::vector<uint8_t> &out, std::string &error) {
+  if (size < 2 || (data[0] & 0x0F) != 8 || ((data[0] << 8) | data[1]) % 31 ||
+      (data[1] & 0x20)) {
+    error = "bad zlib header";
+    return false;
+  }
+  BitReader br(data + 2, size - 2);
+  int last = 0;
+  do {
+    last = (int)br.Bits(1);
+    const uint32_t type = br.Bits(2);
+    if (type == 0) {
+      br.AlignToByte();
+      if (br.pos + 4 > br.size) {
+        error = "truncated stored block";
+        return false;
+      }
+      const uint16_t len = ReadLE16(br.data + br.pos);
+      const uint16_t nlen = ReadLE16(br.data + br.pos + 2);
+      br.pos += 4;
+      if ((uint16_t)~nlen != len || br.pos + len > br.size) {
+        error = "bad stored block";
+        return false;
+      }
+      if (len > limit - out.size()) {
+        error = "deflate stream too long";
+        return false;
+      }
+      out.insert(out.end(), br.data + br.pos, br.data + br.pos + len);
+      br.pos += len;
+      continue;
+    }
+
+    Huffman lit, dist;
+    uint8_t lengths[320];
+    if (type == 1) {
+      int i = 0;
+      for (; i < 144; ++i) lengths[i] = 8;
+      for (; i < 256; ++i) lengths[i] = 9;
+      for (; i < 280; ++i) lengths[i] = 7;
+      for (; i < 288; ++i) lengths[i] = 8;
+      BuildHuffman(lit, lengths, 288);
+      for (i = 0; i < 30; ++i) lengths[i] = 5;
+      BuildHuffman(dist, lengths, 30);
+    } else if (type == 2) {
+      static const uint8_t ORDER[19] = {16, 17, 18, 0, 8,  7, 9,  6, 10, 5,
+                                        11, 4,  12, 3, 13, 2, 14, 1, 15};
+      const int nlit = (int)br.Bits(5) + 257;
+      const int ndist = (int)br.Bits(5) + 1;
+      const int ncode = (int)br.Bits(4) + 4;
+      if (nlit > 286 || ndist > 30) {
+        error = "bad dynamic block";
+        return false;
+      }
+      uint8_t codeLengths[19] = {};
+      for (int i = 0; i < ncode; ++i)
+        codeLengths[ORDER[i]] = (uint8_t)br.Bits(3);
+      Huffman lencode;
+      if (!BuildHuffman(lencode, codeLengths, 19)) {
+        error = "bad code lengths";
+        return false;
+      }
+      int index = 0;
+      while (index < nlit + ndist) {
+        int sym = DecodeSymbol(br, lencode);
+        if (sym < 0) {
+          error = "bad code lengths";
+          return false;
+        }
+        if (sym < 16) {
+          lengths[index++] = (uint8_t)sym;
+          continue;
+        }
+        uint8_t value = 0;
+        int repeat = 0;
+        if (sym == 16) {
+          if (index == 0) {
+            error = "bad repeat";
+            return false;
+          }
+          value = lengths[index - 1];
+          repeat = 3 + (int)br.Bits(2);
+        } else if (sym == 17) {
+          repeat = 3 + (int)br.Bits(3);
+        } else {
+          repeat = 11 + (int)br.Bits(7);
+        }
+        if (index + repeat > nlit + ndist) {
+          error = "bad repeat";
+          return false;
+        }
+        while (repeat--)
+          lengths[index++] = value;
+      }
+      if (!BuildHuffman(lit, lengths, nlit) ||
+          !BuildHuffman(dist, lengths + nlit, ndist)) {
+        error = "bad huffman table";
+        return false;
+      }
+    } else {
+      error = "bad block type";
+      return false;
+    }
+    if (!InflateBlock(br, lit, dist, limit, out)) {
+      error = "corrupt deflate stream";
+      return false;
+    }
+  } while (!last && !br.overrun);
+
+  if (br.overrun) {
+    error = "truncated deflate stream";
+    return false;
+  }
+  return true;
+}
+
+// ---------------------------------------------------------------------------
+// PNG
+// ---------------------------------------------------------------------------
+
+int Paeth(int a, int b, int c) {
+  int p = a + b - c;
+  int pa = std::abs(p - a), pb = std::abs(p - b), pc = std::abs(p - c);
+  if (pa <= pb && pa <= pc)
+    return a;
+  return pb <= pc ? b : c;
+}
+
+bool DecodePNG(const uint8_t *data, size_t size, Image &out,
+               std::string &error) {
+  size_t pos = 8;
+  int width = 0, height = 0, depth = 0, colorType = -1;
+  uint8_t palette[256][4];
+  int paletteSize = 0;
+  std::vector<uint8_t> idat;
+  std::memset(palette, 0, sizeof(palette));
+  for (int i = 0; i < 256; ++i)
+    palette[i][3] = 255;
+
+  while (pos + 12 <= size) {
+    const uint32_t len = ReadBE32(data + pos);
+    const uint8_t *type = data + pos + 4;
+    const uint8_t *body = data + pos + 8;
+    if (len > size - pos - 12) {
+      error = "truncated chunk";
+      return false;
+    }
+    if (!std::memcmp(type, "IHDR", 4) && len >= 13) {
+      width = (int)ReadBE32(body);
+      height = (int)ReadBE32(body + 4);
+      depth = body[8];
+      colorType = body[9];
+      if (body[12] != 0) {
+        error = "interlaced PNG not supported";
+        return false;
+      }
+    } else if (!std::memcmp(type, "PLTE", 4)) {
+      paletteSize = (int)std::min<uint32_t>(len / 3, 256);
+      for (int i = 0; i < paletteSize; ++i) {
+        palette[i][0] = body[i * 3];
+        palette[i][1] = body[i * 3 + 1];
+        palette[i][2] = body[i * 3 + 2];
+      }
+    } else if (!std::memcmp(type, "tRNS", 4) && colorType == 3) {
+      for (uint32_t i = 0; i < len && i < 256; ++i)
+        palette[i][3] = body[i];
+    } else if (!std::memcmp(type, "IDAT", 4)) {
+      idat.insert(idat.end(), body, body + len);
+    } else if (!std::memcmp(type, "IEND", 4)) {
+      break;
+    }
+    pos += 12 + len;
+  }
+
+  if (!ValidSize(width, height, error))
+    return false;
+  int channels = 0;
+  switch (colorType) {
+  case 0: channels = 1; break;
+  case 2: channels = 3; break;
+  case 3: channels = 1; break;
+  case 4: channels = 2; break;
+  case 6: channels = 4; break;
+  default: error = "bad PNG colour type"; return false;
+  }
+  const bool subByte = depth < 8;
+  if ((depth != 1 && depth != 2 && depth != 4 && depth != 8 && depth != 16) ||
+      (subByte && colorType != 0 && colorType != 3) ||
+      (depth == 16 && colorType == 3)) {
+    error = "unsupported PNG bit depth";
+    return false;
+  }
+  if (colorType == 3 && paletteSize == 0) {
+    error = "missing PNG palette";
+    return false;
+  }
+
+  const size_t stride = ((size_t)width * channels * depth + 7) / 8;
+  const size_t bpp = std::max<size_t>(1, (size_t)channels * depth / 8);
+  std::vector<uint8_t> raw;
+  raw.reserve((stride + 1) * height);
+  if (!Inflate(idat.data(), idat.size(), (stride + 1) * height, raw, error))
+    return false;
+  if (raw.size() < (stride + 1) * height) {
+    error = "PNG image data too short";
+    return false;
+  }
+
+  // Undo the per-row filters in place
+  std::vector<uint8_t> zero(stride, 0);
+  for (int y = 0; y < height; ++y) {
+    uint8_t *row = &raw[y * (stride + 1)];
+    const uint8_t filter = row[0];
+    uint8_t *cur = row + 1;
+    const uint8_t *prev = y ? &raw[(y - 1) * (stride + 1) + 1] : zero.data();
+    for (size_t i = 0; i < stride; ++i) {
+      const int a = i >= bpp ? cur[i - bpp] : 0;
+      const int b = prev[i];
+      const int c = i >= bpp ? prev[i - bpp] : 0;
+      switch (filter) {
+      case 0: break;
+      case 1: cur[i] = (uint8_t)(cur[i] + a); break;
+      case 2: cur[i] = (uint8_t)(cur[i] + b); break;
+      case 3: cur[i] = (uint8_t)(cur[i] + ((a + b) >> 1)); break;
+      case 4: cur[i] = (uint8_t)(cur[i] + Paeth(a, b, c)); break;
+      default: error = "bad PNG filter"; return false;
+      }
+    }
+  }
+
+  out.width = width;
+  out.height = height;
+  out.pixels.resize(out.ByteSize());
+  const int step = depth == 16 ? 2 : 1; // 16-bit: keep the high byte
+  for (int y = 0; y < height; ++y) {
+    const uint8_t *src = &raw[y * (stride + 1) + 1];
+    uint8_t *dst = &out.pixels[(size_t)y * width * 4];
+    for (int x = 0; x < width; ++x, dst += 4) {
+      if (subByte) {
+        const int bitPos = x * depth;
+        const int shift = 8 - depth - (bitPos & 7);
+        const int v = (src[bitPos >> 3] >> shift) & ((1 << depth) - 1);
+        if (colorType == 3) {
+          std::memcpy(dst, palette[v], 4);
+        } else {
+          const uint8_t g = (uint8_t)(v * 255 / ((1 << depth) - 1));
+          dst[0] = dst[1] = dst[2] = g;
+          dst[3] = 255;
+        }
+        continue;
+      }
+      const uint8_t *p = src + (size_t)x * channels * step;
+      switch (colorType) {
+      case 0:
+        dst[0] = dst[1] = dst[2] = p[0];
+        dst[3] = 255;
+        break;
+      case 2:
+        dst[0] = p[0];
+        dst[1] = p[step];
+        dst[2] = p[2 * step];
+        dst[3] = 255;
+        break;
+      case 3:
+        std::memcpy(dst, palette[p[0]], 4);
+        break;
+      case 4:
+        dst[0] = dst[1] = dst[2] = p[0];
+        dst[3] = p[step];
+        break;
+      case 6:
+        dst[0] = p[0];
+        dst[1] = p[step];
+        dst[2] = p[2 * step];
+        dst[3] = p[3 * step];
+        break;
+      }
+    }
+  }
+  FlipRows(out);
+  return true;
+}
+
+// ---------------------------------------------------------------------------
+// TGA
+// ---------------------------------------------------------------------------
+
+bool DecodeTGA(const uint8_t *data, size_t size, Image &out,
+               std::string &error) {
+  if (size < 18) {
+    error = "truncated TGA header";
+    return false;
+  }
+  const int idLength = data[0];
+  const int colorMapType = data[1];
+  const int type = data[2];
+  const int width = ReadLE16(data + 12);
+  const int height = ReadLE16(data + 14);
+  const int bits = data[16];
+  const bool topDown = (data[17] & 0x20) != 0;
+  const bool rle = type == 10 || type == 11;
+  const bool grey = type == 3 || type == 11;
+  if (colorMapType != 0 || (type != 2 && type != 3 && type != 10 && type != 11)) {
+    error = "unsupported TGA type";
+    return false;
+  }
+  if ((grey && bits != 8) || (!grey && bits != 24 && bits != 32)) {
+    error = "unsupported TGA bit depth";
+    return false;
+  }
+  if (!ValidSize(width, height, error))
+    return false;
+
+  size_t pos = 18 + idLength + ReadLE16(data + 5) * ((data[7] + 7) / 8);
+  const int bpp = bits / 8;
+  out.width = width;
+  out.height = height;
+  out.pixels.resize(out.ByteSize());
+  auto put = [&](uint8_t *dst, const uint8_t *src) {
+    if (grey) {
+      dst[0] = dst[1] = dst[2] = src[0];
+      dst[3] = 255;
+    } else {
+      dst[0] = src[2]; // BGR(A)
+      dst[1] = src[1];
+      dst[2] = src[0];
+      dst[3] = bpp == 4 ? src[3] : 255;
+    }
+  };
+
+  const size_t total = (size_t)width * height;
+  size_t i = 0;
+  while (i < total) {
+    if (!rle) {
+      if (pos + bpp > size)
+        break;
+      put(&out.pixels[i * 4], data + pos);
+      pos += bpp;
+      ++i;
+      continue;
+    }
+    if (pos >= size)
+      break;
+    const uint8_t header = data[pos++];
+    const size_t count = (header & 0x7F) + 1;
+    if (header & 0x80) {
+      if (pos + bpp > size)
+        break;
+      for (size_t k = 0; k < count && i < total; ++k, ++i)
+        put(&out.pixels[i * 4], data + pos);
+      pos += bpp;
+    } else {
+      for (size_t k = 0; k < count && i < total; ++k, ++i) {
+        if (pos + bpp > size)
+          break;
+        put(&out.pixels[i * 4], data + pos);
+        pos += bpp;
+      }
+    }
+  }
+  if (i < total) {
+    error = "truncated TGA data";
+    return false;
+  }
+  // Default TGA origin is bottom-left, which already is GL order
+  if (topDown)
+    FlipRows(out);
+  return true;
+}
+
+// ---------------------------------------------------------------------------
+// BMP
+// ---------------------------------------------------------------------------
+
+bool DecodeBMP(const uint8_t *data, size_t size, Image &out,
+               std::string &error) {
+  if (size < 54 || data[0] != 'B' || data[1] != 'M') {
+    error = "bad BMP header";
+    return false;
+  }
+  const uint32_t offset = ReadLE32(data + 10);
+  const uint32_t headerSize = ReadLE32(data + 14);
+  const int width = (int)ReadLE32(data + 18);
+  const int rawHeight = (int)ReadLE32(data + 22);
+  const int bits = ReadLE16(data + 28);
+  const uint32_t compression = ReadLE32(data + 30);
+  // BI_RGB, or BI_BITFIELDS with the usual BGRA masks for 32 bit
+  if (compression != 0 && !(compression == 3 && bits == 32)) {
+    error = "compressed BMP not supported";
+    return false;
+  }
+  if (bits != 8 && bits != 24 && bits != 32) {
+    error = "unsupported BMP bit depth";
+    return false;
+  }
+  const bool topDown = rawHeight < 0;
+  const int height = topDown ? -rawHeight : rawHeight;
+  if (!ValidSize(width, height, error))
+    return false;
+
+  const size_t stride = (((size_t)width * bits + 31) / 32) * 4;
+  if (offset > size || stride * height > size - offset) {
+    error = "truncated BMP data";
+    return false;
+  }
+  const uint8_t *palette = data + 14 + headerSize;
+
+  out.width = width;
+  out.height = height;
+  out.pixels.resize(out.ByteSize());
+  for (int y = 0; y < height; ++y) {
+    const uint8_t *src = data + offset + stride * y;
+    uint8_t *dst = &out.pixels[(size_t)y * width * 4];
+    for (int x = 0; x < width; ++x, dst += 4) {
+      const uint8_t *p = bits == 8 ? palette + src[x] * 4 : src + x * (bits / 8);
+      if (bits == 8 && p + 4 > data + offset) {
+        error = "bad BMP palette";
+        return false;
+      }
+      dst[0] = p[2];
+      dst[1] = p[1];
+      dst[2] = p[0];
+      dst[3] = bits == 32 ? p[3] : 255;
+    }
+  }
+  // Bottom-up BMP rows already are GL order
+  if (topDown)
+    FlipRows(out);
+  return true;
+}
+
+// ---------------------------------------------------------------------------
+// PPM / PGM (binary)
+// ---------------------------------------------------------------------------
+
+bool DecodePNM(const uint8_t *data, size_t size, Image &out,
+               std::string &error) {
+  const bool grey = data[1] == '5';
+  size_t pos = 2;
+  int values[3];
+  for (int &v : values) {
+    // Whitespace and # comments between header fields
+    for (;;) {
+      while (pos < size && std::isspace(data[pos]))
+        ++pos;
+      if (pos < size && data[pos] == '#') {
+        while (pos < size && data[pos] != '\n')
+          ++pos;
+        continue;
+      }
+      break;
+    }
+    v = 0;
+    if (pos >= size || !std::isdigit(data[pos])) {
+      error = "bad PNM header";
+      return false;
+    }
+    while (pos < size && std::isdigit(data[pos]) && v < 1000000)
+      v = v * 10 + (data[pos++] - '0');
+  }
+  ++pos; // single whitespace before the raster
+  const int width = values[0], height = values[1], maxval = values[2];
+  if (maxval <= 0 || maxval > 255) {
+    error = "16-bit PNM not supported";
+    return false;
+  }
+  if (!ValidSize(width, height, error))
+    return false;
+  const int channels = grey ? 1 : 3;
+  if (pos > size || (size_t)width * height * channels > size - pos) {
+    error = "truncated PNM data";
+    return false;
+  }
+
+  out.width = width;
+  out.height = height;
+  out.pixels.resize(out.ByteSize());
+  const uint8_t *src = data + pos;
+  for (size_t i = 0; i < (size_t)width * height; ++i, src += channels) {
+    uint8_t *dst = &out.pixels[i * 4];
+    for (int k = 0; k < 3; ++k)
+      dst[k] = (uint8_t)(src[grey ? 0 : k] * 255 / maxval);
+    dst[3] = 255;
+  }
+  FlipRows(out);
+  return true;
+}
+
+// ---------------------------------------------------------------------------
+// Mips
+// ---------------------------------------------------------------------------
+
+void Downsample(const Image &src, Image &dst) {
+  dst.width = std::max(1, src.width / 2);
+  dst.height = std::max(1, src.height / 2);
+  dst.pixels.resize(dst.ByteSize());
+  const size_t srcStride = (size_t)src.width * 4;
+  // Column/row pairs; a 1-wide (or 1-high) source reuses its only one
+  const size_t dx = src.width > 1 ? 4 : 0;
+
+  for (int y = 0; y < dst.height; ++y) {
+    const uint8_t *r0 = &src.pixels[(size_t)(2 * y) * srcStride];
+    const uint8_t *r1 = src.height > 1 ? r0 + srcStride : r0;
+    uint8_t *out = &dst.pixels[(size_t)y * dst.width * 4];
+    int x = 0;
+#ifdef IMAGE_SSE2
+    if (dx) {
+      // 4 output pixels per iteration from 8 source pixels of each row
+      const __m128i zero = _mm_setzero_si128();
+      const __m128i bias = _mm_set1_epi16(2);
+      for (; x + 4 <= dst.width; x += 4) {
+        __m128i half[2];
+        for (int k = 0; k < 2; ++k) {
+          const __m128i a = _mm_loadu_si128((const __m128i *)(r0 + x * 8 + k * 16));
+          const __m128i b = _mm_loadu_si128((const __m128i *)(r1 + x * 8 + k * 16));
+          // Vertical sums, 16 bits per channel: [p0 p1] and [p2 p3]
+          const __m128i lo = _mm_add_epi16(_mm_unpacklo_epi8(a, zero),
+                                           _mm_unpacklo_epi8(b, zero));
+          const __m128i hi = _mm_add_epi16(_mm_unpackhi_epi8(a, zero),
+                                           _mm_unpackhi_epi8(b, zero));
+          // Horizontal pair sums land in the low 64 bits
+          const __m128i s01 = _mm_add_epi16(lo, _mm_srli_si128(lo, 8));
+          const __m128i s23 = _mm_add_epi16(hi, _mm_srli_si128(hi, 8));
+          half[k] = _mm_srli_epi16(
+              _mm_add_epi16(_mm_unpacklo_epi64(s01, s23), bias), 2);
+        }
+        _mm_storeu_si128((__m128i *)(out + x * 4),
+                         _mm_packus_epi16(half[0], half[1]));
+      }
+    }
+#endif
+    for (; x < dst.width; ++x) {
+      const uint8_t *a = r0 + (size_t)x * 2 * 4;
+      const uint8_t *b = r1 + (size_t)x * 2 * 4;
+      for (int c = 0; c < 4; ++c)
+        out[x * 4 + c] =
+            (uint8_t)((a[c] + a[dx + c] + b[c] + b[dx + c] + 2) >> 2);
+    }
+  }
+}
+
+} // namespace
+
+namespace ImageLoader {
+
+bool Decode(const uint8_t *data, size_t size, Image &out, std::string &error) {
+  static const uint8_t PNG_SIGNATURE[8] = {0x89, 'P',  'N',  'G',
+                                           '\r', '\n', 0x1A, '\n'};
+  if (size >= 8 && !std::memcmp(data, PNG_SIGNATURE, 8))
+    return DecodePNG(data, size, out, error);
+  if (size >= 2 && data[0] == 'B' && data[1] == 'M')
+    return DecodeBMP(data, size, out, error);
+  if (size >= 3 && data[0] == 'P' && (data[1] == '5' || data[1] == '6'))
+    return DecodePNM(data, size, out, error);
+  if (size >= 2 && data[0] == 0xFF && data[1] == 0xD8) {
+    error = "JPEG not supported";
+    return false;
+  }
+  // TGA has no signature: last resort
+  return DecodeTGA(data, size, out, error);
+}
+
+bool Load(const std::string &path, Image &out, std::string &error) {
+  std::ifstream file(path, std::ios::binary | std::ios::ate);
+  if (!file) {
+    error = "cannot open file";
+    return false;
+  }
+  std::vector<uint8_t> bytes((size_t)file.tellg());
+  file.seekg(0);
+  if (!file.read((char *)bytes.data(), bytes.size())) {
+    error = "read error";
+    return false;
+  }
+  return Decode(bytes.data(), bytes.size(), out, error);
+}
+
+bool IsSupportedExtension(const std::string &path) {
+  size_t dot = path.find_last_of('.');
+  if (dot == std::string::npos)
+    return false;
+  std::string ext = path.substr(dot + 1);
+  for (char &c : ext)
+    c = (char)std::tolower((unsigned char)c);
+  return ext == "png" || ext == "tga" || ext == "bmp" || ext == "ppm" ||
+         ext == "pgm";
+}
+
+void BuildMipChain(std::vector<Image> &mips) {
+  if (mips.empty())
+    return;
+  mips.resize(1);
+  while (mips.back().width > 1 || mips.back().height > 1) {
+    Image next;
+    Downsample(mips.back(), next);
+    mips.push_back(std::move(next));
+  }
+}
+
+} // namespace ImageLoader
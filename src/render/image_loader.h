@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Imagen RGBA8 en memoria
+// Rows are stored bottom-to-top (OpenGL's order), 4 bytes per pixel.
+struct Image {
+  int width = 0;
+  int height = 0;
+  std::vector<uint8_t> pixels;
+
+  size_t ByteSize() const { return (size_t)width * height * 4; }
+};
+
+// In-house decoders for the formats the content browser classifies as
+// textures. No external image library is linked, so the coverage is:
+// - PNG: 8/16-bit grey, grey+alpha, RGB, RGBA; 1/2/4/8-bit palette (+tRNS).
+//   Interlaced (Adam7) files are rejected.
+// - TGA: true-colour and grey, raw or RLE, 8/24/32 bit.
+// - BMP: uncompressed 8 (palette), 24 and 32 bit.
+// - PPM/PGM: binary P6/P5, maxval <= 255.
+// JPEG is not supported. Safe to call from worker threads.
+namespace ImageLoader {
+
+bool Decode(const uint8_t *data, size_t size, Image &out, std::string &error);
+bool Load(const std::string &path, Image &out, std::string &error);
+
+// Extension check only ("png", "tga", "bmp", "ppm", "pgm")
+bool IsSupportedExtension(const std::string &path);
+
+// mips[0] is the base level; appends 2x2 box-filtered levels down to 1x1.
+// Odd sizes drop the last row/column (floor), as glGenerateMipmap does.
+// SSE2 when available.
+void BuildMipChain(std::vector<Image> &mips);
+
+} // namespace ImageLoader
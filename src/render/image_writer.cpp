@@ -0,0 +1,365 @@
+#include "image_writer.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+
+namespace {
+
+// --- Checksums ---
+
+uint32_t Crc32(const uint8_t *data, size_t size, uint32_t crc = 0) {
+  static uint32_t table[256];
+  static const bool init = [] {
+    for (uint32_t n = 0; n < 256; ++n) {
+      uint32_t c = n;
+      for (int k = 0; k < 8; ++k)
+        c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+      table[n] = c;
+    }
+    return true;
+  }();
+  (void)init;
+  crc = ~crc;
+  for (size_t i = 0; i < size; ++i)
+    crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+  return ~crc;
+}
+
+uint32_t Adler32(const uint8_t *data, size_t size) {
+  uint32_t a = 1, b = 0;
+  while (size > 0) {
+    // Largest block before the sums can overflow 32 bits
+    const size_t block = std::min<size_t>(size, 5552);
+    for (size_t i = 0; i < block; ++i) {
+      a += data[i];
+      b += a;
+    }
+    a %= 65521;
+    b %= 65521;
+    data += block;
+    size -= block;
+  }
+  return (b << 16) | a;
+}
+
+// --- Deflate (fixed Huffman codes) ---
+
+class BitWriter {
+public:
+  explicit BitWriter(std::vector<uint8_t> &out) : m_Out(out) {}
+
+  // LSB first, as deflate packs everything but Huffman codes
+  void Bits(uint32_t value, int count) {
+    m_Buffer |= (uint64_t)value << m_Count;
+    m_Count += count;
+    while (m_Count >= 8) {
+      m_Out.push_back((uint8_t)m_Buffer);
+      m_Buffer >>= 8;
+      m_Count -= 8;
+    }
+  }
+  // Huffman codes go MSB first
+  void Code(uint32_t code, int length) {
+    uint32_t reversed = 0;
+    for (int i = 0; i < length; ++i)
+      reversed |= ((code >> i) & 1) << (length - 1 - i);
+    Bits(reversed, length);
+  }
+  void Flush() {
+    if (m_Count > 0)
+      Bits(0, 8 - m_Count);
+  }
+
+private:
+  std::vector<uint8_t> &m_Out;
+  uint64_t m_Buffer = 0;
+  int m_Count = 0;
+};
+
+const uint16_t LENGTH_BASE[29] = {3,  4,  5,  6,  7,  8,  9,  10,  11, 13,
+                                  15, 17, 19, 23, 27, 31, 35, 43,  51, 59,
+                                  67, 83, 99, 115, 131, 163, 195, 227, 258};
+const uint8_t LENGTH_EXTRA[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1,
+                                  1, 1, 2, 2, 2, 2, 3, 3, 3, 3,
+                                  4, 4, 4, 4, 5, 5, 5, 5, 0};
+const uint16_t DIST_BASE[30] = {
+    1,    2,    3,    4,    5,    7,     9,     13,    17,  25,
+    33,   49,   65,   97,   129,  193,   257,   385,   513, 769,
+    1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+const uint8_t DIST_EXTRA[30] = {0, 0, 0, 0, 1, 1, 2,  2,  3,  3,
+                                4, 4, 5, 5, 6, 6, 7,  7,  8,  8,
+                                9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+void PutLiteral(BitWriter &bits, int symbol) {
+  if (symbol < 144)
+    bits.Code(0x30 + symbol, 8);
+  else if (symbol < 256)
+    bits.Code(0x190 + symbol - 144, 9);
+  else if (symbol < 280)
+    bits.Code(symbol - 256, 7);
+  else
+    bits.Code(0xC0 + symbol - 280, 8);
+}
+
+void PutMatch(BitWriter &bits, int length, int distance) {
+  int l = 28;
+  while (LENGTH_BASE[l] > length)
+    l--;
+  PutLiteral(bits, 257 + l);
+  bits.Bits(length - LENGTH_BASE[l], LENGTH_EXTRA[l]);
+  int d = 29;
+  while (DIST_BASE[d] > distance)
+    d--;
+  bits.Code(d, 5);
+  bits.Bits(distance - DIST_BASE[d], DIST_EXTRA[d]);
+}
+
+// zlib stream of `data`: a single fixed-Huffman block, matches found
+// through 3-byte hash chains walked at most MAX_CHAIN steps
+void Deflate(const uint8_t *data, size_t size, std::vector<uint8_t> &out) {
+  const int WINDOW = 32768, MIN_MATCH = 3, MAX_MATCH = 258, MAX_CHAIN = 16;
+  const int HASH_BITS = 15;
+
+  out.push_back(0x78); // deflate, 32K window
+  out.push_back(0x01); // fastest level, check bits
+  BitWriter bits(out);
+  bits.Bits(1, 1); // final block
+  bits.Bits(1, 2); // fixed Huffman
+
+  std::vector<int32_t> head(1 << HASH_BITS, -1);
+  std::vector<int32_t> prev(WINDOW, -1);
+  auto hash = [&](size_t i) {
+    const uint32_t v = data[i] | (data[i + 1] << 8) | (data[i + 2] << 16);
+    return (v * 2654435761u) >> (32 - HASH_BITS);
+  };
+  auto insert = [&](size_t i) {
+    const uint32_t h = hash(i);
+    prev[i % WINDOW] = head[h];
+    head[h] = (int32_t)i;
+  };
+
+  size_t i = 0;
+  while (i < size) {
+    int bestLength = 0, bestDistance = 0;
+    if (i + MIN_MATCH <= size) {
+      const size_t limit = std::min<size_t>(MAX_MATCH, size - i);
+      int32_t candidate = head[hash(i)];
+      for (int chain = 0; chain < MAX_CHAIN && candidate >= 0; ++chain) {
+        const size_t distance = i - (size_t)candidate;
+        if (distance > (size_t)WINDOW - 1)
+          break;
+        const uint8_t *a = data + candidate, *b = data + i;
+        size_t length = 0;
+        while (length < limit && a[length] == b[length])
+          length++;
+        if ((int)length > bestLength) {
+          bestLength = (int)length;
+          bestDistance = (int)distance;
+          if (length == limit)
+            break;
+        }
+        const int32_t next = prev[candidate % WINDOW];
+        if (next >= candidate)
+          break; // slot reused by a newer position
+        candidate = next;
+      }
+      insert(i);
+    }
+    if (bestLength >= MIN_MATCH) {
+      PutMatch(bits, bestLength, bestDistance);
+      for (size_t k = i + 1; k < i + bestLength; ++k)
+        if (k + MIN_MATCH <= size)
+          insert(k);
+      i += bestLength;
+    } else {
+      PutLiteral(bits, data[i]);
+      i++;
+    }
+  }
+  PutLiteral(bits, 256);
+  bits.Flush();
+
+  const uint32_t adler = Adler32(data, size);
+  for (int shift = 24; shift >= 0; shift -= 8)
+    out.push_back((uint8_t)(adler >> shift));
+}
+
+// --- PNG ---
+
+void PutU32(std::vector<uint8_t> &out, uint32_t v) {
+  for (int shift = 24; shift >= 0; shift -= 8)
+    out.push_back((uint8_t)(v >> shift));
+}
+
+void PutChunk(std::vector<uint8_t> &out, const char type[4],
+              const uint8_t *data, size_t size) {
+  PutU32(out, (uint32_t)size);
+  const size_t start = out.size();
+  out.insert(out.end(), type, type + 4);
+  out.insert(out.end(), data, data + size);
+  PutU32(out, Crc32(out.data() + start, size + 4));
+}
+
+uint8_t Paeth(int a, int b, int c) {
+  const int p = a + b - c;
+  const int pa = std::abs(p - a), pb = std::abs(p - b), pc = std::abs(p - c);
+  if (pa <= pb && pa <= pc)
+    return (uint8_t)a;
+  return (uint8_t)(pb <= pc ? b : c);
+}
+
+void EncodePng(const Image &image, std::vector<uint8_t> &out) {
+  const int w = image.width, h = image.height;
+  const size_t stride = (size_t)w * 3;
+
+  // Filtered scanlines, top to bottom. Each row takes the filter with the
+  // smallest sum of absolute (signed) residuals, the usual heuristic.
+  std::vector<uint8_t> raw((stride + 1) * h);
+  std::vector<uint8_t> row(stride), above(stride, 0), candidate[4];
+  for (auto &c : candidate)
+    c.resize(stride);
+  for (int y = 0; y < h; ++y) {
+    const uint8_t *src = image.pixels.data() + (size_t)(h - 1 - y) * w * 4;
+    for (int x = 0; x < w; ++x)
+      std::memcpy(&row[x * 3], src + x * 4, 3);
+
+    int bestFilter = 0;
+    uint64_t bestCost = UINT64_MAX;
+    for (int f = 0; f < 4; ++f) {
+      uint64_t cost = 0;
+      for (size_t i = 0; i < stride; ++i) {
+        const int left = i >= 3 ? row[i - 3] : 0;
+        const int up = above[i];
+        const int upLeft = i >= 3 ? above[i - 3] : 0;
+        uint8_t predicted = 0;
+        switch (f) {
+        case 1: predicted = (uint8_t)left; break;
+        case 2: predicted = (uint8_t)up; break;
+        case 3: predicted = Paeth(left, up, upLeft); break;
+        }
+        const uint8_t v = (uint8_t)(row[i] - predicted);
+        candidate[f][i] = v;
+        cost += v < 128 ? v : 256 - v;
+      }
+      if (cost < bestCost) {
+        bestCost = cost;
+        bestFilter = f;
+      }
+    }
+    // PNG filter types: 0 none, 1 sub, 2 up, 4 paeth
+    uint8_t *dst = raw.data() + (size_t)y * (stride + 1);
+    dst[0] = (uint8_t)(bestFilter == 3 ? 4 : bestFilter);
+    std::memcpy(dst + 1, candidate[bestFilter].data(), stride);
+    above.swap(row);
+  }
+
+  static const uint8_t SIGNATURE[8] = {0x89, 'P',  'N',  'G',
+                                       0x0D, 0x0A, 0x1A, 0x0A};
+  out.insert(out.end(), SIGNATURE, SIGNATURE + 8);
+
+  uint8_t header[13];
+  for (int k = 0; k < 4; ++k) {
+    header[k] = (uint8_t)(w >> (24 - 8 * k));
+    header[4 + k] = (uint8_t)(h >> (24 - 8 * k));
+  }
+  header[8] = 8;  // bit depth
+  header[9] = 2;  // RGB
+  header[10] = 0; // deflate
+  header[11] = 0; // adaptive filtering
+  header[12] = 0; // no interlace
+  PutChunk(out, "IHDR", header, sizeof(header));
+
+  std::vector<uint8_t> compressed;
+  compressed.reserve(raw.size() / 2);
+  Deflate(raw.data(), raw.size(), compressed);
+  PutChunk(out, "IDAT", compressed.data(), compressed.size());
+  PutChunk(out, "IEND", nullptr, 0);
+}
+
+} // namespace
+
+namespace ImageWriter {
+
+bool Encode(const Image &image, Format format, std::vector<uint8_t> &out) {
+  if (image.width <= 0 || image.height <= 0 ||
+      image.pixels.size() < image.ByteSize())
+    return false;
+  out.clear();
+  const size_t rowBytes = (size_t)image.width * 4;
+  switch (format) {
+  case Format::Png:
+    EncodePng(image, out);
+    break;
+  case Format::Ppm: {
+    const std::string header = "P6\n" + std::to_string(image.width) + " " +
+                               std::to_string(image.height) + "\n255\n";
+    out.reserve(header.size() + (size_t)image.width * image.height * 3);
+    out.insert(out.end(), header.begin(), header.end());
+    for (int y = image.height - 1; y >= 0; --y) {
+      const uint8_t *src = image.pixels.data() + y * rowBytes;
+      for (int x = 0; x < image.width; ++x)
+        out.insert(out.end(), src + x * 4, src + x * 4 + 3);
+    }
+    break;
+  }
+  case Format::Raw:
+    out.reserve(image.ByteSize());
+    for (int y = image.height - 1; y >= 0; --y) {
+      const uint8_t *src = image.pixels.data() + y * rowBytes;
+      out.insert(out.end(), src, src + rowBytes);
+    }
+    break;
+  }
+  return true;
+}
+
+bool Write(const std::string &path, const Image &image, Format format,
+           std::string &error) {
+  std::vector<uint8_t> bytes;
+  if (!Encode(image, format, bytes)) {
+    error = "empty image";
+    return false;
+  }
+  std::ofstream file(path, std::ios::binary);
+  if (!file) {
+    error = "cannot open " + path;
+    return false;
+  }
+  file.write((const char *)bytes.data(), (std::streamsize)bytes.size());
+  if (!file) {
+    error = "write failed: " + path;
+    return false;
+  }
+  return true;
+}
+
+bool FormatFromPath(const std::string &path, Format &format) {
+  const size_t dot = path.find_last_of('.');
+  if (dot == std::string::npos)
+    return false;
+  std::string ext = path.substr(dot + 1);
+  std::transform(ext.begin(), ext.end(), ext.begin(),
+                 [](unsigned char c) { return (char)std::tolower(c); });
+  if (ext == "png")
+    format = Format::Png;
+  else if (ext == "ppm")
+    format = Format::Ppm;
+  else if (ext == "raw")
+    format = Format::Raw;
+  else
+    return false;
+  return true;
+}
+
+const char *Extension(Format format) {
+  switch (format) {
+  case Format::Png: return "png";
+  case Format::Ppm: return "ppm";
+  case Format::Raw: return "raw";
+  }
+  return "";
+}
+
+} // namespace ImageWriter
@@ -0,0 +1,28 @@
+#pragma once
+
+#include "image_loader.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// In-house encoders for captured frames (the counterpart of ImageLoader, no
+// external image library is linked). Input is an Image (RGBA8, rows
+// bottom-to-top); files are written top-to-bottom:
+// - PNG: 8-bit RGB, per-row adaptive filter, deflate with fixed Huffman
+//   codes and a short hash-chain match search (fast rather than small).
+// - PPM: binary P6.
+// - Raw: the RGBA8 pixels with no header.
+// Safe to call from worker threads.
+namespace ImageWriter {
+
+enum class Format { Png, Ppm, Raw };
+
+bool Encode(const Image &image, Format format, std::vector<uint8_t> &out);
+bool Write(const std::string &path, const Image &image, Format format,
+           std::string &error);
+
+// From the extension ("png", "ppm", "raw"); false if unknown
+bool FormatFromPath(const std::string &path, Format &format);
+const char *Extension(Format format);
+
+} // namespace ImageWriter
@@ -0,0 +1,160 @@
+#include "indirect_draw.h"
+#include "gl_state_cache.h"
+#include <cstddef>
+
+IndirectDrawList::~IndirectDrawList() {
+  GLStateCache &gl = GLStateCache::Get();
+  if (m_VAO)
+    gl.DeleteVertexArray(m_VAO);
+  if (m_InstanceVBO)
+    gl.DeleteBuffer(m_InstanceVBO);
+  if (m_IndirectBuffer)
+    gl.DeleteBuffer(m_IndirectBuffer);
+}
+
+void IndirectDrawList::Init(const MeshLibrary &meshes) {
+  // baseInstance in the command is only honoured with GL 4.2+/ARB_base_instance
+  // (the path in use is shown in the Stats panel)
+  m_UseMDI = GLAD_GL_VERSION_4_3 ||
+             (GLAD_GL_ARB_multi_draw_indirect && GLAD_GL_ARB_base_instance);
+
+  glGenVertexArrays(1, &m_VAO);
+  glGenBuffers(1, &m_InstanceVBO);
+  if (m_UseMDI)
+    glGenBuffers(1, &m_IndirectBuffer);
+
+  GLStateCache &gl = GLStateCache::Get();
+  gl.BindVertexArray(m_VAO);
+
+  gl.BindBuffer(GL_ARRAY_BUFFER, meshes.GetVertexBuffer());
+  glEnableVertexAttribArray(ATTRIB_POSITION);
+  glVertexAttribPointer(ATTRIB_POSITION, 3, GL_FLOAT, GL_FALSE,
+                        sizeof(MeshVertex),
+                        (void *)offsetof(MeshVertex, pos));
+  glEnableVertexAttribArray(ATTRIB_NORMAL);
+  glVertexAttribPointer(ATTRIB_NORMAL, 3, GL_FLOAT, GL_FALSE,
+                        sizeof(MeshVertex),
+                        (void *)offsetof(MeshVertex, normal));
+  glEnableVertexAttribArray(ATTRIB_TEXCOORD);
+  glVertexAttribPointer(ATTRIB_TEXCOORD, 2, GL_FLOAT, GL_FALSE,
+                        sizeof(MeshVertex), (void *)offsetof(MeshVertex, uv));
+  gl.BindBuffer(GL_ELEMENT_ARRAY_BUFFER, meshes.GetIndexBuffer());
+
+  gl.BindBuffer(GL_ARRAY_BUFFER, m_InstanceVBO);
+  for (int i = 0; i < 4; ++i) {
+    glEnableVertexAttribArray(ATTRIB_MODEL + i);
+    glVertexAttribDivisor(ATTRIB_MODEL + i, 1);
+  }
+  glEnableVertexAttribArray(ATTRIB_COLOR);
+  glVertexAttribDivisor(ATTRIB_COLOR, 1);
+  glEnableVertexAttribArray(ATTRIB_TEXRECT);
+  glVertexAttribDivisor(ATTRIB_TEXRECT, 1);
+  glEnableVertexAttribArray(ATTRIB_TEXLAYER);
+  glVertexAttribDivisor(ATTRIB_TEXLAYER, 1);
+  glEnableVertexAttribArray(ATTRIB_SURFACE);
+  glVertexAttribDivisor(ATTRIB_SURFACE, 1);
+  SetInstanceAttribOffset(0);
+
+  gl.BindVertexArray(0);
+  gl.BindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void IndirectDrawList::SetInstanceAttribOffset(size_t byteOffset) {
+  const GLsizei stride = sizeof(InstanceData);
+  for (int i = 0; i < 4; ++i) {
+    glVertexAttribPointer(
+        ATTRIB_MODEL + i, 4, GL_FLOAT, GL_FALSE, stride,
+        (void *)(byteOffset + offsetof(InstanceData, model) +
+                 i * 4 * sizeof(float)));
+  }
+  glVertexAttribPointer(
+      ATTRIB_COLOR, 4, GL_FLOAT, GL_FALSE, stride,
+      (void *)(byteOffset + offsetof(InstanceData, color)));
+  glVertexAttribPointer(
+      ATTRIB_TEXRECT, 4, GL_FLOAT, GL_FALSE, stride,
+      (void *)(byteOffset + offsetof(InstanceData, texRect)));
+  glVertexAttribPointer(
+      ATTRIB_TEXLAYER, 1, GL_FLOAT, GL_FALSE, stride,
+      (void *)(byteOffset + offsetof(InstanceData, texLayer)));
+  glVertexAttribPointer(
+      ATTRIB_SURFACE, 2, GL_FLOAT, GL_FALSE, stride,
+      (void *)(byteOffset + offsetof(InstanceData, surface)));
+}
+
+void IndirectDrawList::Build(const std::vector<DrawItem> &items,
+                             const MeshLibrary &meshes) {
+  const uint32_t meshCount = meshes.GetMeshCount();
+
+  // 1. Histograma por malla
+  m_MeshCounts.assign(meshCount, 0);
+  for (const auto &item : items)
+    m_MeshCounts[item.mesh]++;
+
+  // 2. One command per used mesh; baseInstance is the prefix sum. The
+  // histogram is turned into per-mesh write cursors in the same pass.
+  m_Commands.clear();
+  uint32_t running = 0;
+  for (uint32_t mesh = 0; mesh < meshCount; ++mesh) {
+    uint32_t count = m_MeshCounts[mesh];
+    m_MeshCounts[mesh] = running;
+    if (count == 0)
+      continue;
+    const MeshRange &range = meshes.GetRange(mesh);
+    DrawElementsIndirectCommand cmd;
+    cmd.count = range.indexCount;
+    cmd.instanceCount = count;
+    cmd.firstIndex = range.firstIndex;
+    cmd.baseVertex = range.baseVertex;
+    cmd.baseInstance = running;
+    m_Commands.push_back(cmd);
+    running += count;
+  }
+
+  // 3. Scatter instances so each mesh's instances are contiguous
+  m_Instances.resize(items.size());
+  for (const auto &item : items)
+    m_Instances[m_MeshCounts[item.mesh]++] = item.instance;
+}
+
+void IndirectDrawList::Submit() {
+  m_LastDrawCalls = 0;
+  if (m_Commands.empty())
+    return;
+
+  GLStateCache &gl = GLStateCache::Get();
+  gl.BindVertexArray(m_VAO);
+
+  // Instance data: orphan and refill (grows geometrically)
+  gl.BindBuffer(GL_ARRAY_BUFFER, m_InstanceVBO);
+  size_t instanceBytes = m_Instances.size() * sizeof(InstanceData);
+  if (m_Instances.size() > m_InstanceCapacity) {
+    m_InstanceCapacity = m_Instances.size() + m_Instances.size() / 2;
+  }
+  glBufferData(GL_ARRAY_BUFFER, m_InstanceCapacity * sizeof(InstanceData),
+               nullptr, GL_STREAM_DRAW);
+  glBufferSubData(GL_ARRAY_BUFFER, 0, instanceBytes, m_Instances.data());
+
+  if (m_UseMDI) {
+    gl.BindBuffer(GL_DRAW_INDIRECT_BUFFER, m_IndirectBuffer);
+    if (m_Commands.size() > m_CommandCapacity)
+      m_CommandCapacity = m_Commands.size() + m_Commands.size() / 2;
+    glBufferData(GL_DRAW_INDIRECT_BUFFER,
+                 m_CommandCapacity * sizeof(DrawElementsIndirectCommand),
+                 nullptr, GL_STREAM_DRAW);
+    glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0,
+                    m_Commands.size() * sizeof(DrawElementsIndirectCommand),
+                    m_Commands.data());
+    glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, nullptr,
+                                (GLsizei)m_Commands.size(), 0);
+    m_LastDrawCalls = 1;
+  } else {
+    for (const auto &cmd : m_Commands) {
+      SetInstanceAttribOffset(cmd.baseInstance * sizeof(InstanceData));
+      glDrawElementsInstancedBaseVertex(
+          GL_TRIANGLES, cmd.count, GL_UNSIGNED_INT,
+          (void *)(cmd.firstIndex * sizeof(uint32_t)), cmd.instanceCount,
+          cmd.baseVertex);
+      m_LastDrawCalls++;
+    }
+  }
+}
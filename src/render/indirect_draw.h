@@ -0,0 +1,92 @@
+#pragma once
+
+#include "mesh_library.h"
+#include <glad/glad.h>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Layout fijo definido por GL_ARB_draw_indirect / GL 4.3
+struct DrawElementsIndirectCommand {
+  GLuint count;
+  GLuint instanceCount;
+  GLuint firstIndex;
+  GLint baseVertex;
+  GLuint baseInstance;
+};
+
+// Per-instance vertex data (attribute locations 2..6 and 8..10 of the scene
+// shader)
+struct InstanceData {
+  float model[16]; // column-major
+  float color[4];
+  // Diffuse texture inside the bound array: uv offset/scale and layer
+  float texRect[4];
+  float texLayer;
+  float surface[2]; // metallic, roughness (LIGHTING permutation)
+};
+
+// One visible object: which mesh to draw and its instance data
+struct DrawItem {
+  uint32_t mesh;
+  InstanceData instance;
+};
+
+// Scene shader attribute locations
+enum InstanceAttrib {
+  ATTRIB_POSITION = 0,
+  ATTRIB_NORMAL = 1,
+  ATTRIB_MODEL = 2, // mat4 -> 2, 3, 4, 5
+  ATTRIB_COLOR = 6,
+  ATTRIB_TEXCOORD = 7,
+  ATTRIB_TEXRECT = 8,
+  ATTRIB_TEXLAYER = 9,
+  ATTRIB_SURFACE = 10
+};
+
+// Groups visible objects by mesh into DrawElementsIndirectCommand arrays and
+// submits them with a constant number of GL calls per frame.
+// - GL 4.3 / ARB_multi_draw_indirect: one glMultiDrawElementsIndirect.
+// - GL 3.3: one glDrawElementsInstancedBaseVertex per mesh, re-pointing the
+//   instance attributes since baseInstance is not available.
+class IndirectDrawList {
+public:
+  IndirectDrawList() = default;
+  ~IndirectDrawList();
+
+  IndirectDrawList(const IndirectDrawList &) = delete;
+  IndirectDrawList &operator=(const IndirectDrawList &) = delete;
+
+  // Requiere contexto GL activo y la libreria ya subida
+  void Init(const MeshLibrary &meshes);
+
+  // Counting sort by mesh id; O(items + meshes).
+  void Build(const std::vector<DrawItem> &items, const MeshLibrary &meshes);
+
+  // Draws everything built by the last Build call. The caller binds the
+  // program and sets per-frame uniforms.
+  void Submit();
+
+  bool HasMultiDrawIndirect() const { return m_UseMDI; }
+  const std::vector<DrawElementsIndirectCommand> &GetCommands() const {
+    return m_Commands;
+  }
+  uint32_t GetInstanceCount() const { return (uint32_t)m_Instances.size(); }
+  // Draw calls issued by the last Submit
+  int GetLastDrawCalls() const { return m_LastDrawCalls; }
+
+private:
+  void SetInstanceAttribOffset(size_t byteOffset);
+
+  std::vector<DrawElementsIndirectCommand> m_Commands;
+  std::vector<InstanceData> m_Instances;
+  std::vector<uint32_t> m_MeshCounts;
+
+  GLuint m_VAO = 0;
+  GLuint m_InstanceVBO = 0;
+  GLuint m_IndirectBuffer = 0;
+  size_t m_InstanceCapacity = 0;
+  size_t m_CommandCapacity = 0;
+  bool m_UseMDI = false;
+  int m_LastDrawCalls = 0;
+};
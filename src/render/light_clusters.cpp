@@ -0,0 +1,287 @@
+#include "light_clusters.h"
+#include "../core/job_system.h"
+#include "gl_state_cache.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <emmintrin.h>
+#define LIGHT_SSE2 1
+#endif
+
+static const int TILE_COUNT = LightClusters::TILES_X * LightClusters::TILES_Y;
+static_assert(TILE_COUNT % 4 == 0, "tiles are tested four at a time");
+
+LightClusters::~LightClusters() {
+  GLStateCache &gl = GLStateCache::Get();
+  for (int i = 0; i < 3; ++i) {
+    gl.DeleteTexture(m_Textures[i]);
+    gl.DeleteBuffer(m_Buffers[i]);
+  }
+}
+
+void LightClusters::Init() {
+  static const GLenum formats[3] = {GL_RGBA32F, GL_RG32UI, GL_R16UI};
+  glGenBuffers(3, m_Buffers);
+  glGenTextures(3, m_Textures);
+  GLStateCache &gl = GLStateCache::Get();
+  for (int i = 0; i < 3; ++i) {
+    // Never empty: a buffer texture without storage is incomplete
+    const uint32_t zero[4] = {0, 0, 0, 0};
+    gl.BindBuffer(GL_TEXTURE_BUFFER, m_Buffers[i]);
+    glBufferData(GL_TEXTURE_BUFFER, sizeof(zero), zero, GL_STREAM_DRAW);
+    gl.BindTexture(0, GL_TEXTURE_BUFFER, m_Textures[i]);
+    glTexBuffer(GL_TEXTURE_BUFFER, formats[i], m_Buffers[i]);
+  }
+  gl.BindBuffer(GL_TEXTURE_BUFFER, 0);
+  m_Lists.resize(CLUSTER_COUNT);
+  m_Grid.assign(CLUSTER_COUNT * 2, 0);
+}
+
+void LightClusters::BuildClusterBounds(float p00, float p11, float zNear,
+                                       float zFar, bool ortho) {
+  m_Bounds.resize(SLICES);
+  for (int s = 0; s < SLICES; ++s) {
+    SliceBounds &b = m_Bounds[s];
+    // Exponential slices in perspective, linear when orthographic (depth
+    // precision is uniform there)
+    const float d0 =
+        ortho ? zNear + (zFar - zNear) * s / SLICES
+              : zNear * std::pow(zFar / zNear, (float)s / SLICES);
+    const float d1 =
+        ortho ? zNear + (zFar - zNear) * (s + 1) / SLICES
+              : zNear * std::pow(zFar / zNear, (float)(s + 1) / SLICES);
+    b.minZ = -d1;
+    b.maxZ = -d0;
+    for (int ty = 0; ty < TILES_Y; ++ty) {
+      for (int tx = 0; tx < TILES_X; ++tx) {
+        const int t = ty * TILES_X + tx;
+        // A view-space point at depth d projects to ndc.x = x * p00 / d
+        // (x * p00 when orthographic: the tiles are boxes)
+        const float x0 = -1.0f + 2.0f * tx / TILES_X;
+        const float x1 = -1.0f + 2.0f * (tx + 1) / TILES_X;
+        const float y0 = -1.0f + 2.0f * ty / TILES_Y;
+        const float y1 = -1.0f + 2.0f * (ty + 1) / TILES_Y;
+        if (ortho) {
+          b.minX[t] = x0 / p00;
+          b.maxX[t] = x1 / p00;
+          b.minY[t] = y0 / p11;
+          b.maxY[t] = y1 / p11;
+          continue;
+        }
+        b.minX[t] = std::min(x0 * d0, x0 * d1) / p00;
+        b.maxX[t] = std::max(x1 * d0, x1 * d1) / p00;
+        b.minY[t] = std::min(y0 * d0, y0 * d1) / p11;
+        b.maxY[t] = std::max(y1 * d0, y1 * d1) / p11;
+      }
+    }
+  }
+}
+
+void LightClusters::Update(const std::vector<ClusterLight> &lights,
+                           const Mat4 &view, const Mat4 &proj,
+                           const int viewport[4], JobSystem *jobs) {
+  auto start = std::chrono::high_resolution_clock::now();
+  m_Viewport[0] = viewport[0];
+  m_Viewport[1] = viewport[1];
+  m_Viewport[2] = std::max(viewport[2], 1);
+  m_Viewport[3] = std::max(viewport[3], 1);
+
+  // 1. Cluster bounds depend only on the projection
+  const float p00 = proj.m[0], p11 = proj.m[5];
+  m_Ortho = proj.m[15] == 1.0f;
+  if (m_Ortho) {
+    m_Near = (proj.m[14] + 1.0f) / proj.m[10];
+    m_Far = (proj.m[14] - 1.0f) / proj.m[10];
+  } else {
+    m_Near = proj.m[14] / (proj.m[10] - 1.0f);
+    m_Far = proj.m[14] / (proj.m[10] + 1.0f);
+  }
+  const float key[5] = {p00, p11, m_Near, m_Far, m_Ortho ? 1.0f : 0.0f};
+  if (m_Bounds.empty() || !std::equal(key, key + 5, m_BoundsKey)) {
+    std::copy(key, key + 5, m_BoundsKey);
+    BuildClusterBounds(p00, p11, m_Near, m_Far, m_Ortho);
+  }
+  if (m_Ortho) {
+    m_SliceScale = SLICES / (m_Far - m_Near);
+    m_SliceBias = -m_Near * m_SliceScale;
+  } else {
+    m_SliceScale = SLICES / std::log(m_Far / m_Near);
+    m_SliceBias = -std::log(m_Near) * m_SliceScale;
+  }
+
+  // 2. View-space bounding spheres of the lights that touch the frustum
+  m_Visible.clear();
+  m_Spheres.clear();
+  const float sideX = 1.0f / std::sqrt(p00 * p00 + 1.0f);
+  const float sideY = 1.0f / std::sqrt(p11 * p11 + 1.0f);
+  auto sliceOf = [this](float depth) {
+    const float z = m_Ortho ? depth : std::log(depth);
+    const int s = (int)std::floor(z * m_SliceScale + m_SliceBias);
+    return std::min(std::max(s, 0), SLICES - 1);
+  };
+  for (const ClusterLight &light : lights) {
+    if (m_Visible.size() == (size_t)MAX_LIGHTS)
+      break;
+    float center[3] = {light.pos[0], light.pos[1], light.pos[2]};
+    float radius = light.range;
+    if (light.cosOuter > -1.0f) {
+      // Tightest sphere around the spot cone
+      const float cosA = std::max(light.cosOuter, 0.0f);
+      const float sinA = std::sqrt(1.0f - cosA * cosA);
+      float along;
+      if (cosA < 0.70710678f) {
+        along = light.range * cosA;
+        radius = light.range * sinA;
+      } else {
+        along = radius = light.range / (2.0f * cosA);
+      }
+      for (int k = 0; k < 3; ++k)
+        center[k] += light.dir[k] * along;
+    }
+    Sphere sphere;
+    mat4_transform_point(view, center, sphere.center);
+    sphere.radius = radius;
+    const float depth = -sphere.center[2];
+    if (depth + radius < m_Near || depth - radius > m_Far)
+      continue;
+    // Orthographic sides: |x| = 1 / p00 etc.
+    if (m_Ortho &&
+        (std::fabs(sphere.center[0]) - 1.0f / p00 > radius ||
+         std::fabs(sphere.center[1]) - 1.0f / p11 > radius))
+      continue;
+    // Side planes through the eye: p00 * x - d = 0 (right) etc.
+    if (!m_Ortho &&
+        ((p00 * sphere.center[0] - depth) * sideX > radius ||
+         (-p00 * sphere.center[0] - depth) * sideX > radius ||
+         (p11 * sphere.center[1] - depth) * sideY > radius ||
+         (-p11 * sphere.center[1] - depth) * sideY > radius))
+      continue;
+    sphere.index = (uint16_t)m_Visible.size();
+    sphere.firstSlice = sliceOf(std::max(depth - radius, m_Near));
+    sphere.lastSlice = sliceOf(std::min(depth + radius, m_Far));
+    m_Spheres.push_back(sphere);
+    m_Visible.push_back(light);
+  }
+
+  // 3. Bin: each job owns whole slices, so the lists need no locking
+  if (jobs && !m_Spheres.empty()) {
+    jobs->ParallelFor(SLICES, 2, [this](size_t begin, size_t end) {
+      for (size_t s = begin; s < end; ++s)
+        BinSlice((int)s);
+    });
+  } else {
+    for (int s = 0; s < SLICES; ++s)
+      BinSlice(s);
+  }
+
+  // 4. Flatten into (offset, count) + one index list
+  m_Indices.clear();
+  m_Stats.activeClusters = 0;
+  m_Stats.maxPerCluster = 0;
+  for (int c = 0; c < CLUSTER_COUNT; ++c) {
+    const std::vector<uint16_t> &list = m_Lists[c];
+    m_Grid[c * 2 + 0] = (uint32_t)m_Indices.size();
+    m_Grid[c * 2 + 1] = (uint32_t)list.size();
+    m_Indices.insert(m_Indices.end(), list.begin(), list.end());
+    if (!list.empty())
+      m_Stats.activeClusters++;
+    m_Stats.maxPerCluster = std::max(m_Stats.maxPerCluster, (int)list.size());
+  }
+  m_Stats.lights = (int)lights.size();
+  m_Stats.visibleLights = (int)m_Visible.size();
+  m_Stats.indices = (int)m_Indices.size();
+  m_Stats.binMs = std::chrono::duration<float, std::milli>(
+                      std::chrono::high_resolution_clock::now() - start)
+                      .count();
+
+  // 5. Upload (orphaning: the previous frame may still be reading)
+  GLStateCache &gl = GLStateCache::Get();
+  auto upload = [&gl](GLuint buffer, const void *data, size_t size) {
+    static const uint32_t zero[4] = {0, 0, 0, 0};
+    gl.BindBuffer(GL_TEXTURE_BUFFER, buffer);
+    if (size == 0)
+      glBufferData(GL_TEXTURE_BUFFER, sizeof(zero), zero, GL_STREAM_DRAW);
+    else
+      glBufferData(GL_TEXTURE_BUFFER, size, data, GL_STREAM_DRAW);
+  };
+  upload(m_Buffers[0], m_Visible.data(),
+         m_Visible.size() * sizeof(ClusterLight));
+  upload(m_Buffers[1], m_Grid.data(), m_Grid.size() * sizeof(uint32_t));
+  upload(m_Buffers[2], m_Indices.data(), m_Indices.size() * sizeof(uint16_t));
+  gl.BindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+void LightClusters::BinSlice(int slice) {
+  std::vector<uint16_t> *lists = &m_Lists[(size_t)slice * TILE_COUNT];
+  for (int t = 0; t < TILE_COUNT; ++t)
+    lists[t].clear();
+  const SliceBounds &b = m_Bounds[slice];
+
+  for (const Sphere &sphere : m_Spheres) {
+    if (slice < sphere.firstSlice || slice > sphere.lastSlice)
+      continue;
+    // Every tile of a slice spans the same depth: fold z in once
+    const float cz = sphere.center[2];
+    const float dz = std::max(std::max(b.minZ - cz, cz - b.maxZ), 0.0f);
+    const float r2 = sphere.radius * sphere.radius - dz * dz;
+    if (r2 < 0.0f)
+      continue;
+#ifdef LIGHT_SSE2
+    const __m128 cx = _mm_set1_ps(sphere.center[0]);
+    const __m128 cy = _mm_set1_ps(sphere.center[1]);
+    const __m128 rr = _mm_set1_ps(r2);
+    const __m128 zero = _mm_setzero_ps();
+    for (int t = 0; t < TILE_COUNT; t += 4) {
+      const __m128 dx = _mm_max_ps(
+          _mm_max_ps(_mm_sub_ps(_mm_loadu_ps(b.minX + t), cx),
+                     _mm_sub_ps(cx, _mm_loadu_ps(b.maxX + t))),
+          zero);
+      const __m128 dy = _mm_max_ps(
+          _mm_max_ps(_mm_sub_ps(_mm_loadu_ps(b.minY + t), cy),
+                     _mm_sub_ps(cy, _mm_loadu_ps(b.maxY + t))),
+          zero);
+      const __m128 d2 = _mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy));
+      int mask = _mm_movemask_ps(_mm_cmple_ps(d2, rr));
+      for (int i = 0; mask; ++i, mask >>= 1) {
+        if (mask & 1)
+          lists[t + i].push_back(sphere.index);
+      }
+    }
+#else
+    for (int t = 0; t < TILE_COUNT; ++t) {
+      const float dx = std::max(std::max(b.minX[t] - sphere.center[0],
+                                         sphere.center[0] - b.maxX[t]),
+                                0.0f);
+      const float dy = std::max(std::max(b.minY[t] - sphere.center[1],
+                                         sphere.center[1] - b.maxY[t]),
+                                0.0f);
+      if (dx * dx + dy * dy <= r2)
+        lists[t].push_back(sphere.index);
+    }
+#endif
+  }
+}
+
+void LightClusters::Bind(GLuint program) const {
+  GLStateCache &gl = GLStateCache::Get();
+  gl.BindTexture(UNIT_LIGHTS, GL_TEXTURE_BUFFER, m_Textures[0]);
+  gl.BindTexture(UNIT_GRID, GL_TEXTURE_BUFFER, m_Textures[1]);
+  gl.BindTexture(UNIT_INDICES, GL_TEXTURE_BUFFER, m_Textures[2]);
+  gl.SetUniform1i(gl.GetUniformLocation(program, "uLightData"), UNIT_LIGHTS);
+  gl.SetUniform1i(gl.GetUniformLocation(program, "uClusterGrid"), UNIT_GRID);
+  gl.SetUniform1i(gl.GetUniformLocation(program, "uLightIndices"),
+                  UNIT_INDICES);
+  // tile = (fragCoord.xy - viewport.xy) * dims.xy / viewport.zw,
+  // slice = log(viewDepth) * depth.z + depth.w, or viewDepth * depth.z +
+  // depth.w when orthographic (dims.w = 1)
+  gl.SetUniform4f(gl.GetUniformLocation(program, "uClusterDims"),
+                  (float)TILES_X, (float)TILES_Y, (float)SLICES,
+                  m_Ortho ? 1.0f : 0.0f);
+  gl.SetUniform4f(gl.GetUniformLocation(program, "uClusterViewport"),
+                  (float)m_Viewport[0], (float)m_Viewport[1],
+                  (float)m_Viewport[2], (float)m_Viewport[3]);
+  gl.SetUniform4f(gl.GetUniformLocation(program, "uClusterDepth"), m_Near,
+                  m_Far, m_SliceScale, m_SliceBias);
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+#include "../utils/math_utils.h"
+#include "render_stats.h"
+#include <glad/glad.h>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class JobSystem;
+
+// A light as the binning and the shader see it, world space. The layout is
+// the three RGBA32F texels uploaded per light.
+struct ClusterLight {
+  float pos[3];
+  float range;    // influence radius; zero past it
+  float color[3]; // colour * intensity
+  float cosInner; // spot cone; point lights use -2 / -3 (never attenuated)
+  float dir[3];   // spot direction (normalized)
+  float cosOuter;
+};
+
+// Clustered forward shading. The view frustum is split into a grid of
+// TILES_X x TILES_Y screen tiles by SLICES depth slices (exponential in
+// depth), and every frame each light's bounding sphere is tested against
+// the view-space AABBs of the clusters it can reach: SSE2, four clusters
+// per test, with the depth slices spread over the job system. Each cluster
+// ends up with an (offset, count) into one list of light indices, so a
+// fragment only loops over the lights of its own cluster.
+//
+// Data reaches the shader through three buffer textures:
+//   uLightData     RGBA32F  3 texels per light (ClusterLight)
+//   uClusterGrid   RG32UI   (offset, count) per cluster, x fastest
+//   uLightIndices  R16UI    light indices
+// GL 3.3 core; no compute or SSBOs needed.
+class LightClusters {
+public:
+  static constexpr int TILES_X = 16;
+  static constexpr int TILES_Y = 9;
+  static constexpr int SLICES = 24;
+  static constexpr int CLUSTER_COUNT = TILES_X * TILES_Y * SLICES;
+  // Light indices are 16-bit
+  static constexpr int MAX_LIGHTS = 4096;
+  // Texture units used by Bind
+  static constexpr int UNIT_LIGHTS = 1;
+  static constexpr int UNIT_GRID = 2;
+  static constexpr int UNIT_INDICES = 3;
+
+  LightClusters() = default;
+  ~LightClusters();
+
+  LightClusters(const LightClusters &) = delete;
+  LightClusters &operator=(const LightClusters &) = delete;
+
+  // Requires a current GL context
+  void Init();
+
+  // Bins the lights for this view and uploads the result. proj must be a
+  // symmetric perspective projection (depth slices spaced exponentially)
+  // or an orthographic one (linear slices); viewport is x, y, width,
+  // height in pixels. jobs may be null (binned on the calling thread).
+  void Update(const std::vector<ClusterLight> &lights, const Mat4 &view,
+              const Mat4 &proj, const int viewport[4], JobSystem *jobs);
+
+  // Binds the buffer textures and sets the cluster uniforms of `program`
+  // (which must be current)
+  void Bind(GLuint program) const;
+
+  const LightClusterStats &GetStats() const { return m_Stats; }
+
+private:
+  void BuildClusterBounds(float p00, float p11, float zNear, float zFar,
+                          bool ortho);
+  void BinSlice(int slice);
+
+  // Per slice, SoA view-space AABBs of its tiles (TILES_X * TILES_Y, a
+  // multiple of 4)
+  struct SliceBounds {
+    float minX[TILES_X * TILES_Y], minY[TILES_X * TILES_Y];
+    float maxX[TILES_X * TILES_Y], maxY[TILES_X * TILES_Y];
+    float minZ, maxZ;
+  };
+  // View-space bounding sphere of a visible light
+  struct Sphere {
+    float center[3];
+    float radius;
+    uint16_t index; // into m_Visible
+    int firstSlice, lastSlice;
+  };
+
+  std::vector<SliceBounds> m_Bounds;
+  // p00, p11, near, far, orthographic
+  float m_BoundsKey[5] = {0.0f, 0.0f, 0.0f, 0.0f, 0.0f};
+  float m_Near = 0.1f, m_Far = 100.0f;
+  bool m_Ortho = false;
+  float m_SliceScale = 0.0f, m_SliceBias = 0.0f;
+  int m_Viewport[4] = {0, 0, 1, 1};
+
+  std::vector<ClusterLight> m_Visible;
+  std::vector<Sphere> m_Spheres;
+  // Per cluster light lists, filled by the slice jobs (each job owns whole
+  // slices, so no locking); capacity is kept between frames
+  std::vector<std::vector<uint16_t>> m_Lists;
+  std::vector<uint32_t> m_Grid; // offset, count per cluster
+  std::vector<uint16_t> m_Indices;
+
+  GLuint m_Buffers[3] = {0, 0, 0};
+  GLuint m_Textures[3] = {0, 0, 0};
+  LightClusterStats m_Stats;
+};
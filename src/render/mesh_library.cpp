@@ -0,0 +1,73 @@
+#include "mesh_library.h"
+#include "gl_state_cache.h"
+
+MeshLibrary::~MeshLibrary() {
+  GLStateCache &gl = GLStateCache::Get();
+  gl.DeleteBuffer(m_VBO);
+  gl.DeleteBuffer(m_EBO);
+}
+
+uint32_t MeshLibrary::AddMesh(const std::vector<MeshVertex> &vertices,
+                              const std::vector<uint32_t> &indices) {
+  MeshRange range;
+  range.firstIndex = (uint32_t)m_Indices.size();
+  range.indexCount = (uint32_t)indices.size();
+  range.baseVertex = (int32_t)m_Vertices.size();
+
+  m_Vertices.insert(m_Vertices.end(), vertices.begin(), vertices.end());
+  m_Indices.insert(m_Indices.end(), indices.begin(), indices.end());
+  m_Ranges.push_back(range);
+  return (uint32_t)m_Ranges.size() - 1;
+}
+
+void MeshLibrary::Upload() {
+  if (!m_VBO)
+    glGenBuffers(1, &m_VBO);
+  if (!m_EBO)
+    glGenBuffers(1, &m_EBO);
+
+  GLStateCache &gl = GLStateCache::Get();
+  gl.BindBuffer(GL_ARRAY_BUFFER, m_VBO);
+  glBufferData(GL_ARRAY_BUFFER, m_Vertices.size() * sizeof(MeshVertex),
+               m_Vertices.data(), GL_STATIC_DRAW);
+  gl.BindBuffer(GL_ARRAY_BUFFER, 0);
+
+  // The element buffer binding is VAO state; bind it through GL_COPY_WRITE so
+  // whichever VAO is current is left untouched.
+  gl.BindBuffer(GL_COPY_WRITE_BUFFER, m_EBO);
+  glBufferData(GL_COPY_WRITE_BUFFER, m_Indices.size() * sizeof(uint32_t),
+               m_Indices.data(), GL_STATIC_DRAW);
+  gl.BindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+void MeshLibrary::BuildCube(std::vector<MeshVertex> &vertices,
+                            std::vector<uint32_t> &indices) {
+  // 6 caras, 4 vertices por cara (normales planas)
+  static const float faces[6][3] = {{1, 0, 0},  {-1, 0, 0}, {0, 1, 0},
+                                    {0, -1, 0}, {0, 0, 1},  {0, 0, -1}};
+  vertices.clear();
+  indices.clear();
+  for (int f = 0; f < 6; ++f) {
+    const float *n = faces[f];
+    // Two tangent axes spanning the face
+    float u[3] = {n[1], n[2], n[0]};
+    float v[3] = {n[1] * u[2] - n[2] * u[1], n[2] * u[0] - n[0] * u[2],
+                  n[0] * u[1] - n[1] * u[0]};
+    const float corners[4][2] = {{-1, -1}, {1, -1}, {1, 1}, {-1, 1}};
+    uint32_t base = (uint32_t)vertices.size();
+    for (int c = 0; c < 4; ++c) {
+      MeshVertex vert;
+      for (int k = 0; k < 3; ++k) {
+        vert.pos[k] =
+            0.5f * (n[k] + corners[c][0] * u[k] + corners[c][1] * v[k]);
+        vert.normal[k] = n[k];
+      }
+      vert.uv[0] = 0.5f * (corners[c][0] + 1.0f);
+      vert.uv[1] = 0.5f * (corners[c][1] + 1.0f);
+      vertices.push_back(vert);
+    }
+    const uint32_t quad[6] = {0, 1, 2, 0, 2, 3};
+    for (uint32_t q : quad)
+      indices.push_back(base + q);
+  }
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <cstdint>
+#include <vector>
+
+// Vertice comun a todas las mallas de la escena
+struct MeshVertex {
+  float pos[3];
+  float normal[3];
+  float uv[2];
+};
+
+// Rango de una malla dentro de los buffers compartidos
+struct MeshRange {
+  uint32_t firstIndex = 0;
+  uint32_t indexCount = 0;
+  int32_t baseVertex = 0;
+};
+
+// Stores every mesh in one shared vertex/index buffer pair so that draws of
+// different meshes only differ by (firstIndex, indexCount, baseVertex).
+class MeshLibrary {
+public:
+  MeshLibrary() = default;
+  ~MeshLibrary();
+
+  MeshLibrary(const MeshLibrary &) = delete;
+  MeshLibrary &operator=(const MeshLibrary &) = delete;
+
+  // Returns the mesh id. Indices are relative to the mesh's own vertices.
+  uint32_t AddMesh(const std::vector<MeshVertex> &vertices,
+                   const std::vector<uint32_t> &indices);
+
+  // (Re)creates the GL buffers from the CPU copy. Call after AddMesh.
+  void Upload();
+
+  const MeshRange &GetRange(uint32_t mesh) const { return m_Ranges[mesh]; }
+  uint32_t GetMeshCount() const { return (uint32_t)m_Ranges.size(); }
+  GLuint GetVertexBuffer() const { return m_VBO; }
+  GLuint GetIndexBuffer() const { return m_EBO; }
+
+  // Built-in primitives
+  static void BuildCube(std::vector<MeshVertex> &vertices,
+                        std::vector<uint32_t> &indices);
+
+private:
+  std::vector<MeshVertex> m_Vertices;
+  std::vector<uint32_t> m_Indices;
+  std::vector<MeshRange> m_Ranges;
+
+  GLuint m_VBO = 0;
+  GLuint m_EBO = 0;
+};
@@ -0,0 +1,280 @@
+#include "occlusion_culler.h"
+#include "../core/job_system.h"
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <emmintrin.h>
+#define OCCLUSION_SSE2 1
+#endif
+
+// Below this many boxes the tests run on the calling thread
+static const size_t PARALLEL_TEST_THRESHOLD = 2048;
+
+static const float UNIT_CUBE[8][3] = {
+    {-0.5f, -0.5f, -0.5f}, {0.5f, -0.5f, -0.5f}, {0.5f, 0.5f, -0.5f},
+    {-0.5f, 0.5f, -0.5f},  {-0.5f, -0.5f, 0.5f}, {0.5f, -0.5f, 0.5f},
+    {0.5f, 0.5f, 0.5f},    {-0.5f, 0.5f, 0.5f}};
+static const int CUBE_TRIANGLES[12][3] = {
+    {0, 2, 1}, {0, 3, 2}, {4, 5, 6}, {4, 6, 7}, {0, 1, 5}, {0, 5, 4},
+    {3, 6, 2}, {3, 7, 6}, {0, 4, 7}, {0, 7, 3}, {1, 2, 6}, {1, 6, 5}};
+
+// clip = m * (p, 1)
+static void TransformClip(const Mat4 &m, float x, float y, float z,
+                          float out[4]) {
+  for (int r = 0; r < 4; ++r)
+    out[r] = m.m[r] * x + m.m[4 + r] * y + m.m[8 + r] * z + m.m[12 + r];
+}
+
+OcclusionCuller::OcclusionCuller() : m_ViewProj(mat4_identity()) {
+  SetResolution(256, 128);
+}
+
+void OcclusionCuller::SetResolution(int width, int height) {
+  width = std::max(4, (width + 3) & ~3);
+  height = std::max(1, height);
+  if (width == m_Width && height == m_Height)
+    return;
+  m_Width = width;
+  m_Height = height;
+
+  m_MaxLevels.clear();
+  m_MinLevels.clear();
+  m_LevelWidth.clear();
+  m_LevelHeight.clear();
+  int w = width, h = height;
+  while (true) {
+    m_LevelWidth.push_back(w);
+    m_LevelHeight.push_back(h);
+    m_MaxLevels.emplace_back((size_t)w * h, 1.0f);
+    m_MinLevels.emplace_back((size_t)w * h, 1.0f);
+    if (w == 1 && h == 1)
+      break;
+    w = std::max(1, (w + 1) / 2);
+    h = std::max(1, (h + 1) / 2);
+  }
+}
+
+void OcclusionCuller::BeginFrame(const Mat4 &viewProj) {
+  m_ViewProj = viewProj;
+  std::fill(m_MaxLevels[0].begin(), m_MaxLevels[0].end(), 1.0f);
+  m_OccluderCount = 0;
+  m_TriangleCount = 0;
+}
+
+void OcclusionCuller::AddOccluder(const Mat4 &model) {
+  Mat4 mvp = mat4_mul(m_ViewProj, model);
+  ScreenVert verts[8];
+  for (int i = 0; i < 8; ++i) {
+    float clip[4];
+    TransformClip(mvp, UNIT_CUBE[i][0], UNIT_CUBE[i][1], UNIT_CUBE[i][2],
+                  clip);
+    // No near-plane clipping: an occluder we cannot rasterize is just skipped
+    if (clip[3] <= 1e-4f || clip[2] < -clip[3])
+      return;
+    float invW = 1.0f / clip[3];
+    verts[i].x = (clip[0] * invW * 0.5f + 0.5f) * (float)m_Width;
+    verts[i].y = (clip[1] * invW * 0.5f + 0.5f) * (float)m_Height;
+    verts[i].z = clip[2] * invW * 0.5f + 0.5f;
+  }
+  for (const auto &t : CUBE_TRIANGLES)
+    RasterizeTriangle(verts[t[0]], verts[t[1]], verts[t[2]]);
+  m_OccluderCount++;
+}
+
+void OcclusionCuller::RasterizeTriangle(const ScreenVert &a,
+                                        const ScreenVert &b0,
+                                        const ScreenVert &c0) {
+  float area = (b0.x - a.x) * (c0.y - a.y) - (b0.y - a.y) * (c0.x - a.x);
+  if (std::fabs(area) < 1e-8f)
+    return;
+  // Both windings are rasterized; back faces never win the min anyway
+  const ScreenVert &b = area > 0.0f ? b0 : c0;
+  const ScreenVert &c = area > 0.0f ? c0 : b0;
+  area = std::fabs(area);
+
+  int minX = std::max(0, (int)std::floor(std::min({a.x, b.x, c.x})));
+  int maxX = std::min(m_Width - 1, (int)std::ceil(std::max({a.x, b.x, c.x})));
+  int minY = std::max(0, (int)std::floor(std::min({a.y, b.y, c.y})));
+  int maxY =
+      std::min(m_Height - 1, (int)std::ceil(std::max({a.y, b.y, c.y})));
+  if (minX > maxX || minY > maxY)
+    return;
+  minX &= ~3; // 4-wide, aligned to the row width
+  m_TriangleCount++;
+
+  // Edge functions E(p) = A * px + B * py + C, >= 0 inside
+  const ScreenVert *v[3] = {&a, &b, &c};
+  float A[3], B[3], C[3];
+  for (int e = 0; e < 3; ++e) {
+    const ScreenVert &p = *v[e];
+    const ScreenVert &q = *v[(e + 1) % 3];
+    A[e] = -(q.y - p.y);
+    B[e] = q.x - p.x;
+    C[e] = -(A[e] * p.x + B[e] * p.y);
+  }
+
+  // Depth plane z = a.z + dzdx * (px - a.x) + dzdy * (py - a.y)
+  const float dx1 = b.x - a.x, dy1 = b.y - a.y, dz1 = b.z - a.z;
+  const float dx2 = c.x - a.x, dy2 = c.y - a.y, dz2 = c.z - a.z;
+  const float dzdx = (dz1 * dy2 - dz2 * dy1) / area;
+  const float dzdy = (dz2 * dx1 - dz1 * dx2) / area;
+  const float z0 = a.z - dzdx * a.x - dzdy * a.y;
+
+  float *depth = m_MaxLevels[0].data();
+
+#ifdef OCCLUSION_SSE2
+  const __m128 laneOffset = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+  const __m128 zero = _mm_setzero_ps();
+  const __m128 vA0 = _mm_set1_ps(A[0]), vA1 = _mm_set1_ps(A[1]),
+               vA2 = _mm_set1_ps(A[2]), vDzdx = _mm_set1_ps(dzdx);
+  for (int y = minY; y <= maxY; ++y) {
+    const float py = (float)y + 0.5f;
+    const __m128 r0 = _mm_set1_ps(B[0] * py + C[0]);
+    const __m128 r1 = _mm_set1_ps(B[1] * py + C[1]);
+    const __m128 r2 = _mm_set1_ps(B[2] * py + C[2]);
+    const __m128 rz = _mm_set1_ps(z0 + dzdy * py);
+    float *row = depth + (size_t)y * m_Width;
+    for (int x = minX; x <= maxX; x += 4) {
+      __m128 px = _mm_add_ps(_mm_set1_ps((float)x), laneOffset);
+      __m128 e0 = _mm_add_ps(_mm_mul_ps(vA0, px), r0);
+      __m128 e1 = _mm_add_ps(_mm_mul_ps(vA1, px), r1);
+      __m128 e2 = _mm_add_ps(_mm_mul_ps(vA2, px), r2);
+      __m128 inside = _mm_and_ps(
+          _mm_and_ps(_mm_cmpge_ps(e0, zero), _mm_cmpge_ps(e1, zero)),
+          _mm_cmpge_ps(e2, zero));
+      if (_mm_movemask_ps(inside) == 0)
+        continue;
+      __m128 z = _mm_add_ps(_mm_mul_ps(vDzdx, px), rz);
+      __m128 d = _mm_loadu_ps(row + x);
+      __m128 nd = _mm_min_ps(d, z);
+      _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nd),
+                                       _mm_andnot_ps(inside, d)));
+    }
+  }
+#else
+  for (int y = minY; y <= maxY; ++y) {
+    const float py = (float)y + 0.5f;
+    float *row = depth + (size_t)y * m_Width;
+    for (int x = minX; x <= maxX; ++x) {
+      const float px = (float)x + 0.5f;
+      if (A[0] * px + B[0] * py + C[0] < 0.0f ||
+          A[1] * px + B[1] * py + C[1] < 0.0f ||
+          A[2] * px + B[2] * py + C[2] < 0.0f)
+        continue;
+      row[x] = std::min(row[x], z0 + dzdx * px + dzdy * py);
+    }
+  }
+#endif
+}
+
+void OcclusionCuller::BuildPyramid() {
+  m_MinLevels[0] = m_MaxLevels[0];
+  for (size_t level = 1; level < m_MaxLevels.size(); ++level) {
+    const int sw = m_LevelWidth[level - 1], sh = m_LevelHeight[level - 1];
+    const int w = m_LevelWidth[level], h = m_LevelHeight[level];
+    const float *srcMax = m_MaxLevels[level - 1].data();
+    const float *srcMin = m_MinLevels[level - 1].data();
+    float *dstMax = m_MaxLevels[level].data();
+    float *dstMin = m_MinLevels[level].data();
+    for (int y = 0; y < h; ++y) {
+      const int y0 = 2 * y, y1 = std::min(2 * y + 1, sh - 1);
+      for (int x = 0; x < w; ++x) {
+        const int x0 = 2 * x, x1 = std::min(2 * x + 1, sw - 1);
+        const int i00 = y0 * sw + x0, i01 = y0 * sw + x1;
+        const int i10 = y1 * sw + x0, i11 = y1 * sw + x1;
+        dstMax[y * w + x] = std::max(std::max(srcMax[i00], srcMax[i01]),
+                                     std::max(srcMax[i10], srcMax[i11]));
+        dstMin[y * w + x] = std::min(std::min(srcMin[i00], srcMin[i01]),
+                                     std::min(srcMin[i10], srcMin[i11]));
+      }
+    }
+  }
+}
+
+void OcclusionCuller::RegionDepth(int level, int x0, int y0, int x1, int y1,
+                                  float &outMin, float &outMax) const {
+  const int w = m_LevelWidth[level];
+  const float *maxDepth = m_MaxLevels[level].data();
+  const float *minDepth = m_MinLevels[level].data();
+  outMin = 1.0f;
+  outMax = 0.0f;
+  for (int y = y0 >> level; y <= (y1 >> level); ++y) {
+    for (int x = x0 >> level; x <= (x1 >> level); ++x) {
+      outMin = std::min(outMin, minDepth[y * w + x]);
+      outMax = std::max(outMax, maxDepth[y * w + x]);
+    }
+  }
+}
+
+bool OcclusionCuller::IsVisible(const float bmin[3],
+                                const float bmax[3]) const {
+  float ndcMin[3] = {1e30f, 1e30f, 1e30f};
+  float ndcMax[3] = {-1e30f, -1e30f, -1e30f};
+  for (int i = 0; i < 8; ++i) {
+    float clip[4];
+    TransformClip(m_ViewProj, (i & 1) ? bmax[0] : bmin[0],
+                  (i & 2) ? bmax[1] : bmin[1], (i & 4) ? bmax[2] : bmin[2],
+                  clip);
+    if (clip[3] <= 1e-4f)
+      return true; // crosses the camera plane
+    float invW = 1.0f / clip[3];
+    for (int k = 0; k < 3; ++k) {
+      float v = clip[k] * invW;
+      ndcMin[k] = std::min(ndcMin[k], v);
+      ndcMax[k] = std::max(ndcMax[k], v);
+    }
+  }
+
+  // Frustum rejection comes for free
+  if (ndcMax[0] < -1.0f || ndcMin[0] > 1.0f || ndcMax[1] < -1.0f ||
+      ndcMin[1] > 1.0f || ndcMin[2] > 1.0f)
+    return false;
+
+  const float nearest = ndcMin[2] * 0.5f + 0.5f;
+  auto toPixel = [](float ndc, int size) {
+    int p = (int)std::floor((ndc * 0.5f + 0.5f) * (float)size);
+    return std::min(size - 1, std::max(0, p));
+  };
+  const int x0 = toPixel(ndcMin[0], m_Width), x1 = toPixel(ndcMax[0], m_Width);
+  const int y0 = toPixel(ndcMin[1], m_Height),
+            y1 = toPixel(ndcMax[1], m_Height);
+
+  // Coarsest level where the rect covers at most 2x2 texels
+  int level = 0;
+  const int lastLevel = (int)m_MaxLevels.size() - 1;
+  while (level < lastLevel &&
+         ((x1 >> level) - (x0 >> level) > 1 ||
+          (y1 >> level) - (y0 >> level) > 1))
+    level++;
+
+  float regionMin, regionMax;
+  RegionDepth(level, x0, y0, x1, y1, regionMin, regionMax);
+  if (nearest <= regionMin)
+    return true; // in front of everything drawn there
+  if (nearest > regionMax)
+    return false;
+
+  // Ambiguous: the coarse max is pessimistic, retry two levels finer
+  RegionDepth(std::max(0, level - 2), x0, y0, x1, y1, regionMin, regionMax);
+  return nearest <= regionMax;
+}
+
+size_t OcclusionCuller::TestBoxes(const float *boxes, size_t count,
+                                  std::vector<char> &visible,
+                                  JobSystem *jobs) const {
+  visible.resize(count);
+  auto testRange = [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i)
+      visible[i] = IsVisible(boxes + i * 6, boxes + i * 6 + 3) ? 1 : 0;
+  };
+  if (jobs && count >= PARALLEL_TEST_THRESHOLD)
+    jobs->ParallelFor(count, 512, testRange);
+  else
+    testRange(0, count);
+
+  size_t hidden = 0;
+  for (size_t i = 0; i < count; ++i)
+    hidden += visible[i] ? 0 : 1;
+  return hidden;
+}
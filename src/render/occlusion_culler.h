@@ -0,0 +1,61 @@
+#pragma once
+
+#include "../utils/math_utils.h"
+#include <cstddef>
+#include <vector>
+
+class JobSystem;
+
+// Software hierarchical-Z occlusion culling.
+//
+// Per frame: BeginFrame clears a low-resolution depth buffer, AddOccluder
+// rasterizes the (budgeted) large occluders into it, BuildPyramid reduces
+// it into min/max mip chains and IsVisible tests a world AABB against them.
+// Depth is NDC z remapped to [0, 1], 1 = far. Everything is CPU-side so it
+// works on any GL 3.3 context.
+class OcclusionCuller {
+public:
+  OcclusionCuller();
+
+  // Width is rounded up to a multiple of 4 (SIMD row width)
+  void SetResolution(int width, int height);
+  int GetWidth() const { return m_Width; }
+  int GetHeight() const { return m_Height; }
+
+  void BeginFrame(const Mat4 &viewProj);
+  // Unit cube centered at the origin, transformed by model. Occluders that
+  // cross the near plane are skipped (that only ever loses culling).
+  void AddOccluder(const Mat4 &model);
+  void BuildPyramid();
+
+  // false only if the box is fully off-screen or fully behind occluders
+  bool IsVisible(const float bmin[3], const float bmax[3]) const;
+  // Tests count boxes (bmin/bmax interleaved as 6 floats each) into visible,
+  // spread over the job system when it pays off. Returns the hidden count.
+  size_t TestBoxes(const float *boxes, size_t count, std::vector<char> &visible,
+                   JobSystem *jobs) const;
+
+  int GetOccluderCount() const { return m_OccluderCount; }
+  int GetTriangleCount() const { return m_TriangleCount; }
+  const std::vector<float> &GetDepth() const { return m_MaxLevels[0]; }
+
+private:
+  struct ScreenVert {
+    float x, y, z; // pixels, pixels, depth [0, 1]
+  };
+
+  void RasterizeTriangle(const ScreenVert &v0, const ScreenVert &v1,
+                         const ScreenVert &v2);
+  // Max/min over the texels of [x0, x1] x [y0, y1] (level 0 pixels) at level
+  void RegionDepth(int level, int x0, int y0, int x1, int y1, float &outMin,
+                   float &outMax) const;
+
+  int m_Width = 0, m_Height = 0;
+  Mat4 m_ViewProj;
+  // Level 0 of m_MaxLevels is the rasterized depth buffer
+  std::vector<std::vector<float>> m_MaxLevels;
+  std::vector<std::vector<float>> m_MinLevels;
+  std::vector<int> m_LevelWidth, m_LevelHeight;
+  int m_OccluderCount = 0;
+  int m_TriangleCount = 0;
+};
@@ -0,0 +1,625 @@
+#include "render_graph.h"
+#include "gl_state_cache.h"
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <ostream>
+
+namespace {
+
+bool IsDepthFormat(GLenum format) {
+  return format == GL_DEPTH24_STENCIL8 || format == GL_DEPTH32F_STENCIL8 ||
+         format == GL_DEPTH_COMPONENT16 || format == GL_DEPTH_COMPONENT24 ||
+         format == GL_DEPTH_COMPONENT32F;
+}
+
+bool HasStencil(GLenum format) {
+  return format == GL_DEPTH24_STENCIL8 || format == GL_DEPTH32F_STENCIL8;
+}
+
+// Client format/type that glTexImage2D accepts for the internal format
+void UploadFormat(GLenum internal, GLenum &format, GLenum &type) {
+  switch (internal) {
+  case GL_DEPTH24_STENCIL8:
+    format = GL_DEPTH_STENCIL;
+    type = GL_UNSIGNED_INT_24_8;
+    break;
+  case GL_DEPTH32F_STENCIL8:
+    format = GL_DEPTH_STENCIL;
+    type = GL_FLOAT_32_UNSIGNED_INT_24_8_REV;
+    break;
+  case GL_DEPTH_COMPONENT16:
+  case GL_DEPTH_COMPONENT24:
+  case GL_DEPTH_COMPONENT32F:
+    format = GL_DEPTH_COMPONENT;
+    type = GL_FLOAT;
+    break;
+  case GL_R8:
+  case GL_R16F:
+  case GL_R32F:
+    format = GL_RED;
+    type = GL_FLOAT;
+    break;
+  case GL_RGB8:
+  case GL_RGB16F:
+  case GL_R11F_G11F_B10F:
+    format = GL_RGB;
+    type = GL_FLOAT;
+    break;
+  default:
+    format = GL_RGBA;
+    type = GL_FLOAT;
+    break;
+  }
+}
+
+// Estimate of the driver's storage (3-channel formats are padded to 4)
+size_t BytesPerPixel(GLenum format) {
+  switch (format) {
+  case GL_R8: return 1;
+  case GL_DEPTH_COMPONENT16:
+  case GL_R16F: return 2;
+  case GL_RGBA16F:
+  case GL_RGB16F:
+  case GL_DEPTH32F_STENCIL8: return 8;
+  case GL_RGBA32F: return 16;
+  default: return 4;
+  }
+}
+
+int RoundUp(int v) {
+  const int g = RenderGraph::GRANULARITY;
+  return (std::max(v, 1) + g - 1) / g * g;
+}
+
+} // namespace
+
+// --- PassBuilder ---
+
+RenderGraph::PassBuilder &RenderGraph::PassBuilder::Read(Resource resource) {
+  if (resource >= 0)
+    m_Graph.m_Passes[m_Pass].uses.push_back({resource, false, false});
+  return *this;
+}
+
+RenderGraph::PassBuilder &RenderGraph::PassBuilder::Write(Resource resource,
+                                                          Access access) {
+  if (resource >= 0)
+    m_Graph.m_Passes[m_Pass].uses.push_back(
+        {resource, true, access == CLEAR});
+  return *this;
+}
+
+RenderGraph::PassBuilder &
+RenderGraph::PassBuilder::ClearColor(float r, float g, float b, float a) {
+  float *c = m_Graph.m_Passes[m_Pass].clearColor;
+  c[0] = r;
+  c[1] = g;
+  c[2] = b;
+  c[3] = a;
+  return *this;
+}
+
+RenderGraph::PassBuilder &RenderGraph::PassBuilder::SideEffect() {
+  m_Graph.m_Passes[m_Pass].sideEffect = true;
+  return *this;
+}
+
+// --- RenderGraph ---
+
+RenderGraph::~RenderGraph() {
+  for (auto &entry : m_Framebuffers)
+    glDeleteFramebuffers(1, &entry.second);
+  for (PoolEntry &entry : m_Pool)
+    GLStateCache::Get().DeleteTexture(entry.texture);
+}
+
+void RenderGraph::Reset() {
+  m_Passes.clear();
+  m_Textures.clear();
+  m_Order.clear();
+}
+
+RenderGraph::Resource RenderGraph::CreateTexture(const char *name,
+                                                 const TextureDesc &desc) {
+  TextureResource texture;
+  texture.name = name;
+  texture.desc = desc;
+  texture.desc.width = std::max(desc.width, 1);
+  texture.desc.height = std::max(desc.height, 1);
+  m_Textures.push_back(texture);
+  return (Resource)m_Textures.size() - 1;
+}
+
+RenderGraph::Resource RenderGraph::ImportTexture(const char *name,
+                                                 GLuint texture, int width,
+                                                 int height, GLenum format) {
+  TextureResource imported;
+  imported.name = name;
+  imported.desc.width = width;
+  imported.desc.height = height;
+  imported.desc.format = format;
+  imported.imported = true;
+  imported.texture = texture;
+  m_Textures.push_back(imported);
+  return (Resource)m_Textures.size() - 1;
+}
+
+RenderGraph::Resource RenderGraph::ImportBackbuffer(const char *name,
+                                                    int width, int height) {
+  Resource resource = ImportTexture(name, 0, width, height, GL_RGBA8);
+  m_Textures[resource].backbuffer = true;
+  return resource;
+}
+
+RenderGraph::PassBuilder RenderGraph::AddPass(const char *name,
+                                              std::function<void()> execute) {
+  Pass pass;
+  pass.name = name;
+  pass.execute = std::move(execute);
+  m_Passes.push_back(std::move(pass));
+  return PassBuilder(*this, (int)m_Passes.size() - 1);
+}
+
+RenderGraph::PassBuilder RenderGraph::AddBlitPass(const char *name,
+                                                  Resource src, Resource dst,
+                                                  GLenum filter) {
+  PassBuilder builder = AddPass(name, nullptr);
+  Pass &pass = m_Passes.back();
+  pass.blit = true;
+  pass.blitSrc = src;
+  pass.blitDst = dst;
+  pass.blitFilter = filter;
+  builder.Read(src).Write(dst);
+  return builder;
+}
+
+GLuint RenderGraph::GetTexture(Resource resource) const {
+  return resource >= 0 ? m_Textures[resource].texture : 0;
+}
+
+void RenderGraph::Compile() {
+  const int passCount = (int)m_Passes.size();
+  const int textureCount = (int)m_Textures.size();
+
+  // 1. Dependencies, from the declaration order of each resource's uses:
+  // a read or a LOAD write needs the last writer (its output is consumed);
+  // a CLEAR write only has to come after the last writer and after the
+  // readers since (ordering, the previous contents are discarded). A read
+  // declared before any write of its resource consumes the frame's final
+  // contents: it needs the resource's last writer, wherever declared.
+  std::vector<int> finalWriter(textureCount, -1);
+  for (int p = 0; p < passCount; ++p)
+    for (const Use &use : m_Passes[p].uses)
+      if (use.write)
+        finalWriter[use.resource] = p;
+  std::vector<std::vector<int>> after(passCount);
+  std::vector<int> lastWriter(textureCount, -1);
+  std::vector<std::vector<int>> readers(textureCount);
+  for (int p = 0; p < passCount; ++p) {
+    Pass &pass = m_Passes[p];
+    pass.dependencies.clear();
+    pass.alive = false;
+    for (const Use &use : pass.uses) {
+      const int writer = lastWriter[use.resource];
+      if (writer >= 0 && writer != p) {
+        if (use.write && use.clear)
+          after[p].push_back(writer);
+        else
+          pass.dependencies.push_back(writer);
+      } else if (writer < 0 && !use.write &&
+                 finalWriter[use.resource] > p) {
+        pass.dependencies.push_back(finalWriter[use.resource]);
+      }
+    }
+    for (const Use &use : pass.uses) {
+      if (!use.write) {
+        // A forward read is not a reader the later writers must wait for
+        if (lastWriter[use.resource] < 0 && finalWriter[use.resource] > p)
+          continue;
+        readers[use.resource].push_back(p);
+        continue;
+      }
+      for (int reader : readers[use.resource])
+        if (reader != p)
+          after[p].push_back(reader);
+      readers[use.resource].clear();
+      lastWriter[use.resource] = p;
+    }
+  }
+
+  // 2. Cull: keep side-effect passes and whatever they consume
+  std::vector<int> stack;
+  for (int p = 0; p < passCount; ++p)
+    if (m_Passes[p].sideEffect) {
+      m_Passes[p].alive = true;
+      stack.push_back(p);
+    }
+  while (!stack.empty()) {
+    const int p = stack.back();
+    stack.pop_back();
+    for (int dependency : m_Passes[p].dependencies)
+      if (!m_Passes[dependency].alive) {
+        m_Passes[dependency].alive = true;
+        stack.push_back(dependency);
+      }
+  }
+
+  // 3. Order: topological sort of the live passes. Among the ready ones,
+  // prefer a pass that is the last user of a live transient (ends its
+  // lifetime sooner, so its pool entry can be reused), then the earliest
+  // declared.
+  std::vector<int> pending(passCount, 0);
+  std::vector<std::vector<int>> successors(passCount);
+  for (int p = 0; p < passCount; ++p) {
+    if (!m_Passes[p].alive)
+      continue;
+    std::vector<int> edges = m_Passes[p].dependencies;
+    edges.insert(edges.end(), after[p].begin(), after[p].end());
+    std::sort(edges.begin(), edges.end());
+    edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+    for (int e : edges)
+      if (m_Passes[e].alive) {
+        pending[p]++;
+        successors[e].push_back(p);
+      }
+  }
+  std::vector<int> remainingUses(textureCount, 0);
+  for (int p = 0; p < passCount; ++p)
+    if (m_Passes[p].alive)
+      for (const Use &use : m_Passes[p].uses)
+        remainingUses[use.resource]++;
+  std::vector<bool> live(textureCount, false);
+  std::vector<int> ready;
+  for (int p = 0; p < passCount; ++p)
+    if (m_Passes[p].alive && pending[p] == 0)
+      ready.push_back(p);
+  while (!ready.empty()) {
+    std::sort(ready.begin(), ready.end());
+    size_t pick = 0;
+    for (size_t i = 0; i < ready.size(); ++i) {
+      const Pass &pass = m_Passes[ready[i]];
+      bool closes = false;
+      for (const Use &use : pass.uses) {
+        if (!live[use.resource] || m_Textures[use.resource].imported)
+          continue;
+        int uses = 0;
+        for (const Use &other : pass.uses)
+          uses += other.resource == use.resource;
+        closes |= uses == remainingUses[use.resource];
+      }
+      if (closes) {
+        pick = i;
+        break;
+      }
+    }
+    const int p = ready[pick];
+    ready.erase(ready.begin() + pick);
+    m_Order.push_back(p);
+    for (const Use &use : m_Passes[p].uses) {
+      remainingUses[use.resource]--;
+      live[use.resource] = remainingUses[use.resource] > 0;
+    }
+    for (int s : successors[p])
+      if (--pending[s] == 0)
+        ready.push_back(s);
+  }
+
+  // 4. Lifetimes and physical textures. Entries are taken at the first use
+  // and given back after the last, so later transients can reuse them.
+  for (int i = 0; i < (int)m_Order.size(); ++i)
+    for (const Use &use : m_Passes[m_Order[i]].uses) {
+      TextureResource &texture = m_Textures[use.resource];
+      if (texture.firstUse < 0)
+        texture.firstUse = i;
+      texture.lastUse = i;
+    }
+  for (int i = 0; i < (int)m_Order.size(); ++i) {
+    for (TextureResource &texture : m_Textures)
+      if (!texture.imported && texture.firstUse == i) {
+        texture.physical = Acquire(texture.desc);
+        texture.texture = m_Pool[texture.physical].texture;
+      }
+    for (TextureResource &texture : m_Textures)
+      if (!texture.imported && texture.lastUse == i)
+        m_Pool[texture.physical].inUse = false;
+  }
+}
+
+int RenderGraph::Acquire(const TextureDesc &desc) {
+  const int width = RoundUp(desc.poolWidth > 0 ? desc.poolWidth : desc.width);
+  const int height =
+      RoundUp(desc.poolHeight > 0 ? desc.poolHeight : desc.height);
+  for (int i = 0; i < (int)m_Pool.size(); ++i) {
+    PoolEntry &entry = m_Pool[i];
+    if (!entry.inUse && entry.width == width && entry.height == height &&
+        entry.format == desc.format) {
+      entry.inUse = true;
+      entry.lastFrame = m_Frame;
+      return i;
+    }
+  }
+
+  PoolEntry entry;
+  entry.width = width;
+  entry.height = height;
+  entry.format = desc.format;
+  entry.inUse = true;
+  entry.lastFrame = m_Frame;
+  glGenTextures(1, &entry.texture);
+  GLStateCache &gl = GLStateCache::Get();
+  gl.BindTexture(0, GL_TEXTURE_2D, entry.texture);
+  GLenum format, type;
+  UploadFormat(desc.format, format, type);
+  glTexImage2D(GL_TEXTURE_2D, 0, desc.format, width, height, 0, format, type,
+               nullptr);
+  const GLint filter = IsDepthFormat(desc.format) ? GL_NEAREST : GL_LINEAR;
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  m_Pool.push_back(entry);
+  m_Stats.allocations++;
+  return (int)m_Pool.size() - 1;
+}
+
+void RenderGraph::EvictUnused() {
+  // Old pool index -> new one (-1 = evicted), to keep the frame's
+  // TextureResource::physical valid for Dump and the stats
+  std::vector<int> remap(m_Pool.size(), -1);
+  size_t kept = 0;
+  for (size_t i = 0; i < m_Pool.size(); ++i) {
+    PoolEntry &entry = m_Pool[i];
+    if (entry.lastFrame + EVICT_FRAMES >= m_Frame) {
+      remap[i] = (int)kept;
+      if (kept != i)
+        m_Pool[kept] = entry;
+      ++kept;
+      continue;
+    }
+    for (auto it = m_Framebuffers.begin(); it != m_Framebuffers.end();) {
+      const std::vector<GLuint> &attachments = it->first;
+      if (std::find(attachments.begin(), attachments.end(), entry.texture) !=
+          attachments.end()) {
+        glDeleteFramebuffers(1, &it->second);
+        it = m_Framebuffers.erase(it);
+      } else {
+        ++it;
+      }
+    }
+    GLStateCache::Get().DeleteTexture(entry.texture);
+  }
+  if (kept == m_Pool.size())
+    return;
+  m_Pool.resize(kept);
+  for (TextureResource &texture : m_Textures)
+    if (texture.physical >= 0)
+      texture.physical = remap[texture.physical];
+}
+
+GLuint RenderGraph::GetFramebuffer(const std::vector<GLuint> &colors,
+                                   GLuint depth) {
+  std::vector<GLuint> key = colors;
+  key.push_back(depth);
+  auto it = m_Framebuffers.find(key);
+  if (it != m_Framebuffers.end())
+    return it->second;
+
+  GLStateCache &gl = GLStateCache::Get();
+  GLuint fbo = 0;
+  glGenFramebuffers(1, &fbo);
+  gl.BindFramebuffer(fbo);
+  std::vector<GLenum> drawBuffers;
+  for (size_t i = 0; i < colors.size(); ++i) {
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GLenum(GL_COLOR_ATTACHMENT0 + i),
+                           GL_TEXTURE_2D, colors[i], 0);
+    drawBuffers.push_back(GLenum(GL_COLOR_ATTACHMENT0 + i));
+  }
+  if (depth) {
+    GLenum format = 0;
+    for (const PoolEntry &entry : m_Pool)
+      if (entry.texture == depth)
+        format = entry.format;
+    for (const TextureResource &texture : m_Textures)
+      if (texture.texture == depth)
+        format = texture.desc.format;
+    glFramebufferTexture2D(GL_FRAMEBUFFER,
+                           HasStencil(format) ? GL_DEPTH_STENCIL_ATTACHMENT
+                                              : GL_DEPTH_ATTACHMENT,
+                           GL_TEXTURE_2D, depth, 0);
+  }
+  if (drawBuffers.empty())
+    glDrawBuffer(GL_NONE);
+  else
+    glDrawBuffers((GLsizei)drawBuffers.size(), drawBuffers.data());
+  m_Framebuffers[key] = fbo;
+  return fbo;
+}
+
+void RenderGraph::RunPass(Pass &pass) {
+  GLStateCache &gl = GLStateCache::Get();
+  const auto start = std::chrono::high_resolution_clock::now();
+  auto timer = m_Timers.try_emplace(pass.name);
+  if (timer.second)
+    timer.first->second.Init();
+  timer.first->second.Begin();
+
+  // Framebuffer of the written textures
+  std::vector<GLuint> colors;
+  GLuint depth = 0;
+  bool backbuffer = false;
+  const TextureResource *target = nullptr;
+  for (const Use &use : pass.uses) {
+    if (!use.write)
+      continue;
+    const TextureResource &texture = m_Textures[use.resource];
+    if (!target)
+      target = &texture;
+    if (texture.backbuffer)
+      backbuffer = true;
+    else if (IsDepthFormat(texture.desc.format))
+      depth = texture.texture;
+    else if (std::find(colors.begin(), colors.end(), texture.texture) ==
+             colors.end())
+      colors.push_back(texture.texture);
+  }
+  GLuint fbo = 0;
+  if (target) {
+    fbo = backbuffer ? 0 : GetFramebuffer(colors, depth);
+    gl.BindFramebuffer(fbo);
+    gl.Viewport(0, 0, target->desc.width, target->desc.height);
+    for (const Use &use : pass.uses) {
+      if (!use.write || !use.clear)
+        continue;
+      const TextureResource &texture = m_Textures[use.resource];
+      if (!texture.backbuffer && IsDepthFormat(texture.desc.format)) {
+        gl.DepthMask(true);
+        if (HasStencil(texture.desc.format))
+          glClearBufferfi(GL_DEPTH_STENCIL, 0, 1.0f, 0);
+        else {
+          const float one = 1.0f;
+          glClearBufferfv(GL_DEPTH, 0, &one);
+        }
+      } else {
+        const GLint index = texture.backbuffer
+                                ? 0
+                                : GLint(std::find(colors.begin(), colors.end(),
+                                                  texture.texture) -
+                                        colors.begin());
+        glClearBufferfv(GL_COLOR, index, pass.clearColor);
+      }
+      gl.CountForwarded();
+    }
+  }
+
+  if (pass.blit) {
+    const TextureResource &src = m_Textures[pass.blitSrc];
+    const TextureResource &dst = m_Textures[pass.blitDst];
+    // Creating the source framebuffer binds it; restore the pass's one
+    const GLuint source = GetFramebuffer({src.texture}, 0);
+    gl.BindFramebuffer(fbo);
+    gl.BindReadFramebuffer(source);
+    glBlitFramebuffer(0, 0, src.desc.width, src.desc.height, 0, 0,
+                      dst.desc.width, dst.desc.height, GL_COLOR_BUFFER_BIT,
+                      pass.blitFilter);
+    gl.CountForwarded();
+    gl.BindReadFramebuffer(gl.GetFramebuffer());
+  } else if (pass.execute) {
+    pass.execute();
+  }
+
+  timer.first->second.End();
+  RenderGraphPassStats &timing = m_Timings[pass.name];
+  timing.name = pass.name;
+  timing.cpuMs = std::chrono::duration<float, std::milli>(
+                     std::chrono::high_resolution_clock::now() - start)
+                     .count();
+}
+
+void RenderGraph::Execute() {
+  Compile();
+  for (int p : m_Order)
+    RunPass(m_Passes[p]);
+  for (auto &timer : m_Timers) {
+    RenderGraphPassStats &timing = m_Timings[timer.first];
+    timing.gpuUpdated = timer.second.Poll(timing.gpuMs);
+  }
+  UpdateStats();
+  EvictUnused();
+  m_Frame++;
+}
+
+void RenderGraph::UpdateStats() {
+  RenderGraphStats &stats = m_Stats;
+  stats.passes = (int)m_Passes.size();
+  stats.culledPasses = stats.passes - (int)m_Order.size();
+  stats.transientTextures = 0;
+  stats.transientBytes = 0;
+  std::vector<bool> used(m_Pool.size(), false);
+  for (const TextureResource &texture : m_Textures) {
+    if (texture.imported || texture.physical < 0)
+      continue;
+    const PoolEntry &entry = m_Pool[texture.physical];
+    stats.transientTextures++;
+    stats.transientBytes += (size_t)entry.width * entry.height *
+                            BytesPerPixel(entry.format);
+    used[texture.physical] = true;
+  }
+  stats.physicalTextures = 0;
+  stats.physicalBytes = 0;
+  stats.poolBytes = 0;
+  for (size_t i = 0; i < m_Pool.size(); ++i) {
+    const size_t bytes = (size_t)m_Pool[i].width * m_Pool[i].height *
+                         BytesPerPixel(m_Pool[i].format);
+    stats.poolBytes += bytes;
+    if (used[i]) {
+      stats.physicalTextures++;
+      stats.physicalBytes += bytes;
+    }
+  }
+  stats.poolTextures = (int)m_Pool.size();
+  stats.framebuffers = (int)m_Framebuffers.size();
+
+  stats.passStats.clear();
+  for (int p : m_Order)
+    stats.passStats.push_back(m_Timings[m_Passes[p].name]);
+  for (const Pass &pass : m_Passes)
+    if (!pass.alive) {
+      RenderGraphPassStats culled;
+      culled.name = pass.name;
+      culled.culled = true;
+      stats.passStats.push_back(culled);
+    }
+}
+
+const RenderGraphPassStats *
+RenderGraph::FindPass(const std::string &name) const {
+  for (const RenderGraphPassStats &pass : m_Stats.passStats)
+    if (pass.name == name && !pass.culled)
+      return &pass;
+  return nullptr;
+}
+
+void RenderGraph::Dump(std::ostream &out) const {
+  const RenderGraphStats &stats = m_Stats;
+  const double MB = 1024.0 * 1024.0;
+  out << "Render graph, frame " << m_Frame << ": " << m_Order.size() << "/"
+      << stats.passes << " passes\n";
+  out << std::fixed << std::setprecision(3);
+  for (size_t i = 0; i < m_Order.size(); ++i) {
+    const Pass &pass = m_Passes[m_Order[i]];
+    const RenderGraphPassStats &timing = stats.passStats[i];
+    out << "  " << i << ". " << pass.name << "  cpu " << timing.cpuMs
+        << " ms, gpu " << timing.gpuMs << " ms\n";
+    for (const Use &use : pass.uses)
+      out << "       " << (use.write ? (use.clear ? "clear " : "write ")
+                                     : "read  ")
+          << m_Textures[use.resource].name << "\n";
+  }
+  for (const Pass &pass : m_Passes)
+    if (!pass.alive)
+      out << "  culled: " << pass.name << "\n";
+  out << "  Textures:\n";
+  for (const TextureResource &texture : m_Textures) {
+    out << "    " << texture.name << " " << texture.desc.width << "x"
+        << texture.desc.height << " 0x" << std::hex << texture.desc.format
+        << std::dec;
+    if (texture.imported)
+      out << " imported";
+    else if (texture.physical >= 0)
+      out << " -> pool #" << texture.physical << " ("
+          << m_Pool[texture.physical].width << "x"
+          << m_Pool[texture.physical].height << "), passes "
+          << texture.firstUse << ".." << texture.lastUse;
+    else
+      out << " unused";
+    out << "\n";
+  }
+  out << std::setprecision(2) << "  Memory: " << stats.transientBytes / MB
+      << " MB declared, " << stats.physicalBytes / MB << " MB after aliasing ("
+      << stats.transientTextures << " textures on " << stats.physicalTextures
+      << "), pool " << stats.poolBytes / MB << " MB in " << stats.poolTextures
+      << " textures, " << stats.framebuffers << " framebuffers, "
+      << stats.allocations << " allocations since startup\n";
+  out.unsetf(std::ios::floatfield);
+}
@@ -0,0 +1,181 @@
+#pragma once
+
+#include "gpu_timer.h"
+#include <glad/glad.h>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iosfwd>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Contadores del render graph (panel Stats, Dump)
+struct RenderGraphPassStats {
+  std::string name;
+  bool culled = false;
+  float cpuMs = 0.0f;
+  float gpuMs = 0.0f; // latest GL_TIME_ELAPSED result (a few frames old)
+  bool gpuUpdated = false; // gpuMs arrived this frame
+};
+struct RenderGraphStats {
+  int passes = 0;
+  int culledPasses = 0;
+  int transientTextures = 0; // declared this frame (by live passes)
+  int physicalTextures = 0;  // pool textures they were assigned to
+  size_t transientBytes = 0; // without aliasing
+  size_t physicalBytes = 0;  // with aliasing
+  size_t poolBytes = 0;      // everything the pool holds
+  int poolTextures = 0;
+  int framebuffers = 0;
+  uint64_t allocations = 0; // pool textures created since startup
+  std::vector<RenderGraphPassStats> passStats;
+};
+
+// Frame graph of GL passes, rebuilt every frame.
+//
+// Passes are added in a natural order and declare the textures they read
+// and write. Uses are resolved in declaration order, except that a read
+// declared before any write of its texture consumes the frame's final
+// contents (it depends on the texture's last writer). Execute() then
+// - culls every pass whose output nothing needs: only passes marked with
+//   SideEffect() (presenting, capturing) and what they transitively depend
+//   on survive,
+// - orders the survivors with a topological sort that, among the passes
+//   ready to run, prefers one ending the lifetime of a transient and
+//   otherwise keeps the declaration order,
+// - gives transient textures physical storage from a pool keyed by size
+//   and format. A texture takes a pool entry at its first use and returns
+//   it after its last, so transients whose lifetimes do not overlap share
+//   the same GL texture,
+// - binds a framebuffer with the pass's written textures (colour in
+//   declaration order, plus depth), sets the viewport to their size,
+//   clears what was declared with CLEAR and runs the pass, timing it on the
+//   CPU and GPU.
+// Pool entries unused for EVICT_FRAMES frames are freed. GL cannot alias
+// memory between different formats, so aliasing happens between textures
+// of the same pool key.
+class RenderGraph {
+public:
+  using Resource = int; // -1 = none
+
+  static const int GRANULARITY = 256; // pool sizes round up to this
+  static const int EVICT_FRAMES = 120;
+
+  enum Access { LOAD = 0, CLEAR = 1 };
+
+  struct TextureDesc {
+    int width = 0, height = 0; // used area (viewport)
+    GLenum format = GL_RGBA8;  // internal format
+    // Storage to allocate for (0 = width/height): lets a texture whose
+    // used area changes often (dynamic resolution) keep its pool entry
+    int poolWidth = 0, poolHeight = 0;
+  };
+
+  class PassBuilder {
+  public:
+    PassBuilder &Read(Resource resource);
+    PassBuilder &Write(Resource resource, Access access = LOAD);
+    PassBuilder &ClearColor(float r, float g, float b, float a);
+    // Never culled
+    PassBuilder &SideEffect();
+
+  private:
+    friend class RenderGraph;
+    PassBuilder(RenderGraph &graph, int pass) : m_Graph(graph), m_Pass(pass) {}
+    RenderGraph &m_Graph;
+    int m_Pass;
+  };
+
+  RenderGraph() = default;
+  ~RenderGraph();
+
+  RenderGraph(const RenderGraph &) = delete;
+  RenderGraph &operator=(const RenderGraph &) = delete;
+
+  // Forgets the previous frame's passes and resources (the pool stays)
+  void Reset();
+
+  Resource CreateTexture(const char *name, const TextureDesc &desc);
+  // External texture (e.g. a persistent render target), width x height used
+  Resource ImportTexture(const char *name, GLuint texture, int width,
+                         int height, GLenum format);
+  // The default framebuffer; a pass writing it may write nothing else
+  Resource ImportBackbuffer(const char *name, int width, int height);
+
+  // execute runs with the pass's framebuffer bound
+  PassBuilder AddPass(const char *name, std::function<void()> execute);
+  // Copies src into dst (scaled with `filter` if the sizes differ)
+  PassBuilder AddBlitPass(const char *name, Resource src, Resource dst,
+                          GLenum filter);
+
+  // GL texture of a resource; valid inside pass callbacks
+  GLuint GetTexture(Resource resource) const;
+
+  void Execute();
+
+  const RenderGraphStats &GetStats() const { return m_Stats; }
+  // Stats of a pass run in the last frame; nullptr if culled or absent
+  const RenderGraphPassStats *FindPass(const std::string &name) const;
+  // Passes, lifetimes, physical textures, memory and timings of the last
+  // executed frame
+  void Dump(std::ostream &out) const;
+
+private:
+  struct Use {
+    Resource resource;
+    bool write;
+    bool clear;
+  };
+  struct Pass {
+    std::string name;
+    std::function<void()> execute;
+    std::vector<Use> uses;
+    float clearColor[4] = {0.0f, 0.0f, 0.0f, 1.0f};
+    bool sideEffect = false;
+    // Blit pass
+    bool blit = false;
+    Resource blitSrc = -1, blitDst = -1;
+    GLenum blitFilter = GL_NEAREST;
+    // Compile results
+    bool alive = false;
+    std::vector<int> dependencies; // passes that must run first
+  };
+  struct TextureResource {
+    std::string name;
+    TextureDesc desc;
+    bool imported = false;
+    bool backbuffer = false;
+    GLuint texture = 0;
+    int firstUse = -1, lastUse = -1; // positions in m_Order
+    int physical = -1;               // pool entry (transients)
+  };
+  struct PoolEntry {
+    int width = 0, height = 0;
+    GLenum format = 0;
+    GLuint texture = 0;
+    bool inUse = false;
+    uint64_t lastFrame = 0;
+  };
+
+  void Compile();
+  int Acquire(const TextureDesc &desc);
+  void EvictUnused();
+  GLuint GetFramebuffer(const std::vector<GLuint> &colors, GLuint depth);
+  void RunPass(Pass &pass);
+  void UpdateStats();
+
+  std::vector<Pass> m_Passes;
+  std::vector<TextureResource> m_Textures;
+  std::vector<int> m_Order; // alive passes, execution order
+
+  std::vector<PoolEntry> m_Pool;
+  // Attachments (colour..., depth) -> framebuffer object
+  std::map<std::vector<GLuint>, GLuint> m_Framebuffers;
+  std::unordered_map<std::string, GpuTimer> m_Timers;
+  std::unordered_map<std::string, RenderGraphPassStats> m_Timings;
+
+  uint64_t m_Frame = 0;
+  RenderGraphStats m_Stats;
+};
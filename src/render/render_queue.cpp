@@ -0,0 +1,98 @@
+#include "render_queue.h"
+#include "../core/job_system.h"
+#include <algorithm>
+#include <functional>
+
+// Below this size the threading overhead outweighs the sort itself
+static const size_t PARALLEL_SORT_THRESHOLD = 16384;
+
+uint64_t RenderQueue::MakeKey(uint32_t pass, uint32_t shader,
+                              uint32_t material, uint32_t mesh,
+                              float depth01) {
+  const uint32_t depthMax = (1u << DEPTH_BITS) - 1;
+  depth01 = std::min(1.0f, std::max(0.0f, depth01));
+  uint32_t depth = (uint32_t)(depth01 * (float)depthMax);
+  if (pass == PASS_TRANSPARENT)
+    depth = depthMax - depth;
+
+  auto field = [](uint32_t v, int bits) {
+    return (uint64_t)(v & ((1u << bits) - 1));
+  };
+  // Masking would alias a large id onto a small one
+  material = std::min(material, MATERIAL_OVERFLOW);
+  return field(pass, PASS_BITS) << PASS_SHIFT |
+         field(shader, SHADER_BITS) << SHADER_SHIFT |
+         field(material, MATERIAL_BITS) << MATERIAL_SHIFT |
+         field(mesh, MESH_BITS) << MESH_SHIFT | (uint64_t)depth;
+}
+
+void RenderQueue::Sort(JobSystem *jobs) {
+  const size_t n = m_Items.size();
+  if (n < 2)
+    return;
+
+  // Which bytes actually vary? (XOR of every key against the first)
+  uint64_t diff = 0;
+  const uint64_t first = m_Items[0].key;
+  for (const auto &item : m_Items)
+    diff |= item.key ^ first;
+  if (diff == 0)
+    return;
+
+  const size_t chunks =
+      (jobs && n >= PARALLEL_SORT_THRESHOLD) ? jobs->GetThreadCount() : 1;
+  const size_t chunkSize = (n + chunks - 1) / chunks;
+  m_Scratch.resize(n);
+  m_Histograms.resize(chunks * 256);
+
+  auto forEachChunk = [&](const std::function<void(size_t)> &fn) {
+    if (chunks == 1) {
+      fn(0);
+      return;
+    }
+    jobs->ParallelFor(chunks, 1, [&](size_t begin, size_t end) {
+      for (size_t c = begin; c < end; ++c)
+        fn(c);
+    });
+  };
+
+  RenderItem *src = m_Items.data();
+  RenderItem *dst = m_Scratch.data();
+
+  for (int shift = 0; shift < 64; shift += 8) {
+    if (((diff >> shift) & 0xFF) == 0)
+      continue;
+
+    // 1. Histograma por chunk
+    forEachChunk([&](size_t c) {
+      uint32_t *hist = &m_Histograms[c * 256];
+      std::fill(hist, hist + 256, 0u);
+      size_t begin = c * chunkSize, end = std::min(n, begin + chunkSize);
+      for (size_t i = begin; i < end; ++i)
+        hist[(src[i].key >> shift) & 0xFF]++;
+    });
+
+    // 2. Exclusive prefix sum in (digit, chunk) order keeps the sort stable
+    uint32_t offset = 0;
+    for (int d = 0; d < 256; ++d) {
+      for (size_t c = 0; c < chunks; ++c) {
+        uint32_t count = m_Histograms[c * 256 + d];
+        m_Histograms[c * 256 + d] = offset;
+        offset += count;
+      }
+    }
+
+    // 3. Scatter
+    forEachChunk([&](size_t c) {
+      uint32_t *cursor = &m_Histograms[c * 256];
+      size_t begin = c * chunkSize, end = std::min(n, begin + chunkSize);
+      for (size_t i = begin; i < end; ++i)
+        dst[cursor[(src[i].key >> shift) & 0xFF]++] = src[i];
+    });
+
+    std::swap(src, dst);
+  }
+
+  if (src != m_Items.data())
+    m_Items.swap(m_Scratch);
+}
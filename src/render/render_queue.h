@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class JobSystem;
+
+enum RenderPass : uint32_t {
+  PASS_OPAQUE = 0,
+  PASS_TRANSPARENT = 1, // depth bits inverted -> back-to-front
+  PASS_OVERLAY = 2
+};
+
+struct RenderItem {
+  uint64_t key;
+  uint32_t index; // caller-defined payload (e.g. object index)
+};
+
+// Draw queue ordered by a 64-bit key:
+//   [63..60] pass  [59..52] shader  [51..36] material  [35..24] mesh
+//   [23..0]  quantized view depth
+// Sorting groups identical state together and, inside a state run, orders
+// opaque geometry front-to-back for early-Z.
+//
+// Material ids past the field's range are clamped to MATERIAL_OVERFLOW, so
+// every material from 65535 up shares one key value: those items sort
+// together but are not grouped by material, and a key boundary no longer
+// implies a material change. Callers compare the real material of items
+// whose KeyMaterial is MATERIAL_OVERFLOW.
+class RenderQueue {
+public:
+  static constexpr int DEPTH_BITS = 24;
+  static constexpr int MESH_SHIFT = 24, MESH_BITS = 12;
+  static constexpr int MATERIAL_SHIFT = 36, MATERIAL_BITS = 16;
+  static constexpr uint32_t MATERIAL_OVERFLOW = (1u << MATERIAL_BITS) - 1;
+  static constexpr int SHADER_SHIFT = 52, SHADER_BITS = 8;
+  static constexpr int PASS_SHIFT = 60, PASS_BITS = 4;
+  // Everything except depth: a change here is a state change
+  static constexpr uint64_t STATE_MASK = ~((1ull << DEPTH_BITS) - 1);
+
+  // depth01: view depth normalized to [0, 1]
+  static uint64_t MakeKey(uint32_t pass, uint32_t shader, uint32_t material,
+                          uint32_t mesh, float depth01);
+
+  static uint32_t KeyPass(uint64_t k) { return Field(k, PASS_SHIFT, PASS_BITS); }
+  static uint32_t KeyShader(uint64_t k) {
+    return Field(k, SHADER_SHIFT, SHADER_BITS);
+  }
+  static uint32_t KeyMaterial(uint64_t k) {
+    return Field(k, MATERIAL_SHIFT, MATERIAL_BITS);
+  }
+  static uint32_t KeyMesh(uint64_t k) { return Field(k, MESH_SHIFT, MESH_BITS); }
+
+  void Clear() { m_Items.clear(); }
+  void Reserve(size_t n) { m_Items.reserve(n); }
+  void Push(uint64_t key, uint32_t index) { m_Items.push_back({key, index}); }
+
+  // LSD radix sort, 8 bits per pass. Passes whose digit is identical for all
+  // keys are skipped. With a job system, histogram and scatter run per
+  // worker chunk; small queues sort on the calling thread.
+  void Sort(JobSystem *jobs = nullptr);
+
+  const std::vector<RenderItem> &GetItems() const { return m_Items; }
+  size_t Size() const { return m_Items.size(); }
+
+private:
+  static uint32_t Field(uint64_t k, int shift, int bits) {
+    return (uint32_t)((k >> shift) & ((1ull << bits) - 1));
+  }
+
+  std::vector<RenderItem> m_Items;
+  std::vector<RenderItem> m_Scratch;
+  std::vector<uint32_t> m_Histograms; // [chunk][256]
+};
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cstdint>
+
+// Estadisticas del grid de chunks (panel Stats)
+struct ChunkStats {
+  int chunks = 0;         // chunks with at least one static cube
+  // Summed over the views drawn this frame
+  int visibleChunks = 0;  // drawn fully
+  int partialChunks = 0;  // drawn per object (frustum edge)
+  int pendingChunks = 0;  // dirty or rebuilding; members drawn as loose cubes
+  int drawCalls = 0;
+  int rebuildsCompleted = 0; // this frame
+  float rebuildLatencyMs = 0.0f; // dirty mark -> upload, last completed
+};
+
+// Contadores del clustered lighting (panel Stats)
+struct LightClusterStats {
+  int lights = 0;        // submitted
+  int visibleLights = 0; // overlapping the view frustum
+  int activeClusters = 0; // clusters with at least one light
+  int indices = 0;        // total entries of the per-cluster lists
+  int maxPerCluster = 0;
+  float binMs = 0.0f; // CPU binning
+};
+
+// Contadores de las cascadas de sombra (panel Stats)
+struct ShadowCascadeStats {
+  float splitFar = 0.0f;  // view distance covered
+  bool cached = false;    // static layer reused this frame
+  int staticDraws = 0;    // chunk draws into the static layer (when redrawn)
+  int dynamicCasters = 0; // loose objects overlapping the cascade
+  int dynamicDraws = 0;
+};
+struct ShadowStats {
+  static const int MAX_CASCADES = 4;
+  int cascadeCount = 0; // 0 when the sun casts no shadows
+  ShadowCascadeStats cascades[MAX_CASCADES];
+  uint64_t cacheHits = 0;     // since startup, per cascade and frame
+  uint64_t staticRenders = 0;
+  int composites = 0; // static -> final copies this frame
+  float ms = 0.0f;    // CPU time of the shadow pass
+};
+
+// Estado de la resolucion dinamica del viewport (panel Stats)
+struct DynamicResolutionStats {
+  bool enabled = false;
+  float scale = 1.0f;    // render size / panel size, per axis
+  float gpuMs = 0.0f;    // last GPU time of the scene span
+  float smoothedMs = 0.0f;
+  float budgetMs = 0.0f;
+  int renderWidth = 0, renderHeight = 0;
+  int scaleChanges = 0; // since startup
+};
+
+// Contadores de la captura de frames (panel Stats, modo headless)
+struct CaptureStats {
+  uint64_t requested = 0;      // frames asked for (screenshots + sequence)
+  uint64_t readbacks = 0;      // copied into the PBO ring
+  uint64_t written = 0;        // encoded and on disk
+  uint64_t droppedRing = 0;    // every PBO of the ring still in flight
+  uint64_t droppedEncoder = 0; // too many frames waiting for workers
+  uint64_t failed = 0;         // encode or write errors
+  int pendingReadbacks = 0;
+  int pendingWrites = 0;
+  float mapMs = 0.0f;    // GL thread: map + copy of the last readback
+  float encodeMs = 0.0f; // worker: encode + write of the last frame
+};
+
+// Contadores del ultimo frame renderizado (panel Stats del editor)
+struct RenderStats {
+  int drawCalls = 0;        // GL draw calls for scene objects
+  int indirectCommands = 0; // DrawElementsIndirectCommand entries
+  int instances = 0;        // objects submitted
+  int textureBinds = 0;     // diffuse texture arrays bound
+  bool multiDrawIndirect = false;
+  int stateChanges = 0; // key boundaries walked in the render queue
+  float sortMs = 0.0f;  // render queue radix sort
+  int occluders = 0;        // cubes rasterized into the CPU depth buffer
+  int occlusionCulled = 0;  // hidden or off-screen cubes skipped
+  float occlusionMs = 0.0f; // rasterize + pyramid + tests
+  ChunkStats chunks;
+  LightClusterStats lights;
+  ShadowStats shadows;
+  float chunkSyncMs = 0.0f; // snapshot diff + upload of finished rebuilds
+  // Multi-view frames (Scene::BeginFrame); draw counters above are summed
+  // over the views, lights and occlusion are those of the main view
+  int views = 0;
+  int unionCulled = 0;       // loose cubes outside the box around all frusta
+  float visibilityMs = 0.0f; // union + per-view frustum tests, all views
+  int debugDrawCalls = 0; // grid + gizmos (DebugDraw flushes)
+  int debugVertices = 0;
+};
@@ -0,0 +1,63 @@
+#include "render_target.h"
+#include "gl_state_cache.h"
+#include <algorithm>
+#include <iostream>
+
+RenderTarget::~RenderTarget() {
+  if (m_Framebuffer)
+    glDeleteFramebuffers(1, &m_Framebuffer);
+  GLStateCache::Get().DeleteTexture(m_Color);
+  if (m_Depth)
+    glDeleteRenderbuffers(1, &m_Depth);
+}
+
+void RenderTarget::Init(bool depth) {
+  m_HasDepth = depth;
+  glGenFramebuffers(1, &m_Framebuffer);
+  glGenTextures(1, &m_Color);
+  if (depth)
+    glGenRenderbuffers(1, &m_Depth);
+}
+
+bool RenderTarget::Reserve(int width, int height) {
+  m_Width = std::max(width, 1);
+  m_Height = std::max(height, 1);
+  if (m_Width <= m_CapacityWidth && m_Height <= m_CapacityHeight)
+    return false;
+  auto roundUp = [](int v) {
+    return (v + GRANULARITY - 1) / GRANULARITY * GRANULARITY;
+  };
+  // Never shrink: a panel dragged back and forth reallocates only once
+  m_CapacityWidth = std::max(m_CapacityWidth, roundUp(m_Width));
+  m_CapacityHeight = std::max(m_CapacityHeight, roundUp(m_Height));
+  Allocate();
+  return true;
+}
+
+void RenderTarget::Allocate() {
+  GLStateCache &gl = GLStateCache::Get();
+  gl.BindTexture(0, GL_TEXTURE_2D, m_Color);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB8, m_CapacityWidth, m_CapacityHeight,
+               0, GL_RGB, GL_UNSIGNED_BYTE, nullptr);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+  const GLuint previous = gl.GetFramebuffer();
+  gl.BindFramebuffer(m_Framebuffer);
+  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
+                         m_Color, 0);
+  if (m_HasDepth) {
+    glBindRenderbuffer(GL_RENDERBUFFER, m_Depth);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8,
+                          m_CapacityWidth, m_CapacityHeight);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT,
+                              GL_RENDERBUFFER, m_Depth);
+  }
+  if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+    std::cerr << "Render target " << m_CapacityWidth << "x"
+              << m_CapacityHeight << " incomplete" << std::endl;
+  gl.BindFramebuffer(previous);
+  m_Reallocations++;
+}
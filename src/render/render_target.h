@@ -0,0 +1,47 @@
+#pragma once
+
+#include <glad/glad.h>
+
+// Off-screen colour (RGB8, linear filtering) + optional depth/stencil
+// target whose storage is over-allocated: Reserve() only reallocates when
+// the requested size does not fit, growing in GRANULARITY steps. Users
+// render into the bottom-left width x height corner (viewport) and sample
+// it with GetUv().
+class RenderTarget {
+public:
+  static const int GRANULARITY = 256;
+
+  RenderTarget() = default;
+  ~RenderTarget();
+
+  RenderTarget(const RenderTarget &) = delete;
+  RenderTarget &operator=(const RenderTarget &) = delete;
+
+  // Requires a current GL context
+  void Init(bool depth);
+
+  // Sets the used size; true if the storage had to grow
+  bool Reserve(int width, int height);
+
+  GLuint GetFramebuffer() const { return m_Framebuffer; }
+  GLuint GetColorTexture() const { return m_Color; }
+  int GetWidth() const { return m_Width; }
+  int GetHeight() const { return m_Height; }
+  int GetCapacityWidth() const { return m_CapacityWidth; }
+  int GetCapacityHeight() const { return m_CapacityHeight; }
+  // Texture coordinates of the used corner's top-right
+  float GetUvX() const { return (float)m_Width / m_CapacityWidth; }
+  float GetUvY() const { return (float)m_Height / m_CapacityHeight; }
+  int GetReallocations() const { return m_Reallocations; }
+
+private:
+  void Allocate();
+
+  GLuint m_Framebuffer = 0;
+  GLuint m_Color = 0;
+  GLuint m_Depth = 0; // renderbuffer, 0 if colour only
+  bool m_HasDepth = false;
+  int m_Width = 0, m_Height = 0;
+  int m_CapacityWidth = 0, m_CapacityHeight = 0;
+  int m_Reallocations = 0;
+};
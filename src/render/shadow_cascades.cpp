@@ -0,0 +1,304 @@
+#include "shadow_cascades.h"
+#include "gl_state_cache.h"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+// Blend between logarithmic (1) and uniform (0) cascade splits
+static const float SPLIT_LAMBDA = 0.75f;
+static const char *MATRIX_NAMES[ShadowStats::MAX_CASCADES] = {
+    "uShadowMatrices[0]", "uShadowMatrices[1]", "uShadowMatrices[2]",
+    "uShadowMatrices[3]"};
+
+ShadowCascades::~ShadowCascades() {
+  if (m_StaticFbo[0]) {
+    glDeleteFramebuffers(CASCADES, m_StaticFbo);
+    glDeleteFramebuffers(CASCADES, m_FinalFbo);
+  }
+  GLStateCache &gl = GLStateCache::Get();
+  gl.DeleteTexture(m_StaticArray);
+  gl.DeleteTexture(m_FinalArray);
+}
+
+void ShadowCascades::Init() {
+  GLStateCache &gl = GLStateCache::Get();
+  auto createArray = [&](bool compare) {
+    GLuint array = 0;
+    glGenTextures(1, &array);
+    gl.BindTexture(0, GL_TEXTURE_2D_ARRAY, array);
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT24, RESOLUTION,
+                 RESOLUTION, CASCADES, 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT,
+                 nullptr);
+    const GLint filter = compare ? GL_LINEAR : GL_NEAREST;
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, filter);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, filter);
+    // Outside the map counts as lit
+    const float border[4] = {1.0f, 1.0f, 1.0f, 1.0f};
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S,
+                    GL_CLAMP_TO_BORDER);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T,
+                    GL_CLAMP_TO_BORDER);
+    glTexParameterfv(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BORDER_COLOR, border);
+    if (compare) {
+      glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_MODE,
+                      GL_COMPARE_REF_TO_TEXTURE);
+      glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_FUNC,
+                      GL_LEQUAL);
+    }
+    return array;
+  };
+  m_StaticArray = createArray(false);
+  m_FinalArray = createArray(true);
+
+  glGenFramebuffers(CASCADES, m_StaticFbo);
+  glGenFramebuffers(CASCADES, m_FinalFbo);
+  for (int c = 0; c < CASCADES; ++c) {
+    for (int pass = 0; pass < 2; ++pass) {
+      const GLuint fbo = pass == 0 ? m_StaticFbo[c] : m_FinalFbo[c];
+      gl.BindFramebuffer(fbo);
+      glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,
+                                pass == 0 ? m_StaticArray : m_FinalArray, 0,
+                                c);
+      glDrawBuffer(GL_NONE);
+      glReadBuffer(GL_NONE);
+      if (glCheckFramebufferStatus(GL_FRAMEBUFFER) !=
+          GL_FRAMEBUFFER_COMPLETE)
+        std::cerr << "Shadow cascade framebuffer incomplete" << std::endl;
+      // Lit until the first composite
+      gl.DepthMask(true);
+      glClear(GL_DEPTH_BUFFER_BIT);
+    }
+  }
+  gl.BindFramebuffer(0);
+}
+
+void ShadowCascades::SetDistance(float distance) {
+  distance = std::max(distance, 1.0f);
+  if (distance == m_Distance)
+    return;
+  m_Distance = distance;
+  Invalidate();
+}
+
+void ShadowCascades::Invalidate() {
+  for (Cascade &c : m_Cascades) {
+    c.radius = 0.0f; // forces a refit
+    c.staticValid = false;
+  }
+}
+
+void ShadowCascades::ToLightSpace(const float p[3], float out[3]) const {
+  for (int j = 0; j < 3; ++j)
+    out[j] = vec3_dot(m_Basis[j], p);
+}
+
+void ShadowCascades::BuildMatrix(Cascade &cascade) const {
+  // Orthographic box [center - h, center + h] on every light-space axis
+  const float inv = 1.0f / cascade.halfSize;
+  Mat4 &m = cascade.viewProj;
+  m = mat4_identity();
+  for (int row = 0; row < 3; ++row) {
+    for (int k = 0; k < 3; ++k)
+      m.m[k * 4 + row] = m_Basis[row][k] * inv;
+    m.m[12 + row] = -cascade.center[row] * inv;
+  }
+  // Sampling matrix: clip [-1, 1] -> texture [0, 1]
+  Mat4 bias = mat4_identity();
+  bias.m[0] = bias.m[5] = bias.m[10] = 0.5f;
+  bias.m[12] = bias.m[13] = bias.m[14] = 0.5f;
+  cascade.shadowMatrix = mat4_mul(bias, m);
+}
+
+void ShadowCascades::Update(const Mat4 &view, const Mat4 &proj,
+                            const float lightDir[3],
+                            const std::vector<float> &changedBounds) {
+  m_Stats.cascadeCount = CASCADES;
+  m_Stats.composites = 0;
+
+  // 1. Light basis; any change of direction invalidates every cascade
+  float forward[3] = {lightDir[0], lightDir[1], lightDir[2]};
+  vec3_normalize(forward);
+  const bool lightMoved = !std::equal(forward, forward + 3, m_LightDir);
+  if (lightMoved) {
+    std::copy(forward, forward + 3, m_LightDir);
+    const float worldUp[3] = {0.0f, 1.0f, 0.0f};
+    const float worldX[3] = {1.0f, 0.0f, 0.0f};
+    const float *ref = std::fabs(forward[1]) < 0.99f ? worldUp : worldX;
+    vec3_cross(forward, ref, m_Basis[0]);
+    vec3_normalize(m_Basis[0]);
+    vec3_cross(m_Basis[0], forward, m_Basis[1]);
+    std::copy(forward, forward + 3, m_Basis[2]);
+  }
+
+  // 2. Splits and the bounding sphere of each frustum slice
+  const float zNear = proj.m[14] / (proj.m[10] - 1.0f);
+  const float zFar = std::min(proj.m[14] / (proj.m[10] + 1.0f), m_Distance);
+  // Squared slope of the frustum's corner rays
+  const float k2 =
+      1.0f / (proj.m[0] * proj.m[0]) + 1.0f / (proj.m[5] * proj.m[5]);
+  float cameraPos[3], cameraFwd[3];
+  for (int k = 0; k < 3; ++k) {
+    cameraPos[k] = -(view.m[k * 4] * view.m[12] +
+                     view.m[k * 4 + 1] * view.m[13] +
+                     view.m[k * 4 + 2] * view.m[14]);
+    cameraFwd[k] = -view.m[k * 4 + 2];
+  }
+
+  float splitNear = zNear;
+  for (int i = 0; i < CASCADES; ++i) {
+    Cascade &c = m_Cascades[i];
+    ShadowCascadeStats &stats = m_Stats.cascades[i];
+    const float t = (float)(i + 1) / CASCADES;
+    const float splitFar =
+        SPLIT_LAMBDA * zNear * std::pow(zFar / zNear, t) +
+        (1.0f - SPLIT_LAMBDA) * (zNear + (zFar - zNear) * t);
+    // Point on the view axis equidistant from the slice's near and far
+    // corners
+    float along = 0.5f * (splitFar + splitNear) * (1.0f + k2);
+    float radius;
+    if (along >= splitFar) {
+      along = splitFar;
+      radius = splitFar * std::sqrt(k2);
+    } else {
+      radius = std::sqrt((splitFar - along) * (splitFar - along) +
+                         splitFar * splitFar * k2);
+    }
+    float world[3], center[3];
+    for (int k = 0; k < 3; ++k)
+      world[k] = cameraPos[k] + cameraFwd[k] * along;
+    ToLightSpace(world, center);
+    c.splitNear = splitNear;
+    c.splitFar = splitFar;
+    splitNear = splitFar;
+    stats = ShadowCascadeStats();
+    stats.splitFar = splitFar;
+
+    // 3. Re-centre only when the sphere leaves the box
+    bool refit = lightMoved || radius != c.radius;
+    for (int k = 0; k < 3 && !refit; ++k)
+      refit = std::fabs(center[k] - c.center[k]) + radius > c.halfSize;
+    if (refit) {
+      c.radius = radius;
+      c.halfSize = radius * (1.0f + MARGIN);
+      const float texel = 2.0f * c.halfSize / RESOLUTION;
+      for (int k = 0; k < 3; ++k)
+        c.center[k] = std::floor(center[k] / texel + 0.5f) * texel;
+      BuildMatrix(c);
+      c.staticValid = false;
+      continue;
+    }
+
+    // 4. Static geometry changed inside the cascade
+    for (size_t b = 0; c.staticValid && b + 6 <= changedBounds.size();
+         b += 6) {
+      if (Overlaps(i, &changedBounds[b]))
+        c.staticValid = false;
+    }
+  }
+}
+
+bool ShadowCascades::Overlaps(int cascade, const float *box) const {
+  const Cascade &c = m_Cascades[cascade];
+  float center[3], extent[3];
+  for (int k = 0; k < 3; ++k) {
+    center[k] = 0.5f * (box[k] + box[3 + k]);
+    extent[k] = 0.5f * (box[3 + k] - box[k]);
+  }
+  float lightCenter[3];
+  ToLightSpace(center, lightCenter);
+  for (int j = 0; j < 3; ++j) {
+    const float lightExtent = std::fabs(m_Basis[j][0]) * extent[0] +
+                              std::fabs(m_Basis[j][1]) * extent[1] +
+                              std::fabs(m_Basis[j][2]) * extent[2];
+    const float d = lightCenter[j] - c.center[j];
+    // Along the light only the far side limits: nearer casters are clamped
+    if (j < 2 ? std::fabs(d) > c.halfSize + lightExtent
+              : d - lightExtent > c.halfSize)
+      return false;
+  }
+  return true;
+}
+
+void ShadowCascades::BeginPass() {
+  GLStateCache &gl = GLStateCache::Get();
+  m_SavedFbo = gl.GetFramebuffer();
+  gl.GetViewport(m_SavedViewport);
+  gl.Viewport(0, 0, RESOLUTION, RESOLUTION);
+  gl.SetEnabled(GL_DEPTH_TEST, true);
+  gl.DepthMask(true);
+  gl.PolygonMode(GL_FILL);
+  gl.SetEnabled(GL_DEPTH_CLAMP, true);
+  // Slope-scaled bias; the shader adds a normal offset on top
+  gl.SetEnabled(GL_POLYGON_OFFSET_FILL, true);
+  glPolygonOffset(2.0f, 4.0f);
+  gl.CountForwarded();
+}
+
+bool ShadowCascades::BeginStatic(int cascade) {
+  Cascade &c = m_Cascades[cascade];
+  if (c.staticValid) {
+    m_Stats.cascades[cascade].cached = true;
+    m_Stats.cacheHits++;
+    return false;
+  }
+  GLStateCache::Get().BindFramebuffer(m_StaticFbo[cascade]);
+  glClear(GL_DEPTH_BUFFER_BIT);
+  return true;
+}
+
+void ShadowCascades::EndStatic(int cascade, int draws) {
+  Cascade &c = m_Cascades[cascade];
+  c.staticValid = true;
+  c.finalStale = true;
+  m_Stats.cascades[cascade].staticDraws = draws;
+  m_Stats.staticRenders++;
+}
+
+bool ShadowCascades::BeginDynamic(int cascade, int casters) {
+  Cascade &c = m_Cascades[cascade];
+  m_Stats.cascades[cascade].dynamicCasters = casters;
+  // Nothing to add and the last composite is the cached layer as is
+  if (casters == 0 && !c.finalStale && !c.finalHasDynamic)
+    return false;
+
+  GLStateCache &gl = GLStateCache::Get();
+  gl.BindFramebuffer(m_FinalFbo[cascade]);
+  gl.BindReadFramebuffer(m_StaticFbo[cascade]);
+  glBlitFramebuffer(0, 0, RESOLUTION, RESOLUTION, 0, 0, RESOLUTION,
+                    RESOLUTION, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+  gl.CountForwarded();
+  m_Stats.composites++;
+  c.finalStale = false;
+  c.finalHasDynamic = casters > 0;
+  return casters > 0;
+}
+
+void ShadowCascades::EndDynamic(int cascade, int draws) {
+  m_Stats.cascades[cascade].dynamicDraws = draws;
+}
+
+void ShadowCascades::EndPass() {
+  GLStateCache &gl = GLStateCache::Get();
+  gl.SetEnabled(GL_POLYGON_OFFSET_FILL, false);
+  gl.SetEnabled(GL_DEPTH_CLAMP, false);
+  gl.BindFramebuffer(m_SavedFbo);
+  gl.Viewport(m_SavedViewport[0], m_SavedViewport[1], m_SavedViewport[2],
+              m_SavedViewport[3]);
+}
+
+void ShadowCascades::Bind(GLuint program) const {
+  GLStateCache &gl = GLStateCache::Get();
+  gl.BindTexture(UNIT_SHADOW, GL_TEXTURE_2D_ARRAY, m_FinalArray);
+  gl.SetUniform1i(gl.GetUniformLocation(program, "uShadowMap"), UNIT_SHADOW);
+  float splits[4] = {1e30f, 1e30f, 1e30f, 1e30f};
+  float texels[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+  for (int i = 0; i < CASCADES; ++i) {
+    gl.SetUniformMatrix4fv(gl.GetUniformLocation(program, MATRIX_NAMES[i]),
+                           m_Cascades[i].shadowMatrix.m);
+    splits[i] = m_Cascades[i].splitFar;
+    texels[i] = 2.0f * m_Cascades[i].halfSize / RESOLUTION;
+  }
+  // Past the last split the sun is unshadowed
+  gl.SetUniform4fv(gl.GetUniformLocation(program, "uCascadeSplits"), splits);
+  gl.SetUniform4fv(gl.GetUniformLocation(program, "uCascadeTexels"), texels);
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include "../utils/math_utils.h"
+#include "render_stats.h"
+#include <glad/glad.h>
+#include <vector>
+
+// Cascaded shadow maps for the directional (sun) light, with a cached
+// static layer per cascade.
+//
+// Each cascade covers a depth range of the view (practical split scheme)
+// with a light-space orthographic box around the bounding sphere of that
+// frustum slice. The box is made MARGIN larger than the sphere and only
+// re-centred (snapped to whole texels) once the sphere leaves it, so small
+// camera moves keep the same light matrix.
+//
+// Static casters (chunk batches) are drawn into a cached depth layer that is
+// redrawn only when the light moves, the cascade re-centres or a changed
+// chunk overlaps the cascade volume. Every frame the cascades that have
+// dynamic casters (loose cubes) get the cached layer blitted into the
+// sampled array and the dynamic casters drawn on top; cascades without any
+// keep the last composite. Casters between the light and the box are
+// flattened onto its near plane with depth clamping ("pancaking"), so the
+// culling only tests the sides and the far plane.
+class ShadowCascades {
+public:
+  static constexpr int CASCADES = 3;
+  static constexpr int RESOLUTION = 1024;
+  static constexpr float MARGIN = 0.25f;
+  // Texture unit used by Bind
+  static constexpr int UNIT_SHADOW = 4;
+  static_assert(CASCADES <= ShadowStats::MAX_CASCADES, "stats size");
+
+  ShadowCascades() = default;
+  ~ShadowCascades();
+
+  ShadowCascades(const ShadowCascades &) = delete;
+  ShadowCascades &operator=(const ShadowCascades &) = delete;
+
+  // Requires a current GL context
+  void Init();
+
+  // View distance covered by the last cascade (clamped to the far plane)
+  void SetDistance(float distance);
+  float GetDistance() const { return m_Distance; }
+  // Forgets the cached layers (e.g. after changes that were not reported)
+  void Invalidate();
+
+  // Fits the cascades for this (perspective) view. lightDir is the
+  // direction the light travels; changedBounds holds world AABBs (min xyz,
+  // max xyz) of static geometry that changed since the last call.
+  void Update(const Mat4 &view, const Mat4 &proj, const float lightDir[3],
+              const std::vector<float> &changedBounds);
+
+  const Mat4 &GetLightViewProj(int cascade) const {
+    return m_Cascades[cascade].viewProj;
+  }
+  // World AABB (min xyz, max xyz) against the cascade box, extended
+  // towards the light
+  bool Overlaps(int cascade, const float *box) const;
+
+  // Saves the framebuffer/viewport and sets up depth-only rendering
+  void BeginPass();
+  // True if the static layer must be redrawn; binds it cleared
+  bool BeginStatic(int cascade);
+  void EndStatic(int cascade, int draws);
+  // Composites the static layer into the sampled one when needed. True if
+  // the caller has to draw its dynamic casters (the layer is bound).
+  bool BeginDynamic(int cascade, int casters);
+  void EndDynamic(int cascade, int draws);
+  void EndPass();
+
+  // Binds the shadow array and sets the cascade uniforms of `program`
+  // (which must be current)
+  void Bind(GLuint program) const;
+
+  const ShadowStats &GetStats() const { return m_Stats; }
+
+private:
+  struct Cascade {
+    float splitNear = 0.0f, splitFar = 0.0f;
+    float radius = 0.0f;                // bounding sphere of the slice
+    float halfSize = 0.0f;              // of the ortho box
+    float center[3] = {0, 0, 0};        // light space, texel snapped
+    Mat4 viewProj;                      // world -> light clip space
+    Mat4 shadowMatrix;                  // world -> shadow map uv, depth
+    bool staticValid = false;           // cached layer up to date
+    bool finalHasDynamic = false;       // sampled layer holds dynamic casters
+    bool finalStale = true;             // sampled layer older than the cache
+  };
+
+  void ToLightSpace(const float p[3], float out[3]) const;
+  void BuildMatrix(Cascade &cascade) const;
+
+  Cascade m_Cascades[CASCADES];
+  float m_Distance = 60.0f;
+  float m_LightDir[3] = {0.0f, 0.0f, 0.0f};
+  float m_Basis[3][3] = {}; // light-space right, up, forward
+
+  // Static cache and sampled array, one FBO per layer of each
+  GLuint m_StaticArray = 0, m_FinalArray = 0;
+  GLuint m_StaticFbo[CASCADES] = {};
+  GLuint m_FinalFbo[CASCADES] = {};
+  GLuint m_SavedFbo = 0;
+  GLint m_SavedViewport[4] = {0, 0, 0, 0};
+
+  ShadowStats m_Stats;
+};
@@ -0,0 +1,408 @@
+#include "texture_cache.h"
+#include "block_compress.h"
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+namespace {
+
+const char CACHE_MAGIC[4] = {'M', 'T', 'X', '1'};
+// Bump when the encoders or the mip filter change
+const uint32_t CACHE_VERSION = 1;
+const uint32_t MAX_LEVELS = 16;
+
+struct FileHeader {
+  char magic[4];
+  uint32_t version;
+  uint64_t key;
+  uint32_t format;
+  uint32_t width;
+  uint32_t height;
+  uint32_t levels;
+};
+
+struct FileLevel {
+  uint32_t width;
+  uint32_t height;
+  uint64_t offset;
+  uint64_t size;
+};
+
+std::string g_Dir;
+
+size_t Align16(size_t v) { return (v + 15) & ~(size_t)15; }
+
+size_t LevelSize(TextureFormat format, int width, int height) {
+  const size_t blockBytes = TextureCache::BlockBytes(format);
+  if (blockBytes == 0)
+    return (size_t)width * height * 4;
+  return BlockCompress::CompressedSize(width, height, blockBytes);
+}
+
+std::string EntryPath(uint64_t key) {
+  char name[32];
+  std::snprintf(name, sizeof(name), "%016llx.mtex", (unsigned long long)key);
+  return (std::filesystem::path(g_Dir) / name).string();
+}
+
+bool ReadFile(const std::string &path, std::vector<uint8_t> &out) {
+  std::ifstream file(path, std::ios::binary | std::ios::ate);
+  if (!file)
+    return false;
+  const std::streamsize size = file.tellg();
+  file.seekg(0);
+  out.resize((size_t)size);
+  return size > 0 && file.read(reinterpret_cast<char *>(out.data()), size);
+}
+
+TextureFormat ChooseFormat(const Image &base,
+                           const TextureImportSettings &settings) {
+  TextureFormat format = TextureFormat::RGBA8;
+  switch (settings.compression) {
+  case TextureCompression::None:
+    format = TextureFormat::RGBA8;
+    break;
+  case TextureCompression::BC1:
+    format = TextureFormat::BC1;
+    break;
+  case TextureCompression::BC3:
+    format = TextureFormat::BC3;
+    break;
+  case TextureCompression::BC4:
+    format = TextureFormat::BC4;
+    break;
+  case TextureCompression::Auto:
+    if (base.width <= settings.smallSize && base.height <= settings.smallSize)
+      format = TextureFormat::RGBA8;
+    else if (BlockCompress::HasAlpha(base))
+      format = TextureFormat::BC3;
+    else if (BlockCompress::IsGrey(base))
+      format = TextureFormat::BC4;
+    else
+      format = TextureFormat::BC1;
+    break;
+  }
+  if (!settings.allowS3TC &&
+      (format == TextureFormat::BC1 || format == TextureFormat::BC3))
+    format = TextureFormat::RGBA8;
+  return format;
+}
+
+double MsSince(std::chrono::high_resolution_clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(
+             std::chrono::high_resolution_clock::now() - start)
+      .count();
+}
+
+} // namespace
+
+size_t TextureData::ByteSize() const {
+  size_t total = 0;
+  for (const TextureLevel &level : levels)
+    total += level.size;
+  return total;
+}
+
+namespace TextureCache {
+
+void SetDirectory(const std::string &dir) { g_Dir = dir; }
+const std::string &GetDirectory() { return g_Dir; }
+
+size_t BlockBytes(TextureFormat format) {
+  switch (format) {
+  case TextureFormat::BC1:
+  case TextureFormat::BC4:
+    return 8;
+  case TextureFormat::BC3:
+    return 16;
+  default:
+    return 0;
+  }
+}
+
+uint64_t Key(const uint8_t *source, size_t size,
+             const TextureImportSettings &settings) {
+  // FNV-1a over 64-bit words: the source can be megabytes and this runs on
+  // every load, hit or miss
+  uint64_t h = 14695981039346656037ull;
+  auto mix = [&h](uint64_t v) {
+    h ^= v;
+    h *= 1099511628211ull;
+  };
+  mix(CACHE_VERSION);
+  mix((uint64_t)settings.compression);
+  mix(settings.mips ? 1 : 0);
+  mix((uint64_t)settings.smallSize);
+  mix(settings.allowS3TC ? 1 : 0);
+  mix(size);
+  size_t i = 0;
+  for (; i + 8 <= size; i += 8) {
+    uint64_t word;
+    std::memcpy(&word, source + i, 8);
+    mix(word);
+  }
+  for (; i < size; ++i)
+    mix(source[i]);
+  return h;
+}
+
+void Encode(const std::vector<Image> &mips,
+            const TextureImportSettings &settings, TextureData &out) {
+  out.format = ChooseFormat(mips[0], settings);
+  out.mapping.reset();
+  out.levels.resize(mips.size());
+  size_t total = 0;
+  for (size_t i = 0; i < mips.size(); ++i) {
+    TextureLevel &level = out.levels[i];
+    level.width = mips[i].width;
+    level.height = mips[i].height;
+    level.size = LevelSize(out.format, level.width, level.height);
+    total = Align16(total) + level.size;
+  }
+  out.storage.assign(total, 0);
+
+  size_t offset = 0;
+  for (size_t i = 0; i < mips.size(); ++i) {
+    TextureLevel &level = out.levels[i];
+    offset = Align16(offset);
+    uint8_t *dst = out.storage.data() + offset;
+    switch (out.format) {
+    case TextureFormat::RGBA8:
+      std::memcpy(dst, mips[i].pixels.data(), level.size);
+      break;
+    case TextureFormat::BC1:
+      BlockCompress::EncodeBC1(mips[i], dst);
+      break;
+    case TextureFormat::BC3:
+      BlockCompress::EncodeBC3(mips[i], dst);
+      break;
+    case TextureFormat::BC4:
+      BlockCompress::EncodeBC4(mips[i], dst);
+      break;
+    }
+    level.data = dst;
+    offset += level.size;
+  }
+}
+
+bool Read(uint64_t key, TextureData &out) {
+  if (g_Dir.empty())
+    return false;
+  auto mapping = std::make_unique<MappedFile>();
+  if (!mapping->Open(EntryPath(key)))
+    return false;
+  const uint8_t *base = mapping->Data();
+  const size_t fileSize = mapping->Size();
+
+  FileHeader header;
+  if (fileSize < sizeof(header))
+    return false;
+  std::memcpy(&header, base, sizeof(header));
+  if (std::memcmp(header.magic, CACHE_MAGIC, 4) != 0 ||
+      header.version != CACHE_VERSION || header.key != key ||
+      header.format > (uint32_t)TextureFormat::BC4 || header.levels == 0 ||
+      header.levels > MAX_LEVELS ||
+      fileSize < sizeof(header) + header.levels * sizeof(FileLevel))
+    return false;
+
+  const TextureFormat format = (TextureFormat)header.format;
+  std::vector<TextureLevel> levels(header.levels);
+  for (uint32_t i = 0; i < header.levels; ++i) {
+    FileLevel entry;
+    std::memcpy(&entry, base + sizeof(header) + i * sizeof(FileLevel),
+                sizeof(entry));
+    // A truncated or foreign file must not send reads past the mapping
+    if (entry.width == 0 || entry.height == 0 ||
+        entry.size != LevelSize(format, entry.width, entry.height) ||
+        entry.offset > fileSize || entry.size > fileSize - entry.offset)
+      return false;
+    levels[i].width = (int)entry.width;
+    levels[i].height = (int)entry.height;
+    levels[i].data = base + entry.offset;
+    levels[i].size = (size_t)entry.size;
+  }
+
+  out.format = format;
+  out.levels = std::move(levels);
+  out.storage.clear();
+  out.mapping = std::move(mapping);
+  return true;
+}
+
+bool Write(uint64_t key, const TextureData &data) {
+  if (g_Dir.empty() || data.levels.empty())
+    return false;
+  std::error_code ec;
+  std::filesystem::create_directories(g_Dir, ec);
+
+  FileHeader header;
+  std::memcpy(header.magic, CACHE_MAGIC, 4);
+  header.version = CACHE_VERSION;
+  header.key = key;
+  header.format = (uint32_t)data.format;
+  header.width = (uint32_t)data.levels[0].width;
+  header.height = (uint32_t)data.levels[0].height;
+  header.levels = (uint32_t)data.levels.size();
+
+  std::vector<FileLevel> table(data.levels.size());
+  size_t offset = sizeof(header) + table.size() * sizeof(FileLevel);
+  for (size_t i = 0; i < data.levels.size(); ++i) {
+    offset = Align16(offset);
+    table[i] = {(uint32_t)data.levels[i].width,
+                (uint32_t)data.levels[i].height, (uint64_t)offset,
+                (uint64_t)data.levels[i].size};
+    offset += data.levels[i].size;
+  }
+
+  // Temp file + rename: a concurrent reader never maps a half-written entry
+  const std::string path = EntryPath(key);
+  char suffix[32];
+  std::snprintf(suffix, sizeof(suffix), ".%p.tmp", (const void *)&data);
+  const std::string tmp = path + suffix;
+  {
+    std::ofstream file(tmp, std::ios::binary | std::ios::trunc);
+    if (!file)
+      return false;
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char *>(table.data()),
+               table.size() * sizeof(FileLevel));
+    size_t written = sizeof(header) + table.size() * sizeof(FileLevel);
+    const char padding[16] = {};
+    for (size_t i = 0; i < data.levels.size(); ++i) {
+      file.write(padding, table[i].offset - written);
+      file.write(reinterpret_cast<const char *>(data.levels[i].data),
+                 data.levels[i].size);
+      written = table[i].offset + data.levels[i].size;
+    }
+    if (!file) {
+      file.close();
+      std::filesystem::remove(tmp, ec);
+      return false;
+    }
+  }
+  std::filesystem::rename(tmp, path, ec);
+  if (ec) {
+    std::filesystem::remove(tmp, ec);
+    return false;
+  }
+  return true;
+}
+
+bool Import(const std::string &path, const TextureImportSettings &settings,
+            TextureData &out, bool &cacheHit, std::string &error) {
+  cacheHit = false;
+  std::vector<uint8_t> source;
+  if (!ReadFile(path, source)) {
+    error = "cannot read file";
+    return false;
+  }
+  const uint64_t key = Key(source.data(), source.size(), settings);
+  if (Read(key, out)) {
+    cacheHit = true;
+    return true;
+  }
+
+  std::vector<Image> mips(1);
+  if (!ImageLoader::Decode(source.data(), source.size(), mips[0], error))
+    return false;
+  if (settings.mips)
+    ImageLoader::BuildMipChain(mips);
+  Encode(mips, settings, out);
+  Write(key, out);
+  return true;
+}
+
+TextureCacheBenchmark RunBenchmark(const std::vector<std::string> &files,
+                                   int loads,
+                                   const TextureImportSettings &settings) {
+  using Clock = std::chrono::high_resolution_clock;
+  TextureCacheBenchmark result;
+  if (files.empty() || loads <= 0) {
+    result.error = "no textures";
+    return result;
+  }
+  if (g_Dir.empty()) {
+    result.error = "texture cache disabled";
+    return result;
+  }
+  result.files = (int)files.size();
+  result.loads = loads;
+
+  // Stand-in for the copy into the upload buffer, which both paths pay and
+  // which is where a mapped entry is actually paged in
+  std::vector<uint8_t> staging;
+  auto copyOut = [&staging](const uint8_t *data, size_t size) {
+    if (staging.size() < size)
+      staging.resize(size);
+    std::memcpy(staging.data(), data, size);
+  };
+
+  // 1. Uncached: what every load cost before the cache
+  auto start = Clock::now();
+  for (int i = 0; i < loads; ++i) {
+    const std::string &path = files[i % files.size()];
+    std::vector<uint8_t> source;
+    std::vector<Image> mips(1);
+    std::string error;
+    if (!ReadFile(path, source) ||
+        !ImageLoader::Decode(source.data(), source.size(), mips[0], error)) {
+      result.error = path + ": " + (error.empty() ? "cannot read" : error);
+      return result;
+    }
+    if (settings.mips)
+      ImageLoader::BuildMipChain(mips);
+    for (const Image &mip : mips) {
+      copyOut(mip.pixels.data(), mip.ByteSize());
+      if (i < (int)files.size())
+        result.decodedBytes += mip.ByteSize();
+    }
+    if (i < (int)files.size())
+      result.sourceBytes += source.size();
+  }
+  result.coldMs = MsSince(start);
+
+  // 2. Import each file once, overwriting whatever entry it had
+  std::vector<uint64_t> keys;
+  start = Clock::now();
+  for (const std::string &path : files) {
+    std::vector<uint8_t> source;
+    std::vector<Image> mips(1);
+    std::string error;
+    ReadFile(path, source);
+    ImageLoader::Decode(source.data(), source.size(), mips[0], error);
+    if (settings.mips)
+      ImageLoader::BuildMipChain(mips);
+    TextureData data;
+    Encode(mips, settings, data);
+    keys.push_back(Key(source.data(), source.size(), settings));
+    if (!Write(keys.back(), data)) {
+      result.error = "cannot write to " + g_Dir;
+      return result;
+    }
+    result.cachedBytes += data.ByteSize();
+  }
+  // Per load, comparable with the other two
+  result.importMs = MsSince(start) * loads / files.size();
+
+  // 3. Cached: the same loads, all hits
+  start = Clock::now();
+  for (int i = 0; i < loads; ++i) {
+    const std::string &path = files[i % files.size()];
+    std::vector<uint8_t> source;
+    ReadFile(path, source);
+    TextureData data;
+    if (Key(source.data(), source.size(), settings) != keys[i % files.size()] ||
+        !Read(keys[i % files.size()], data)) {
+      result.error = path + ": cache miss";
+      return result;
+    }
+    for (const TextureLevel &level : data.levels)
+      copyOut(level.data, level.size);
+  }
+  result.cachedMs = MsSince(start);
+  return result;
+}
+
+} // namespace TextureCache
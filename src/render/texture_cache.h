@@ -0,0 +1,105 @@
+#pragma once
+
+#include "../core/mapped_file.h"
+#include "image_loader.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// GPU-ready pixel formats stored in the cache
+enum class TextureFormat : uint32_t { RGBA8 = 0, BC1 = 1, BC3 = 2, BC4 = 3 };
+
+enum class TextureCompression : uint32_t {
+  Auto = 0, // BC4 for grey, BC3 with alpha, BC1 otherwise; RGBA8 when small
+  None,     // RGBA8
+  BC1,
+  BC3,
+  BC4,
+};
+
+struct TextureImportSettings {
+  TextureCompression compression = TextureCompression::Auto;
+  bool mips = true;
+  // Auto keeps textures up to this size a side in RGBA8, so they can be
+  // packed into the atlas (see TexturePacker)
+  int smallSize = 64;
+  // BC1/BC3 need GL_EXT_texture_compression_s3tc; without it they fall back
+  // to RGBA8 (BC4 is core since GL 3.0)
+  bool allowS3TC = true;
+};
+
+struct TextureLevel {
+  int width = 0;
+  int height = 0;
+  const uint8_t *data = nullptr;
+  size_t size = 0;
+};
+
+// Every level of a texture in its final format. The bytes live either in
+// `storage` (fresh import) or in the mapped cache file.
+struct TextureData {
+  TextureFormat format = TextureFormat::RGBA8;
+  std::vector<TextureLevel> levels;
+  std::vector<uint8_t> storage;
+  std::unique_ptr<MappedFile> mapping;
+
+  size_t ByteSize() const;
+};
+
+// Resultados del benchmark de la cache
+struct TextureCacheBenchmark {
+  int loads = 0;
+  int files = 0;
+  double coldMs = 0.0;   // read + decode + mips
+  double importMs = 0.0; // cold + block compression + cache write
+  double cachedMs = 0.0; // read + hash + map + touch every level
+  size_t sourceBytes = 0;
+  size_t decodedBytes = 0; // RGBA8 with mips
+  size_t cachedBytes = 0;
+  std::string error;
+};
+
+// Derived-data cache for imported textures. An entry holds the whole mip
+// chain already converted to the GPU format, in a file that is memory
+// mapped on load, so a hit costs hashing the source plus copying the levels
+// into the upload buffers: no decode, no filtering, no compression.
+//
+// Entries are named after a key built from the source file bytes and the
+// import settings; changing either produces a new entry. Layout of
+// "<dir>/<key>.mtex":
+//   header { "MTX1", version, key, format, width, height, levels }
+//   level table { width, height, offset, size } x levels
+//   level data, each level 16-byte aligned
+// Safe to call from worker threads once the directory is set.
+namespace TextureCache {
+
+// Empty disables the cache (every import decodes). Set at startup, before
+// any load is submitted.
+void SetDirectory(const std::string &dir);
+const std::string &GetDirectory();
+
+size_t BlockBytes(TextureFormat format); // 0 for RGBA8
+uint64_t Key(const uint8_t *source, size_t size,
+             const TextureImportSettings &settings);
+
+// Converts a decoded mip chain (mips[0] = base) to its final format
+void Encode(const std::vector<Image> &mips,
+            const TextureImportSettings &settings, TextureData &out);
+
+bool Read(uint64_t key, TextureData &out);
+bool Write(uint64_t key, const TextureData &data);
+
+// Cached entry if there is one, otherwise decode, build mips, compress and
+// store the result for next time
+bool Import(const std::string &path, const TextureImportSettings &settings,
+            TextureData &out, bool &cacheHit, std::string &error);
+
+// Loads `loads` textures cycling over `files`: first the uncached path,
+// then an import that fills the cache, then cache hits only.
+TextureCacheBenchmark RunBenchmark(const std::vector<std::string> &files,
+                                   int loads,
+                                   const TextureImportSettings &settings);
+
+} // namespace TextureCache
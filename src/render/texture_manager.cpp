@@ -0,0 +1,344 @@
+#include "texture_manager.h"
+#include "../core/job_system.h"
+#include "gl_state_cache.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+
+// A budget must fit at least one row of the largest accepted image
+static const size_t MIN_BUDGET = 64 * 1024;
+
+// Pixel rows per upload row: compressed levels go by rows of blocks
+static int RowHeight(TextureFormat format) {
+  return format == TextureFormat::RGBA8 ? 1 : 4;
+}
+
+static size_t RowBytes(TextureFormat format, int width) {
+  const size_t blockBytes = TextureCache::BlockBytes(format);
+  return blockBytes ? (size_t)((width + 3) / 4) * blockBytes
+                    : (size_t)width * 4;
+}
+
+TextureManager &TextureManager::Get() {
+  static TextureManager instance;
+  return instance;
+}
+
+void TextureManager::Init() {
+  GLStateCache &gl = GLStateCache::Get();
+  gl.BindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+  // Layer 0: white placeholder. Layer 1: magenta/black checkerboard for
+  // files that failed to decode
+  uint8_t pixels[2][8 * 8 * 4];
+  for (int i = 0; i < 64; ++i) {
+    const bool odd = ((i % 8) / 4 + (i / 8) / 4) & 1;
+    const uint8_t white[4] = {255, 255, 255, 255};
+    const uint8_t checker[4] = {uint8_t(odd ? 255 : 0), 0,
+                                uint8_t(odd ? 255 : 0), 255};
+    std::memcpy(&pixels[0][i * 4], white, 4);
+    std::memcpy(&pixels[1][i * 4], checker, 4);
+  }
+  glGenTextures(1, &m_Defaults);
+  gl.BindTexture(0, GL_TEXTURE_2D_ARRAY, m_Defaults);
+  glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, 8, 8, 2, 0, GL_RGBA,
+               GL_UNSIGNED_BYTE, pixels);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, 0);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  m_PlaceholderSlot.array = m_Defaults;
+  m_PlaceholderSlot.layer = 0;
+  m_PlaceholderSlot.width = m_PlaceholderSlot.height = 8;
+  m_MissingSlot = m_PlaceholderSlot;
+  m_MissingSlot.layer = 1;
+
+  for (RingBuffer &rb : m_Ring)
+    glGenBuffers(1, &rb.pbo);
+
+  m_S3TC = GLAD_GL_EXT_texture_compression_s3tc != 0;
+}
+
+TextureHandle TextureManager::Load(const std::string &path,
+                                   const TextureImportSettings &settings) {
+  if (path.empty())
+    return 0;
+  auto it = m_Lookup.find(path);
+  if (it != m_Lookup.end())
+    return it->second;
+
+  Entry entry;
+  entry.path = path;
+  entry.decode = std::make_shared<DecodeResult>();
+  entry.decode->path = path;
+  entry.decode->settings = settings;
+  entry.decode->settings.allowS3TC = settings.allowS3TC && m_S3TC;
+  std::shared_ptr<DecodeResult> decode = entry.decode;
+  m_Entries.push_back(std::move(entry));
+  const TextureHandle handle = (TextureHandle)m_Entries.size();
+  m_Lookup.emplace(path, handle);
+  m_Decoding.push_back(handle);
+  m_Stats.requested++;
+
+  JobSystem::Get().SubmitBackground([decode] {
+    decode->ok = TextureCache::Import(decode->path, decode->settings,
+                                      decode->data, decode->cacheHit,
+                                      decode->error);
+    decode->done.store(true, std::memory_order_release);
+  });
+  return handle;
+}
+
+const TextureSlot &TextureManager::GetSlot(TextureHandle handle) const {
+  if (handle == 0 || handle > m_Entries.size())
+    return m_PlaceholderSlot;
+  const Entry &entry = m_Entries[handle - 1];
+  if (entry.state == State::Resident)
+    return entry.slot;
+  return entry.state == State::Failed ? m_MissingSlot : m_PlaceholderSlot;
+}
+
+bool TextureManager::IsResident(TextureHandle handle) const {
+  return handle != 0 && handle <= m_Entries.size() &&
+         m_Entries[handle - 1].state == State::Resident;
+}
+
+bool TextureManager::IsFailed(TextureHandle handle) const {
+  return handle != 0 && handle <= m_Entries.size() &&
+         m_Entries[handle - 1].state == State::Failed;
+}
+
+const std::string &TextureManager::GetPath(TextureHandle handle) const {
+  static const std::string empty;
+  if (handle == 0 || handle > m_Entries.size())
+    return empty;
+  return m_Entries[handle - 1].path;
+}
+
+void TextureManager::SetUploadBudget(size_t bytesPerFrame) {
+  m_Budget = std::max(bytesPerFrame, MIN_BUDGET);
+}
+
+void TextureManager::Update() {
+  auto start = std::chrono::high_resolution_clock::now();
+  GLStateCache::Get().BindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+  // 1. Finished decodes join the upload queue
+  for (size_t i = 0; i < m_Decoding.size();) {
+    const TextureHandle handle = m_Decoding[i];
+    Entry &entry = m_Entries[handle - 1];
+    if (!entry.decode->done.load(std::memory_order_acquire)) {
+      ++i;
+      continue;
+    }
+    if (entry.decode->ok) {
+      if (entry.decode->cacheHit)
+        m_Stats.cacheHits++;
+      else
+        m_Stats.imported++;
+      entry.state = State::Uploading;
+      m_UploadQueue.push_back(handle);
+    } else {
+      std::cerr << "Texture '" << entry.path
+                << "' failed to load: " << entry.decode->error << std::endl;
+      entry.state = State::Failed;
+      entry.decode.reset();
+      m_Stats.failed++;
+    }
+    m_Decoding[i] = m_Decoding.back();
+    m_Decoding.pop_back();
+  }
+
+  // 2. Stream pixels within the budget
+  m_Stats.uploadedBytes = 0;
+  if (!m_UploadQueue.empty())
+    Upload();
+
+  m_Stats.decoding = (int)m_Decoding.size();
+  m_Stats.uploading = (int)m_UploadQueue.size();
+  m_Stats.updateMs = std::chrono::duration<float, std::milli>(
+                         std::chrono::high_resolution_clock::now() - start)
+                         .count();
+}
+
+void TextureManager::Upload() {
+  GLStateCache &gl = GLStateCache::Get();
+  RingBuffer &rb = m_Ring[m_RingIndex];
+  if (rb.fence) {
+    // Never wait: if the GPU has not consumed this buffer yet, skip a frame
+    if (glClientWaitSync(rb.fence, 0, 0) == GL_TIMEOUT_EXPIRED) {
+      m_Stats.ringStalls++;
+      return;
+    }
+    glDeleteSync(rb.fence);
+    rb.fence = nullptr;
+  }
+
+  gl.BindBuffer(GL_PIXEL_UNPACK_BUFFER, rb.pbo);
+  if (m_RingCapacity != m_Budget) {
+    // Budget changed: reallocate every buffer of the ring (all are idle
+    // or about to be orphaned)
+    m_RingCapacity = m_Budget;
+    for (RingBuffer &other : m_Ring) {
+      gl.BindBuffer(GL_PIXEL_UNPACK_BUFFER, other.pbo);
+      glBufferData(GL_PIXEL_UNPACK_BUFFER, m_RingCapacity, nullptr,
+                   GL_STREAM_DRAW);
+    }
+    gl.BindBuffer(GL_PIXEL_UNPACK_BUFFER, rb.pbo);
+  }
+  // The fence above guarantees the GPU is done with this buffer
+  uint8_t *dst = (uint8_t *)glMapBufferRange(
+      GL_PIXEL_UNPACK_BUFFER, 0, m_RingCapacity,
+      GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT |
+          GL_MAP_INVALIDATE_BUFFER_BIT);
+  if (!dst) {
+    gl.BindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    return;
+  }
+
+  // Copy front to back of the queue until the budget is spent
+  m_Slices.clear();
+  size_t used = 0;
+  size_t completed = 0;
+  for (TextureHandle handle : m_UploadQueue) {
+    Entry &entry = m_Entries[handle - 1];
+    if (!entry.allocated) {
+      // The slot is taken when the cursor first reaches the texture, so a
+      // new array page is created in the frame that starts filling it.
+      // Needs no unpack buffer bound (it would read from it).
+      gl.BindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+      if (!m_Packer.Allocate(entry.decode->data, entry.slot)) {
+        // Nothing to upload; resolved as failed below
+        entry.slot = m_MissingSlot;
+        entry.level = (int)entry.decode->data.levels.size();
+      }
+      entry.allocated = true;
+      gl.BindBuffer(GL_PIXEL_UNPACK_BUFFER, rb.pbo);
+    }
+    const bool copied = entry.slot.atlas ? CopyAtlasLevels(entry, dst, used)
+                                         : CopyRows(entry, dst, used);
+    if (!copied)
+      break;
+    completed++;
+  }
+  glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
+  for (const Slice &slice : m_Slices) {
+    gl.BindTexture(0, GL_TEXTURE_2D_ARRAY, slice.array);
+    if (slice.format == TextureFormat::RGBA8) {
+      glTexSubImage3D(GL_TEXTURE_2D_ARRAY, slice.level, slice.x, slice.y,
+                      slice.layer, slice.width, slice.height, 1, GL_RGBA,
+                      GL_UNSIGNED_BYTE, (const void *)slice.offset);
+    } else {
+      glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, slice.level, slice.x,
+                                slice.y, slice.layer, slice.width, slice.height,
+                                1, TextureInternalFormat(slice.format),
+                                (GLsizei)slice.size,
+                                (const void *)slice.offset);
+    }
+  }
+  gl.CountForwarded(m_Slices.size());
+  rb.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  m_RingIndex = (m_RingIndex + 1) % RING_SIZE;
+  gl.BindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+  // Every level is queued on the GPU: the texture can be sampled from now on
+  for (size_t i = 0; i < completed; ++i) {
+    Entry &entry = m_Entries[m_UploadQueue.front() - 1];
+    if (entry.slot.array == m_Defaults) {
+      entry.state = State::Failed;
+      m_Stats.failed++;
+    } else {
+      m_Stats.residentBytes += entry.decode->data.ByteSize();
+      entry.state = State::Resident;
+      m_Stats.resident++;
+    }
+    entry.decode.reset();
+    m_UploadQueue.pop_front();
+  }
+  m_Stats.uploadedBytes = used;
+}
+
+bool TextureManager::CopyRows(Entry &entry, uint8_t *dst, size_t &used) {
+  const TextureData &data = entry.decode->data;
+  const int rowHeight = RowHeight(data.format);
+  while (entry.level < (int)data.levels.size()) {
+    const TextureLevel &level = data.levels[entry.level];
+    const size_t rowBytes = RowBytes(data.format, level.width);
+    const int levelRows = (level.height + rowHeight - 1) / rowHeight;
+    const int rows = (int)std::min<size_t>(levelRows - entry.row,
+                                           (m_RingCapacity - used) / rowBytes);
+    if (rows == 0)
+      return false;
+    // For a cache hit this is where the mapped pages are read in
+    std::memcpy(dst + used, level.data + entry.row * rowBytes,
+                rows * rowBytes);
+    Slice slice;
+    slice.array = entry.slot.array;
+    slice.format = data.format;
+    slice.level = entry.level;
+    slice.layer = entry.slot.layer;
+    slice.x = 0;
+    slice.y = entry.row * rowHeight;
+    slice.width = level.width;
+    // The last block row may cover fewer than 4 pixel rows
+    slice.height = std::min(rows * rowHeight, level.height - slice.y);
+    slice.offset = used;
+    slice.size = rows * rowBytes;
+    m_Slices.push_back(slice);
+    used += slice.size;
+    entry.row += rows;
+    if (entry.row == levelRows) {
+      entry.level++;
+      entry.row = 0;
+    }
+  }
+  return true;
+}
+
+bool TextureManager::CopyAtlasLevels(Entry &entry, uint8_t *dst,
+                                     size_t &used) {
+  const TextureData &data = entry.decode->data;
+  const TextureSlot &slot = entry.slot;
+  for (; entry.level < TexturePacker::ATLAS_LEVELS; entry.level++) {
+    // Atlas levels past the end of the chain are 1x1, like its last level
+    const TextureLevel &level = data.levels[std::min<size_t>(
+        entry.level, data.levels.size() - 1)];
+    const int pad = TexturePacker::ATLAS_PADDING >> entry.level;
+    const int width = level.width + 2 * pad;
+    const int height = level.height + 2 * pad;
+    const size_t size = (size_t)width * height * 4;
+    // Small enough to always go in one piece
+    if (size > m_RingCapacity - used)
+      return false;
+
+    // Content plus a border repeating the edge texels
+    uint8_t *out = dst + used;
+    const size_t rowBytes = (size_t)level.width * 4;
+    for (int y = 0; y < height; ++y) {
+      const int sy = std::min(std::max(y - pad, 0), level.height - 1);
+      const uint8_t *row = level.data + sy * rowBytes;
+      for (int x = 0; x < pad; ++x, out += 4)
+        std::memcpy(out, row, 4);
+      std::memcpy(out, row, rowBytes);
+      out += rowBytes;
+      for (int x = 0; x < pad; ++x, out += 4)
+        std::memcpy(out, row + rowBytes - 4, 4);
+    }
+
+    Slice slice;
+    slice.array = slot.array;
+    slice.format = TextureFormat::RGBA8;
+    slice.level = entry.level;
+    slice.layer = slot.layer;
+    slice.x = (slot.x >> entry.level) - pad;
+    slice.y = (slot.y >> entry.level) - pad;
+    slice.width = width;
+    slice.height = height;
+    slice.offset = used;
+    slice.size = size;
+    m_Slices.push_back(slice);
+    used += size;
+  }
+  return true;
+}
@@ -0,0 +1,140 @@
+#pragma once
+
+#include "texture_cache.h"
+#include "texture_packer.h"
+#include <glad/glad.h>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// 0 = no texture
+using TextureHandle = uint32_t;
+
+// Contadores del streaming de texturas (panel Stats)
+struct TextureStats {
+  int requested = 0;
+  int decoding = 0;  // on worker threads
+  int uploading = 0; // decoded, waiting for or in the middle of uploads
+  int resident = 0;
+  int failed = 0;
+  size_t uploadedBytes = 0; // last Update
+  size_t residentBytes = 0;
+  int ringStalls = 0;       // Updates skipped because the PBO was still busy
+  int cacheHits = 0;        // loaded from the derived-data cache
+  int imported = 0;         // decoded and compressed (cache misses)
+  float updateMs = 0.0f;
+};
+
+// Asynchronous texture loading. Load() returns a handle immediately; a
+// background job maps the file's entry in the TextureCache, or on a miss
+// decodes it, builds the mip chain, block-compresses it and stores the
+// entry. The levels are then uploaded on the GL thread by Update() through
+// a ring of pixel-unpack buffers, at most the per-frame byte budget at a
+// time (large levels are split by rows of pixels or of 4x4 blocks), into a
+// slot handed out by the TexturePacker: a layer of an array shared with
+// same-sized textures, or a rectangle of an atlas layer. Until every level
+// is uploaded GetSlot() returns a white placeholder layer, and a
+// checkerboard if the file could not be decoded.
+class TextureManager {
+public:
+  static TextureManager &Get();
+
+  TextureManager(const TextureManager &) = delete;
+  TextureManager &operator=(const TextureManager &) = delete;
+
+  // Requires a current GL context
+  void Init();
+
+  // Same path, same handle (the first settings win). An empty path
+  // returns 0.
+  TextureHandle Load(const std::string &path,
+                     const TextureImportSettings &settings = {});
+
+  // Array texture, layer and uv rect to sample; always valid
+  const TextureSlot &GetSlot(TextureHandle handle) const;
+  bool IsResident(TextureHandle handle) const;
+  // The file could not be read or decoded (GetSlot is the checkerboard)
+  bool IsFailed(TextureHandle handle) const;
+  const std::string &GetPath(TextureHandle handle) const;
+
+  // Once per frame on the GL thread
+  void Update();
+
+  void SetUploadBudget(size_t bytesPerFrame);
+  size_t GetUploadBudget() const { return m_Budget; }
+  const TextureStats &GetStats() const { return m_Stats; }
+  const TexturePackerStats &GetPackerStats() const {
+    return m_Packer.GetStats();
+  }
+
+private:
+  TextureManager() = default;
+
+  enum class State { Decoding, Uploading, Resident, Failed };
+
+  // Worker output, published through `done`
+  struct DecodeResult {
+    std::string path;
+    TextureImportSettings settings;
+    TextureData data;
+    std::string error;
+    bool ok = false;
+    bool cacheHit = false;
+    std::atomic<bool> done{false};
+  };
+  struct Entry {
+    std::string path;
+    State state = State::Decoding;
+    bool allocated = false;
+    TextureSlot slot;
+    std::shared_ptr<DecodeResult> decode;
+    // Upload cursor
+    int level = 0;
+    int row = 0;
+  };
+  // A region of one level copied into the current PBO: a row range (rows
+  // of 4x4 blocks for compressed formats), or a whole padded atlas rect
+  struct Slice {
+    GLuint array;
+    TextureFormat format;
+    int level, layer;
+    int x, y, width, height;
+    size_t offset, size;
+  };
+  struct RingBuffer {
+    GLuint pbo = 0;
+    GLsync fence = nullptr;
+  };
+
+  static const int RING_SIZE = 3;
+
+  void Upload();
+  // Copy as much of the texture as fits into the mapped PBO; true once
+  // every level has been copied
+  bool CopyRows(Entry &entry, uint8_t *dst, size_t &used);
+  bool CopyAtlasLevels(Entry &entry, uint8_t *dst, size_t &used);
+
+  std::vector<Entry> m_Entries; // handle - 1
+  std::unordered_map<std::string, TextureHandle> m_Lookup;
+  std::vector<TextureHandle> m_Decoding;
+  std::deque<TextureHandle> m_UploadQueue;
+  std::vector<Slice> m_Slices;
+
+  RingBuffer m_Ring[RING_SIZE];
+  int m_RingIndex = 0;
+  size_t m_Budget = 4 * 1024 * 1024;
+  size_t m_RingCapacity = 0;
+
+  TexturePacker m_Packer;
+  // Layer 0 white placeholder, layer 1 checkerboard
+  GLuint m_Defaults = 0;
+  TextureSlot m_PlaceholderSlot;
+  TextureSlot m_MissingSlot;
+  bool m_S3TC = false;
+  TextureStats m_Stats;
+};
@@ -0,0 +1,220 @@
+#include "texture_packer.h"
+#include "gl_state_cache.h"
+#include <algorithm>
+#include <iostream>
+
+// imgui builds its copy of stb_rect_pack with static linkage, so this file
+// compiles its own from the same header
+#define STBRP_STATIC
+#define STB_RECT_PACK_IMPLEMENTATION
+#include "imstb_rectpack.h"
+
+namespace {
+
+// Atlas layers are packed in cells of this many texels, which keeps every
+// content origin a multiple of 2^(ATLAS_LEVELS - 1)
+const int ATLAS_CELL = 1 << (TexturePacker::ATLAS_LEVELS - 1);
+const int ATLAS_CELLS = TexturePacker::ATLAS_SIZE / ATLAS_CELL;
+const size_t MAX_PAGE_BYTES = 64 * 1024 * 1024;
+
+size_t LevelBytes(TextureFormat format, int width, int height) {
+  const size_t blockBytes = TextureCache::BlockBytes(format);
+  if (blockBytes == 0)
+    return (size_t)width * height * 4;
+  return (size_t)((width + 3) / 4) * ((height + 3) / 4) * blockBytes;
+}
+
+int FullChainLevels(int width, int height) {
+  int levels = 1;
+  for (int size = std::max(width, height); size > 1; size /= 2)
+    levels++;
+  return levels;
+}
+
+} // namespace
+
+GLenum TextureInternalFormat(TextureFormat format) {
+  switch (format) {
+  case TextureFormat::BC1:
+    return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+  case TextureFormat::BC3:
+    return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+  case TextureFormat::BC4:
+    return GL_COMPRESSED_RED_RGTC1;
+  default:
+    return GL_RGBA8;
+  }
+}
+
+struct TexturePacker::AtlasLayer {
+  GLuint texture = 0;
+  int layer = 0;
+  stbrp_context context;
+  std::vector<stbrp_node> nodes;
+};
+
+GLuint TexturePacker::CreateArray(TextureFormat format, int width, int height,
+                                  int levels, int layers, bool clampToEdge) {
+  GLStateCache &gl = GLStateCache::Get();
+  const GLenum internalFormat = TextureInternalFormat(format);
+  GLuint texture = 0;
+  glGenTextures(1, &texture);
+  gl.BindTexture(0, GL_TEXTURE_2D_ARRAY, texture);
+  size_t bytes = 0;
+  for (int level = 0; level < levels; ++level) {
+    bytes += LevelBytes(format, std::max(1, width >> level),
+                        std::max(1, height >> level)) *
+             layers;
+  }
+  // Storage only; contents arrive through the upload ring
+  if (GLAD_GL_VERSION_4_2) {
+    glTexStorage3D(GL_TEXTURE_2D_ARRAY, levels, internalFormat, width, height,
+                   layers);
+  } else {
+    for (int level = 0; level < levels; ++level) {
+      const int w = std::max(1, width >> level);
+      const int h = std::max(1, height >> level);
+      if (format == TextureFormat::RGBA8) {
+        glTexImage3D(GL_TEXTURE_2D_ARRAY, level, GL_RGBA8, w, h, layers, 0,
+                     GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+      } else {
+        glCompressedTexImage3D(GL_TEXTURE_2D_ARRAY, level, internalFormat, w,
+                               h, layers, 0,
+                               (GLsizei)(LevelBytes(format, w, h) * layers),
+                               nullptr);
+      }
+    }
+  }
+  if (glGetError() == GL_OUT_OF_MEMORY) {
+    std::cerr << "Texture array " << width << "x" << height << "x" << layers
+              << " could not be allocated" << std::endl;
+    gl.DeleteTexture(texture);
+    return 0;
+  }
+  if (format == TextureFormat::BC4) {
+    // Single channel: sample it as grey
+    const GLint swizzle[4] = {GL_RED, GL_RED, GL_RED, GL_ONE};
+    glTexParameteriv(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_SWIZZLE_RGBA, swizzle);
+  }
+  const GLint wrap = clampToEdge ? GL_CLAMP_TO_EDGE : GL_REPEAT;
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, levels - 1);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER,
+                  GL_LINEAR_MIPMAP_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, wrap);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, wrap);
+
+  m_Stats.arrays++;
+  m_Stats.allocatedBytes += bytes;
+  return texture;
+}
+
+bool TexturePacker::Allocate(const TextureData &data, TextureSlot &slot) {
+  const TextureLevel &base = data.levels[0];
+  const int levels = (int)data.levels.size();
+  if (data.format == TextureFormat::RGBA8 &&
+      base.width <= ATLAS_MAX_TEXTURE && base.height <= ATLAS_MAX_TEXTURE &&
+      levels == FullChainLevels(base.width, base.height))
+    return AllocateAtlas(data, slot);
+
+  auto it = std::find_if(m_Buckets.begin(), m_Buckets.end(),
+                         [&](const Bucket &b) {
+                           return b.format == data.format &&
+                                  b.width == base.width &&
+                                  b.height == base.height && b.levels == levels;
+                         });
+  if (it == m_Buckets.end()) {
+    m_Buckets.push_back({data.format, base.width, base.height, levels, {}});
+    it = m_Buckets.end() - 1;
+  }
+  Bucket &bucket = *it;
+  if (bucket.pages.empty() ||
+      bucket.pages.back().used == bucket.pages.back().capacity) {
+    // Start small (most sizes are used by a handful of textures) and double
+    const size_t layerBytes = std::max<size_t>(data.ByteSize(), 1);
+    int capacity = bucket.pages.empty()
+                       ? 4
+                       : std::min(bucket.pages.back().capacity * 2, MAX_LAYERS);
+    capacity = std::max(
+        1, std::min<int>(capacity, (int)(MAX_PAGE_BYTES / layerBytes)));
+    Page page;
+    page.capacity = capacity;
+    page.texture = CreateArray(data.format, base.width, base.height, levels,
+                               capacity, false);
+    if (!page.texture)
+      return false;
+    bucket.pages.push_back(page);
+    m_Stats.layersAllocated += capacity;
+  }
+
+  Page &page = bucket.pages.back();
+  slot = TextureSlot();
+  slot.array = page.texture;
+  slot.layer = page.used++;
+  slot.width = base.width;
+  slot.height = base.height;
+  m_Stats.layersUsed++;
+  return true;
+}
+
+bool TexturePacker::AllocateAtlas(const TextureData &data, TextureSlot &slot) {
+  const TextureLevel &base = data.levels[0];
+  stbrp_rect rect = {};
+  rect.w = (base.width + 2 * ATLAS_PADDING + ATLAS_CELL - 1) / ATLAS_CELL;
+  rect.h = (base.height + 2 * ATLAS_PADDING + ATLAS_CELL - 1) / ATLAS_CELL;
+
+  AtlasLayer *target = nullptr;
+  for (auto &layer : m_AtlasLayers) {
+    stbrp_pack_rects(&layer->context, &rect, 1);
+    if (rect.was_packed) {
+      target = layer.get();
+      break;
+    }
+  }
+  if (!target) {
+    if (m_AtlasPages.empty() ||
+        m_AtlasPages.back().used == m_AtlasPages.back().capacity) {
+      Page page;
+      page.capacity = m_AtlasPages.empty()
+                          ? 1
+                          : std::min(m_AtlasPages.back().capacity * 2, 8);
+      page.texture = CreateArray(TextureFormat::RGBA8, ATLAS_SIZE, ATLAS_SIZE,
+                                 ATLAS_LEVELS, page.capacity, true);
+      if (!page.texture)
+        return false;
+      m_AtlasPages.push_back(page);
+    }
+    Page &page = m_AtlasPages.back();
+    auto layer = std::make_shared<AtlasLayer>();
+    layer->texture = page.texture;
+    layer->layer = page.used++;
+    layer->nodes.resize(ATLAS_CELLS);
+    stbrp_init_target(&layer->context, ATLAS_CELLS, ATLAS_CELLS,
+                      layer->nodes.data(), (int)layer->nodes.size());
+    stbrp_pack_rects(&layer->context, &rect, 1);
+    target = layer.get();
+    m_AtlasLayers.push_back(std::move(layer));
+    m_Stats.atlasLayers++;
+  }
+
+  const float inv = 1.0f / ATLAS_SIZE;
+  slot = TextureSlot();
+  slot.array = target->texture;
+  slot.layer = target->layer;
+  slot.atlas = true;
+  slot.x = rect.x * ATLAS_CELL + ATLAS_PADDING;
+  slot.y = rect.y * ATLAS_CELL + ATLAS_PADDING;
+  slot.width = base.width;
+  slot.height = base.height;
+  slot.rect[0] = slot.x * inv;
+  slot.rect[1] = slot.y * inv;
+  slot.rect[2] = slot.width * inv;
+  slot.rect[3] = slot.height * inv;
+
+  m_AtlasArea += (size_t)base.width * base.height;
+  m_Stats.atlasTextures++;
+  m_Stats.atlasFill =
+      (float)((double)m_AtlasArea /
+              ((double)m_Stats.atlasLayers * ATLAS_SIZE * ATLAS_SIZE));
+  return true;
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include "texture_cache.h"
+#include <glad/glad.h>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+// Where a texture's pixels live: a layer of a GL_TEXTURE_2D_ARRAY, and for
+// atlas pages a padded rectangle of that layer
+struct TextureSlot {
+  GLuint array = 0;
+  int layer = 0;
+  bool atlas = false;
+  int x = 0, y = 0; // texel origin of the content at level 0
+  int width = 0, height = 0;
+  float rect[4] = {0.0f, 0.0f, 1.0f, 1.0f}; // uv offset (xy) and scale (zw)
+};
+
+GLenum TextureInternalFormat(TextureFormat format);
+
+// Contadores del empaquetado (panel Stats)
+struct TexturePackerStats {
+  int arrays = 0;       // GL array textures (array pages + atlas pages)
+  int layersUsed = 0;   // one per texture packed by size
+  int layersAllocated = 0;
+  int atlasTextures = 0;
+  int atlasLayers = 0;
+  float atlasFill = 0.0f; // packed area / allocated atlas area
+  size_t allocatedBytes = 0;
+};
+
+// Groups resident textures so that objects with different textures can be
+// drawn together. Textures with the same size, format and level count share
+// a GL_TEXTURE_2D_ARRAY, one layer each. Small RGBA8 textures (up to
+// ATLAS_MAX_TEXTURE texels a side, with a full mip chain) are packed into
+// ATLAS_SIZE^2 atlas layers instead, with an ATLAS_PADDING texel border that
+// the uploader fills by replicating the edges so bilinear and mip sampling
+// never bleed into neighbours.
+//
+// Arrays cannot grow in place on GL 3.3, so each bucket is a list of pages
+// whose layer count doubles up to MAX_LAYERS. Textures are never removed and
+// the arrays live as long as the GL context. GL thread only.
+class TexturePacker {
+public:
+  static constexpr int ATLAS_SIZE = 1024;
+  static constexpr int ATLAS_MAX_TEXTURE = 64;
+  static constexpr int ATLAS_PADDING = 4;
+  // Levels kept by atlas layers; content origins are aligned so every level
+  // lands on whole texels
+  static constexpr int ATLAS_LEVELS = 3;
+  static constexpr int MAX_LAYERS = 64;
+
+  TexturePacker() = default;
+
+  TexturePacker(const TexturePacker &) = delete;
+  TexturePacker &operator=(const TexturePacker &) = delete;
+
+  // Creates array storage as needed; false if the GL could not allocate it
+  bool Allocate(const TextureData &data, TextureSlot &slot);
+
+  const TexturePackerStats &GetStats() const { return m_Stats; }
+
+private:
+  struct Page {
+    GLuint texture = 0;
+    int capacity = 0;
+    int used = 0;
+  };
+  struct Bucket {
+    TextureFormat format;
+    int width, height, levels;
+    std::vector<Page> pages;
+  };
+  struct AtlasLayer;
+
+  GLuint CreateArray(TextureFormat format, int width, int height, int levels,
+                     int layers, bool clampToEdge);
+  bool AllocateAtlas(const TextureData &data, TextureSlot &slot);
+
+  std::vector<Bucket> m_Buckets;
+  // Atlas pages are arrays too; their layers are separate packing targets
+  std::vector<Page> m_AtlasPages;
+  // shared_ptr: AtlasLayer holds the stb_rect_pack state, defined in the .cpp
+  std::vector<std::shared_ptr<AtlasLayer>> m_AtlasLayers;
+  size_t m_AtlasArea = 0;
+  TexturePackerStats m_Stats;
+};
@@ -0,0 +1,484 @@
+#include "chunk_grid.h"
+#include "../core/job_system.h"
+#include "../render/gl_state_cache.h"
+#include "../render/indirect_draw.h"
+#include "../render/mesh_library.h"
+#include "../render/occlusion_culler.h"
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+
+// Members kept per chunk as occluder candidates
+static const size_t OCCLUDERS_PER_CHUNK = 4;
+static const int CUBE_INDEX_COUNT = 36;
+
+static uint32_t PackColor(const float c[4]) {
+  auto to8 = [](float v) {
+    return (uint32_t)(std::min(1.0f, std::max(0.0f, v)) * 255.0f + 0.5f);
+  };
+  return to8(c[0]) | to8(c[1]) << 8 | to8(c[2]) << 16 | to8(c[3]) << 24;
+}
+
+ChunkGrid::~ChunkGrid() { Clear(); }
+
+void ChunkGrid::Clear() {
+  for (auto &entry : m_Chunks)
+    DestroyChunk(*entry.second);
+  m_Chunks.clear();
+  m_Snapshots.clear();
+  m_Dynamic.clear();
+  m_Dirty.clear();
+  m_Culled.clear();
+  m_CulledViews = 0;
+}
+
+uint64_t ChunkGrid::ChunkKey(const float pos[3]) {
+  // 21 bits per axis, biased so negative coordinates stay positive
+  uint64_t key = 0;
+  for (int k = 0; k < 3; ++k) {
+    int64_t cell = (int64_t)std::floor(pos[k] / CHUNK_SIZE) + (1 << 20);
+    key |= (uint64_t)(cell & 0x1FFFFF) << (21 * k);
+  }
+  return key;
+}
+
+bool ChunkGrid::SameTransform(const Snapshot &s, const CubeInst &c) {
+  for (int k = 0; k < 3; ++k) {
+    if (s.pos[k] != c.pos[k] || s.rotation[k] != c.rotation[k] ||
+        s.scale[k] != c.scale[k])
+      return false;
+  }
+  return true;
+}
+
+void ChunkGrid::MarkDirty(uint64_t key) { m_Dirty.push_back(key); }
+
+std::vector<uint32_t> &ChunkGrid::MemberList(uint64_t key) {
+  if (key == NO_CHUNK)
+    return m_Dynamic;
+  std::unique_ptr<Chunk> &chunk = m_Chunks[key];
+  if (!chunk)
+    chunk.reset(new Chunk());
+  return chunk->members;
+}
+
+void ChunkGrid::Leave(uint32_t index) {
+  Snapshot &s = m_Snapshots[index];
+  if (s.slot == NO_SLOT)
+    return;
+  // Swap-and-pop; the last member takes the slot
+  std::vector<uint32_t> &list = MemberList(s.chunk);
+  const uint32_t last = list.back();
+  list[s.slot] = last;
+  m_Snapshots[last].slot = s.slot;
+  list.pop_back();
+  s.slot = NO_SLOT;
+  if (s.chunk != NO_CHUNK)
+    MarkDirty(s.chunk);
+}
+
+void ChunkGrid::Join(uint32_t index) {
+  Snapshot &s = m_Snapshots[index];
+  std::vector<uint32_t> &list = MemberList(s.chunk);
+  s.slot = (uint32_t)list.size();
+  list.push_back(index);
+  if (s.chunk != NO_CHUNK)
+    MarkDirty(s.chunk);
+}
+
+void ChunkGrid::AddChangedBounds(const float bounds[6]) {
+  m_ChangedBounds.insert(m_ChangedBounds.end(), bounds, bounds + 6);
+}
+
+void ChunkGrid::Sync(const std::vector<CubeInst> &cubes,
+                     const std::vector<Material> &materials,
+                     std::vector<uint32_t> &loose, size_t first,
+                     size_t end) {
+  m_Stats.rebuildsCompleted = 0;
+  m_ChangedBounds.clear();
+  loose.clear();
+
+  // 1. Diff the changed range against last frame's snapshot. A cube whose
+  // snapshot changes leaves its chunk's member list (or the dynamic list)
+  // and joins the one it belongs to now, so both stay current without a
+  // scan of the scene
+  const size_t n = cubes.size();
+  const size_t previous = m_Snapshots.size();
+  for (size_t i = previous; i-- > n;)
+    Leave((uint32_t)i);
+  m_Snapshots.resize(n, Snapshot{{}, {}, {}, -2, false, NO_CHUNK, NO_SLOT});
+
+  auto diff = [&](size_t i) {
+    const CubeInst &c = cubes[i];
+    Snapshot &s = m_Snapshots[i];
+    if (s.material == c.material && s.selected == c.selected &&
+        SameTransform(s, c))
+      return;
+    Leave((uint32_t)i);
+    for (int k = 0; k < 3; ++k) {
+      s.pos[k] = c.pos[k];
+      s.rotation[k] = c.rotation[k];
+      s.scale[k] = c.scale[k];
+    }
+    s.material = c.material;
+    s.selected = c.selected;
+    // Textured materials need their own texture bind: instanced path
+    const bool dynamic =
+        c.selected || materials[c.material].diffuseHandle != 0;
+    s.chunk = dynamic ? NO_CHUNK : ChunkKey(c.pos);
+    Join((uint32_t)i);
+  };
+  end = std::min(end, std::min(n, previous));
+  for (size_t i = first; i < end; ++i)
+    diff(i);
+  for (size_t i = previous; i < n; ++i)
+    diff(i);
+  loose = m_Dynamic;
+
+  // 2. Touched chunks get a new version; emptied ones go away
+  if (!m_Dirty.empty()) {
+    const auto now = std::chrono::high_resolution_clock::now();
+    std::sort(m_Dirty.begin(), m_Dirty.end());
+    m_Dirty.erase(std::unique(m_Dirty.begin(), m_Dirty.end()), m_Dirty.end());
+    for (uint64_t key : m_Dirty) {
+      auto it = m_Chunks.find(key);
+      Chunk &chunk = *it->second;
+      // Its batch stops being drawn until the rebuild lands
+      if (chunk.Ready())
+        AddChangedBounds(chunk.bounds);
+      if (chunk.members.empty()) {
+        DestroyChunk(chunk);
+        m_Chunks.erase(it);
+        continue;
+      }
+      chunk.version++;
+      if (!chunk.dirtyPending) {
+        chunk.dirtyPending = true;
+        chunk.dirtySince = now;
+      }
+    }
+    m_Dirty.clear();
+  }
+
+  // 3. Upload finished builds, start new ones
+  JobSystem &jobs = JobSystem::Get();
+  m_Stats.pendingChunks = 0;
+  for (auto &entry : m_Chunks) {
+    Chunk &chunk = *entry.second;
+    if (chunk.building &&
+        chunk.building->done.load(std::memory_order_acquire)) {
+      if (chunk.building->version == chunk.version)
+        Upload(chunk, *chunk.building);
+      chunk.building.reset();
+    }
+    if (chunk.Ready())
+      continue;
+
+    m_Stats.pendingChunks++;
+    loose.insert(loose.end(), chunk.members.begin(), chunk.members.end());
+    if (chunk.building)
+      continue; // an older version is still in flight
+
+    std::shared_ptr<BuildResult> build = std::make_shared<BuildResult>();
+    build->version = chunk.version;
+    build->sources.reserve(chunk.members.size());
+    for (uint32_t index : chunk.members) {
+      const CubeInst &c = cubes[index];
+      BuildSource src;
+      for (int k = 0; k < 3; ++k) {
+        src.pos[k] = c.pos[k];
+        src.rotation[k] = c.rotation[k];
+        src.scale[k] = c.scale[k];
+      }
+      const Material &mat = materials[c.material];
+      src.color[0] = mat.color[0];
+      src.color[1] = mat.color[1];
+      src.color[2] = mat.color[2];
+      // Alpha carries emission (scene shader EMISSION permutation)
+      src.color[3] = std::min(std::max(mat.emission, 0.0f), 1.0f);
+      src.surface[0] = mat.metallic;
+      src.surface[1] = mat.roughness;
+      src.surface[2] = src.surface[3] = 0.0f;
+      build->sources.push_back(src);
+    }
+    chunk.building = build;
+    // Latency tolerant (the members are drawn loose meanwhile): behind the
+    // frame's culling and sort work
+    jobs.SubmitBackground([build] {
+      Build(*build);
+      build->done.store(true, std::memory_order_release);
+    });
+  }
+  m_Stats.chunks = (int)m_Chunks.size();
+}
+
+void ChunkGrid::Build(BuildResult &result) {
+  static std::vector<MeshVertex> cubeVertices;
+  static std::vector<uint32_t> cubeIndices;
+  static const bool init = [] {
+    MeshLibrary::BuildCube(cubeVertices, cubeIndices);
+    return true;
+  }();
+  (void)init;
+
+  const size_t count = result.sources.size();
+  result.vertices.clear();
+  result.indices.clear();
+  result.vertices.reserve(count * cubeVertices.size());
+  result.indices.reserve(count * cubeIndices.size());
+  result.boxes.resize(count * 6);
+  for (int k = 0; k < 3; ++k) {
+    result.bounds[k] = 1e30f;
+    result.bounds[3 + k] = -1e30f;
+  }
+
+  std::vector<std::pair<float, size_t>> largest;
+  for (size_t i = 0; i < count; ++i) {
+    const BuildSource &src = result.sources[i];
+    Mat4 m = mat4_model_trs(src.pos, src.rotation, src.scale);
+    const uint32_t color = PackColor(src.color);
+    const uint32_t surface = PackColor(src.surface);
+    const uint32_t base = (uint32_t)result.vertices.size();
+
+    for (const MeshVertex &v : cubeVertices) {
+      ChunkVertex out;
+      mat4_transform_point(m, v.pos, out.pos);
+      for (int r = 0; r < 3; ++r)
+        out.normal[r] = m.m[r] * v.normal[0] + m.m[4 + r] * v.normal[1] +
+                        m.m[8 + r] * v.normal[2];
+      vec3_normalize(out.normal);
+      out.color = color;
+      out.surface = surface;
+      result.vertices.push_back(out);
+    }
+    for (uint32_t index : cubeIndices)
+      result.indices.push_back(base + index);
+
+    float *box = &result.boxes[i * 6];
+    for (int k = 0; k < 3; ++k) {
+      float extent = 0.5f * (std::fabs(m.m[k]) + std::fabs(m.m[4 + k]) +
+                             std::fabs(m.m[8 + k]));
+      box[k] = m.m[12 + k] - extent;
+      box[3 + k] = m.m[12 + k] + extent;
+      result.bounds[k] = std::min(result.bounds[k], box[k]);
+      result.bounds[3 + k] = std::max(result.bounds[3 + k], box[3 + k]);
+    }
+
+    const float *s = src.scale;
+    largest.push_back({s[0] * s[1] + s[1] * s[2] + s[0] * s[2], i});
+  }
+
+  const size_t keep = std::min(largest.size(), OCCLUDERS_PER_CHUNK);
+  std::partial_sort(largest.begin(), largest.begin() + keep, largest.end(),
+                    [](const std::pair<float, size_t> &a,
+                       const std::pair<float, size_t> &b) {
+                      return a.first > b.first;
+                    });
+  result.occluders.clear();
+  for (size_t i = 0; i < keep; ++i) {
+    const BuildSource &src = result.sources[largest[i].second];
+    result.occluders.push_back(
+        mat4_model_trs(src.pos, src.rotation, src.scale));
+  }
+}
+
+void ChunkGrid::Upload(Chunk &chunk, const BuildResult &result) {
+  GLStateCache &gl = GLStateCache::Get();
+  if (!chunk.vao) {
+    glGenVertexArrays(1, &chunk.vao);
+    glGenBuffers(1, &chunk.vbo);
+    glGenBuffers(1, &chunk.ebo);
+    gl.BindVertexArray(chunk.vao);
+    gl.BindBuffer(GL_ARRAY_BUFFER, chunk.vbo);
+    gl.BindBuffer(GL_ELEMENT_ARRAY_BUFFER, chunk.ebo);
+    glEnableVertexAttribArray(ATTRIB_POSITION);
+    glVertexAttribPointer(ATTRIB_POSITION, 3, GL_FLOAT, GL_FALSE,
+                          sizeof(ChunkVertex),
+                          (void *)offsetof(ChunkVertex, pos));
+    glEnableVertexAttribArray(ATTRIB_NORMAL);
+    glVertexAttribPointer(ATTRIB_NORMAL, 3, GL_FLOAT, GL_FALSE,
+                          sizeof(ChunkVertex),
+                          (void *)offsetof(ChunkVertex, normal));
+    // Per-vertex colour; the model matrix attributes stay disabled and read
+    // the identity generic value set in Draw
+    glEnableVertexAttribArray(ATTRIB_COLOR);
+    glVertexAttribPointer(ATTRIB_COLOR, 4, GL_UNSIGNED_BYTE, GL_TRUE,
+                          sizeof(ChunkVertex),
+                          (void *)offsetof(ChunkVertex, color));
+    glEnableVertexAttribArray(ATTRIB_SURFACE);
+    glVertexAttribPointer(ATTRIB_SURFACE, 2, GL_UNSIGNED_BYTE, GL_TRUE,
+                          sizeof(ChunkVertex),
+                          (void *)offsetof(ChunkVertex, surface));
+  } else {
+    gl.BindVertexArray(chunk.vao);
+    gl.BindBuffer(GL_ARRAY_BUFFER, chunk.vbo);
+  }
+
+  glBufferData(GL_ARRAY_BUFFER, result.vertices.size() * sizeof(ChunkVertex),
+               result.vertices.data(), GL_STATIC_DRAW);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER,
+               result.indices.size() * sizeof(uint32_t),
+               result.indices.data(), GL_STATIC_DRAW);
+  gl.CountForwarded(2);
+
+  chunk.indexCount = (uint32_t)result.indices.size();
+  chunk.boxes = result.boxes;
+  chunk.occluders = result.occluders;
+  std::copy(result.bounds, result.bounds + 6, chunk.bounds);
+  chunk.builtVersion = result.version;
+  AddChangedBounds(chunk.bounds);
+
+  if (chunk.dirtyPending) {
+    m_Stats.rebuildLatencyMs =
+        std::chrono::duration<float, std::milli>(
+            std::chrono::high_resolution_clock::now() - chunk.dirtySince)
+            .count();
+    chunk.dirtyPending = false;
+  }
+  m_Stats.rebuildsCompleted++;
+}
+
+void ChunkGrid::DestroyChunk(Chunk &chunk) {
+  GLStateCache &gl = GLStateCache::Get();
+  gl.DeleteVertexArray(chunk.vao);
+  gl.DeleteBuffer(chunk.vbo);
+  gl.DeleteBuffer(chunk.ebo);
+  chunk.vao = chunk.vbo = chunk.ebo = 0;
+  // An in-flight build keeps its own BuildResult alive and is dropped
+  chunk.building.reset();
+}
+
+void ChunkGrid::CollectOccluders(const Mat4 &viewProj,
+                                 std::vector<const Mat4 *> &out) const {
+  float planes[6][4];
+  frustum_planes(viewProj, planes);
+  for (const auto &entry : m_Chunks) {
+    const Chunk &chunk = *entry.second;
+    if (!chunk.Ready() ||
+        frustum_classify_box(planes, chunk.bounds) == FRUSTUM_OUTSIDE)
+      continue;
+    for (const Mat4 &m : chunk.occluders)
+      out.push_back(&m);
+  }
+}
+
+void ChunkGrid::Cull(const ViewFrusta &frusta,
+                     const OcclusionCuller *occlusion, JobSystem *jobs) {
+  m_Stats.visibleChunks = 0;
+  m_Stats.partialChunks = 0;
+  m_Stats.drawCalls = 0;
+
+  m_Culled.clear();
+  for (auto &entry : m_Chunks) {
+    if (entry.second->Ready())
+      m_Culled.push_back(entry.second.get());
+  }
+  m_CulledViews = std::min(frusta.count, (int)ViewFrusta::MAX_VIEWS);
+
+  auto cullChunk = [&](Chunk &chunk) {
+    const float *ub = frusta.bounds, *cb = chunk.bounds;
+    const bool inUnion = cb[0] <= ub[3] && cb[3] >= ub[0] && cb[1] <= ub[4] &&
+                         cb[4] >= ub[1] && cb[2] <= ub[5] && cb[5] >= ub[2];
+    for (int v = 0; v < m_CulledViews; ++v) {
+      Chunk::ViewDraw &draw = chunk.views[v];
+      const OcclusionCuller *occ = v == 0 ? occlusion : nullptr;
+      draw.runCounts.clear();
+      draw.runOffsets.clear();
+      draw.cls = inUnion ? frustum_classify_box(frusta.planes[v], cb)
+                         : FRUSTUM_OUTSIDE;
+      if (draw.cls != FRUSTUM_OUTSIDE && occ && !occ->IsVisible(cb, cb + 3))
+        draw.cls = FRUSTUM_OUTSIDE;
+      if (draw.cls != FRUSTUM_PARTIAL)
+        continue;
+
+      // Cut by the frustum: test members, merge consecutive survivors
+      const size_t members = chunk.boxes.size() / 6;
+      for (size_t i = 0; i < members; ++i) {
+        const float *box = &chunk.boxes[i * 6];
+        bool visible =
+            frustum_classify_box(frusta.planes[v], box) != FRUSTUM_OUTSIDE &&
+            (!occ || occ->IsVisible(box, box + 3));
+        if (!visible)
+          continue;
+        const size_t offset = i * CUBE_INDEX_COUNT * sizeof(uint32_t);
+        if (!draw.runOffsets.empty() &&
+            (size_t)draw.runOffsets.back() +
+                    draw.runCounts.back() * sizeof(uint32_t) ==
+                offset) {
+          draw.runCounts.back() += CUBE_INDEX_COUNT;
+        } else {
+          draw.runCounts.push_back(CUBE_INDEX_COUNT);
+          draw.runOffsets.push_back((const void *)offset);
+        }
+      }
+      if (draw.runCounts.empty())
+        draw.cls = FRUSTUM_OUTSIDE;
+    }
+  };
+
+  // Each job owns whole chunks, so the per-view results need no locking
+  if (jobs) {
+    jobs->ParallelFor(m_Culled.size(), 8, [&](size_t begin, size_t end) {
+      for (size_t i = begin; i < end; ++i)
+        cullChunk(*m_Culled[i]);
+    });
+  } else {
+    for (Chunk *chunk : m_Culled)
+      cullChunk(*chunk);
+  }
+}
+
+void ChunkGrid::Draw(int view) {
+  if (view < 0 || view >= m_CulledViews)
+    return;
+  GLStateCache &gl = GLStateCache::Get();
+
+  // Vertices are already in world space
+  const Mat4 identity = mat4_identity();
+  for (int i = 0; i < 4; ++i)
+    glVertexAttrib4fv(ATTRIB_MODEL + i, &identity.m[i * 4]);
+
+  for (Chunk *chunk : m_Culled) {
+    const Chunk::ViewDraw &draw = chunk->views[view];
+    if (draw.cls == FRUSTUM_OUTSIDE)
+      continue;
+    gl.BindVertexArray(chunk->vao);
+    if (draw.cls == FRUSTUM_INSIDE) {
+      glDrawElements(GL_TRIANGLES, (GLsizei)chunk->indexCount,
+                     GL_UNSIGNED_INT, nullptr);
+      m_Stats.visibleChunks++;
+    } else {
+      glMultiDrawElements(GL_TRIANGLES, draw.runCounts.data(),
+                          GL_UNSIGNED_INT, draw.runOffsets.data(),
+                          (GLsizei)draw.runCounts.size());
+      m_Stats.partialChunks++;
+    }
+    m_Stats.drawCalls++;
+  }
+}
+
+int ChunkGrid::DrawCasters(const Mat4 &lightViewProj) {
+  float planes[6][4];
+  frustum_planes(lightViewProj, planes);
+  // Near plane (index 4) always passes
+  planes[4][0] = planes[4][1] = planes[4][2] = 0.0f;
+  planes[4][3] = 1.0f;
+  GLStateCache &gl = GLStateCache::Get();
+
+  const Mat4 identity = mat4_identity();
+  for (int i = 0; i < 4; ++i)
+    glVertexAttrib4fv(ATTRIB_MODEL + i, &identity.m[i * 4]);
+
+  int draws = 0;
+  for (auto &entry : m_Chunks) {
+    Chunk &chunk = *entry.second;
+    if (!chunk.Ready() ||
+        frustum_classify_box(planes, chunk.bounds) == FRUSTUM_OUTSIDE)
+      continue;
+    gl.BindVertexArray(chunk.vao);
+    glDrawElements(GL_TRIANGLES, (GLsizei)chunk.indexCount, GL_UNSIGNED_INT,
+                   nullptr);
+    draws++;
+  }
+  return draws;
+}
@@ -0,0 +1,161 @@
+#pragma once
+
+#include "../render/render_stats.h"
+#include "../utils/math_utils.h"
+#include "scene_defs.h"
+#include <glad/glad.h>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+class JobSystem;
+class OcclusionCuller;
+
+// Uniform grid of CHUNK_SIZE^3 world units over the static cubes.
+//
+// Each chunk owns one merged, pre-transformed vertex/index buffer for the
+// cubes whose center lies inside it. Sync() diffs the cubes the scene
+// reports as changed against a snapshot from the previous frame and moves
+// them between the chunks' member lists, so an edit costs the cubes it
+// touched; only the chunks it touched are marked dirty. Those are rebuilt
+// on the job system's background queue and uploaded on the main thread
+// once ready.
+//
+// Selected cubes and cubes with a textured material are dynamic: they stay
+// out of the chunks and go through the instanced path with the loose cubes.
+class ChunkGrid {
+public:
+  static constexpr float CHUNK_SIZE = 32.0f;
+
+  ChunkGrid() = default;
+  ~ChunkGrid();
+
+  ChunkGrid(const ChunkGrid &) = delete;
+  ChunkGrid &operator=(const ChunkGrid &) = delete;
+
+  void Clear();
+
+  // cubes[i].material must be resolved. Only cubes[first, end) and the
+  // ones past the previous array's end are diffed; the rest must be
+  // unchanged since the last Sync. Fills loose with the indices that the
+  // caller has to draw itself: dynamic cubes and members of chunks without
+  // an up-to-date GPU batch.
+  void Sync(const std::vector<CubeInst> &cubes,
+            const std::vector<Material> &materials,
+            std::vector<uint32_t> &loose, size_t first, size_t end);
+
+  // Large members of the chunks intersecting the frustum, as occluders
+  void CollectOccluders(const Mat4 &viewProj,
+                        std::vector<const Mat4 *> &out) const;
+
+  // Visibility of the ready chunks in every view, computed once for all of
+  // them: chunks outside frusta.bounds are skipped, the rest are classified
+  // per view and the members of chunks cut by a frustum tested and merged
+  // into index runs. Chunks are spread over jobs (may be null). occlusion
+  // may be null (frustum only) and applies to view 0.
+  void Cull(const ViewFrusta &frusta, const OcclusionCuller *occlusion,
+            JobSystem *jobs);
+  // Issues the draws of one view of the last Cull with the currently bound
+  // program (the scene shader's WORLD_SPACE variant or its instanced
+  // fallback; vertex colour alpha is the material emission and the surface
+  // attribute holds metallic/roughness for LIGHTING).
+  void Draw(int view);
+
+  // Depth-only draw of every ready chunk inside a shadow cascade, culled
+  // against all planes of lightViewProj but the near one (casters in front
+  // of it are depth clamped). Returns the draw calls issued.
+  int DrawCasters(const Mat4 &lightViewProj);
+
+  // World AABBs (min xyz, max xyz) of chunk batches that appeared, changed
+  // or went away during the last Sync, for caches of static geometry
+  const std::vector<float> &GetChangedBounds() const {
+    return m_ChangedBounds;
+  }
+
+  const ChunkStats &GetStats() const { return m_Stats; }
+
+private:
+  struct ChunkVertex {
+    float pos[3];
+    float normal[3];
+    uint32_t color;   // RGBA8
+    uint32_t surface; // metallic, roughness (unorm8)
+  };
+  struct BuildSource {
+    float pos[3], rotation[3], scale[3];
+    float color[4];
+    float surface[4]; // metallic, roughness, 0, 0
+  };
+  // Result of a worker rebuild; published through `done`
+  struct BuildResult {
+    std::vector<BuildSource> sources;
+    uint32_t version = 0;
+    std::vector<ChunkVertex> vertices;
+    std::vector<uint32_t> indices;
+    std::vector<float> boxes;    // per member: min xyz, max xyz
+    std::vector<Mat4> occluders; // largest members
+    float bounds[6];
+    std::atomic<bool> done{false};
+  };
+  struct Chunk {
+    std::vector<uint32_t> members; // cube indices, in no order
+    uint32_t version = 0;          // bumped on every change
+    uint32_t builtVersion = ~0u;   // version the GPU batch holds
+    std::shared_ptr<BuildResult> building;
+    std::chrono::high_resolution_clock::time_point dirtySince;
+    bool dirtyPending = false; // dirtySince is set
+    // Cull result per view; the runs are glMultiDrawElements ranges
+    struct ViewDraw {
+      FrustumClass cls = FRUSTUM_OUTSIDE;
+      std::vector<GLsizei> runCounts;
+      std::vector<const void *> runOffsets;
+    };
+    ViewDraw views[ViewFrusta::MAX_VIEWS];
+
+    GLuint vao = 0, vbo = 0, ebo = 0;
+    uint32_t indexCount = 0;
+    std::vector<float> boxes;
+    std::vector<Mat4> occluders;
+    float bounds[6] = {0, 0, 0, 0, 0, 0};
+
+    bool Ready() const { return builtVersion == version && vao != 0; }
+  };
+  struct Snapshot {
+    float pos[3], rotation[3], scale[3];
+    int material;
+    bool selected;
+    uint64_t chunk; // NO_CHUNK if dynamic
+    uint32_t slot;  // position in its member list, NO_SLOT if in none
+  };
+
+  static const uint64_t NO_CHUNK = ~0ull;
+  static const uint32_t NO_SLOT = ~0u;
+  static uint64_t ChunkKey(const float pos[3]);
+  static bool SameTransform(const Snapshot &s, const CubeInst &c);
+  static void Build(BuildResult &result);
+
+  void MarkDirty(uint64_t key);
+  // Members of a chunk (created if missing), m_Dynamic for NO_CHUNK
+  std::vector<uint32_t> &MemberList(uint64_t key);
+  // Moves a cube out of / into the member list of its snapshot's chunk,
+  // marking the chunk dirty
+  void Leave(uint32_t index);
+  void Join(uint32_t index);
+  void AddChangedBounds(const float bounds[6]);
+  void Upload(Chunk &chunk, const BuildResult &result);
+  void DestroyChunk(Chunk &chunk);
+
+  std::unordered_map<uint64_t, std::unique_ptr<Chunk>> m_Chunks;
+  std::vector<Snapshot> m_Snapshots;
+  // Indices of the dynamic cubes, in no order; kept by Leave/Join
+  std::vector<uint32_t> m_Dynamic;
+  std::vector<uint64_t> m_Dirty; // keys touched since the last Sync
+  std::vector<float> m_ChangedBounds;
+  ChunkStats m_Stats;
+  // Ready chunks of the last Cull, in draw order
+  std::vector<Chunk *> m_Culled;
+  int m_CulledViews = 0;
+};
@@ -1,13 +1,20 @@
 #include "scene.h"
+#include "../core/job_system.h"
+#include "../render/gl_state_cache.h"
+#include "../render/texture_manager.h"
+#include "../shaders/shader_library.h"
 #include <algorithm>
+#include <atomic>
 #include <cfloat> // FLT_MAX
+#include <chrono>
 #include <cmath>
+#include <cstring>
+#include <filesystem>
 #include <fstream>
 #include <iostream>
 #include <sstream>
 
-// Helper temporario para cargar material desde disco
-static Material LoadMaterialHelper(const std::string &filepath) {
+Material LoadMaterialFile(const std::string &filepath) {
   Material material;
   std::ifstream file(filepath);
   std::string line;
@@ -33,10 +40,21 @@ static Material LoadMaterialHelper(const std::string &filepath) {
           material.roughness = std::stof(value);
         else if (key == "emission")
           material.emission = std::stof(value);
+        else if (key == "diffuseTexture")
+          material.diffuseTexture = value;
       }
     }
     file.close();
   }
+  if (!material.diffuseTexture.empty()) {
+    // Relative texture paths are tried from the working directory first,
+    // then from the material's folder
+    std::filesystem::path texture = material.diffuseTexture;
+    std::error_code ec;
+    if (texture.is_relative() && !std::filesystem::exists(texture, ec))
+      texture = std::filesystem::path(filepath).parent_path() / texture;
+    material.diffuseTexture = texture.string();
+  }
   return material;
 }
 
@@ -68,29 +86,360 @@ static bool RayAABB(const float ro[3], const float rd[3], const float bmin[3],
   return tmin >= 0.0f; // Simplified, check main definition if needed tmax logic
 }
 
-Scene::Scene() {}
+static Mat4 CubeModelMatrix(const CubeInst &c) {
+  return mat4_model_trs(c.pos, c.rotation, c.scale);
+}
 
-Scene::~Scene() {
-  if (m_VAO_Grid)
-    glDeleteVertexArrays(1, &m_VAO_Grid);
-  if (m_VBO_Grid)
-    glDeleteBuffers(1, &m_VBO_Grid);
-  if (m_VAO_Cube)
-    glDeleteVertexArrays(1, &m_VAO_Cube);
-  if (m_VBO_Cube)
-    glDeleteBuffers(1, &m_VBO_Cube);
+// field: 0=pos, 1=rotation, 2=scale
+static float *CubeField(CubeInst &cube, int field) {
+  return field == 0 ? cube.pos : field == 1 ? cube.rotation : cube.scale;
 }
 
+// Feature bits of the "scene" shader family, in the order of SCENE_FEATURES.
+// The loose cubes' mask is also the shader field of their render queue key.
+enum SceneShaderFeature : uint32_t {
+  SCENE_SELECTION_TINT = 1u << 0,
+  SCENE_EMISSION = 1u << 1,
+  SCENE_WORLD_SPACE = 1u << 2,
+  SCENE_DIFFUSE_TEXTURE = 1u << 3,
+  SCENE_LIGHTING = 1u << 4,
+  SCENE_SHADOWS = 1u << 5
+};
+static const std::vector<std::string> SCENE_FEATURES = {
+    "SELECTION_TINT", "EMISSION", "WORLD_SPACE", "DIFFUSE_TEXTURE",
+    "LIGHTING", "SHADOWS"};
+
+// Shown until a variant is compiled (or if Content/Shaders is missing):
+// untinted, no emission. Chunk batches also work with it because their VAOs
+// feed an identity matrix to aModel.
+static const char *SCENE_FALLBACK_VS = R"(#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 2) in mat4 aModel;
+layout (location = 6) in vec4 aColor;
+uniform mat4 uViewProj;
+out vec4 vColor;
+void main(){ vColor = aColor; gl_Position = uViewProj * aModel * vec4(aPos, 1.0); }
+)";
+static const char *SCENE_FALLBACK_FS = R"(#version 330 core
+in vec4 vColor;
+out vec4 FragColor;
+void main(){ FragColor = vec4(vColor.rgb, 1.0); }
+)";
+
+// Depth-only "shadow" family (Content/Shaders/shadow.*)
+enum ShadowShaderFeature : uint32_t { SHADOW_WORLD_SPACE = 1u << 0 };
+static const std::vector<std::string> SHADOW_FEATURES = {"WORLD_SPACE"};
+
+static const char *SHADOW_FALLBACK_VS = R"(#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 2) in mat4 aModel;
+uniform mat4 uViewProj;
+void main(){ gl_Position = uViewProj * aModel * vec4(aPos, 1.0); }
+)";
+static const char *SHADOW_FALLBACK_FS = R"(#version 330 core
+void main(){}
+)";
+
+Scene::Scene() {}
+
+Scene::~Scene() {}
+
 void Scene::Init() {
-  InitGrid();
-  InitCubeResources();
-  InitGizmoResources();
+  m_ShaderFamily = ShaderLibrary::Get().Register(
+      "scene", SCENE_FEATURES, SCENE_FALLBACK_VS, SCENE_FALLBACK_FS);
+  InitMeshResources();
+  m_Debug.Init();
+  m_LightClusters.Init();
+  m_ShadowFamily = ShaderLibrary::Get().Register(
+      "shadow", SHADOW_FEATURES, SHADOW_FALLBACK_VS, SHADOW_FALLBACK_FS);
+  m_Shadows.Init();
+  m_ShadowList = std::make_unique<IndirectDrawList>();
+  m_ShadowList->Init(m_Meshes);
 }
 
-void Scene::LoadFromProject(const ProjectData &project) {
+EntityHandle Scene::AddCube(const CubeInst &cube) {
+  uint32_t slot;
+  while (!m_FreeSlots.empty() && m_Slots[m_FreeSlots.back()].dense != FREE_SLOT)
+    m_FreeSlots.pop_back(); // restored since it was freed
+  if (!m_FreeSlots.empty()) {
+    slot = m_FreeSlots.back();
+    m_FreeSlots.pop_back();
+  } else {
+    slot = (uint32_t)m_Slots.size();
+    m_Slots.emplace_back();
+  }
+  const uint32_t dense = (uint32_t)m_Cubes.size();
+  m_Slots[slot].dense = dense;
+  m_Cubes.push_back(cube);
+  m_DenseToSlot.push_back(slot);
+  NoteChange(SCENE_CHANGE_ADDED, dense, dense + 1, 1);
+  return EntityHandle{slot, m_Slots[slot].generation};
+}
+
+void Scene::AddCubes(const CubeInst *cubes, size_t count,
+                     std::vector<EntityHandle> *handles) {
+  m_Cubes.reserve(m_Cubes.size() + count);
+  m_DenseToSlot.reserve(m_Cubes.size() + count);
+  if (handles)
+    handles->reserve(handles->size() + count);
+  BeginChanges();
+  for (size_t i = 0; i < count; ++i) {
+    const EntityHandle handle = AddCube(cubes[i]);
+    if (handles)
+      handles->push_back(handle);
+  }
+  EndChanges();
+}
+
+void Scene::FreeSlot(uint32_t slot) {
+  EntitySlot &s = m_Slots[slot];
+  s.dense = FREE_SLOT;
+  s.generation = s.nextGeneration++;
+  m_FreeSlots.push_back(slot);
+}
+
+bool Scene::EraseCube(EntityHandle handle) {
+  if (!IsValid(handle))
+    return false;
+  // Swap-and-pop: the last cube takes the hole
+  const uint32_t dense = m_Slots[handle.index].dense;
+  const uint32_t last = (uint32_t)m_Cubes.size() - 1;
+  if (dense != last) {
+    m_Cubes[dense] = std::move(m_Cubes[last]);
+    m_DenseToSlot[dense] = m_DenseToSlot[last];
+    m_Slots[m_DenseToSlot[dense]].dense = dense;
+  }
+  m_Cubes.pop_back();
+  m_DenseToSlot.pop_back();
+  FreeSlot(handle.index);
+  m_EntityVersion++;
+  NoteChange(SCENE_CHANGE_REMOVED, dense, last + 1, 0, 1);
+  return true;
+}
+
+bool Scene::RemoveCube(EntityHandle handle) { return EraseCube(handle); }
+
+size_t Scene::RemoveCubes(const std::vector<EntityHandle> &handles) {
+  // Past an eighth of the scene one pass over it beats scattered swaps,
+  // and keeps the order
+  if (handles.size() * 8 >= m_Cubes.size()) {
+    m_RemoveMarks.assign(m_Cubes.size(), 0);
+    for (EntityHandle handle : handles) {
+      const int index = GetIndex(handle);
+      if (index >= 0)
+        m_RemoveMarks[index] = 1;
+    }
+    return RemoveMarked();
+  }
+  size_t removed = 0;
+  BeginChanges();
+  for (EntityHandle handle : handles)
+    removed += EraseCube(handle) ? 1 : 0;
+  EndChanges();
+  return removed;
+}
+
+size_t Scene::RemoveMarked() {
+  const size_t n = m_Cubes.size();
+  size_t write = 0;
+  while (write < n && !m_RemoveMarks[write])
+    ++write;
+  const size_t first = write;
+  for (size_t read = first; read < n; ++read) {
+    const uint32_t slot = m_DenseToSlot[read];
+    if (m_RemoveMarks[read]) {
+      FreeSlot(slot);
+      continue;
+    }
+    if (read != write) {
+      m_Cubes[write] = std::move(m_Cubes[read]);
+      m_DenseToSlot[write] = slot;
+      m_Slots[slot].dense = (uint32_t)write;
+    }
+    ++write;
+  }
+  const size_t removed = n - write;
+  if (removed) {
+    m_Cubes.resize(write);
+    m_DenseToSlot.resize(write);
+    m_EntityVersion++;
+    NoteChange(SCENE_CHANGE_REMOVED, (uint32_t)first, (uint32_t)n, 0,
+               (uint32_t)removed);
+  }
+  return removed;
+}
+
+bool Scene::RestoreCube(EntityHandle handle, const CubeInst &cube) {
+  if (handle.index >= m_Slots.size()) {
+    // Slots past the end are created free (they are popped from the free
+    // list lazily, like restored ones)
+    const size_t first = m_Slots.size();
+    m_Slots.resize(handle.index + 1);
+    for (size_t slot = first; slot < handle.index; ++slot)
+      m_FreeSlots.push_back((uint32_t)slot);
+  }
+  EntitySlot &s = m_Slots[handle.index];
+  if (s.dense != FREE_SLOT)
+    return false;
+  const uint32_t dense = (uint32_t)m_Cubes.size();
+  s.dense = dense;
+  s.generation = handle.generation;
+  s.nextGeneration = std::max(s.nextGeneration, handle.generation + 1);
+  m_Cubes.push_back(cube);
+  m_DenseToSlot.push_back(handle.index);
+  m_EntityVersion++;
+  NoteChange(SCENE_CHANGE_ADDED, dense, dense + 1, 1);
+  return true;
+}
+
+void Scene::Clear() {
+  // Every slot freed, listed so that new cubes take them from slot 0 up
+  m_FreeSlots.clear();
+  for (size_t slot = m_Slots.size(); slot-- > 0;) {
+    if (m_Slots[slot].dense != FREE_SLOT)
+      FreeSlot((uint32_t)slot);
+    else
+      m_FreeSlots.push_back((uint32_t)slot);
+  }
+  const uint32_t count = (uint32_t)m_Cubes.size();
   m_Cubes.clear();
-  m_Cubes.reserve(project.cubes.size());
-  for (const auto &data : project.cubes) {
+  m_DenseToSlot.clear();
+  m_EntityVersion++;
+  if (count)
+    NoteChange(SCENE_CHANGE_REMOVED, 0, count, 0, count);
+}
+
+std::vector<CubeInst> &Scene::EditCubes() {
+  if (!m_Cubes.empty())
+    NoteChange(SCENE_CHANGE_CONTENTS, 0, (uint32_t)m_Cubes.size());
+  return m_Cubes;
+}
+
+void Scene::TransformRange(uint32_t first, uint32_t count, int field,
+                           const float delta[3], float minValue) {
+  if (first >= m_Cubes.size())
+    return;
+  count = std::min(count, (uint32_t)m_Cubes.size() - first);
+  // Packed xyz in, SIMD offset, packed xyz out
+  m_TransformScratch.resize((size_t)count * 3);
+  float *values = m_TransformScratch.data();
+  for (uint32_t j = 0; j < count; ++j)
+    std::memcpy(&values[j * 3], CubeField(m_Cubes[first + j], field),
+                3 * sizeof(float));
+  vec3_array_offset(values, delta, values, count, minValue);
+  for (uint32_t j = 0; j < count; ++j)
+    std::memcpy(CubeField(m_Cubes[first + j], field), &values[j * 3],
+                3 * sizeof(float));
+  NoteChange(SCENE_CHANGE_TRANSFORM, first, first + count);
+}
+
+void Scene::TransformCubes(const std::vector<EntityHandle> &handles,
+                           int field, const float *start,
+                           const float delta[3], float minValue) {
+  m_TransformScratch.resize(handles.size() * 3);
+  float *values = m_TransformScratch.data();
+  vec3_array_offset(start, delta, values, handles.size(), minValue);
+  uint32_t first = 0xFFFFFFFFu, end = 0;
+  for (size_t j = 0; j < handles.size(); ++j) {
+    const int index = GetIndex(handles[j]);
+    if (index < 0)
+      continue;
+    std::memcpy(CubeField(m_Cubes[index], field), &values[j * 3],
+                3 * sizeof(float));
+    first = std::min(first, (uint32_t)index);
+    end = std::max(end, (uint32_t)index + 1);
+  }
+  if (first < end)
+    NoteChange(SCENE_CHANGE_TRANSFORM, first, end);
+}
+
+void Scene::SetMaterial(EntityHandle handle, const std::string &path) {
+  const int index = GetIndex(handle);
+  if (index < 0)
+    return;
+  m_Cubes[index].materialPath = path;
+  m_Cubes[index].material = -1;
+  NoteChange(SCENE_CHANGE_MATERIAL, (uint32_t)index, (uint32_t)index + 1);
+}
+
+void Scene::SetMaterial(const std::vector<EntityHandle> &handles,
+                        const std::string &path) {
+  BeginChanges();
+  for (EntityHandle handle : handles)
+    SetMaterial(handle, path);
+  EndChanges();
+}
+
+void Scene::SetSelected(EntityHandle handle, bool selected) {
+  const int index = GetIndex(handle);
+  if (index < 0 || m_Cubes[index].selected == selected)
+    return;
+  m_Cubes[index].selected = selected;
+  NoteChange(SCENE_CHANGE_SELECTION, (uint32_t)index, (uint32_t)index + 1);
+}
+
+void Scene::NoteChange(uint32_t flags, uint32_t first, uint32_t end,
+                       uint32_t added, uint32_t removed) {
+  m_PendingChanges.Merge(flags, first, end);
+  m_PendingChanges.added += added;
+  m_PendingChanges.removed += removed;
+  if (m_ChangeDepth == 0)
+    PublishChanges();
+}
+
+void Scene::EndChanges() {
+  if (m_ChangeDepth > 0 && --m_ChangeDepth == 0)
+    PublishChanges();
+}
+
+void Scene::PublishChanges() {
+  if (m_PendingChanges.Empty())
+    return;
+  const SceneChangeBatch batch = m_PendingChanges;
+  m_PendingChanges = SceneChangeBatch();
+  m_FrameChanges.Merge(batch);
+  m_ChangeVersion++;
+  for (auto &listener : m_ChangeListeners)
+    listener.second(batch);
+}
+
+int Scene::AddChangeListener(SceneChangeListener listener) {
+  m_ChangeListeners.emplace_back(m_NextListener, std::move(listener));
+  return m_NextListener++;
+}
+
+void Scene::RemoveChangeListener(int id) {
+  m_ChangeListeners.erase(
+      std::remove_if(m_ChangeListeners.begin(), m_ChangeListeners.end(),
+                     [id](const std::pair<int, SceneChangeListener> &entry) {
+                       return entry.first == id;
+                     }),
+      m_ChangeListeners.end());
+}
+
+void Scene::LoadFromProject(const ProjectData &project) {
+  Reset();
+  AddProjectCubes(project, 0, project.cubes.size());
+}
+
+void Scene::Reset() {
+  Clear();
+  m_Chunks.Clear();
+  m_Materials.clear();
+  m_MaterialLookup.clear();
+  m_MaterialsVersion++;
+}
+
+void Scene::AddProjectCubes(const ProjectData &project, size_t first,
+                            size_t count) {
+  const size_t end = std::min(first + count, project.cubes.size());
+  // Room for the rest of the project, so a load in slices reallocates once
+  const size_t rest = m_Cubes.size() + (project.cubes.size() - first);
+  m_Cubes.reserve(rest);
+  m_DenseToSlot.reserve(rest);
+  BeginChanges();
+  for (size_t i = first; i < end; ++i) {
+    const CubeData &data = project.cubes[i];
     CubeInst inst;
     for (int k = 0; k < 3; k++) {
       inst.pos[k] = data.pos[k];
@@ -99,8 +448,9 @@ void Scene::LoadFromProject(const ProjectData &project) {
     }
     inst.materialPath = data.materialPath;
     inst.selected = false;
-    m_Cubes.push_back(inst);
+    AddCube(inst);
   }
+  EndChanges();
 }
 
 void Scene::GetProjectData(ProjectData &project) const {
@@ -147,502 +497,626 @@ int Scene::Raycast(const float ro[3], const float rd[3]) {
   return hitIndex;
 }
 
-void Scene::InitGrid() {
-  const int halfExtent = 50;
-  const float step = 1.0f;
-  std::vector<float> gridVerts;
-  gridVerts.reserve((size_t)(halfExtent * 2 + 1) * 4 * 3);
-  const float min = -halfExtent * step;
-  const float max = halfExtent * step;
-  for (int i = -halfExtent; i <= halfExtent; ++i) {
-    float v = i * step;
-    gridVerts.push_back(min);
-    gridVerts.push_back(0.0f);
-    gridVerts.push_back(v);
-    gridVerts.push_back(max);
-    gridVerts.push_back(0.0f);
-    gridVerts.push_back(v);
-    gridVerts.push_back(v);
-    gridVerts.push_back(0.0f);
-    gridVerts.push_back(min);
-    gridVerts.push_back(v);
-    gridVerts.push_back(0.0f);
-    gridVerts.push_back(max);
-  }
-  m_GridVertexCount = (int)(gridVerts.size() / 3);
-  glGenVertexArrays(1, &m_VAO_Grid);
-  glGenBuffers(1, &m_VBO_Grid);
-  glBindVertexArray(m_VAO_Grid);
-  glBindBuffer(GL_ARRAY_BUFFER, m_VBO_Grid);
-  glBufferData(GL_ARRAY_BUFFER, gridVerts.size() * sizeof(float),
-               gridVerts.data(), GL_STATIC_DRAW);
-  glEnableVertexAttribArray(0);
-  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void *)0);
-  glBindVertexArray(0);
-}
-
-void Scene::InitCubeResources() {
-  const float c[] = {// Cara +X
-                     0.5f, -0.5f, -0.5f, 0.5f, 0.5f, -0.5f, 0.5f, 0.5f, 0.5f,
-                     0.5f, -0.5f, -0.5f, 0.5f, 0.5f, 0.5f, 0.5f, -0.5f, 0.5f,
-                     // Cara -X
-                     -0.5f, -0.5f, -0.5f, -0.5f, -0.5f, 0.5f, -0.5f, 0.5f, 0.5f,
-                     -0.5f, -0.5f, -0.5f, -0.5f, 0.5f, 0.5f, -0.5f, 0.5f, -0.5f,
-                     // Cara +Y
-                     -0.5f, 0.5f, -0.5f, -0.5f, 0.5f, 0.5f, 0.5f, 0.5f, 0.5f,
-                     -0.5f, 0.5f, -0.5f, 0.5f, 0.5f, 0.5f, 0.5f, 0.5f, -0.5f,
-                     // Cara -Y
-                     -0.5f, -0.5f, -0.5f, 0.5f, -0.5f, -0.5f, 0.5f, -0.5f, 0.5f,
-                     -0.5f, -0.5f, -0.5f, 0.5f, -0.5f, 0.5f, -0.5f, -0.5f, 0.5f,
-                     // Cara +Z
-                     -0.5f, -0.5f, 0.5f, 0.5f, -0.5f, 0.5f, 0.5f, 0.5f, 0.5f,
-                     -0.5f, -0.5f, 0.5f, 0.5f, 0.5f, 0.5f, -0.5f, 0.5f, 0.5f,
-                     // Cara -Z
-                     -0.5f, -0.5f, -0.5f, -0.5f, 0.5f, -0.5f, 0.5f, 0.5f, -0.5f,
-                     -0.5f, -0.5f, -0.5f, 0.5f, 0.5f, -0.5f, 0.5f, -0.5f,
-                     -0.5f};
-  m_CubeVertexCount = 36;
-  glGenVertexArrays(1, &m_VAO_Cube);
-  glGenBuffers(1, &m_VBO_Cube);
-  glBindVertexArray(m_VAO_Cube);
-  glBindBuffer(GL_ARRAY_BUFFER, m_VBO_Cube);
-  glBufferData(GL_ARRAY_BUFFER, sizeof(c), c, GL_STATIC_DRAW);
-  glEnableVertexAttribArray(0);
-  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void *)0);
-  glBindVertexArray(0);
-}
-
-void Scene::InitGizmoResources() {
-  // Arrow (Cylinder + Cone simplified to single mesh for now, or just lines)
-  // Let's use simple thick lines for arrows (cubes scaled) for visualization
-  const float arrow[] = {
-      0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, // X
-      0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, // Y
-      0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f  // Z
-  };
-  // Actually, let's use the code from main.cpp we saw earlier?
-  // It constructed arrows. For simplicity here, I'll build visual indicators.
-  // 1. Arrow (Translate): 3 lines + tips.
-  // We will use drawing logic in RenderGizmos to position generic shapes.
-  // So here we just need a Unit Cylinder or Unit Cube.
-  // We already have VBO_Cube (Unit cube centered at 0).
-
-  // Rings (Rotate): Circle lineloop.
-  std::vector<float> ring;
-  const int segments = 32;
-  for (int i = 0; i <= segments; ++i) {
-    float theta = 2.0f * 3.1415926f * float(i) / float(segments);
-    ring.push_back(cosf(theta)); // X
-    ring.push_back(sinf(theta)); // Y
-    ring.push_back(0.0f);        // Z
-  }
-  m_RingVertexCount = segments + 1;
-  glGenVertexArrays(1, &m_VAO_Ring);
-  glGenBuffers(1, &m_VBO_Ring);
-  glBindVertexArray(m_VAO_Ring);
-  glBindBuffer(GL_ARRAY_BUFFER, m_VBO_Ring);
-  glBufferData(GL_ARRAY_BUFFER, ring.size() * sizeof(float), ring.data(),
-               GL_STATIC_DRAW);
-  glEnableVertexAttribArray(0);
-  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void *)0);
-  glBindVertexArray(0);
-
-  // Compile Gizmo Shader (Simple Unlit)
-  const char *vs = R"(
-    #version 330 core
-    layout (location = 0) in vec3 aPos;
-    uniform mat4 uMVP;
-    void main() {
-        gl_Position = uMVP * vec4(aPos, 1.0);
-    }
-  )";
-  const char *fs = R"(
-    #version 330 core
-    out vec4 FragColor;
-    uniform vec4 uColor;
-    void main() {
-        FragColor = uColor;
-    }
-  )";
-  // We need to include shader.h or just use raw GL calls? Scene includes glad.
-  // Ideally use Shader namespace helper if available. But Scene includes
-  // scene.h which doesn't know Shader helper. We need to include
-  // "../shaders/shader.h" in scene.cpp or just replicate code. Scene.cpp top
-  // includes "scene.h". Let's add include code in separate edit if needed or
-  // assume we can inline raw GL calls helper locally? No, let's just do it raw
-  // here to avoid dependency hell or add header. Actually, we can just include
-  // "../shaders/shader.h" in scene.cpp. But wait, I'm replacing lines in a
-  // middle of file.
-
-  // Implementation of shader compile inline
-  auto compile = [](GLenum type, const char *src) -> GLuint {
-    GLuint s = glCreateShader(type);
-    glShaderSource(s, 1, &src, nullptr);
-    glCompileShader(s);
-    return s;
-  };
-  GLuint v = compile(GL_VERTEX_SHADER, vs);
-  GLuint f = compile(GL_FRAGMENT_SHADER, fs);
-  m_GizmoShader = glCreateProgram();
-  glAttachShader(m_GizmoShader, v);
-  glAttachShader(m_GizmoShader, f);
-  glLinkProgram(m_GizmoShader);
-  glDeleteShader(v);
-  glDeleteShader(f);
-}
-
-void Scene::ApplyMaterialToShader(const Material &material,
-                                  GLuint shaderProgram) {
-  GLint colorLoc = glGetUniformLocation(shaderProgram, "u_material_color");
-  if (colorLoc != -1)
-    glUniform3f(colorLoc, material.color[0], material.color[1],
-                material.color[2]);
-  GLint metallicLoc =
-      glGetUniformLocation(shaderProgram, "u_material_metallic");
-  if (metallicLoc != -1)
-    glUniform1f(metallicLoc, material.metallic);
-  GLint roughnessLoc =
-      glGetUniformLocation(shaderProgram, "u_material_roughness");
-  if (roughnessLoc != -1)
-    glUniform1f(roughnessLoc, material.roughness);
-  GLint emissionLoc =
-      glGetUniformLocation(shaderProgram, "u_material_emission");
-  if (emissionLoc != -1)
-    glUniform1f(emissionLoc, material.emission);
-}
-
-Material Scene::GetMaterialFromPath(const std::string &path) {
+void Scene::InitMeshResources() {
+  std::vector<MeshVertex> vertices;
+  std::vector<uint32_t> indices;
+  MeshLibrary::BuildCube(vertices, indices);
+  m_CubeMesh = m_Meshes.AddMesh(vertices, indices);
+  m_Meshes.Upload();
+}
+
+size_t Scene::GetTextureBatch(GLuint array) {
+  // A handful of arrays at most: linear search
+  for (size_t i = 0; i < m_TextureBatches.size(); ++i) {
+    if (m_TextureBatches[i].array == array)
+      return i;
+  }
+  m_TextureBatches.push_back({array, {}});
+  return m_TextureBatches.size() - 1;
+}
+
+int Scene::GetMaterialHandle(const std::string &path) {
+  // Cache: el archivo se lee una sola vez, no en cada frame
+  auto it = m_MaterialLookup.find(path);
+  if (it != m_MaterialLookup.end())
+    return it->second;
+
+  Material m;
   if (path.empty()) {
-    Material m; // defaul
-    m.color[0] = 0.8f;
+    m.color[0] = 0.8f; // defaul
     m.color[1] = 0.8f;
     m.color[2] = 0.8f;
-    return m;
+  } else {
+    m = LoadMaterialFile(path);
   }
-  return LoadMaterialHelper(path);
+  if (!m.diffuseTexture.empty())
+    m.diffuseHandle = TextureManager::Get().Load(m.diffuseTexture);
+  int handle = (int)m_Materials.size();
+  m_Materials.push_back(m);
+  m_MaterialLookup.emplace(path, handle);
+  return handle;
 }
 
-void Scene::Render(const Mat4 &view, const Mat4 &proj, GLuint shaderProgram) {
-  glUseProgram(shaderProgram);
+void Scene::CullOccluded(const Mat4 &view, const Mat4 &vp) {
+  m_Stats.occluders = 0;
+  m_Stats.occlusionCulled = 0;
+  m_Stats.occlusionMs = 0.0f;
+  if (!m_OcclusionCulling)
+    return;
+  auto start = std::chrono::high_resolution_clock::now();
 
-  // Uniform locations common
-  GLint locMVP = glGetUniformLocation(shaderProgram, "uMVP");
-  GLint locColor = glGetUniformLocation(shaderProgram, "uColor");
+  // Candidates: loose cubes plus the largest members of visible chunks
+  m_OccluderCandidates.clear();
+  for (const Mat4 &m : m_Models)
+    m_OccluderCandidates.push_back(&m);
+  m_Chunks.CollectOccluders(vp, m_OccluderCandidates);
 
-  Mat4 vp = mat4_mul(proj, view); // Precompute VP
+  // Occluder score: surface area over squared view distance
+  m_OccluderScores.clear();
+  for (const Mat4 *m : m_OccluderCandidates) {
+    float viewZ = view.m[2] * m->m[12] + view.m[6] * m->m[13] +
+                  view.m[10] * m->m[14] + view.m[14];
+    if (viewZ >= 0.0f)
+      continue;
+    float s[3];
+    for (int k = 0; k < 3; ++k)
+      s[k] = vec3_length(&m->m[k * 4]);
+    float area = s[0] * s[1] + s[1] * s[2] + s[0] * s[2];
+    m_OccluderScores.push_back({area / (viewZ * viewZ), m});
+  }
 
-  // 1. Draw Grid
-  if (locColor != -1)
-    glUniform4f(locColor, 0.35f, 0.35f, 0.35f, 1.0f);
-  Mat4 identity = mat4_identity();
-  Mat4 mvpGrid = mat4_mul(vp, identity);
-  if (locMVP != -1)
-    glUniformMatrix4fv(locMVP, 1, GL_FALSE, mvpGrid.m);
+  // Largest on-screen occluders within budget
+  size_t budget = std::min(m_OccluderScores.size(), (size_t)m_OccluderBudget);
+  std::partial_sort(m_OccluderScores.begin(), m_OccluderScores.begin() + budget,
+                    m_OccluderScores.end(),
+                    [](const std::pair<float, const Mat4 *> &a,
+                       const std::pair<float, const Mat4 *> &b) {
+                      return a.first > b.first;
+                    });
 
-  glBindVertexArray(m_VAO_Grid);
-  glDrawArrays(GL_LINES, 0, m_GridVertexCount);
-  glBindVertexArray(0);
+  m_Occlusion.BeginFrame(vp);
+  for (size_t i = 0; i < budget; ++i)
+    m_Occlusion.AddOccluder(*m_OccluderScores[i].second);
+  m_Occlusion.BuildPyramid();
 
-  // 2. Draw Cubes
-  glPolygonMode(GL_FRONT_AND_BACK, m_Wireframe ? GL_LINE : GL_FILL);
-  glBindVertexArray(m_VAO_Cube);
+  m_Stats.occlusionCulled = (int)m_Occlusion.TestBoxes(
+      m_Boxes.data(), m_Models.size(), m_Visible, &JobSystem::Get());
+  m_Stats.occluders = m_Occlusion.GetOccluderCount();
+  m_Stats.occlusionMs = std::chrono::duration<float, std::milli>(
+                            std::chrono::high_resolution_clock::now() - start)
+                            .count();
+}
 
-  for (const auto &c : m_Cubes) {
-    // Transform
-    Mat4 model = mat4_identity();
+void Scene::UpdateLights(const Mat4 &view, const Mat4 &proj) {
+  m_ClusterLights.resize(m_Lights.size());
+  for (size_t i = 0; i < m_Lights.size(); ++i) {
+    const Light &light = m_Lights[i];
+    ClusterLight &out = m_ClusterLights[i];
+    for (int k = 0; k < 3; ++k) {
+      out.pos[k] = light.pos[k];
+      out.color[k] = light.color[k] * light.intensity;
+      out.dir[k] = light.dir[k];
+    }
+    vec3_normalize(out.dir);
+    out.range = std::max(light.range, 0.01f);
+    if (light.type == LightType::Spot) {
+      const float toRad = 3.1415926f / 180.0f;
+      const float outer = std::min(std::max(light.outerAngle, 1.0f), 89.0f);
+      const float inner = std::min(std::max(light.innerAngle, 0.0f), outer);
+      out.cosOuter = std::cos(outer * toRad);
+      out.cosInner = std::max(std::cos(inner * toRad), out.cosOuter + 1e-4f);
+    } else {
+      out.cosInner = -2.0f;
+      out.cosOuter = -3.0f;
+    }
+  }
+  GLint viewport[4];
+  GLStateCache::Get().GetViewport(viewport);
+  m_LightClusters.Update(m_ClusterLights, view, proj, viewport,
+                         &JobSystem::Get());
+}
 
-    Mat4 scaleM = mat4_identity();
-    scaleM.m[0] = c.scale[0];
-    scaleM.m[5] = c.scale[1];
-    scaleM.m[10] = c.scale[2];
+void Scene::RenderShadows(const Mat4 &view, const Mat4 &proj) {
+  auto start = std::chrono::high_resolution_clock::now();
+  GLStateCache &gl = GLStateCache::Get();
+  ShaderLibrary &shaders = ShaderLibrary::Get();
+  auto useProgram = [&](uint32_t features, const Mat4 &lightViewProj) {
+    GLuint program = shaders.GetProgram(m_ShadowFamily, features);
+    gl.UseProgram(program);
+    gl.SetUniformMatrix4fv(gl.GetUniformLocation(program, "uViewProj"),
+                           lightViewProj.m);
+  };
 
-    float radX = c.rotation[0] * 3.1415926f / 180.0f;
-    float radY = c.rotation[1] * 3.1415926f / 180.0f;
-    float radZ = c.rotation[2] * 3.1415926f / 180.0f;
+  // Edits made while shadows were off were never reported
+  if (!m_ShadowsValid) {
+    m_Shadows.Invalidate();
+    m_ShadowsValid = true;
+  }
+  m_Shadows.Update(view, proj, m_Sun.dir, m_Chunks.GetChangedBounds());
+  m_Shadows.BeginPass();
+  for (int c = 0; c < ShadowCascades::CASCADES; ++c) {
+    const Mat4 &lightViewProj = m_Shadows.GetLightViewProj(c);
+    if (m_Shadows.BeginStatic(c)) {
+      useProgram(SHADOW_WORLD_SPACE, lightViewProj);
+      m_Shadows.EndStatic(c, m_Chunks.DrawCasters(lightViewProj));
+    }
 
-    Mat4 rotX = mat4_identity();
-    rotX.m[5] = cos(radX);
-    rotX.m[6] = -sin(radX);
-    rotX.m[9] = sin(radX);
-    rotX.m[10] = cos(radX);
-    Mat4 rotY = mat4_identity();
-    rotY.m[0] = cos(radY);
-    rotY.m[2] = sin(radY);
-    rotY.m[8] = -sin(radY);
-    rotY.m[10] = cos(radY);
-    Mat4 rotZ = mat4_identity();
-    rotZ.m[0] = cos(radZ);
-    rotZ.m[1] = -sin(radZ);
-    rotZ.m[4] = sin(radZ);
-    rotZ.m[5] = cos(radZ);
+    // Loose cubes are re-drawn into every cascade they overlap
+    m_ShadowItems.clear();
+    for (size_t i = 0; i < m_Loose.size(); ++i) {
+      if (!m_Shadows.Overlaps(c, &m_Boxes[i * 6]))
+        continue;
+      DrawItem item = {};
+      item.mesh = m_CubeMesh;
+      std::copy(m_Models[i].m, m_Models[i].m + 16, item.instance.model);
+      m_ShadowItems.push_back(item);
+    }
+    if (m_Shadows.BeginDynamic(c, (int)m_ShadowItems.size())) {
+      useProgram(0, lightViewProj);
+      m_ShadowList->Build(m_ShadowItems, m_Meshes);
+      m_ShadowList->Submit();
+      m_Shadows.EndDynamic(c, m_ShadowList->GetLastDrawCalls());
+    }
+  }
+  m_Shadows.EndPass();
 
-    Mat4 rotation = mat4_mul(mat4_mul(rotZ, rotY), rotX);
-    model = mat4_mul(rotation, scaleM);
+  m_Stats.shadows = m_Shadows.GetStats();
+  m_Stats.shadows.ms = std::chrono::duration<float, std::milli>(
+                           std::chrono::high_resolution_clock::now() - start)
+                           .count();
+}
 
-    model.m[12] = c.pos[0];
-    model.m[13] = c.pos[1];
-    model.m[14] = c.pos[2];
+void Scene::Render(const Mat4 &view, const Mat4 &proj) {
+  const SceneView single = {view, proj};
+  BeginFrame(&single, 1);
+  RenderView(0);
+  EndFrame();
+}
 
-    Mat4 mvp = mat4_mul(vp, model);
-    if (locMVP != -1)
-      glUniformMatrix4fv(locMVP, 1, GL_FALSE, mvp.m);
+void Scene::CullViews() {
+  // Loose cubes: the box around all frusta first, then every view's planes,
+  // one bit per view; jobs own disjoint ranges of the mask array
+  const size_t looseCount = m_Loose.size();
+  m_ViewMasks.resize(looseCount);
+  const ViewFrusta &frusta = m_Frusta;
+  const bool occlusion = m_OcclusionCulling;
+  std::atomic<int> unionCulled{0};
+  JobSystem::Get().ParallelFor(looseCount, 256, [&](size_t begin,
+                                                    size_t end) {
+    const float *ub = frusta.bounds;
+    int culled = 0;
+    for (size_t i = begin; i < end; ++i) {
+      const float *box = &m_Boxes[i * 6];
+      uint8_t mask = 0;
+      if (box[0] <= ub[3] && box[3] >= ub[0] && box[1] <= ub[4] &&
+          box[4] >= ub[1] && box[2] <= ub[5] && box[5] >= ub[2]) {
+        for (int v = 0; v < frusta.count; ++v) {
+          if (frustum_classify_box(frusta.planes[v], box) != FRUSTUM_OUTSIDE)
+            mask |= (uint8_t)(1u << v);
+        }
+      } else {
+        culled++;
+      }
+      // The occlusion buffer is the main view's
+      if (occlusion && !m_Visible[i])
+        mask &= (uint8_t)~1u;
+      m_ViewMasks[i] = mask;
+    }
+    unionCulled += culled;
+  });
+  m_Stats.unionCulled = unionCulled;
+}
 
-    // Material
-    Material mat = GetMaterialFromPath(c.materialPath);
+void Scene::BeginFrame(const SceneView *views, int count) {
+  count = std::min(std::max(count, 0), (int)ViewFrusta::MAX_VIEWS);
+  m_Views.assign(views, views + count);
+  m_Stats.views = count;
+  m_Stats.drawCalls = 0;
+  m_Stats.indirectCommands = 0;
+  m_Stats.instances = 0;
+  m_Stats.textureBinds = 0;
+  m_Stats.stateChanges = 0;
+  m_Stats.sortMs = 0.0f;
+  m_Stats.debugDrawCalls = 0;
+  m_Stats.lights = LightClusterStats();
+  if (count == 0)
+    return;
 
-    if (c.selected) {
-      glUniform4f(locColor, mat.color[0] * 1.2f, mat.color[1] * 0.8f,
-                  mat.color[2] * 0.4f, 1.0f);
-    } else {
-      glUniform4f(locColor, mat.color[0], mat.color[1], mat.color[2], 1.0f);
+  // Frusta and the world box around all of them
+  m_Frusta.count = count;
+  for (int k = 0; k < 3; ++k) {
+    m_Frusta.bounds[k] = FLT_MAX;
+    m_Frusta.bounds[3 + k] = -FLT_MAX;
+  }
+  for (int v = 0; v < count; ++v) {
+    frustum_planes(mat4_mul(views[v].proj, views[v].view),
+                   m_Frusta.planes[v]);
+    float corners[8][3];
+    frustum_corners(views[v].view, views[v].proj, corners);
+    for (const float *c : corners) {
+      for (int k = 0; k < 3; ++k) {
+        m_Frusta.bounds[k] = std::min(m_Frusta.bounds[k], c[k]);
+        m_Frusta.bounds[3 + k] = std::max(m_Frusta.bounds[3 + k], c[k]);
+      }
     }
+  }
+
+  // Grid (queued; flushed depth-tested after the cubes of every view)
+  m_Debug.SetLayer(DebugDraw::LAYER_WORLD);
+  m_Debug.Grid(50, 1.0f, DebugDraw::Color(0.35f, 0.35f, 0.35f));
 
-    ApplyMaterialToShader(mat, shaderProgram);
-    glDrawArrays(GL_TRIANGLES, 0, m_CubeVertexCount);
+  // Static cubes live in chunks; the rest (selected cubes and members of
+  // chunks being rebuilt) are "loose" and go through the render queue.
+  // Only the cubes the change batches since the last frame touched can
+  // have an unresolved material or differ from the chunks' snapshot.
+  // A batch still open is included now and again once published.
+  SceneChangeBatch changes = m_FrameChanges;
+  changes.Merge(m_PendingChanges);
+  m_FrameChanges = SceneChangeBatch();
+  const size_t changedEnd = std::min((size_t)changes.end, m_Cubes.size());
+  for (size_t i = changes.first; i < changedEnd; ++i) {
+    CubeInst &c = m_Cubes[i];
+    if (c.material < 0)
+      c.material = GetMaterialHandle(c.materialPath);
   }
+  auto syncStart = std::chrono::high_resolution_clock::now();
+  m_Chunks.Sync(m_Cubes, m_Materials, m_Loose, changes.first, changedEnd);
+  m_Stats.chunkSyncMs =
+      std::chrono::duration<float, std::milli>(
+          std::chrono::high_resolution_clock::now() - syncStart)
+          .count();
 
-  glBindVertexArray(0);
-  glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+  // World AABB of each (possibly rotated) loose cube: |M| * half extents.
+  // Shared by every view: the instance data is built from these.
+  const size_t looseCount = m_Loose.size();
+  m_Models.resize(looseCount);
+  m_Boxes.resize(looseCount * 6);
+  for (size_t i = 0; i < looseCount; ++i) {
+    const Mat4 &m = m_Models[i] = CubeModelMatrix(m_Cubes[m_Loose[i]]);
+    float *box = &m_Boxes[i * 6];
+    for (int k = 0; k < 3; ++k) {
+      float extent = 0.5f * (std::fabs(m.m[k]) + std::fabs(m.m[4 + k]) +
+                             std::fabs(m.m[8 + k]));
+      box[k] = m.m[12 + k] - extent;
+      box[3 + k] = m.m[12 + k] + extent;
+    }
+  }
+  const Mat4 mainViewProj = mat4_mul(views[0].proj, views[0].view);
+  CullOccluded(views[0].view, mainViewProj);
+
+  auto visibilityStart = std::chrono::high_resolution_clock::now();
+  CullViews();
+  m_Chunks.Cull(m_Frusta, m_OcclusionCulling ? &m_Occlusion : nullptr,
+                &JobSystem::Get());
+  m_Stats.visibilityMs =
+      std::chrono::duration<float, std::milli>(
+          std::chrono::high_resolution_clock::now() - visibilityStart)
+          .count();
+
+  m_Lit = !m_Lights.empty() || m_Sun.enabled;
+  // The cascades slice a perspective frustum; an orthographic main view is
+  // drawn without them
+  m_Shadowed = m_Sun.enabled && m_Sun.castShadows && views[0].proj.m[15] != 1.0f;
+  if (m_Shadowed) {
+    RenderShadows(views[0].view, views[0].proj);
+  } else {
+    m_ShadowsValid = false;
+    m_Stats.shadows = ShadowStats();
+  }
+  m_Stats.debugVertices =
+      (int)m_Debug.GetVertexCount(DebugDraw::LAYER_WORLD);
 }
 
-void Scene::RenderGizmos(const Mat4 &view, const Mat4 &proj,
-                         GLuint shaderProgram, int selectedIndex,
-                         int transformMode, int hoveredAxis,
-                         bool localSpace) {
-  if (selectedIndex < 0 || selectedIndex >= (int)m_Cubes.size())
+void Scene::RenderView(int index) {
+  if (index < 0 || index >= (int)m_Views.size())
     return;
+  GLStateCache &gl = GLStateCache::Get();
+  ShaderLibrary &shaders = ShaderLibrary::Get();
+  const Mat4 &view = m_Views[index].view;
+  const Mat4 &proj = m_Views[index].proj;
+  Mat4 vp = mat4_mul(proj, view); // Precompute VP
 
-  const auto &c = m_Cubes[selectedIndex];
+  // Lights are binned once per view (for its viewport); every lit draw of
+  // the view reads the same clusters
+  const bool lit = m_Lit;
+  if (lit) {
+    UpdateLights(view, proj);
+    if (index == 0)
+      m_Stats.lights = m_LightClusters.GetStats();
+  }
+  // The cascades are fitted to the main view's depth range
+  const bool shadowed = m_Shadowed && index == 0;
+  // Camera position = -R^T * t of the view matrix
+  float cameraPos[3];
+  for (int k = 0; k < 3; ++k)
+    cameraPos[k] = -(view.m[k * 4] * view.m[12] +
+                     view.m[k * 4 + 1] * view.m[13] +
+                     view.m[k * 4 + 2] * view.m[14]);
+
+  // Towards the sun; black when it is off
+  float sunDirection[3], sunColor[3];
+  for (int k = 0; k < 3; ++k) {
+    sunDirection[k] = -m_Sun.dir[k];
+    sunColor[k] = m_Sun.enabled ? m_Sun.color[k] * m_Sun.intensity : 0.0f;
+  }
+  vec3_normalize(sunDirection);
+
+  auto useProgram = [&](uint32_t features) {
+    GLuint program = shaders.GetProgram(m_ShaderFamily, features);
+    gl.UseProgram(program);
+    gl.SetUniformMatrix4fv(gl.GetUniformLocation(program, "uViewProj"), vp.m);
+    if (features & SCENE_LIGHTING) {
+      m_LightClusters.Bind(program);
+      gl.SetUniform3f(gl.GetUniformLocation(program, "uCameraPos"),
+                      cameraPos[0], cameraPos[1], cameraPos[2]);
+      gl.SetUniform3f(gl.GetUniformLocation(program, "uAmbient"), m_Ambient[0],
+                      m_Ambient[1], m_Ambient[2]);
+      gl.SetUniform3f(gl.GetUniformLocation(program, "uSunDirection"),
+                      sunDirection[0], sunDirection[1], sunDirection[2]);
+      gl.SetUniform3f(gl.GetUniformLocation(program, "uSunColor"),
+                      sunColor[0], sunColor[1], sunColor[2]);
+    }
+    if (features & SCENE_SHADOWS)
+      m_Shadows.Bind(program);
+  };
+
+  // Sort keys: view depth normalized by the far plane (perspective:
+  // far = m14 / (m10 + 1); orthographic: far = (m14 - 1) / m10)
+  // RenderItem::index is the position in m_Loose. The shader field holds the
+  // permutation, so each variant's items form one contiguous run.
+  const float zFar = proj.m[15] == 1.0f ? (proj.m[14] - 1.0f) / proj.m[10]
+                                        : proj.m[14] / (proj.m[10] + 1.0f);
+  const uint8_t viewBit = (uint8_t)(1u << index);
+  m_Queue.Clear();
+  m_Queue.Reserve(m_Loose.size());
+  for (uint32_t i = 0; i < (uint32_t)m_Loose.size(); ++i) {
+    if (!(m_ViewMasks[i] & viewBit))
+      continue;
+    const CubeInst &c = m_Cubes[m_Loose[i]];
+    uint32_t features = 0;
+    if (c.selected)
+      features |= SCENE_SELECTION_TINT;
+    if (m_Materials[c.material].emission > 0.0f)
+      features |= SCENE_EMISSION;
+    if (m_Materials[c.material].diffuseHandle)
+      features |= SCENE_DIFFUSE_TEXTURE;
+    if (lit)
+      features |= SCENE_LIGHTING;
+    if (shadowed)
+      features |= SCENE_SHADOWS;
+    float viewZ = view.m[2] * c.pos[0] + view.m[6] * c.pos[1] +
+                  view.m[10] * c.pos[2] + view.m[14];
+    m_Queue.Push(RenderQueue::MakeKey(PASS_OPAQUE, features,
+                                      (uint32_t)c.material, m_CubeMesh,
+                                      -viewZ / zFar),
+                 i);
+  }
+
+  auto sortStart = std::chrono::high_resolution_clock::now();
+  m_Queue.Sort(&JobSystem::Get());
+  auto sortEnd = std::chrono::high_resolution_clock::now();
+
+  gl.PolygonMode(m_Wireframe ? GL_LINE : GL_FILL);
+
+  // Chunk vertex colours always carry emission in alpha
+  uint32_t chunkFeatures = SCENE_WORLD_SPACE | SCENE_EMISSION;
+  if (lit)
+    chunkFeatures |= SCENE_LIGHTING;
+  if (shadowed)
+    chunkFeatures |= SCENE_SHADOWS;
+  useProgram(chunkFeatures);
+  m_Chunks.Draw(index);
+
+  // Walk in key order; material data is resolved only on key boundaries and
+  // every shader run is built and submitted as one draw list. Textured runs
+  // are split by the texture array only: the layer and uv rect of each
+  // object's texture travel in its instance data.
+  uint64_t prevState = ~0ull;
+  const Material *mat = nullptr;
+  const TextureSlot *slot = nullptr;
+  size_t batch = 0;
+  int stateChanges = 0;
+  const std::vector<RenderItem> &items = m_Queue.GetItems();
+  for (size_t begin = 0; begin < items.size();) {
+    const uint32_t features = RenderQueue::KeyShader(items[begin].key);
+    const bool textured = (features & SCENE_DIFFUSE_TEXTURE) != 0;
+    m_DrawItems.clear();
+    for (TextureBatch &b : m_TextureBatches)
+      b.items.clear();
+    size_t end = begin;
+    for (; end < items.size() &&
+           RenderQueue::KeyShader(items[end].key) == features;
+         ++end) {
+      const RenderItem &ri = items[end];
+      const uint64_t state = ri.key & RenderQueue::STATE_MASK;
+      // Overflowed material ids share one key value: compare the real one
+      const uint32_t keyMaterial = RenderQueue::KeyMaterial(ri.key);
+      const Material *itemMat =
+          keyMaterial == RenderQueue::MATERIAL_OVERFLOW
+              ? &m_Materials[m_Cubes[m_Loose[ri.index]].material]
+              : &m_Materials[keyMaterial];
+      if (state != prevState || itemMat != mat) {
+        prevState = state;
+        mat = itemMat;
+        stateChanges++;
+        if (textured) {
+          slot = &TextureManager::Get().GetSlot(mat->diffuseHandle);
+          batch = GetTextureBatch(slot->array);
+        }
+      }
+
+      DrawItem item;
+      item.mesh = RenderQueue::KeyMesh(ri.key);
+      const Mat4 &model = m_Models[ri.index];
+      std::copy(model.m, model.m + 16, item.instance.model);
+      std::copy(mat->color, mat->color + 3, item.instance.color);
+      item.instance.color[3] = std::min(std::max(mat->emission, 0.0f), 1.0f);
+      item.instance.surface[0] = mat->metallic;
+      item.instance.surface[1] = mat->roughness;
+      if (textured) {
+        std::copy(slot->rect, slot->rect + 4, item.instance.texRect);
+        item.instance.texLayer = (float)slot->layer;
+        m_TextureBatches[batch].items.push_back(item);
+      } else {
+        std::fill(item.instance.texRect, item.instance.texRect + 4, 0.0f);
+        item.instance.texLayer = 0.0f;
+        m_DrawItems.push_back(item);
+      }
+    }
+
+    if (m_DrawLists.size() <= features)
+      m_DrawLists.resize(features + 1);
+    if (!m_DrawLists[features]) {
+      m_DrawLists[features] = std::make_unique<IndirectDrawList>();
+      m_DrawLists[features]->Init(m_Meshes);
+    }
+    IndirectDrawList &list = *m_DrawLists[features];
+    useProgram(features);
 
-  // Use our specific Gizmo shader
-  glUseProgram(m_GizmoShader);
-  glDisable(GL_DEPTH_TEST); // Gizmos visible thru walls
+    // Counting sort by mesh is stable: front-to-back order survives
+    auto submit = [&](const std::vector<DrawItem> &drawItems) {
+      list.Build(drawItems, m_Meshes);
+      list.Submit();
+      m_Stats.drawCalls += list.GetLastDrawCalls();
+      m_Stats.indirectCommands += (int)list.GetCommands().size();
+      m_Stats.instances += (int)list.GetInstanceCount();
+      m_Stats.multiDrawIndirect = list.HasMultiDrawIndirect();
+    };
+    if (textured) {
+      gl.SetUniform1i(gl.GetUniformLocation(gl.GetProgram(), "uDiffuse"), 0);
+      for (const TextureBatch &b : m_TextureBatches) {
+        if (b.items.empty())
+          continue;
+        gl.BindTexture(0, GL_TEXTURE_2D_ARRAY, b.array);
+        m_Stats.textureBinds++;
+        submit(b.items);
+      }
+    } else {
+      submit(m_DrawItems);
+    }
+    begin = end;
+  }
+  gl.PolygonMode(GL_FILL);
 
-  GLint locMVP = glGetUniformLocation(m_GizmoShader, "uMVP");
-  GLint locColor = glGetUniformLocation(m_GizmoShader, "uColor");
+  m_Stats.stateChanges += stateChanges;
+  m_Stats.sortMs +=
+      std::chrono::duration<float, std::milli>(sortEnd - sortStart).count();
+  m_Stats.chunks = m_Chunks.GetStats();
 
+  // Grid and any debug geometry queued by other systems; kept for the
+  // other views until EndFrame
+  m_Stats.debugDrawCalls +=
+      m_Debug.Flush(DebugDraw::LAYER_WORLD, vp, 1.0f, true);
+}
+
+void Scene::EndFrame() { m_Debug.Clear(DebugDraw::LAYER_WORLD); }
+
+
+
+void Scene::RenderGizmos(const Mat4 &view, const Mat4 &proj,
+                         int selectedIndex, int transformMode,
+                         int hoveredAxis, bool localSpace) {
+  if (selectedIndex < 0 || selectedIndex >= (int)m_Cubes.size())
+    return;
+
+  const auto &c = m_Cubes[selectedIndex];
   Mat4 vp = mat4_mul(proj, view);
 
-  // Position of gizmo
-  float px = c.pos[0];
-  float py = c.pos[1];
-  float pz = c.pos[2];
-  
   // Colors: normal and highlighted (brighter)
-  float colorsNormal[3][4] = {
-    {1.0f, 0.25f, 0.25f, 1.0f},  // X - Red
-    {0.25f, 1.0f, 0.25f, 1.0f},  // Y - Green
-    {0.4f, 0.4f, 1.0f, 1.0f}     // Z - Blue
+  const uint32_t colorsNormal[3] = {
+      DebugDraw::Color(1.0f, 0.25f, 0.25f), // X - Red
+      DebugDraw::Color(0.25f, 1.0f, 0.25f), // Y - Green
+      DebugDraw::Color(0.4f, 0.4f, 1.0f)    // Z - Blue
+  };
+  const uint32_t colorHighlight = DebugDraw::Color(1.0f, 1.0f, 0.2f);
+  auto axisColor = [&](int axis) {
+    return axis == hoveredAxis ? colorHighlight : colorsNormal[axis];
   };
-  float colorHighlight[4] = {1.0f, 1.0f, 0.2f, 1.0f}; // Yellow highlight
 
   // Gizmo size
   const float gizmoLength = 1.5f;
   const float arrowTipSize = 0.1f;
-  
+
   // Build gizmo transform matrix (position + optional rotation for local space)
   Mat4 t_pos = mat4_identity();
-  t_pos.m[12] = px;
-  t_pos.m[13] = py;
-  t_pos.m[14] = pz;
-  
+  t_pos.m[12] = c.pos[0];
+  t_pos.m[13] = c.pos[1];
+  t_pos.m[14] = c.pos[2];
+
   // Build rotation matrix for local space
   Mat4 objRot = mat4_identity();
   if (localSpace) {
     float radX = c.rotation[0] * 3.1415926f / 180.0f;
     float radY = c.rotation[1] * 3.1415926f / 180.0f;
     float radZ = c.rotation[2] * 3.1415926f / 180.0f;
-    
+
     Mat4 rotX = mat4_identity();
     rotX.m[5] = cos(radX); rotX.m[6] = -sin(radX);
     rotX.m[9] = sin(radX); rotX.m[10] = cos(radX);
-    
+
     Mat4 rotY = mat4_identity();
     rotY.m[0] = cos(radY); rotY.m[2] = sin(radY);
     rotY.m[8] = -sin(radY); rotY.m[10] = cos(radY);
-    
+
     Mat4 rotZ = mat4_identity();
     rotZ.m[0] = cos(radZ); rotZ.m[1] = -sin(radZ);
     rotZ.m[4] = sin(radZ); rotZ.m[5] = cos(radZ);
-    
+
     objRot = mat4_mul(mat4_mul(rotZ, rotY), rotX);
   }
-  
+
   // Combined gizmo base transform: position * rotation
   Mat4 gizmoBase = mat4_mul(t_pos, objRot);
 
-  auto setAxisColor = [&](int axis) {
-    if (axis == hoveredAxis) {
-      glUniform4fv(locColor, 1, colorHighlight);
-    } else {
-      glUniform4fv(locColor, 1, colorsNormal[axis]);
-    }
-  };
+  // Everything goes to the overlay layer (gizmos visible thru walls) and is
+  // flushed as one line draw plus one triangle draw for the tips.
+  m_Debug.SetLayer(DebugDraw::LAYER_OVERLAY);
+  const float origin[3] = {0.0f, 0.0f, 0.0f};
+  float lineWidth = 3.0f;
 
-  // Create temporary VAO/VBO for lines
-  GLuint tempVAO, tempVBO;
-  glGenVertexArrays(1, &tempVAO);
-  glGenBuffers(1, &tempVBO);
-
-  if (transformMode == 0) { // TRANSLATE - Lines with arrow tips
-    glLineWidth(3.0f);
-    
-    // Draw axis lines
-    float lineVerts[] = {
-      0.0f, 0.0f, 0.0f, gizmoLength, 0.0f, 0.0f,  // X
-      0.0f, 0.0f, 0.0f, 0.0f, gizmoLength, 0.0f,  // Y
-      0.0f, 0.0f, 0.0f, 0.0f, 0.0f, gizmoLength   // Z
-    };
-    
-    glBindVertexArray(tempVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, tempVBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(lineVerts), lineVerts, GL_DYNAMIC_DRAW);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
-    
-    Mat4 mvp = mat4_mul(vp, gizmoBase);
-    glUniformMatrix4fv(locMVP, 1, GL_FALSE, mvp.m);
-    
-    setAxisColor(0);
-    glDrawArrays(GL_LINES, 0, 2);
-    setAxisColor(1);
-    glDrawArrays(GL_LINES, 2, 2);
-    setAxisColor(2);
-    glDrawArrays(GL_LINES, 4, 2);
-    
-    // Draw arrow tips as small cubes
-    glBindVertexArray(m_VAO_Cube);
-    
-    Mat4 s_tip = mat4_identity();
-    s_tip.m[0] = arrowTipSize * 1.8f;
-    s_tip.m[5] = arrowTipSize;
-    s_tip.m[10] = arrowTipSize;
-    Mat4 t_tip = mat4_identity();
-    t_tip.m[12] = gizmoLength;
-    mvp = mat4_mul(vp, mat4_mul(gizmoBase, mat4_mul(t_tip, s_tip)));
-    glUniformMatrix4fv(locMVP, 1, GL_FALSE, mvp.m);
-    setAxisColor(0);
-    glDrawArrays(GL_TRIANGLES, 0, m_CubeVertexCount);
-
-    s_tip = mat4_identity();
-    s_tip.m[0] = arrowTipSize;
-    s_tip.m[5] = arrowTipSize * 1.8f;
-    s_tip.m[10] = arrowTipSize;
-    t_tip = mat4_identity();
-    t_tip.m[13] = gizmoLength;
-    mvp = mat4_mul(vp, mat4_mul(gizmoBase, mat4_mul(t_tip, s_tip)));
-    glUniformMatrix4fv(locMVP, 1, GL_FALSE, mvp.m);
-    setAxisColor(1);
-    glDrawArrays(GL_TRIANGLES, 0, m_CubeVertexCount);
-
-    s_tip = mat4_identity();
-    s_tip.m[0] = arrowTipSize;
-    s_tip.m[5] = arrowTipSize;
-    s_tip.m[10] = arrowTipSize * 1.8f;
-    t_tip = mat4_identity();
-    t_tip.m[14] = gizmoLength;
-    mvp = mat4_mul(vp, mat4_mul(gizmoBase, mat4_mul(t_tip, s_tip)));
-    glUniformMatrix4fv(locMVP, 1, GL_FALSE, mvp.m);
-    setAxisColor(2);
-    glDrawArrays(GL_TRIANGLES, 0, m_CubeVertexCount);
-    
+  if (transformMode == 0 || transformMode == 2) {
+    // TRANSLATE: lines with elongated tips. SCALE: shorter lines with cubes.
+    // (scale uses gizmoBase too; with localSpace off it is world aligned)
+    const bool scale = transformMode == 2;
+    const float lineEnd = scale ? gizmoLength - 0.1f : gizmoLength;
+    for (int axis = 0; axis < 3; ++axis) {
+      float end[3] = {0.0f, 0.0f, 0.0f};
+      end[axis] = lineEnd;
+      m_Debug.Line(gizmoBase, origin, end, axisColor(axis));
+
+      Mat4 tip = mat4_identity();
+      tip.m[0] = tip.m[5] = tip.m[10] = arrowTipSize;
+      if (!scale)
+        tip.m[axis * 5] = arrowTipSize * 1.8f;
+      tip.m[12 + axis] = gizmoLength;
+      m_Debug.SolidBox(mat4_mul(gizmoBase, tip), axisColor(axis));
+    }
   } else if (transformMode == 1) { // ROTATE - Rings
-    glLineWidth(2.5f);
-    glBindVertexArray(m_VAO_Ring);
-    
+    lineWidth = 2.5f;
     Mat4 s = mat4_identity();
     s.m[0] = gizmoLength;
     s.m[5] = gizmoLength;
     s.m[10] = gizmoLength;
 
     // X Axis Rotation (YZ plane)
-    Mat4 rot = mat4_identity();
-    rot.m[5] = 0; rot.m[6] = 1;
-    rot.m[9] = -1; rot.m[10] = 0;
-    Mat4 mvp = mat4_mul(vp, mat4_mul(gizmoBase, mat4_mul(rot, s)));
-    glUniformMatrix4fv(locMVP, 1, GL_FALSE, mvp.m);
-    setAxisColor(0);
-    glDrawArrays(GL_LINE_LOOP, 0, m_RingVertexCount);
+    Mat4 rotXRing = mat4_identity();
+    rotXRing.m[5] = 0; rotXRing.m[6] = 1;
+    rotXRing.m[9] = -1; rotXRing.m[10] = 0;
+    m_Debug.Circle(mat4_mul(gizmoBase, mat4_mul(rotXRing, s)), axisColor(0));
 
     // Y Axis Rotation (XZ plane)
-    rot = mat4_identity();
-    rot.m[0] = 0; rot.m[2] = -1;
-    rot.m[8] = 1; rot.m[10] = 0;
-    mvp = mat4_mul(vp, mat4_mul(gizmoBase, mat4_mul(rot, s)));
-    glUniformMatrix4fv(locMVP, 1, GL_FALSE, mvp.m);
-    setAxisColor(1);
-    glDrawArrays(GL_LINE_LOOP, 0, m_RingVertexCount);
+    Mat4 rotYRing = mat4_identity();
+    rotYRing.m[0] = 0; rotYRing.m[2] = -1;
+    rotYRing.m[8] = 1; rotYRing.m[10] = 0;
+    m_Debug.Circle(mat4_mul(gizmoBase, mat4_mul(rotYRing, s)), axisColor(1));
 
     // Z Axis Rotation (XY plane)
-    mvp = mat4_mul(vp, mat4_mul(gizmoBase, s));
-    glUniformMatrix4fv(locMVP, 1, GL_FALSE, mvp.m);
-    setAxisColor(2);
-    glDrawArrays(GL_LINE_LOOP, 0, m_RingVertexCount);
-    
-  } else if (transformMode == 2) { // SCALE - Lines with boxes (always local)
-    glLineWidth(3.0f);
-    
-    // Scale gizmo always uses local space (object rotation)
-    Mat4 scaleBase = mat4_mul(t_pos, objRot);
-    
-    float lineVerts[] = {
-      0.0f, 0.0f, 0.0f, gizmoLength - 0.1f, 0.0f, 0.0f,
-      0.0f, 0.0f, 0.0f, 0.0f, gizmoLength - 0.1f, 0.0f,
-      0.0f, 0.0f, 0.0f, 0.0f, 0.0f, gizmoLength - 0.1f
-    };
-    
-    glBindVertexArray(tempVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, tempVBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(lineVerts), lineVerts, GL_DYNAMIC_DRAW);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
-    
-    Mat4 mvp = mat4_mul(vp, scaleBase);
-    glUniformMatrix4fv(locMVP, 1, GL_FALSE, mvp.m);
-    
-    setAxisColor(0);
-    glDrawArrays(GL_LINES, 0, 2);
-    setAxisColor(1);
-    glDrawArrays(GL_LINES, 2, 2);
-    setAxisColor(2);
-    glDrawArrays(GL_LINES, 4, 2);
-    
-    // Draw end boxes
-    glBindVertexArray(m_VAO_Cube);
-    const float boxSize = 0.1f;
-    
-    Mat4 s_box = mat4_identity();
-    s_box.m[0] = boxSize;
-    s_box.m[5] = boxSize;
-    s_box.m[10] = boxSize;
-    
-    Mat4 t_end = mat4_identity();
-    t_end.m[12] = gizmoLength;
-    mvp = mat4_mul(vp, mat4_mul(scaleBase, mat4_mul(t_end, s_box)));
-    glUniformMatrix4fv(locMVP, 1, GL_FALSE, mvp.m);
-    setAxisColor(0);
-    glDrawArrays(GL_TRIANGLES, 0, m_CubeVertexCount);
-
-    t_end = mat4_identity();
-    t_end.m[13] = gizmoLength;
-    mvp = mat4_mul(vp, mat4_mul(scaleBase, mat4_mul(t_end, s_box)));
-    glUniformMatrix4fv(locMVP, 1, GL_FALSE, mvp.m);
-    setAxisColor(1);
-    glDrawArrays(GL_TRIANGLES, 0, m_CubeVertexCount);
-
-    t_end = mat4_identity();
-    t_end.m[14] = gizmoLength;
-    mvp = mat4_mul(vp, mat4_mul(scaleBase, mat4_mul(t_end, s_box)));
-    glUniformMatrix4fv(locMVP, 1, GL_FALSE, mvp.m);
-    setAxisColor(2);
-    glDrawArrays(GL_TRIANGLES, 0, m_CubeVertexCount);
-  }
-
-  // Cleanup temp buffers
-  glDeleteBuffers(1, &tempVBO);
-  glDeleteVertexArrays(1, &tempVAO);
-
-  glBindVertexArray(0);
-  glLineWidth(1.0f);
-  glEnable(GL_DEPTH_TEST);
+    m_Debug.Circle(mat4_mul(gizmoBase, s), axisColor(2));
+  }
+
+  m_Stats.debugVertices +=
+      (int)m_Debug.GetVertexCount(DebugDraw::LAYER_OVERLAY);
+  m_Stats.debugDrawCalls +=
+      m_Debug.Flush(DebugDraw::LAYER_OVERLAY, vp, lineWidth);
+  m_Debug.SetLayer(DebugDraw::LAYER_WORLD);
 }
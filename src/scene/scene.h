@@ -1,36 +1,218 @@
 #pragma once
 
 #include "../project/project_manager.h"
+#include "../render/debug_draw.h"
+#include "../render/indirect_draw.h"
+#include "../render/light_clusters.h"
+#include "../render/mesh_library.h"
+#include "../render/occlusion_culler.h"
+#include "../render/render_queue.h"
+#include "../render/render_stats.h"
+#include "../render/shadow_cascades.h"
 #include "../utils/math_utils.h"
+#include "chunk_grid.h"
 #include "scene_defs.h"
 #include <glad/glad.h>
+#include <algorithm>
+#include <cfloat>
+#include <functional>
+#include <memory>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
+// Camera of one view of a multi-view frame
+struct SceneView {
+  Mat4 view;
+  Mat4 proj; // symmetric perspective or orthographic
+};
+
+// Parses a .mat file (key=value lines); a relative diffuseTexture is
+// resolved to the path to load. Touches no GL state, so it can run on a
+// worker thread. Throws std::invalid_argument on a malformed number.
+Material LoadMaterialFile(const std::string &path);
+
+// What a batch of cube edits touched (Scene::BeginChanges)
+enum SceneChange : uint32_t {
+  SCENE_CHANGE_ADDED = 1u << 0,
+  SCENE_CHANGE_REMOVED = 1u << 1, // dense positions were refilled
+  SCENE_CHANGE_TRANSFORM = 1u << 2,
+  SCENE_CHANGE_MATERIAL = 1u << 3,
+  SCENE_CHANGE_SELECTION = 1u << 4,
+  // Anything but the cube count (Scene::EditCubes)
+  SCENE_CHANGE_CONTENTS = SCENE_CHANGE_TRANSFORM | SCENE_CHANGE_MATERIAL |
+                          SCENE_CHANGE_SELECTION
+};
+
+struct SceneChangeBatch {
+  uint32_t flags = 0; // SceneChange bits, 0 = nothing changed
+  // Dense range of the cubes that may differ, in the array as it is after
+  // the batch (it may end past its size when cubes were removed)
+  uint32_t first = 0xFFFFFFFFu, end = 0;
+  uint32_t added = 0, removed = 0;
+
+  bool Empty() const { return flags == 0; }
+  void Merge(uint32_t changeFlags, uint32_t begin, uint32_t rangeEnd) {
+    flags |= changeFlags;
+    first = std::min(first, begin);
+    end = std::max(end, rangeEnd);
+  }
+  void Merge(const SceneChangeBatch &other) {
+    if (other.Empty())
+      return;
+    Merge(other.flags, other.first, other.end);
+    added += other.added;
+    removed += other.removed;
+  }
+};
+using SceneChangeListener = std::function<void(const SceneChangeBatch &)>;
+
 class Scene {
 public:
   Scene();
   ~Scene();
 
   void Init();
-  void Render(const Mat4 &view, const Mat4 &proj, GLuint shaderProgram);
+  // Scene objects use the "scene" shader family (Content/Shaders/scene.*)
+  void Render(const Mat4 &view, const Mat4 &proj);
+
+  // Multi-view frames (split viewports). BeginFrame does the work shared by
+  // up to ViewFrusta::MAX_VIEWS views once: chunk sync, loose transforms,
+  // and visibility against the box around all frusta refined per view on
+  // the job system. Occlusion culling and the shadow cascades follow
+  // views[0]. RenderView then draws one view into the bound framebuffer
+  // and viewport; EndFrame drops the debug geometry they all drew.
+  void BeginFrame(const SceneView *views, int count);
+  void RenderView(int index);
+  void EndFrame();
   // transformMode: 0=Translate, 1=Rotate, 2=Scale
   // hoveredAxis: -1=none, 0=X, 1=Y, 2=Z (for highlight)
   // localSpace: if true, gizmo axes follow object rotation
-  void RenderGizmos(const Mat4 &view, const Mat4 &proj, GLuint shaderProgram,
-                    int selectedIndex, int transformMode, int hoveredAxis = -1,
+  void RenderGizmos(const Mat4 &view, const Mat4 &proj, int selectedIndex,
+                    int transformMode, int hoveredAxis = -1,
                     bool localSpace = false);
 
-  std::vector<CubeInst> &GetCubes() { return m_Cubes; }
+  // Dense cube array. Its order changes when cubes are removed (the last
+  // one moves into the hole), so indices into it only hold until the next
+  // removal; keep an EntityHandle to refer to a cube across edits.
   const std::vector<CubeInst> &GetCubes() const { return m_Cubes; }
+  // Direct write access, published as a change of every cube's contents
+  // (not the count): the caches rescan them all. Prefer the batch calls
+  // below; the reference is only good until the current batch ends.
+  std::vector<CubeInst> &EditCubes();
+
+  // Entities: each cube owns a slot (EntityHandle::index) mapped to its
+  // dense index. Removal is O(1) per cube (swap-and-pop) and bumps the
+  // slot's generation, which invalidates the handles to it.
+  EntityHandle AddCube(const CubeInst &cube);
+  // One reserve for the batch; the new cubes are appended in order. Their
+  // handles are written to handles if not null.
+  void AddCubes(const CubeInst *cubes, size_t count,
+                std::vector<EntityHandle> *handles = nullptr);
+  // False if the handle is stale
+  bool RemoveCube(EntityHandle handle);
+  // Stale or repeated handles are skipped. Small sets are swapped out one
+  // by one, O(handles); large ones in a single compacting pass. The order
+  // of the remaining cubes is not kept. Returns the count removed.
+  size_t RemoveCubes(const std::vector<EntityHandle> &handles);
+  // Removes every cube for which remove(const CubeInst &) is true in one
+  // compacting pass that keeps the order of the rest
+  template <typename Fn> size_t RemoveCubesIf(Fn remove) {
+    m_RemoveMarks.assign(m_Cubes.size(), 0);
+    for (size_t i = 0; i < m_Cubes.size(); ++i)
+      m_RemoveMarks[i] = remove((const CubeInst &)m_Cubes[i]) ? 1 : 0;
+    return RemoveMarked();
+  }
+  // Brings a removed cube back under its old handle (undo); appended at
+  // the end of the dense array. False if the slot is in use.
+  bool RestoreCube(EntityHandle handle, const CubeInst &cube);
+  void Clear();
+
+  // Transform field (0=pos, 1=rotation, 2=scale) of a run of cubes offset
+  // by delta, through the SIMD batch path (vec3_array_offset). Components
+  // are clamped to minValue.
+  void TransformRange(uint32_t first, uint32_t count, int field,
+                      const float delta[3], float minValue = -FLT_MAX);
+  // Same for a set of cubes, each written as its start value (packed xyz
+  // per handle) plus delta, so repeated calls during a drag do not drift.
+  // Stale handles are skipped.
+  void TransformCubes(const std::vector<EntityHandle> &handles, int field,
+                      const float *start, const float delta[3],
+                      float minValue = -FLT_MAX);
+  // CubeInst::materialPath (the material is resolved again on the next
+  // frame). Stale handles are skipped.
+  void SetMaterial(EntityHandle handle, const std::string &path);
+  void SetMaterial(const std::vector<EntityHandle> &handles,
+                   const std::string &path);
+  // CubeInst::selected, read by the renderer (selected cubes are dynamic)
+  void SetSelected(EntityHandle handle, bool selected);
+
+  bool IsValid(EntityHandle handle) const {
+    return handle.index < m_Slots.size() &&
+           m_Slots[handle.index].dense != FREE_SLOT &&
+           m_Slots[handle.index].generation == handle.generation;
+  }
+  // Dense index of a cube, -1 if the handle is stale
+  int GetIndex(EntityHandle handle) const {
+    return IsValid(handle) ? (int)m_Slots[handle.index].dense : -1;
+  }
+  EntityHandle GetHandle(uint32_t index) const {
+    const uint32_t slot = m_DenseToSlot[index];
+    return EntityHandle{slot, m_Slots[slot].generation};
+  }
+  // Bumped whenever cubes are removed or restored (handles may go stale)
+  uint64_t GetEntityVersion() const { return m_EntityVersion; }
+  // Bumped by Reset, which drops the loaded materials: CubeInst::material
+  // handles from before it may name another material
+  uint64_t GetMaterialsVersion() const { return m_MaterialsVersion; }
 
-  void AddCube(const CubeInst &cube) { m_Cubes.push_back(cube); }
-  void Clear() { m_Cubes.clear(); }
+  // Change notification. Every edit above is gathered into a batch; edits
+  // between BeginChanges and EndChanges (nesting) form one batch, any
+  // other edit is a batch of its own. Listeners get each batch once, when
+  // it ends, and should only note what to refresh (EditCubes publishes
+  // before the caller writes). The chunk grid and the loose cube data
+  // accumulate the batches until the next BeginFrame and rescan only the
+  // dense range they touched.
+  void BeginChanges() { m_ChangeDepth++; }
+  void EndChanges();
+  int AddChangeListener(SceneChangeListener listener);
+  void RemoveChangeListener(int id);
+  // Bumped by every published batch
+  uint64_t GetChangeVersion() const { return m_ChangeVersion; }
+
+  // Point/spot lights, shaded per cluster (see LightClusters). Without any
+  // light the scene keeps its unlit look.
+  void AddLight(const Light &light) { m_Lights.push_back(light); }
+  std::vector<Light> &GetLights() { return m_Lights; }
+  const std::vector<Light> &GetLights() const { return m_Lights; }
+  void ClearLights() { m_Lights.clear(); }
+  // Directional light with cascaded shadows (see ShadowCascades)
+  DirectionalLight &GetSun() { return m_Sun; }
+  const DirectionalLight &GetSun() const { return m_Sun; }
+  void SetShadowDistance(float distance) { m_Shadows.SetDistance(distance); }
+  void SetAmbient(float r, float g, float b) {
+    m_Ambient[0] = r;
+    m_Ambient[1] = g;
+    m_Ambient[2] = b;
+  }
 
   void SetWireframe(bool enabled) { m_Wireframe = enabled; }
+  void SetOcclusionCulling(bool enabled) { m_OcclusionCulling = enabled; }
+  // Max number of cubes rasterized as occluders per frame
+  void SetOccluderBudget(int budget) { m_OccluderBudget = budget; }
+
+  const RenderStats &GetRenderStats() const { return m_Stats; }
+  // Lines/boxes queued here are drawn with the next Render (world layer)
+  DebugDraw &GetDebugDraw() { return m_Debug; }
 
-  // Serialization
+  // Serialization. LoadFromProject is Reset plus AddProjectCubes for all
+  // of them; a load spread over frames calls those itself.
   void LoadFromProject(const ProjectData &project);
+  // Clear, and drops the chunk batches and the loaded materials
+  void Reset();
+  // project.cubes[first, first + count), appended as one batch
+  void AddProjectCubes(const ProjectData &project, size_t first,
+                       size_t count);
   void GetProjectData(ProjectData &project) const;
 
   // Interaction
@@ -41,25 +223,105 @@ private:
   std::vector<CubeInst> m_Cubes;
   bool m_Wireframe = false;
 
-  // OpenGL Resources
-  GLuint m_VAO_Grid = 0, m_VBO_Grid = 0;
-  int m_GridVertexCount = 0;
-  GLuint m_GizmoShader = 0;
-
-  GLuint m_VAO_Cube = 0, m_VBO_Cube = 0;
-  int m_CubeVertexCount = 0;
-
-  // Gizmo Resources
-  GLuint m_VAO_Arrow = 0, m_VBO_Arrow = 0;
-  int m_ArrowVertexCount = 0;
-  GLuint m_VAO_Ring = 0, m_VBO_Ring = 0;
-  int m_RingVertexCount = 0;
-  GLuint m_VAO_Scale = 0, m_VBO_Scale = 0;
-  int m_ScaleVertexCount = 0;
-
-  void InitGrid();
-  void InitCubeResources();
-  void InitGizmoResources();
-  void ApplyMaterialToShader(const Material &material, GLuint shaderProgram);
-  Material GetMaterialFromPath(const std::string &path);
+  // Entity slots. A free slot keeps the generation its next cube will get;
+  // nextGeneration only grows, so a restored handle never collides with one
+  // handed out meanwhile.
+  static constexpr uint32_t FREE_SLOT = 0xFFFFFFFFu;
+  struct EntitySlot {
+    uint32_t dense = FREE_SLOT;
+    uint32_t generation = 0;
+    uint32_t nextGeneration = 1;
+  };
+  std::vector<EntitySlot> m_Slots;
+  std::vector<uint32_t> m_DenseToSlot; // parallel to m_Cubes
+  // Freed slots, reused last first; restored slots are skipped when popped
+  std::vector<uint32_t> m_FreeSlots;
+  uint64_t m_EntityVersion = 0;
+  uint64_t m_MaterialsVersion = 0;
+  std::vector<char> m_RemoveMarks; // per dense cube, RemoveCubesIf
+  std::vector<float> m_TransformScratch;
+  void FreeSlot(uint32_t slot);
+  // Swap-and-pop without publishing
+  bool EraseCube(EntityHandle handle);
+  // Removes the cubes flagged in m_RemoveMarks (stable compaction)
+  size_t RemoveMarked();
+
+  // Change batches
+  int m_ChangeDepth = 0;
+  SceneChangeBatch m_PendingChanges; // batch being gathered
+  SceneChangeBatch m_FrameChanges;   // since the last BeginFrame
+  uint64_t m_ChangeVersion = 0;
+  std::vector<std::pair<int, SceneChangeListener>> m_ChangeListeners;
+  int m_NextListener = 1;
+  // Merges an edit into the pending batch; published right away outside
+  // BeginChanges/EndChanges
+  void NoteChange(uint32_t flags, uint32_t first, uint32_t end,
+                  uint32_t added = 0, uint32_t removed = 0);
+  void PublishChanges();
+
+  // Grid and gizmos
+  DebugDraw m_Debug;
+
+  // Instanced / indirect path for scene objects
+  MeshLibrary m_Meshes;
+  uint32_t m_CubeMesh = 0;
+  // One draw list per shader permutation of the loose cubes, created on use
+  std::vector<std::unique_ptr<IndirectDrawList>> m_DrawLists;
+  std::vector<DrawItem> m_DrawItems;
+  // Textured objects of the current run, one batch per texture array
+  struct TextureBatch {
+    GLuint array;
+    std::vector<DrawItem> items;
+  };
+  std::vector<TextureBatch> m_TextureBatches;
+  int m_ShaderFamily = -1;
+  RenderQueue m_Queue;
+  RenderStats m_Stats;
+  // Static cubes, batched per chunk
+  ChunkGrid m_Chunks;
+  std::vector<uint32_t> m_Loose; // cubes drawn through the render queue
+  std::vector<Mat4> m_Models;    // per loose cube, rebuilt each Render
+
+  // CPU occlusion culling
+  OcclusionCuller m_Occlusion;
+  bool m_OcclusionCulling = true;
+  int m_OccluderBudget = 64;
+  std::vector<float> m_Boxes; // world AABB per loose cube (min, max)
+  std::vector<char> m_Visible;
+  std::vector<const Mat4 *> m_OccluderCandidates;
+  std::vector<std::pair<float, const Mat4 *>> m_OccluderScores;
+
+  // Clustered lighting
+  std::vector<Light> m_Lights;
+  std::vector<ClusterLight> m_ClusterLights;
+  LightClusters m_LightClusters;
+  float m_Ambient[3] = {0.25f, 0.25f, 0.25f};
+  DirectionalLight m_Sun;
+
+  // Shadow cascades: chunks are the cached static casters, loose cubes the
+  // per-frame dynamic ones
+  ShadowCascades m_Shadows;
+  int m_ShadowFamily = -1;
+  bool m_ShadowsValid = false; // false after frames without shadows
+  std::unique_ptr<IndirectDrawList> m_ShadowList;
+  std::vector<DrawItem> m_ShadowItems;
+
+  // Views of the current frame (BeginFrame)
+  std::vector<SceneView> m_Views;
+  ViewFrusta m_Frusta;
+  std::vector<uint8_t> m_ViewMasks; // per loose cube, bit v: visible in view v
+  bool m_Lit = false;
+  bool m_Shadowed = false;
+
+  // Material handles (index into m_Materials), cached in CubeInst::material
+  std::vector<Material> m_Materials;
+  std::unordered_map<std::string, int> m_MaterialLookup;
+
+  void InitMeshResources();
+  void CullOccluded(const Mat4 &view, const Mat4 &vp);
+  void CullViews();
+  void UpdateLights(const Mat4 &view, const Mat4 &proj);
+  void RenderShadows(const Mat4 &view, const Mat4 &proj);
+  int GetMaterialHandle(const std::string &path);
+  size_t GetTextureBatch(GLuint array);
 };
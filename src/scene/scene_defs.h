@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstdint>
 #include <string>
 #include <vector>
 
@@ -7,12 +8,60 @@
 struct Material {
     std::string name;
     std::string diffuseTexture = "";
+    uint32_t diffuseHandle = 0;          // TextureManager handle (0 = sin textura)
     float color[3] = {1.0f, 1.0f, 1.0f}; // RGB
     float metallic = 0.0f;
     float roughness = 0.5f;
     float emission = 0.0f;
 };
 
+// Referencia estable a un cubo de Scene: slot + generacion. Los indices
+// densos (GetCubes) cambian al borrar otros cubos; el slot no. Borrar el
+// cubo avanza la generacion del slot, asi que un handle guardado de antes
+// deja de ser valido en lugar de apuntar al cubo que reutilice el slot.
+struct EntityHandle {
+    static constexpr uint32_t INVALID_INDEX = 0xFFFFFFFFu;
+    uint32_t index = INVALID_INDEX; // slot
+    uint32_t generation = 0;
+
+    bool operator==(const EntityHandle& other) const {
+        return index == other.index && generation == other.generation;
+    }
+    bool operator!=(const EntityHandle& other) const { return !(*this == other); }
+};
+
+// Frustums de las vistas de un frame (Scene::BeginFrame), planos como en
+// frustum_planes
+struct ViewFrusta {
+    static constexpr int MAX_VIEWS = 8;
+    int count = 0;
+    float planes[MAX_VIEWS][6][4];
+    float bounds[6]; // AABB del mundo que los contiene a todos
+};
+
+// Luces dinamicas (clustered forward shading)
+enum class LightType { Point, Spot };
+
+struct Light {
+    LightType type = LightType::Point;
+    float pos[3] = {0.0f, 0.0f, 0.0f};
+    float dir[3] = {0.0f, -1.0f, 0.0f}; // spot
+    float color[3] = {1.0f, 1.0f, 1.0f};
+    float intensity = 1.0f;
+    float range = 10.0f;      // sin contribucion mas alla del radio
+    float innerAngle = 20.0f; // spot, grados desde el eje
+    float outerAngle = 30.0f;
+};
+
+// Luz direccional (sol); la unica con sombras (cascadas)
+struct DirectionalLight {
+    bool enabled = false;
+    bool castShadows = true;
+    float dir[3] = {-0.4f, -1.0f, -0.3f}; // direccion en la que viaja la luz
+    float color[3] = {1.0f, 0.95f, 0.85f};
+    float intensity = 1.5f;
+};
+
 // Objetos de escena y recursos de malla
 struct CubeInst { 
     float pos[3]; 
@@ -20,8 +69,9 @@ struct CubeInst {
     float scale[3];     // escala (X, Y, Z)
     bool selected;
     std::string materialPath; // ruta al archivo de material
+    int material;             // handle de material en Scene (-1 = sin resolver)
     
-    CubeInst() : selected(false), materialPath("") { 
+    CubeInst() : selected(false), materialPath(""), material(-1) { 
         pos[0] = pos[1] = pos[2] = 0.0f; 
         rotation[0] = rotation[1] = rotation[2] = 0.0f;
         scale[0] = scale[1] = scale[2] = 1.0f;
@@ -0,0 +1,234 @@
+#include "program_cache.h"
+#include "../render/gl_state_cache.h"
+#include "shader.h"
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+namespace Shader {
+
+namespace {
+
+const char CACHE_MAGIC[4] = {'M', 'E', 'P', 'B'};
+const uint32_t CACHE_VERSION = 1;
+
+struct CacheHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t format;  // GLenum from glGetProgramBinary
+    uint32_t length;  // bytes of binary that follow
+    uint64_t key;
+};
+
+std::string g_CacheDir;
+ProgramCacheStats g_Stats;
+int g_Supported = -1;  // -1 = not queried yet
+uint64_t g_DeviceHash = 0;
+
+uint64_t fnv1a(uint64_t h, const void* data, size_t size) {
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    for (size_t i = 0; i < size; ++i) {
+        h ^= p[i];
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+uint64_t fnv1a(uint64_t h, const std::string& s) {
+    // Length first so ("ab","c") and ("a","bc") differ
+    uint64_t n = s.size();
+    h = fnv1a(h, &n, sizeof(n));
+    return fnv1a(h, s.data(), s.size());
+}
+
+std::string glString(GLenum name) {
+    const GLubyte* s = glGetString(name);
+    return s ? reinterpret_cast<const char*>(s) : "";
+}
+
+std::string cachePath(uint64_t key) {
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx.bin", (unsigned long long)key);
+    return (std::filesystem::path(g_CacheDir) / name).string();
+}
+
+double msSince(std::chrono::high_resolution_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(
+               std::chrono::high_resolution_clock::now() - start).count();
+}
+
+GLuint tryLoad(uint64_t key) {
+    const std::string path = cachePath(key);
+    std::error_code ec;
+    const uintmax_t fileSize = std::filesystem::file_size(path, ec);
+    if (ec)
+        return 0;
+    std::ifstream file(path, std::ios::binary);
+    if (!file)
+        return 0;
+    CacheHeader header;
+    if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+        std::memcmp(header.magic, CACHE_MAGIC, 4) != 0 ||
+        header.version != CACHE_VERSION || header.key != key)
+        return 0;
+    // Entrada truncada o corrupta: no reservar lo que dice la cabecera
+    if (header.length == 0 || header.length > fileSize - sizeof(header))
+        return 0;
+    std::vector<char> binary(header.length);
+    if (!file.read(binary.data(), binary.size()))
+        return 0;
+
+    GLuint prog = glCreateProgram();
+    glProgramBinary(prog, header.format, binary.data(), (GLsizei)binary.size());
+    GLint success = 0;
+    glGetProgramiv(prog, GL_LINK_STATUS, &success);
+    if (!success) {
+        // Formato no aceptado (driver distinto o actualizado)
+        GLStateCache::Get().DeleteProgram(prog);
+        g_Stats.rejected++;
+        return 0;
+    }
+    return prog;
+}
+
+void store(uint64_t key, GLuint prog) {
+    GLint length = 0;
+    glGetProgramiv(prog, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0)
+        return;
+    std::vector<char> binary(length);
+    GLenum format = 0;
+    glGetProgramBinary(prog, length, &length, &format, binary.data());
+
+    std::error_code ec;
+    std::filesystem::create_directories(g_CacheDir, ec);
+    // Write to a temp file and rename so a crash never leaves a torn entry
+    std::string path = cachePath(key);
+    std::string tmp = path + ".tmp";
+    {
+        std::ofstream file(tmp, std::ios::binary | std::ios::trunc);
+        if (!file)
+            return;
+        CacheHeader header;
+        std::memcpy(header.magic, CACHE_MAGIC, 4);
+        header.version = CACHE_VERSION;
+        header.format = format;
+        header.length = (uint32_t)length;
+        header.key = key;
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(binary.data(), length);
+        if (!file)
+            return;
+    }
+    std::filesystem::rename(tmp, path, ec);
+    if (ec)
+        std::filesystem::remove(tmp, ec);
+}
+
+} // namespace
+
+// Inserts the defines right after the #version line (GLSL requires it first)
+std::string applyDefines(const char* src, const char* defines) {
+    std::string out = src;
+    if (!defines || !*defines)
+        return out;
+    size_t pos = out.find("#version");
+    size_t lineEnd = pos == std::string::npos ? std::string::npos : out.find('\n', pos);
+    std::string block = defines;
+    if (block.back() != '\n')
+        block += '\n';
+    if (lineEnd == std::string::npos)
+        return block + out;
+    out.insert(lineEnd + 1, block);
+    return out;
+}
+
+void setProgramCacheDir(const std::string& dir) {
+    g_CacheDir = dir;
+}
+
+const std::string& getProgramCacheDir() {
+    return g_CacheDir;
+}
+
+bool programBinarySupported() {
+    if (g_Supported < 0) {
+        GLint formats = 0;
+        if (GLAD_GL_VERSION_4_1 || GLAD_GL_ARB_get_program_binary)
+            glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+        g_Supported = formats > 0 ? 1 : 0;
+        g_DeviceHash = fnv1a(1469598103934665603ull, glString(GL_VENDOR));
+        g_DeviceHash = fnv1a(g_DeviceHash, glString(GL_RENDERER));
+        g_DeviceHash = fnv1a(g_DeviceHash, glString(GL_VERSION));
+    }
+    return g_Supported == 1;
+}
+
+uint64_t programCacheKey(const std::string& vs, const std::string& fs) {
+    if (g_CacheDir.empty() || !programBinarySupported())
+        return 0;
+    uint64_t key = fnv1a(g_DeviceHash, vs);
+    key = fnv1a(key, fs);
+    return key ? key : 1;
+}
+
+GLuint loadCachedProgram(uint64_t key) {
+    if (!key)
+        return 0;
+    auto start = std::chrono::high_resolution_clock::now();
+    GLuint prog = tryLoad(key);
+    if (prog) {
+        g_Stats.hits++;
+        g_Stats.loadMs += msSince(start);
+    }
+    return prog;
+}
+
+void storeCachedProgram(uint64_t key, GLuint prog) {
+    if (key)
+        store(key, prog);
+}
+
+GLuint createCachedProgram(const char* vs, const char* fs, const char* defines) {
+    const std::string vsFull = applyDefines(vs, defines);
+    const std::string fsFull = applyDefines(fs, defines);
+    const uint64_t key = programCacheKey(vsFull, fsFull);
+    if (GLuint prog = loadCachedProgram(key))
+        return prog;
+
+    auto start = std::chrono::high_resolution_clock::now();
+    GLuint v = compileShader(GL_VERTEX_SHADER, vsFull.c_str());
+    GLuint f = compileShader(GL_FRAGMENT_SHADER, fsFull.c_str());
+    GLuint prog = glCreateProgram();
+    glAttachShader(prog, v);
+    glAttachShader(prog, f);
+    if (key)
+        glProgramParameteri(prog, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    glLinkProgram(prog);
+    GLint success = 0;
+    glGetProgramiv(prog, GL_LINK_STATUS, &success);
+    if (!success) {
+        char log[512];
+        glGetProgramInfoLog(prog, 512, nullptr, log);
+        std::cerr << "Program link error: " << log << std::endl;
+    }
+    glDeleteShader(v);
+    glDeleteShader(f);
+    g_Stats.misses++;
+    g_Stats.compileMs += msSince(start);
+
+    if (success)
+        storeCachedProgram(key, prog);
+    return prog;
+}
+
+const ProgramCacheStats& getProgramCacheStats() {
+    return g_Stats;
+}
+
+} // namespace Shader
@@ -0,0 +1,46 @@
+#ifndef PROGRAM_CACHE_H
+#define PROGRAM_CACHE_H
+
+#include <glad/glad.h>
+#include <cstdint>
+#include <string>
+
+namespace Shader {
+
+// Contadores de la cache de programas (arranque en frio vs caliente).
+// Shown in the Stats panel and printed by --headless runs: a run with an
+// empty cache dir gives the cold numbers, the next one the warm numbers.
+struct ProgramCacheStats {
+    int hits = 0;        // programs restored with glProgramBinary
+    int misses = 0;      // no cache entry: compiled from source
+    int rejected = 0;    // entry present but the driver refused it
+    double loadMs = 0.0;
+    double compileMs = 0.0;
+};
+
+// On-disk cache of glGetProgramBinary blobs, one file per program:
+//   <dir>/<key>.bin, key = FNV-1a 64 of the final sources (defines
+//   included) + GL_VENDOR/GL_RENDERER/GL_VERSION.
+// A driver update changes the key; a blob the driver still rejects (format
+// mismatch) is recompiled and overwritten. Empty dir disables the cache.
+void setProgramCacheDir(const std::string& dir);
+const std::string& getProgramCacheDir();
+bool programBinarySupported();
+
+// Compiles or restores; used by createProgram
+GLuint createCachedProgram(const char* vs, const char* fs, const char* defines);
+
+// Building blocks for callers that link asynchronously (shader_library.h).
+// programCacheKey returns 0 when the cache is disabled; load/store are
+// no-ops for key 0. Programs to be stored must be linked with
+// GL_PROGRAM_BINARY_RETRIEVABLE_HINT.
+std::string applyDefines(const char* src, const char* defines);
+uint64_t programCacheKey(const std::string& vs, const std::string& fs);
+GLuint loadCachedProgram(uint64_t key);
+void storeCachedProgram(uint64_t key, GLuint prog);
+
+const ProgramCacheStats& getProgramCacheStats();
+
+} // namespace Shader
+
+#endif // PROGRAM_CACHE_H
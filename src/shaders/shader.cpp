@@ -1,4 +1,5 @@
 #include "shader.h"
+#include "program_cache.h"
 #include <iostream>
 
 namespace Shader {
@@ -17,23 +18,8 @@ GLuint compileShader(GLenum type, const char* src) {
     return shader;
 }
 
-GLuint createProgram(const char* vs, const char* fs) {
-    GLuint v = compileShader(GL_VERTEX_SHADER, vs);
-    GLuint f = compileShader(GL_FRAGMENT_SHADER, fs);
-    GLuint prog = glCreateProgram();
-    glAttachShader(prog, v);
-    glAttachShader(prog, f);
-    glLinkProgram(prog);
-    GLint success = 0;
-    glGetProgramiv(prog, GL_LINK_STATUS, &success);
-    if (!success) {
-        char log[512];
-        glGetProgramInfoLog(prog, 512, nullptr, log);
-        std::cerr << "Program link error: " << log << std::endl;
-    }
-    glDeleteShader(v);
-    glDeleteShader(f);
-    return prog;
+GLuint createProgram(const char* vs, const char* fs, const char* defines) {
+    return createCachedProgram(vs, fs, defines);
 }
 
 } // namespace Shader
@@ -6,7 +6,9 @@
 namespace Shader {
 
 GLuint compileShader(GLenum type, const char* src);
-GLuint createProgram(const char* vs, const char* fs);
+// Goes through the program binary cache (program_cache.h) when enabled.
+// defines: "#define X 1\n" lines inserted after #version (may be null).
+GLuint createProgram(const char* vs, const char* fs, const char* defines = nullptr);
 
 } // namespace Shader
 
@@ -0,0 +1,210 @@
+#include "shader_library.h"
+#include "../render/gl_state_cache.h"
+#include "program_cache.h"
+#include "shader.h"
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+namespace {
+
+using Clock = std::chrono::high_resolution_clock;
+
+double msSince(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+std::string readFile(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file)
+        return "";
+    std::stringstream ss;
+    ss << file.rdbuf();
+    return ss.str();
+}
+
+// Issues the compile without querying the status (that would block)
+GLuint startShader(GLenum type, const std::string& src) {
+    GLuint shader = glCreateShader(type);
+    const char* text = src.c_str();
+    glShaderSource(shader, 1, &text, nullptr);
+    glCompileShader(shader);
+    return shader;
+}
+
+void printShaderLog(GLuint shader, const char* stage) {
+    GLint success = 0;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+    if (success)
+        return;
+    char log[512];
+    glGetShaderInfoLog(shader, 512, nullptr, log);
+    std::cerr << "  " << stage << ": " << log << std::endl;
+}
+
+} // namespace
+
+ShaderLibrary& ShaderLibrary::Get() {
+    static ShaderLibrary instance;
+    return instance;
+}
+
+void ShaderLibrary::Init(const std::string& dir) {
+    m_Dir = dir;
+    m_Stats.parallelCompile = GLAD_GL_KHR_parallel_shader_compile != 0;
+    if (m_Stats.parallelCompile) {
+        // 0xFFFFFFFF: let the driver pick the number of compiler threads
+        glMaxShaderCompilerThreadsKHR(0xFFFFFFFFu);
+    }
+}
+
+int ShaderLibrary::Register(const char* name, const std::vector<std::string>& features,
+                            const char* fallbackVs, const char* fallbackFs) {
+    Family family;
+    family.name = name;
+    family.features = features;
+    if (family.features.size() > 32)
+        family.features.resize(32);
+    const std::filesystem::path base = std::filesystem::path(m_Dir) / name;
+    family.vs = readFile(base.string() + ".vert");
+    family.fs = readFile(base.string() + ".frag");
+    if (family.vs.empty() || family.fs.empty()) {
+        std::cerr << "Shader family '" << name << "' not found in " << m_Dir
+                  << ", using the built-in fallback" << std::endl;
+        family.vs.clear();
+        family.fs.clear();
+    }
+    family.fallback = Shader::createProgram(fallbackVs, fallbackFs);
+    m_Families.push_back(std::move(family));
+    return (int)m_Families.size() - 1;
+}
+
+bool ShaderLibrary::IsReady(int family, uint32_t features) const {
+    const auto& variants = m_Families[family].variants;
+    auto it = variants.find(features);
+    return it != variants.end() && it->second.state == VariantState::Ready;
+}
+
+GLuint ShaderLibrary::GetProgram(int familyId, uint32_t features) {
+    Family& family = m_Families[familyId];
+    auto it = family.variants.find(features);
+    if (it != family.variants.end()) {
+        if (it->second.state == VariantState::Ready)
+            return it->second.program;
+        if (it->second.state != VariantState::Failed)
+            m_FrameFallbacks++;
+        return family.fallback;
+    }
+
+    // First request for this permutation
+    Variant& variant = family.variants[features];
+    m_Stats.variants++;
+    if (family.vs.empty()) {
+        variant.state = VariantState::Failed;
+        m_Stats.failed++;
+        return family.fallback;
+    }
+
+    auto start = Clock::now();
+    std::string defines;
+    for (size_t bit = 0; bit < family.features.size(); ++bit) {
+        if (features & (1u << bit))
+            defines += "#define " + family.features[bit] + " 1\n";
+    }
+    variant.vsSource = Shader::applyDefines(family.vs.c_str(), defines.c_str());
+    variant.fsSource = Shader::applyDefines(family.fs.c_str(), defines.c_str());
+    variant.cacheKey = Shader::programCacheKey(variant.vsSource, variant.fsSource);
+    variant.requested = start;
+
+    variant.program = Shader::loadCachedProgram(variant.cacheKey);
+    if (variant.program) {
+        variant.state = VariantState::Ready;
+        variant.vsSource.clear();
+        variant.fsSource.clear();
+        m_Stats.ready++;
+        m_Stats.fromCache++;
+        m_Stats.submitMs += msSince(start);
+        return variant.program;
+    }
+
+    if (m_Stats.parallelCompile)
+        StartCompile(variant);
+    m_Pending.push_back({familyId, features});
+    m_Stats.pending++;
+    m_Stats.submitMs += msSince(start);
+    m_FrameFallbacks++;
+    return family.fallback;
+}
+
+void ShaderLibrary::StartCompile(Variant& variant) {
+    variant.vs = startShader(GL_VERTEX_SHADER, variant.vsSource);
+    variant.fs = startShader(GL_FRAGMENT_SHADER, variant.fsSource);
+    variant.program = glCreateProgram();
+    glAttachShader(variant.program, variant.vs);
+    glAttachShader(variant.program, variant.fs);
+    if (variant.cacheKey)
+        glProgramParameteri(variant.program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    glLinkProgram(variant.program);
+    variant.state = VariantState::Compiling;
+}
+
+void ShaderLibrary::FinishCompile(Family& family, uint32_t features, Variant& variant) {
+    GLint success = 0;
+    glGetProgramiv(variant.program, GL_LINK_STATUS, &success);
+    if (success) {
+        Shader::storeCachedProgram(variant.cacheKey, variant.program);
+        variant.state = VariantState::Ready;
+        m_Stats.ready++;
+    } else {
+        char log[512];
+        glGetProgramInfoLog(variant.program, 512, nullptr, log);
+        std::cerr << "Shader variant '" << family.name << "' 0x" << std::hex << features
+                  << std::dec << " failed: " << log << std::endl;
+        printShaderLog(variant.vs, "vertex");
+        printShaderLog(variant.fs, "fragment");
+        GLStateCache::Get().DeleteProgram(variant.program);
+        variant.program = 0;
+        variant.state = VariantState::Failed;
+        m_Stats.failed++;
+    }
+    glDeleteShader(variant.vs);
+    glDeleteShader(variant.fs);
+    variant.vs = variant.fs = 0;
+    variant.vsSource.clear();
+    variant.fsSource.clear();
+    m_Stats.pending--;
+    m_Stats.lastLatencyMs = msSince(variant.requested);
+}
+
+void ShaderLibrary::Poll() {
+    m_Stats.fallbackUses = m_FrameFallbacks;
+    m_FrameFallbacks = 0;
+    if (m_Pending.empty())
+        return;
+
+    auto start = Clock::now();
+    bool startedSync = false;
+    auto done = [&](const std::pair<int, uint32_t>& entry) {
+        Family& family = m_Families[entry.first];
+        Variant& variant = family.variants[entry.second];
+        if (variant.state == VariantState::Queued) {
+            // No parallel compile: one blocking compile per frame at most
+            if (startedSync)
+                return false;
+            startedSync = true;
+            StartCompile(variant);
+        } else {
+            GLint complete = GL_FALSE;
+            glGetProgramiv(variant.program, GL_COMPLETION_STATUS_KHR, &complete);
+            if (!complete)
+                return false;
+        }
+        FinishCompile(family, entry.second, variant);
+        return true;
+    };
+    m_Pending.erase(std::remove_if(m_Pending.begin(), m_Pending.end(), done),
+                    m_Pending.end());
+    m_Stats.submitMs += msSince(start);
+}
@@ -0,0 +1,93 @@
+#ifndef SHADER_LIBRARY_H
+#define SHADER_LIBRARY_H
+
+#include <glad/glad.h>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Contadores de variantes para el panel de estadisticas
+struct ShaderLibraryStats {
+    int variants = 0;        // variants requested so far
+    int ready = 0;
+    int pending = 0;         // compiling, or queued without the KHR extension
+    int failed = 0;
+    int fromCache = 0;       // restored from the program binary cache
+    int fallbackUses = 0;    // GetProgram calls answered with the fallback last frame
+    double submitMs = 0.0;   // main-thread time spent issuing and finishing compiles
+    double lastLatencyMs = 0.0; // request -> ready of the last finished variant
+    bool parallelCompile = false;
+};
+
+// Shader families loaded from <dir>/<name>.vert and <dir>/<name>.frag.
+// Each family declares up to 32 feature names; a variant is the family
+// compiled with "#define <FEATURE> 1" for every bit set in its mask, so the
+// hot shaders select features at compile time instead of branching.
+//
+// Variants are compiled lazily on first request. Until a variant is linked
+// GetProgram returns the family's fallback program (compiled synchronously
+// from embedded sources at Register), so a new permutation never stalls the
+// frame:
+// - GL_KHR_parallel_shader_compile: compile and link are issued right away
+//   and Poll() checks GL_COMPLETION_STATUS_KHR without blocking.
+// - Otherwise: Poll() compiles at most one queued variant per frame.
+// Variants go through the program binary cache (program_cache.h), so a
+// cached permutation is ready on the frame it is first requested.
+class ShaderLibrary {
+public:
+    static ShaderLibrary& Get();
+
+    ShaderLibrary(const ShaderLibrary&) = delete;
+    ShaderLibrary& operator=(const ShaderLibrary&) = delete;
+
+    // Requires a current GL context
+    void Init(const std::string& dir);
+
+    // Returns the family id. A family whose files are missing or fail to
+    // compile keeps drawing with the fallback.
+    int Register(const char* name, const std::vector<std::string>& features,
+                 const char* fallbackVs, const char* fallbackFs);
+
+    GLuint GetProgram(int family, uint32_t features);
+    GLuint GetFallback(int family) const { return m_Families[family].fallback; }
+    bool IsReady(int family, uint32_t features) const;
+
+    // Once per frame: finishes compiled variants and starts queued ones
+    void Poll();
+
+    const ShaderLibraryStats& GetStats() const { return m_Stats; }
+
+private:
+    ShaderLibrary() = default;
+
+    enum class VariantState { Queued, Compiling, Ready, Failed };
+    struct Variant {
+        VariantState state = VariantState::Queued;
+        GLuint program = 0;
+        GLuint vs = 0, fs = 0;
+        uint64_t cacheKey = 0;
+        std::string vsSource, fsSource; // with defines; freed once linked
+        std::chrono::high_resolution_clock::time_point requested;
+    };
+    struct Family {
+        std::string name;
+        std::vector<std::string> features;
+        std::string vs, fs; // file sources; empty if not found
+        GLuint fallback = 0;
+        std::unordered_map<uint32_t, Variant> variants;
+    };
+
+    void StartCompile(Variant& variant);
+    void FinishCompile(Family& family, uint32_t features, Variant& variant);
+
+    std::string m_Dir;
+    std::vector<Family> m_Families;
+    std::vector<std::pair<int, uint32_t>> m_Pending; // request order
+    ShaderLibraryStats m_Stats;
+    int m_FrameFallbacks = 0;
+};
+
+#endif // SHADER_LIBRARY_H
@@ -2,6 +2,11 @@
 #include <cmath>
 #include <algorithm>
 
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <emmintrin.h>
+#define MATH_UTILS_SSE2 1
+#endif
+
 Mat4 mat4_identity() {
     Mat4 r{};
     for (int i = 0; i < 16; ++i) r.m[i] = 0.0f;
@@ -50,6 +55,26 @@ void vec3_scale(const float v[3], float s, float o[3]) {
     o[2] = v[2] * s;
 }
 
+void vec3_array_offset(const float* src, const float delta[3], float* dst,
+                       size_t count, float minValue) {
+    const size_t n = count * 3;
+    size_t i = 0;
+#ifdef MATH_UTILS_SSE2
+    // Four triples are three registers; the delta pattern repeats with them
+    const __m128 d0 = _mm_setr_ps(delta[0], delta[1], delta[2], delta[0]);
+    const __m128 d1 = _mm_setr_ps(delta[1], delta[2], delta[0], delta[1]);
+    const __m128 d2 = _mm_setr_ps(delta[2], delta[0], delta[1], delta[2]);
+    const __m128 lo = _mm_set1_ps(minValue);
+    for (; i + 12 <= n; i += 12) {
+        _mm_storeu_ps(dst + i, _mm_max_ps(_mm_add_ps(_mm_loadu_ps(src + i), d0), lo));
+        _mm_storeu_ps(dst + i + 4, _mm_max_ps(_mm_add_ps(_mm_loadu_ps(src + i + 4), d1), lo));
+        _mm_storeu_ps(dst + i + 8, _mm_max_ps(_mm_add_ps(_mm_loadu_ps(src + i + 8), d2), lo));
+    }
+#endif
+    for (; i < n; ++i)
+        dst[i] = std::max(src[i] + delta[i % 3], minValue);
+}
+
 float point_to_line_distance(const Vec3& point, const Vec3& lineStart, const Vec3& lineEnd) {
     Vec3 line = lineEnd - lineStart;
     Vec3 toPoint = point - lineStart;
@@ -106,6 +131,15 @@ Mat4 mat4_perspective(float fovy_rad, float aspect, float znear, float zfar) {
     return r;
 }
 
+Mat4 mat4_orthographic(float halfWidth, float halfHeight, float znear, float zfar) {
+    Mat4 r = mat4_identity();
+    r.m[0] = 1.0f / halfWidth;
+    r.m[5] = 1.0f / halfHeight;
+    r.m[10] = 2.0f / (znear - zfar);
+    r.m[14] = (zfar + znear) / (znear - zfar);
+    return r;
+}
+
 Mat4 mat4_mul(const Mat4& a, const Mat4& b) {
     Mat4 r{};
     for (int c = 0; c < 4; ++c) {
@@ -116,6 +150,89 @@ Mat4 mat4_mul(const Mat4& a, const Mat4& b) {
     return r;
 }
 
+void mat4_transform_point(const Mat4& m, const float p[3], float out[3]) {
+    for (int r = 0; r < 3; ++r) {
+        out[r] = m.m[0 * 4 + r] * p[0] + m.m[1 * 4 + r] * p[1] + m.m[2 * 4 + r] * p[2] + m.m[3 * 4 + r];
+    }
+}
+
+Mat4 mat4_model_trs(const float pos[3], const float rotationDeg[3], const float scale[3]) {
+    Mat4 scaleM = mat4_identity();
+    scaleM.m[0] = scale[0];
+    scaleM.m[5] = scale[1];
+    scaleM.m[10] = scale[2];
+
+    float radX = rotationDeg[0] * 3.1415926f / 180.0f;
+    float radY = rotationDeg[1] * 3.1415926f / 180.0f;
+    float radZ = rotationDeg[2] * 3.1415926f / 180.0f;
+
+    Mat4 rotX = mat4_identity();
+    rotX.m[5] = std::cos(radX); rotX.m[6] = -std::sin(radX);
+    rotX.m[9] = std::sin(radX); rotX.m[10] = std::cos(radX);
+    Mat4 rotY = mat4_identity();
+    rotY.m[0] = std::cos(radY); rotY.m[2] = std::sin(radY);
+    rotY.m[8] = -std::sin(radY); rotY.m[10] = std::cos(radY);
+    Mat4 rotZ = mat4_identity();
+    rotZ.m[0] = std::cos(radZ); rotZ.m[1] = -std::sin(radZ);
+    rotZ.m[4] = std::sin(radZ); rotZ.m[5] = std::cos(radZ);
+
+    Mat4 model = mat4_mul(mat4_mul(mat4_mul(rotZ, rotY), rotX), scaleM);
+    model.m[12] = pos[0];
+    model.m[13] = pos[1];
+    model.m[14] = pos[2];
+    return model;
+}
+
+void frustum_planes(const Mat4& viewProj, float planes[6][4]) {
+    const float* m = viewProj.m;
+    for (int i = 0; i < 3; ++i) {
+        for (int k = 0; k < 4; ++k) {
+            planes[i * 2][k] = m[k * 4 + 3] + m[k * 4 + i];
+            planes[i * 2 + 1][k] = m[k * 4 + 3] - m[k * 4 + i];
+        }
+    }
+}
+
+FrustumClass frustum_classify_box(const float planes[6][4], const float box[6]) {
+    FrustumClass result = FRUSTUM_INSIDE;
+    for (int p = 0; p < 6; ++p) {
+        const float* pl = planes[p];
+        // Corner furthest along the plane normal, and the opposite one
+        float far = pl[3], near = pl[3];
+        for (int k = 0; k < 3; ++k) {
+            float lo = pl[k] * box[k], hi = pl[k] * box[3 + k];
+            far += std::max(lo, hi);
+            near += std::min(lo, hi);
+        }
+        if (far < 0.0f) return FRUSTUM_OUTSIDE;
+        if (near < 0.0f) result = FRUSTUM_PARTIAL;
+    }
+    return result;
+}
+
+void frustum_corners(const Mat4& view, const Mat4& proj, float corners[8][3]) {
+    const bool ortho = proj.m[15] == 1.0f;
+    float depth[2];
+    if (ortho) {
+        depth[0] = (proj.m[14] + 1.0f) / proj.m[10];
+        depth[1] = (proj.m[14] - 1.0f) / proj.m[10];
+    } else {
+        depth[0] = proj.m[14] / (proj.m[10] - 1.0f);
+        depth[1] = proj.m[14] / (proj.m[10] + 1.0f);
+    }
+    for (int i = 0; i < 8; ++i) {
+        const float d = depth[i >> 2];
+        // Half extents at that depth
+        const float sx = (ortho ? 1.0f : d) / proj.m[0];
+        const float sy = (ortho ? 1.0f : d) / proj.m[5];
+        const float p[3] = { (i & 1) ? sx : -sx, (i & 2) ? sy : -sy, -d };
+        // world = R^T * (p - t)
+        const float q[3] = { p[0] - view.m[12], p[1] - view.m[13], p[2] - view.m[14] };
+        for (int k = 0; k < 3; ++k)
+            corners[i][k] = view.m[k * 4] * q[0] + view.m[k * 4 + 1] * q[1] + view.m[k * 4 + 2] * q[2];
+    }
+}
+
 Mat4 create_view_matrix(const float pos[3], const float front[3], const float world_up[3]) {
     float zaxis[3] = { -front[0], -front[1], -front[2] }; // -front
     vec3_normalize(zaxis);
@@ -1,7 +1,9 @@
 #ifndef MATH_UTILS_H
 #define MATH_UTILS_H
 
+#include <cfloat>
 #include <cmath>
+#include <cstddef>
 
 struct Mat4 {
     float m[16];
@@ -29,9 +31,30 @@ void vec3_sub(const float a[3], const float b[3], float o[3]);
 void vec3_add(const float a[3], const float b[3], float o[3]);
 void vec3_scale(const float v[3], float s, float o[3]);
 Mat4 mat4_perspective(float fovy_rad, float aspect, float znear, float zfar);
+// Symmetric: x in [-halfWidth, halfWidth], y in [-halfHeight, halfHeight]
+Mat4 mat4_orthographic(float halfWidth, float halfHeight, float znear, float zfar);
 Mat4 mat4_mul(const Mat4& a, const Mat4& b);
+// out = m * (p, 1), sin division perspectiva
+void mat4_transform_point(const Mat4& m, const float p[3], float out[3]);
+// Model = T * Rz * Ry * Rx * S (rotation en grados)
+Mat4 mat4_model_trs(const float pos[3], const float rotationDeg[3], const float scale[3]);
 Mat4 create_view_matrix(const float pos[3], const float front[3], const float world_up[3]);
 
+// Frustum planes (a, b, c, d) of a view-projection matrix, inside when
+// a*x + b*y + c*z + d >= 0. Order: left, right, bottom, top, near, far
+void frustum_planes(const Mat4& viewProj, float planes[6][4]);
+enum FrustumClass { FRUSTUM_OUTSIDE, FRUSTUM_INSIDE, FRUSTUM_PARTIAL };
+// box = min xyz, max xyz
+FrustumClass frustum_classify_box(const float planes[6][4], const float box[6]);
+// World-space corners of the frustum of a view and a symmetric perspective
+// or orthographic projection (near face first)
+void frustum_corners(const Mat4& view, const Mat4& proj, float corners[8][3]);
+
+// Batched edit of count packed xyz triples (SSE2 when available):
+// dst[i] = max(src[i] + delta, minValue) per component. src may be dst.
+void vec3_array_offset(const float* src, const float delta[3], float* dst,
+                       size_t count, float minValue = -FLT_MAX);
+
 // Gizmo helper: distance from point to line segment
 float point_to_line_distance(const Vec3& point, const Vec3& lineStart, const Vec3& lineEnd);
 
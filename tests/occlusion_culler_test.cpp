@@ -0,0 +1,170 @@
+// Headless test and benchmark of OcclusionCuller (no GL context needed).
+//
+// Checks the rasterizer and the hi-Z test against a wall in front of the
+// camera, that TestBoxes agrees with IsVisible on and off the job system,
+// then times a frame of 20 walls and 20k small cubes.
+#include "../src/core/job_system.h"
+#include "../src/render/occlusion_culler.h"
+#include "../src/utils/math_utils.h"
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+static int g_Failures = 0;
+
+#define CHECK(cond)                                                            \
+  do {                                                                         \
+    if (!(cond)) {                                                             \
+      std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__,    \
+                   #cond);                                                     \
+      g_Failures++;                                                            \
+    }                                                                          \
+  } while (0)
+
+// Camera at the origin looking down -Z
+static Mat4 ViewProj() {
+  const float pos[3] = {0.0f, 0.0f, 0.0f};
+  const float front[3] = {0.0f, 0.0f, -1.0f};
+  const float up[3] = {0.0f, 1.0f, 0.0f};
+  const Mat4 view = create_view_matrix(pos, front, up);
+  const Mat4 proj = mat4_perspective(1.0471976f, 16.0f / 9.0f, 0.1f, 500.0f);
+  return mat4_mul(proj, view);
+}
+
+static Mat4 Box(float x, float y, float z, float sx, float sy, float sz) {
+  const float pos[3] = {x, y, z};
+  const float rotation[3] = {0.0f, 0.0f, 0.0f};
+  const float scale[3] = {sx, sy, sz};
+  return mat4_model_trs(pos, rotation, scale);
+}
+
+static void Bounds(float x, float y, float z, float half, float box[6]) {
+  box[0] = x - half;
+  box[1] = y - half;
+  box[2] = z - half;
+  box[3] = x + half;
+  box[4] = y + half;
+  box[5] = z + half;
+}
+
+static bool Visible(const OcclusionCuller &culler, float x, float y, float z,
+                    float half) {
+  float box[6];
+  Bounds(x, y, z, half, box);
+  return culler.IsVisible(box, box + 3);
+}
+
+static void TestWall() {
+  OcclusionCuller culler;
+  culler.SetResolution(256, 128);
+  culler.BeginFrame(ViewProj());
+  // 8 x 8 wall, 10 units ahead
+  culler.AddOccluder(Box(0.0f, 0.0f, -10.0f, 8.0f, 8.0f, 0.5f));
+  culler.BuildPyramid();
+
+  CHECK(culler.GetOccluderCount() == 1);
+  CHECK(culler.GetTriangleCount() > 0);
+  // The wall covers the center of the depth buffer, not its corners
+  const std::vector<float> &depth = culler.GetDepth();
+  const int w = culler.GetWidth(), h = culler.GetHeight();
+  CHECK(depth[(h / 2) * w + w / 2] < 1.0f);
+  CHECK(depth[0] == 1.0f);
+
+  CHECK(!Visible(culler, 0.0f, 0.0f, -30.0f, 0.5f));  // behind the wall
+  CHECK(!Visible(culler, 3.0f, -2.0f, -60.0f, 2.0f)); // far behind it
+  CHECK(Visible(culler, 0.0f, 0.0f, -5.0f, 0.5f));    // in front of it
+  CHECK(Visible(culler, 30.0f, 0.0f, -30.0f, 0.5f));  // beside it
+  CHECK(Visible(culler, 0.0f, 0.0f, -10.0f, 6.0f));   // through it
+  CHECK(!Visible(culler, 0.0f, 200.0f, -30.0f, 0.5f)); // off-screen
+}
+
+static void TestEmpty() {
+  // No occluders: only the frustum rejects
+  OcclusionCuller culler;
+  culler.SetResolution(256, 128);
+  culler.BeginFrame(ViewProj());
+  culler.BuildPyramid();
+  CHECK(Visible(culler, 0.0f, 0.0f, -400.0f, 0.5f));
+  CHECK(!Visible(culler, 0.0f, 0.0f, -600.0f, 0.5f)); // past the far plane
+}
+
+static void TestBoxesMatch() {
+  OcclusionCuller culler;
+  culler.SetResolution(256, 128);
+  culler.BeginFrame(ViewProj());
+  culler.AddOccluder(Box(-6.0f, 0.0f, -12.0f, 10.0f, 14.0f, 0.5f));
+  culler.AddOccluder(Box(6.0f, 2.0f, -16.0f, 10.0f, 10.0f, 0.5f));
+  culler.BuildPyramid();
+
+  // Enough boxes to take the job system path
+  const size_t count = 5000;
+  std::vector<float> boxes(count * 6);
+  for (size_t i = 0; i < count; ++i)
+    Bounds((float)(i % 50) - 25.0f, (float)(i / 50 % 20) - 10.0f,
+           -8.0f - (float)(i / 1000) * 10.0f, 0.4f, &boxes[i * 6]);
+
+  std::vector<char> serial, parallel;
+  const size_t hiddenSerial = culler.TestBoxes(boxes.data(), count, serial,
+                                               nullptr);
+  const size_t hiddenParallel = culler.TestBoxes(boxes.data(), count,
+                                                 parallel, &JobSystem::Get());
+  CHECK(hiddenSerial == hiddenParallel);
+  CHECK(serial == parallel);
+  CHECK(hiddenSerial > 0 && hiddenSerial < count);
+  size_t mismatches = 0;
+  for (size_t i = 0; i < count; ++i)
+    mismatches += (serial[i] != 0) !=
+                  culler.IsVisible(&boxes[i * 6], &boxes[i * 6 + 3]);
+  CHECK(mismatches == 0);
+}
+
+static void Benchmark() {
+  const Mat4 viewProj = ViewProj();
+  std::vector<Mat4> walls;
+  for (int i = 0; i < 20; ++i)
+    walls.push_back(Box((float)(i % 5) * 8.0f - 16.0f,
+                        (float)(i / 5) * 6.0f - 9.0f, -15.0f, 6.0f, 5.0f,
+                        0.5f)); // gaps between them
+  const size_t count = 20000;
+  std::vector<float> boxes(count * 6);
+  for (size_t i = 0; i < count; ++i)
+    Bounds((float)(i % 100) * 0.4f - 20.0f,
+           (float)(i / 100 % 50) * 0.3f - 7.5f,
+           -20.0f - (float)(i / 5000) * 5.0f, 0.1f, &boxes[i * 6]);
+
+  OcclusionCuller culler;
+  culler.SetResolution(256, 128);
+  std::vector<char> visible;
+  const int frames = 50;
+  size_t hidden = 0;
+  const auto start = std::chrono::high_resolution_clock::now();
+  for (int frame = 0; frame < frames; ++frame) {
+    culler.BeginFrame(viewProj);
+    for (const Mat4 &wall : walls)
+      culler.AddOccluder(wall);
+    culler.BuildPyramid();
+    hidden = culler.TestBoxes(boxes.data(), count, visible, &JobSystem::Get());
+  }
+  const float ms = std::chrono::duration<float, std::milli>(
+                       std::chrono::high_resolution_clock::now() - start)
+                       .count() /
+                   frames;
+  std::printf("occlusion: %zu of %zu cubes hidden by %d walls, %.3f ms/frame "
+              "(%u threads)\n",
+              hidden, count, (int)walls.size(), ms,
+              JobSystem::Get().GetThreadCount());
+  CHECK(hidden > count / 2 && hidden < count);
+}
+
+int main() {
+  TestWall();
+  TestEmpty();
+  TestBoxesMatch();
+  Benchmark();
+  if (g_Failures) {
+    std::fprintf(stderr, "%d check(s) failed\n", g_Failures);
+    return 1;
+  }
+  std::printf("occlusion_culler_test: ok\n");
+  return 0;
+}